@@ -15,6 +15,7 @@
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_audio.h"
 #include "allegro5/internal/aintern_audio_cfg.h"
+#include "allegro5/internal/aintern_profile.h"
 
 ALLEGRO_DEBUG_CHANNEL("audio")
 
@@ -345,12 +346,12 @@ MAKE_MIXER(read_to_mixer_linear_int16_t_16, linear_spl16, int16_t)
 #undef MAKE_MIXER
 
 
-/* _al_kcm_mixer_read:
+/* mixer_read:
  *  Mixes the streams attached to the mixer and writes additively to the
  *  specified buffer (or if *buf is NULL, indicating a voice, convert it and
  *  set it to the buffer pointer).
  */
-void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
+static void mixer_read(void *source, void **buf, unsigned int *samples,
    ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc)
 {
    const ALLEGRO_MIXER *mixer;
@@ -604,6 +605,18 @@ void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
 }
 
 
+/* _al_kcm_mixer_read:
+ *  The sample reader of mixers; see mixer_read.
+ */
+void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
+   ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc)
+{
+   _AL_PROFILE_BEGIN("mix audio");
+   mixer_read(source, buf, samples, buffer_depth, dest_maxc);
+   _AL_PROFILE_END();
+}
+
+
 /* Function: al_create_mixer
  */
 ALLEGRO_MIXER *al_create_mixer(unsigned int freq,
@@ -667,7 +680,7 @@ ALLEGRO_MIXER *al_create_mixer(unsigned int freq,
 
    _al_vector_init(&mixer->streams, sizeof(ALLEGRO_SAMPLE_INSTANCE *));
 
-   mixer->dtor_item = _al_kcm_register_destructor("mixer", mixer, (void (*)(void *)) al_destroy_mixer);
+   _al_kcm_register_destructor(&mixer->dtor_item, "mixer", mixer, (void (*)(void *)) al_destroy_mixer);
 
    return mixer;
 }
@@ -678,7 +691,7 @@ ALLEGRO_MIXER *al_create_mixer(unsigned int freq,
 void al_destroy_mixer(ALLEGRO_MIXER *mixer)
 {
    if (mixer) {
-      _al_kcm_unregister_destructor(mixer->dtor_item);
+      _al_kcm_unregister_destructor(&mixer->dtor_item);
       _al_kcm_destroy_sample(&mixer->ss, false);
    }
 }
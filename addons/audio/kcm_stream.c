@@ -13,6 +13,7 @@
 #include "allegro5/allegro_audio.h"
 #include "allegro5/internal/aintern_audio.h"
 #include "allegro5/internal/aintern_audio_cfg.h"
+#include "allegro5/internal/aintern_profile.h"
 
 ALLEGRO_DEBUG_CHANNEL("audio")
 
@@ -135,7 +136,7 @@ ALLEGRO_AUDIO_STREAM *al_create_audio_stream(size_t fragment_count,
    al_init_user_event_source(&stream->spl.es);
 
    /* This can lead to deadlocks on shutdown, hence we don't do it. */
-   /* stream->dtor_item = _al_kcm_register_destructor(stream, (void (*)(void *)) al_destroy_audio_stream); */
+   /* _al_kcm_register_destructor(&stream->dtor_item, stream, (void (*)(void *)) al_destroy_audio_stream); */
 
    return stream;
 }
@@ -150,7 +151,7 @@ void al_destroy_audio_stream(ALLEGRO_AUDIO_STREAM *stream)
          stream->unload_feeder(stream);
       }
       /* See commented out call to _al_kcm_register_destructor. */
-      /* _al_kcm_unregister_destructor(stream->dtor_item); */
+      /* _al_kcm_unregister_destructor(&stream->dtor_item); */
       _al_kcm_detach_from_parent(&stream->spl);
 
       al_destroy_user_event_source(&stream->spl.es);
@@ -708,9 +709,11 @@ void *_al_kcm_feed_stream(ALLEGRO_THREAD *self, void *vstream)
                al_get_channel_count(stream->spl.spl_data.chan_conf) *
                al_get_audio_depth_size(stream->spl.spl_data.depth);
 
+         _AL_PROFILE_BEGIN("feed audio stream");
          stream_mutex = maybe_lock_mutex(stream->spl.mutex);
          bytes_written = stream->feeder(stream, fragment, bytes);
          maybe_unlock_mutex(stream_mutex);
+         _AL_PROFILE_END();
 
          if (stream->spl.loop == _ALLEGRO_PLAYMODE_STREAM_ONEDIR) {
             /* Keep rewinding until the fragment is filled. */
@@ -1,6 +1,7 @@
 #ifndef __al_included_allegro_aintern_font_h
 #define __al_included_allegro_aintern_font_h
 
+#include "allegro5/internal/aintern_dtor.h"
 #include "allegro5/internal/aintern_list.h"
 
 typedef struct ALLEGRO_FONT_VTABLE ALLEGRO_FONT_VTABLE;
@@ -11,7 +12,7 @@ struct ALLEGRO_FONT
    int height;
    ALLEGRO_FONT *fallback;
    ALLEGRO_FONT_VTABLE *vtable;
-   _AL_LIST_ITEM *dtor_item;
+   _AL_DTOR_ITEM dtor_item;
 };
 
 /* text- and font-related stuff */
@@ -33,6 +33,12 @@ extern "C" {
 ALLEGRO_MEMFILE_FUNC(ALLEGRO_FILE *, al_open_memfile, (void *mem, int64_t size, const char *mode));
 ALLEGRO_MEMFILE_FUNC(uint32_t, al_get_allegro_memfile_version, (void));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_MEMFILE_SRC)
+ALLEGRO_MEMFILE_FUNC(ALLEGRO_FILE *, al_open_growable_memfile, (int64_t initial_capacity));
+ALLEGRO_MEMFILE_FUNC(void *, al_detach_memfile_buffer, (ALLEGRO_FILE *fp, int64_t *ret_size));
+ALLEGRO_MEMFILE_FUNC(ALLEGRO_FILE *, al_share_memfile, (ALLEGRO_FILE *fp));
+#endif
+
 #ifdef __cplusplus
 }
 #endif
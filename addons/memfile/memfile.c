@@ -1,21 +1,86 @@
 #include <allegro5/allegro.h>
 #include "allegro5/allegro_memfile.h"
+#include "allegro5/internal/aintern_file.h"
 
 typedef struct ALLEGRO_FILE_MEMFILE ALLEGRO_FILE_MEMFILE;
+typedef struct MEMFILE_BLOCK MEMFILE_BLOCK;
+
+/* Minimum capacity a growable memfile starts with. */
+#define MIN_CAPACITY    64
+
+/* A growable buffer which has been shared between several handles.
+ * It is immutable from then on and freed with the last handle.
+ */
+struct MEMFILE_BLOCK {
+   ALLEGRO_MUTEX *mutex;
+   int refcount;
+   char *mem;
+};
 
 struct ALLEGRO_FILE_MEMFILE {
    bool readable;
    bool writable;
+   bool growable;    /* mem is ours and is reallocated on writes */
    
    bool eof;
    int64_t size;
    int64_t pos;
+   int64_t capacity;
    char *mem;
+   MEMFILE_BLOCK *block;
 };
 
+static void release_block(MEMFILE_BLOCK *block)
+{
+   int refcount;
+
+   al_lock_mutex(block->mutex);
+   refcount = --block->refcount;
+   al_unlock_mutex(block->mutex);
+
+   if (refcount == 0) {
+      al_destroy_mutex(block->mutex);
+      al_free(block->mem);
+      al_free(block);
+   }
+}
+
 static bool memfile_fclose(ALLEGRO_FILE *fp)
 {
-   al_free(al_get_file_userdata(fp));
+   ALLEGRO_FILE_MEMFILE *mf = al_get_file_userdata(fp);
+
+   if (mf->block)
+      release_block(mf->block);
+   else if (mf->growable)
+      al_free(mf->mem);
+
+   al_free(mf);
+   return true;
+}
+
+static bool memfile_grow(ALLEGRO_FILE_MEMFILE *mf, int64_t needed)
+{
+   int64_t capacity = mf->capacity;
+   char *mem;
+
+   if (capacity < MIN_CAPACITY)
+      capacity = MIN_CAPACITY;
+   while (capacity < needed)
+      capacity *= 2;
+
+   if ((int64_t)(size_t)capacity != capacity) {
+      al_set_errno(ENOMEM);
+      return false;
+   }
+
+   mem = al_realloc(mf->mem, capacity);
+   if (!mem) {
+      al_set_errno(ENOMEM);
+      return false;
+   }
+
+   mf->mem = mem;
+   mf->capacity = capacity;
    return true;
 }
 
@@ -54,6 +119,18 @@ static size_t memfile_fwrite(ALLEGRO_FILE *fp, const void *ptr, size_t size)
       return 0;
    }   
    
+   if (mf->growable) {
+      if (mf->pos + (int64_t)size > mf->capacity &&
+            !memfile_grow(mf, mf->pos + size)) {
+         return 0;
+      }
+      memcpy(mf->mem + mf->pos, ptr, size);
+      mf->pos += size;
+      if (mf->pos > mf->size)
+         mf->size = mf->pos;
+      return size;
+   }
+
    if (mf->size - mf->pos < (int64_t)size) {
       /* partial write */
       n = mf->size - mf->pos;
@@ -148,6 +225,41 @@ static off_t memfile_fsize(ALLEGRO_FILE *fp)
    return mf->size;
 }
 
+static size_t memfile_ffill(ALLEGRO_FILE *fp)
+{
+   ALLEGRO_FILE_MEMFILE *mf = al_get_file_userdata(fp);
+   size_t n;
+
+   if (!mf->readable || mf->pos >= mf->size)
+      return 0;
+
+   /* The rest of the block becomes the read window. */
+   n = mf->size - mf->pos;
+   fp->window_pos = (unsigned char *)mf->mem + mf->pos;
+   fp->window_end = fp->window_pos + n;
+   mf->pos = mf->size;
+   return n;
+}
+
+static const void *memfile_fview(ALLEGRO_FILE *fp, int64_t offset,
+   size_t *size)
+{
+   ALLEGRO_FILE_MEMFILE *mf = al_get_file_userdata(fp);
+
+   /* Views must stay valid until the file is closed, which a buffer that
+    * may still be reallocated cannot promise.
+    */
+   if (!mf->readable || (mf->growable && mf->writable) || offset > mf->size) {
+      *size = 0;
+      return NULL;
+   }
+
+   if (mf->size - offset < (int64_t)*size)
+      *size = mf->size - offset;
+
+   return mf->mem + offset;
+}
+
 static struct ALLEGRO_FILE_INTERFACE memfile_vtable = {
    NULL,    /* open */
    memfile_fclose,
@@ -164,6 +276,26 @@ static struct ALLEGRO_FILE_INTERFACE memfile_vtable = {
    memfile_fsize
 };
 
+static const _AL_FILE_EXTENSION memfile_ext = {
+   memfile_fview,
+   memfile_ffill
+};
+
+static ALLEGRO_FILE *create_memfile(ALLEGRO_FILE_MEMFILE *userdata)
+{
+   static bool registered = false;
+
+   /* The addon has no initialisation function, so register the extension
+    * the first time a memfile is made.  Registering again is harmless.
+    */
+   if (!registered) {
+      _al_register_file_extension(&memfile_vtable, &memfile_ext);
+      registered = true;
+   }
+
+   return al_create_file_handle(&memfile_vtable, userdata);
+}
+
 /* Function: al_open_memfile
  */
 ALLEGRO_FILE *al_open_memfile(void *mem, int64_t size, const char *mode)
@@ -183,13 +315,145 @@ ALLEGRO_FILE *al_open_memfile(void *mem, int64_t size, const char *mode)
    memset(userdata, 0, sizeof(*userdata));
    userdata->size = size;
    userdata->pos = 0;
+   userdata->capacity = size;
    userdata->mem = mem;
    
    userdata->readable = strchr(mode, 'r') || strchr(mode, 'R');
    userdata->writable = strchr(mode, 'w') || strchr(mode, 'W');
       
-   memfile = al_create_file_handle(&memfile_vtable, userdata);
+   memfile = create_memfile(userdata);
+   if (!memfile) {
+      al_free(userdata);
+   }
+
+   return memfile;
+}
+
+/* Function: al_open_growable_memfile
+ */
+ALLEGRO_FILE *al_open_growable_memfile(int64_t initial_capacity)
+{
+   ALLEGRO_FILE *memfile;
+   ALLEGRO_FILE_MEMFILE *userdata = NULL;
+
+   ASSERT(initial_capacity >= 0);
+
+   userdata = al_calloc(1, sizeof(ALLEGRO_FILE_MEMFILE));
+   if (!userdata) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+
+   userdata->readable = true;
+   userdata->writable = true;
+   userdata->growable = true;
+
+   if (initial_capacity > 0 && !memfile_grow(userdata, initial_capacity)) {
+      al_free(userdata);
+      return NULL;
+   }
+
+   memfile = create_memfile(userdata);
+   if (!memfile) {
+      al_free(userdata->mem);
+      al_free(userdata);
+   }
+
+   return memfile;
+}
+
+/* Function: al_detach_memfile_buffer
+ */
+void *al_detach_memfile_buffer(ALLEGRO_FILE *fp, int64_t *ret_size)
+{
+   ALLEGRO_FILE_MEMFILE *mf;
+   void *mem;
+   ASSERT(fp);
+   ASSERT(al_get_file_userdata(fp));
+
+   mf = al_get_file_userdata(fp);
+   if (!mf->growable || mf->block) {
+      al_set_errno(EPERM);
+      return NULL;
+   }
+
+   /* The read window may point into the buffer we are handing out. */
+   _al_discard_file_buffers(fp);
+
+   mem = mf->mem;
+   if (ret_size)
+      *ret_size = mf->size;
+
+   mf->mem = NULL;
+   mf->size = 0;
+   mf->pos = 0;
+   mf->capacity = 0;
+   mf->eof = false;
+
+   if (!mem) {
+      /* Nothing was written yet; still hand out a buffer the caller can
+       * pass to al_free.
+       */
+      mem = al_malloc(1);
+      if (!mem)
+         al_set_errno(ENOMEM);
+   }
+
+   return mem;
+}
+
+/* Function: al_share_memfile
+ */
+ALLEGRO_FILE *al_share_memfile(ALLEGRO_FILE *fp)
+{
+   ALLEGRO_FILE_MEMFILE *mf;
+   ALLEGRO_FILE_MEMFILE *userdata;
+   ALLEGRO_FILE *memfile;
+   ASSERT(fp);
+   ASSERT(al_get_file_userdata(fp));
+
+   mf = al_get_file_userdata(fp);
+
+   userdata = al_malloc(sizeof(ALLEGRO_FILE_MEMFILE));
+   if (!userdata) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+
+   if (mf->growable && !mf->block) {
+      /* From now on the buffer is shared and may no longer move. */
+      MEMFILE_BLOCK *block = al_malloc(sizeof(MEMFILE_BLOCK));
+      ALLEGRO_MUTEX *mutex = al_create_mutex();
+      if (!block || !mutex) {
+         al_free(block);
+         al_destroy_mutex(mutex);
+         al_free(userdata);
+         al_set_errno(ENOMEM);
+         return NULL;
+      }
+      block->mutex = mutex;
+      block->refcount = 1;
+      block->mem = mf->mem;
+      mf->block = block;
+      mf->writable = false;
+   }
+
+   *userdata = *mf;
+   userdata->readable = true;
+   userdata->writable = false;
+   userdata->eof = false;
+   userdata->pos = 0;
+
+   if (userdata->block) {
+      al_lock_mutex(userdata->block->mutex);
+      userdata->block->refcount++;
+      al_unlock_mutex(userdata->block->mutex);
+   }
+
+   memfile = create_memfile(userdata);
    if (!memfile) {
+      if (userdata->block)
+         release_block(userdata->block);
       al_free(userdata);
    }
 
@@ -7,19 +7,54 @@
 #include <physfs.h>
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_physfs.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_file.h"
 
 #include "allegro_physfs_intern.h"
 
 
+/* Default size of the read-ahead buffer of each file. */
+#define DEFAULT_BUFFER_SIZE   16384
+
+
 typedef struct ALLEGRO_FILE_PHYSFS ALLEGRO_FILE_PHYSFS;
+typedef struct CACHE_ENTRY CACHE_ENTRY;
+
+/* The whole, decompressed contents of a file, shared by all handles open
+ * on it.
+ */
+struct CACHE_ENTRY
+{
+   char *path;
+   unsigned char *data;
+   int64_t size;
+   int refcount;              /* open handles, plus one while cached */
+   CACHE_ENTRY *prev;         /* LRU list, most recently used first */
+   CACHE_ENTRY *next;
+};
 
 struct ALLEGRO_FILE_PHYSFS
 {
-   PHYSFS_file *phys;
+   PHYSFS_file *phys;         /* NULL for files served from the cache */
+   CACHE_ENTRY *cached;
+   int64_t pos;               /* position in cached->data */
+   bool eof;
+   unsigned char *buffer;     /* read-ahead buffer */
+   size_t buffer_size;
    bool error_indicator;
    char error_msg[80];
 };
 
+
+static size_t buffer_size = DEFAULT_BUFFER_SIZE;
+
+static ALLEGRO_MUTEX *cache_mutex;
+static CACHE_ENTRY *cache_head;
+static CACHE_ENTRY *cache_tail;
+static size_t cache_limit;
+static size_t cache_used;
+
 /* forward declaration */
 static const ALLEGRO_FILE_INTERFACE file_phys_vtable;
 
@@ -32,6 +67,190 @@ const ALLEGRO_FILE_INTERFACE *_al_get_phys_vtable(void)
 #define streq(a, b)  (0 == strcmp(a, b))
 
 
+/* Must be called with cache_mutex held. */
+static void cache_unlink(CACHE_ENTRY *ce)
+{
+   if (ce->prev)
+      ce->prev->next = ce->next;
+   else
+      cache_head = ce->next;
+   if (ce->next)
+      ce->next->prev = ce->prev;
+   else
+      cache_tail = ce->prev;
+   ce->prev = ce->next = NULL;
+}
+
+
+/* Must be called with cache_mutex held. */
+static void cache_link_front(CACHE_ENTRY *ce)
+{
+   ce->prev = NULL;
+   ce->next = cache_head;
+   if (cache_head)
+      cache_head->prev = ce;
+   else
+      cache_tail = ce;
+   cache_head = ce;
+}
+
+
+/* Must be called with cache_mutex held. */
+static void cache_release(CACHE_ENTRY *ce)
+{
+   if (--ce->refcount == 0) {
+      al_free(ce->path);
+      al_free(ce->data);
+      al_free(ce);
+   }
+}
+
+
+/* Must be called with cache_mutex held. */
+static void cache_remove(CACHE_ENTRY *ce)
+{
+   cache_unlink(ce);
+   cache_used -= ce->size;
+   cache_release(ce);
+}
+
+
+/* Must be called with cache_mutex held. */
+static void cache_trim(size_t limit)
+{
+   while (cache_tail && cache_used > limit) {
+      cache_remove(cache_tail);
+   }
+}
+
+
+/* Must be called with cache_mutex held.  Takes a reference. */
+static CACHE_ENTRY *cache_find(const char *path)
+{
+   CACHE_ENTRY *ce;
+
+   for (ce = cache_head; ce; ce = ce->next) {
+      if (streq(ce->path, path)) {
+         cache_unlink(ce);
+         cache_link_front(ce);
+         ce->refcount++;
+         return ce;
+      }
+   }
+   return NULL;
+}
+
+
+/* Returns the cached entry for `path` with a reference for the caller, or
+ * NULL if it is not cached or the cache is disabled.
+ */
+static CACHE_ENTRY *cache_lookup(const char *path)
+{
+   CACHE_ENTRY *ce = NULL;
+
+   if (!cache_mutex)
+      return NULL;
+
+   al_lock_mutex(cache_mutex);
+   if (cache_limit > 0)
+      ce = cache_find(path);
+   al_unlock_mutex(cache_mutex);
+   return ce;
+}
+
+
+static void cache_invalidate(const char *path)
+{
+   CACHE_ENTRY *ce;
+
+   if (!cache_mutex)
+      return;
+
+   al_lock_mutex(cache_mutex);
+   for (ce = cache_head; ce; ce = ce->next) {
+      if (streq(ce->path, path)) {
+         cache_remove(ce);
+         break;
+      }
+   }
+   al_unlock_mutex(cache_mutex);
+}
+
+
+/* Read the whole of `phys` into a new cache entry and close it.  Returns
+ * the entry with a reference for the caller, or NULL if the file is not
+ * worth caching, in which case `phys` is left open.
+ */
+static CACHE_ENTRY *cache_load(const char *path, PHYSFS_file *phys)
+{
+   CACHE_ENTRY *ce;
+   CACHE_ENTRY *other;
+   PHYSFS_sint64 len;
+   size_t path_size;
+   size_t limit;
+
+   if (!cache_mutex)
+      return NULL;
+
+   al_lock_mutex(cache_mutex);
+   limit = cache_limit;
+   al_unlock_mutex(cache_mutex);
+
+   /* Files which would push out a large part of the cache go uncached. */
+   len = PHYSFS_fileLength(phys);
+   if (limit == 0 || len < 0 || (uint64_t)len > limit / 4)
+      return NULL;
+
+   path_size = strlen(path) + 1;
+   ce = al_calloc(1, sizeof(*ce));
+   if (!ce)
+      return NULL;
+   ce->path = al_malloc(path_size);
+   ce->data = al_malloc(len ? len : 1);
+   if (!ce->path || !ce->data ||
+         PHYSFS_read(phys, ce->data, 1, len) != len) {
+      al_free(ce->path);
+      al_free(ce->data);
+      al_free(ce);
+      PHYSFS_seek(phys, 0);
+      return NULL;
+   }
+   memcpy(ce->path, path, path_size);
+   ce->size = len;
+   ce->refcount = 2;
+   PHYSFS_close(phys);
+
+   al_lock_mutex(cache_mutex);
+   /* Another thread may have loaded the same file in the meantime. */
+   other = cache_find(path);
+   if (other) {
+      al_unlock_mutex(cache_mutex);
+      al_free(ce->path);
+      al_free(ce->data);
+      al_free(ce);
+      return other;
+   }
+   cache_link_front(ce);
+   cache_used += ce->size;
+   cache_trim(cache_limit);
+   al_unlock_mutex(cache_mutex);
+
+   return ce;
+}
+
+
+static void shutdown_cache(void)
+{
+   /* Entries still open stay alive until their handles are closed. */
+   al_lock_mutex(cache_mutex);
+   cache_trim(0);
+   cache_limit = 0;
+   al_unlock_mutex(cache_mutex);
+   al_destroy_mutex(cache_mutex);
+   cache_mutex = NULL;
+}
+
+
 static ALLEGRO_FILE_PHYSFS *cast_stream(ALLEGRO_FILE *f)
 {
    return (ALLEGRO_FILE_PHYSFS *)al_get_file_userdata(f);
@@ -68,6 +287,24 @@ static void *file_phys_fopen(const char *filename, const char *mode)
 
    us = _al_physfs_apply_cwd(filename);
 
+   fp = al_calloc(1, sizeof(*fp));
+   if (!fp) {
+      al_set_errno(ENOMEM);
+      al_ustr_free(us);
+      return NULL;
+   }
+
+   if (!(streq(mode, "r") || streq(mode, "rb"))) {
+      cache_invalidate(al_cstr(us));
+   }
+   else {
+      fp->cached = cache_lookup(al_cstr(us));
+      if (fp->cached) {
+         al_ustr_free(us);
+         return fp;
+      }
+   }
+
    /* XXX handle '+' modes */
    /* It might be worth adding a function to parse mode strings, to be
     * shared amongst these kinds of addons.
@@ -81,24 +318,36 @@ static void *file_phys_fopen(const char *filename, const char *mode)
    else
       phys = NULL;
 
-   al_ustr_free(us);
-
    if (!phys) {
       phys_set_errno(NULL);
+      al_ustr_free(us);
+      al_free(fp);
       return NULL;
    }
 
-   fp = al_malloc(sizeof(*fp));
-   if (!fp) {
-      al_set_errno(ENOMEM);
-      PHYSFS_close(phys);
-      return NULL;
+   if (streq(mode, "r") || streq(mode, "rb")) {
+      fp->cached = cache_load(al_cstr(us), phys);
+      if (fp->cached) {
+         al_ustr_free(us);
+         return fp;
+      }
    }
 
+   al_ustr_free(us);
+
    fp->phys = phys;
    fp->error_indicator = false;
    fp->error_msg[0] = '\0';
 
+   /* Without a buffer, every small read would go through PhysicsFS and,
+    * for compressed archives, through the decompressor.
+    */
+   if (buffer_size > 0 && (streq(mode, "r") || streq(mode, "rb"))) {
+      fp->buffer = al_malloc(buffer_size);
+      if (fp->buffer)
+         fp->buffer_size = buffer_size;
+   }
+
    return fp;
 }
 
@@ -108,6 +357,20 @@ static bool file_phys_fclose(ALLEGRO_FILE *f)
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
    PHYSFS_file *phys_fp = fp->phys;
 
+   if (fp->cached) {
+      if (cache_mutex) {
+         al_lock_mutex(cache_mutex);
+         cache_release(fp->cached);
+         al_unlock_mutex(cache_mutex);
+      }
+      else {
+         cache_release(fp->cached);
+      }
+      al_free(fp);
+      return true;
+   }
+
+   al_free(fp->buffer);
    al_free(fp);
 
    if (PHYSFS_close(phys_fp) != 0) {
@@ -127,6 +390,17 @@ static size_t file_phys_fread(ALLEGRO_FILE *f, void *buf, size_t buf_size)
    if (buf_size == 0)
       return 0;
 
+   if (fp->cached) {
+      if (fp->cached->size - fp->pos < (int64_t)buf_size) {
+         buf_size = (fp->pos < fp->cached->size) ?
+            fp->cached->size - fp->pos : 0;
+         fp->eof = true;
+      }
+      memcpy(buf, fp->cached->data + fp->pos, buf_size);
+      fp->pos += buf_size;
+      return buf_size;
+   }
+
    n = PHYSFS_read(fp->phys, buf, 1, buf_size);
    if (n < 0) {
       phys_set_errno(fp);
@@ -142,6 +416,11 @@ static size_t file_phys_fwrite(ALLEGRO_FILE *f, const void *buf,
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
    PHYSFS_sint64 n;
 
+   if (fp->cached) {
+      al_set_errno(EBADF);
+      return 0;
+   }
+
    n = PHYSFS_write(fp->phys, buf, 1, buf_size);
    if (n < 0) {
       phys_set_errno(fp);
@@ -156,6 +435,9 @@ static bool file_phys_fflush(ALLEGRO_FILE *f)
 {
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
 
+   if (fp->cached)
+      return true;
+
    if (!PHYSFS_flush(fp->phys)) {
       phys_set_errno(fp);
       return false;
@@ -170,6 +452,9 @@ static int64_t file_phys_ftell(ALLEGRO_FILE *f)
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
    PHYSFS_sint64 n;
 
+   if (fp->cached)
+      return fp->pos;
+
    n = PHYSFS_tell(fp->phys);
    if (n < 0) {
       phys_set_errno(fp);
@@ -191,7 +476,7 @@ static bool file_phys_seek(ALLEGRO_FILE *f, int64_t offset, int whence)
          break;
 
       case ALLEGRO_SEEK_CUR:
-         base = PHYSFS_tell(fp->phys);
+         base = fp->cached ? fp->pos : PHYSFS_tell(fp->phys);
          if (base < 0) {
             phys_set_errno(fp);
             return false;
@@ -199,7 +484,7 @@ static bool file_phys_seek(ALLEGRO_FILE *f, int64_t offset, int whence)
          break;
 
       case ALLEGRO_SEEK_END:
-         base = PHYSFS_fileLength(fp->phys);
+         base = fp->cached ? fp->cached->size : PHYSFS_fileLength(fp->phys);
          if (base < 0) {
             phys_set_errno(fp);
             return false;
@@ -211,6 +496,17 @@ static bool file_phys_seek(ALLEGRO_FILE *f, int64_t offset, int whence)
          return false;
    }
 
+   if (fp->cached) {
+      /* Like PHYSFS_seek, refuse to seek outside the file. */
+      if (base + offset < 0 || base + offset > fp->cached->size) {
+         al_set_errno(EINVAL);
+         return false;
+      }
+      fp->pos = base + offset;
+      fp->eof = false;
+      return true;
+   }
+
    if (!PHYSFS_seek(fp->phys, base + offset)) {
       phys_set_errno(fp);
       return false;
@@ -224,6 +520,9 @@ static bool file_phys_feof(ALLEGRO_FILE *f)
 {
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
 
+   if (fp->cached)
+      return fp->eof;
+
    return PHYSFS_eof(fp->phys);
 }
 
@@ -252,6 +551,7 @@ static void file_phys_fclearerr(ALLEGRO_FILE *f)
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
 
    fp->error_indicator = false;
+   fp->eof = false;
 
    /* PhysicsFS doesn't provide a way to clear the EOF indicator. */
 }
@@ -262,6 +562,9 @@ static off_t file_phys_fsize(ALLEGRO_FILE *f)
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
    PHYSFS_sint64 n;
 
+   if (fp->cached)
+      return fp->cached->size;
+
    n = PHYSFS_fileLength(fp->phys);
    if (n < 0) {
       phys_set_errno(fp);
@@ -272,6 +575,54 @@ static off_t file_phys_fsize(ALLEGRO_FILE *f)
 }
 
 
+static const void *file_phys_fview(ALLEGRO_FILE *f, int64_t offset,
+   size_t *size)
+{
+   ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
+
+   if (!fp->cached || offset > fp->cached->size) {
+      *size = 0;
+      return NULL;
+   }
+
+   if (fp->cached->size - offset < (int64_t)*size)
+      *size = fp->cached->size - offset;
+
+   return fp->cached->data + offset;
+}
+
+
+static size_t file_phys_ffill(ALLEGRO_FILE *f)
+{
+   ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
+   PHYSFS_sint64 n;
+
+   if (fp->cached) {
+      if (fp->pos >= fp->cached->size) {
+         fp->eof = true;
+         return 0;
+      }
+      n = fp->cached->size - fp->pos;
+      f->window_pos = fp->cached->data + fp->pos;
+      fp->pos = fp->cached->size;
+   }
+   else {
+      if (!fp->buffer)
+         return 0;
+      n = PHYSFS_read(fp->phys, fp->buffer, 1, fp->buffer_size);
+      if (n <= 0) {
+         if (n < 0)
+            phys_set_errno(fp);
+         return 0;
+      }
+      f->window_pos = fp->buffer;
+   }
+
+   f->window_end = f->window_pos + n;
+   return n;
+}
+
+
 static const ALLEGRO_FILE_INTERFACE file_phys_vtable =
 {
    file_phys_fopen,
@@ -290,15 +641,51 @@ static const ALLEGRO_FILE_INTERFACE file_phys_vtable =
 };
 
 
+static const _AL_FILE_EXTENSION file_phys_ext =
+{
+   file_phys_fview,
+   file_phys_ffill
+};
+
+
 /* Function: al_set_physfs_file_interface
  */
 void al_set_physfs_file_interface(void)
 {
+   _al_register_file_extension(&file_phys_vtable, &file_phys_ext);
    al_set_new_file_interface(&file_phys_vtable);
    _al_set_physfs_fs_interface();
 }
 
 
+/* Function: al_set_physfs_buffer_size
+ */
+void al_set_physfs_buffer_size(size_t size)
+{
+   buffer_size = size;
+}
+
+
+/* Function: al_set_physfs_cache_size
+ */
+void al_set_physfs_cache_size(size_t size)
+{
+   if (!cache_mutex) {
+      if (size == 0)
+         return;
+      cache_mutex = al_create_mutex();
+      if (!cache_mutex)
+         return;
+      _al_add_exit_func(shutdown_cache, "shutdown_physfs_cache");
+   }
+
+   al_lock_mutex(cache_mutex);
+   cache_limit = size;
+   cache_trim(size);
+   al_unlock_mutex(cache_mutex);
+}
+
+
 /* Function: al_get_allegro_physfs_version
  */
 uint32_t al_get_allegro_physfs_version(void)
@@ -33,6 +33,11 @@ extern "C" {
 ALLEGRO_PHYSFS_FUNC(void, al_set_physfs_file_interface, (void));
 ALLEGRO_PHYSFS_FUNC(uint32_t, al_get_allegro_physfs_version, (void));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_PHYSFS_SRC)
+ALLEGRO_PHYSFS_FUNC(void, al_set_physfs_buffer_size, (size_t size));
+ALLEGRO_PHYSFS_FUNC(void, al_set_physfs_cache_size, (size_t size));
+#endif
+
 
 #ifdef __cplusplus
 }
@@ -19,6 +19,8 @@
 
 #define _AL_NO_BLEND_INLINE_FUNC
 
+#define ALLEGRO_INTERNAL_UNSTABLE
+
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_primitives.h"
 #include "allegro5/internal/aintern_blend.h"
@@ -348,6 +350,8 @@ static void line_stepper(uintptr_t state, shader_first first, shader_step step,
    float x1, y1, x2, y2;
    float dx, dy;
    int end_x, end_y;
+   int clip_x1, clip_y1, clip_x2, clip_y2;
+   int pixels = 0;
 
    if (vtx2->y < vtx1->y) {
       ALLEGRO_VERTEX* t;
@@ -371,21 +375,33 @@ static void line_stepper(uintptr_t state, shader_first first, shader_step step,
    
    end_x = floorf(x2 + 0.5f);
    end_y = floorf(y2 + 0.5f);
+
+   /* Only pixels inside the clipping rectangle are counted as drawn. */
+   al_get_clipping_rectangle(&clip_x1, &clip_y1, &clip_x2, &clip_y2);
+   clip_x2 += clip_x1;
+   clip_y2 += clip_y1;
    
+#define DRAW                                                               \
+   {                                                                       \
+      draw(state, x, y);                                                   \
+      if (x >= clip_x1 && x < clip_x2 && y >= clip_y1 && y < clip_y2)     \
+         pixels++;                                                         \
+   }
+
 #define FIRST                                                              \
    first(state, x, y, vtx1, vtx2);                                         \
    if((x2 - x1) * ((float)x - x1) + (y2 - y1) * ((float)y - y1) >= 0)      \
-      draw(state, x, y);                                                   \
+      DRAW                                                                 \
    (void)minor;
    
 #define STEP                                                               \
    step(state, minor);                                                     \
-   draw(state, x, y);
+   DRAW
    
 #define LAST                                                               \
    step(state, minor);                                                     \
    if((x1 - x2) * ((float)x - x2) + (y1 - y2) * ((float)y - y2) > 0)       \
-      draw(state, x, y);
+      DRAW
    
    
 #define WORKER(var1, var2, comp, dvar1, dvar2, derr1, derr2, func)         \
@@ -486,10 +502,13 @@ static void line_stepper(uintptr_t state, shader_first first, shader_step step,
          }
       }
    }
+#undef DRAW
 #undef FIRST
 #undef LAST
 #undef STEP
 #undef WORKER
+
+   _AL_RENDER_STATS_ADD(software_pixels, pixels);
 }
 
 /*
@@ -19,8 +19,11 @@
 
 #define _AL_NO_BLEND_INLINE_FUNC
 
+#define ALLEGRO_INTERNAL_UNSTABLE
+
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_primitives.h"
+#include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_blend.h"
 #include "allegro5/internal/aintern_prim.h"
 #include "allegro5/internal/aintern_prim_soft.h"
@@ -52,6 +55,8 @@ void _al_point_2d(ALLEGRO_BITMAP* texture, ALLEGRO_VERTEX* v)
    if(x < clip_min_x || x >= clip_max_x || y < clip_min_y || y >= clip_max_y)
       return;
 
+   _AL_RENDER_STATS_ADD(software_pixels, 1);
+
    vc = v->color;
 
    al_get_separate_blender(&op, &src_mode, &dst_mode, &op_alpha, &src_alpha, &dst_alpha);
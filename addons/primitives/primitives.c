@@ -16,6 +16,8 @@
  *      See readme.txt for copyright information.
  */
 
+#define ALLEGRO_INTERNAL_UNSTABLE
+
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_primitives.h"
 #include "allegro5/platform/alplatf.h"
@@ -23,6 +25,7 @@
 #include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_exitfunc.h"
 #include "allegro5/internal/aintern_pixels.h"
+#include "allegro5/internal/aintern_profile.h"
 #include "allegro5/internal/aintern_prim.h"
 #include "allegro5/internal/aintern_prim_directx.h"
 #include "allegro5/internal/aintern_prim_opengl.h"
@@ -83,6 +86,9 @@ int al_draw_prim(const void* vtxs, const ALLEGRO_VERTEX_DECL* decl,
     * view space should occur here
     */
    
+   _AL_PROFILE_BEGIN("al_draw_prim");
+   _AL_RENDER_STATS_ADD(draw_calls, 1);
+
    if (al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP ||
        (texture && al_get_bitmap_flags(texture) & ALLEGRO_MEMORY_BITMAP) ||
        _al_pixel_format_is_compressed(al_get_bitmap_format(target))) {
@@ -96,6 +102,8 @@ int al_draw_prim(const void* vtxs, const ALLEGRO_VERTEX_DECL* decl,
       }
    }
    
+   _AL_PROFILE_END();
+
    return ret;
 }
 
@@ -119,6 +127,9 @@ int al_draw_indexed_prim(const void* vtxs, const ALLEGRO_VERTEX_DECL* decl,
     * view space should occur here
     */
    
+   _AL_PROFILE_BEGIN("al_draw_indexed_prim");
+   _AL_RENDER_STATS_ADD(draw_calls, 1);
+
    if (al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP ||
        (texture && al_get_bitmap_flags(texture) & ALLEGRO_MEMORY_BITMAP) ||
        _al_pixel_format_is_compressed(al_get_bitmap_format(target))) {
@@ -132,6 +143,8 @@ int al_draw_indexed_prim(const void* vtxs, const ALLEGRO_VERTEX_DECL* decl,
       }
    }
    
+   _AL_PROFILE_END();
+
    return ret;
 }
 
@@ -514,6 +527,9 @@ int al_draw_vertex_buffer(ALLEGRO_VERTEX_BUFFER* vertex_buffer,
 
    target = al_get_target_bitmap();
 
+   _AL_PROFILE_BEGIN("al_draw_vertex_buffer");
+   _AL_RENDER_STATS_ADD(draw_calls, 1);
+
    if (al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP ||
        (texture && al_get_bitmap_flags(texture) & ALLEGRO_MEMORY_BITMAP) ||
        _al_pixel_format_is_compressed(al_get_bitmap_format(target))) {
@@ -528,6 +544,8 @@ int al_draw_vertex_buffer(ALLEGRO_VERTEX_BUFFER* vertex_buffer,
       }
    }
 
+   _AL_PROFILE_END();
+
    return ret;
 }
 
@@ -552,6 +570,9 @@ int al_draw_indexed_buffer(ALLEGRO_VERTEX_BUFFER* vertex_buffer,
 
    target = al_get_target_bitmap();
 
+   _AL_PROFILE_BEGIN("al_draw_indexed_buffer");
+   _AL_RENDER_STATS_ADD(draw_calls, 1);
+
    if (al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP ||
        (texture && al_get_bitmap_flags(texture) & ALLEGRO_MEMORY_BITMAP) ||
        _al_pixel_format_is_compressed(al_get_bitmap_format(target))) {
@@ -566,6 +587,8 @@ int al_draw_indexed_buffer(ALLEGRO_VERTEX_BUFFER* vertex_buffer,
       }
    }
 
+   _AL_PROFILE_END();
+
    return ret;
 }
 
@@ -11,6 +11,7 @@
 #include "allegro5/internal/aintern_font.h"
 #include "allegro5/internal/aintern_ttf_cfg.h"
 #include "allegro5/internal/aintern_dtor.h"
+#include "allegro5/internal/aintern_profile.h"
 #include "allegro5/internal/aintern_system.h"
 
 #include <ft2build.h>
@@ -410,6 +411,8 @@ static void cache_glyph(ALLEGRO_TTF_FONT_DATA *font_data, FT_Face face,
      * should have been set to ft_index = 0. */
     ASSERT(!(font_data->skip_cache_misses && !lock_whole_page));
 
+    _AL_PROFILE_BEGIN("cache glyph");
+
     // FIXME: make this a config setting? FT_LOAD_FORCE_AUTOHINT
 
     // FIXME: Investigate why some fonts don't work without the
@@ -438,6 +441,7 @@ static void cache_glyph(ALLEGRO_TTF_FONT_DATA *font_data, FT_Face face,
        glyph->region.x = -1;
        glyph->region.y = -1;
        ALLEGRO_DEBUG("Glyph %d has zero size.\n", ft_index);
+       _AL_PROFILE_END();
        return;
     }
 
@@ -448,6 +452,7 @@ static void cache_glyph(ALLEGRO_TTF_FONT_DATA *font_data, FT_Face face,
        w + 2, h + 2, false, glyph, lock_whole_page);
 
     if (glyph_data == NULL) {
+       _AL_PROFILE_END();
        return;
     }
 
@@ -459,6 +464,8 @@ static void cache_glyph(ALLEGRO_TTF_FONT_DATA *font_data, FT_Face face,
     if (!lock_whole_page) {
        unlock_current_page(font_data);
     }
+
+    _AL_PROFILE_END();
 }
 
 /* WARNING: It is only valid to call this function when the current page is empty
@@ -860,6 +867,20 @@ ALLEGRO_FONT *al_load_ttf_font_stretch_f(ALLEGRO_FILE *file,
     data->base_offset = al_ftell(file);
     data->stream.size = al_fsize(file);
     data->file = file;
+
+    /* If the whole font is addressable in memory, let Freetype parse it in
+     * place instead of copying it out through ftread.
+     */
+    {
+       size_t view_size = data->stream.size;
+       const void *view = al_fview(file, data->base_offset, &view_size);
+       if (view && view_size > 0) {
+          data->stream.base = (unsigned char *)view;
+          data->stream.size = view_size;
+          data->stream.read = NULL;
+       }
+    }
+
     data->bitmap_format = al_get_new_bitmap_format();
     data->bitmap_flags = al_get_new_bitmap_flags();
     data->min_page_size = 256;
@@ -960,7 +981,7 @@ ALLEGRO_FONT *al_load_ttf_font_stretch_f(ALLEGRO_FILE *file,
     f->vtable = &vt;
     f->data = data;
 
-    f->dtor_item = _al_register_destructor(_al_dtor_list, "ttf_font", f,
+    _al_register_destructor(_al_dtor_list, &f->dtor_item, "ttf_font", f,
        (void (*)(void *))al_destroy_font);
 
     return f;
@@ -20,6 +20,10 @@ set(ALLEGRO_SRC_FILES
     src/evtsrc.c
     src/exitfunc.c
     src/file.c
+    src/file_async.c
+    src/file_filter.c
+    src/file_mmap.c
+    src/file_pack.c
     src/file_slice.c
     src/file_stdio.c
     src/fshook.c
@@ -27,6 +31,7 @@ set(ALLEGRO_SRC_FILES
     src/fullscreen_mode.c
     src/haptic.c
     src/inline.c
+    src/jobs.c
     src/joynu.c
     src/keybdnu.c
     src/libc.c
@@ -34,11 +39,13 @@ set(ALLEGRO_SRC_FILES
     src/memblit.c
     src/memdraw.c
     src/memory.c
+    src/mempool.c
     src/monitor.c
     src/mousenu.c
     src/mouse_cursor.c
     src/path.c
     src/pixels.c
+    src/profile.c
     src/shader.c
     src/system.c
     src/threads.c
@@ -51,6 +58,7 @@ set(ALLEGRO_SRC_FILES
     src/misc/aatree.c
     src/misc/bstrlib.c
     src/misc/list.c
+    src/misc/lz4.c
     src/misc/vector.c
     )
 
@@ -243,6 +251,7 @@ set(ALLEGRO_INCLUDE_ALLEGRO_FILES
     include/allegro5/mouse.h
     include/allegro5/mouse_cursor.h
     include/allegro5/path.h
+    include/allegro5/profile.h
     include/allegro5/render_state.h
     include/allegro5/shader.h
     include/allegro5/system.h
@@ -0,0 +1,185 @@
+/*
+ *    Example program for the Allegro library.
+ *
+ *    Test file routines.
+ */
+
+#define ALLEGRO_UNSTABLE
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_memfile.h>
+#include <stdio.h>
+
+#include "common.c"
+
+typedef void (*test_t)(void);
+
+int error = 0;
+
+#define CHECK(x)                                                            \
+   do {                                                                     \
+      bool ok = (bool)(x);                                                  \
+      if (!ok) {                                                            \
+         log_printf("FAIL %s\n", #x);                                       \
+         error++;                                                           \
+      } else {                                                              \
+         log_printf("OK   %s\n", #x);                                       \
+      }                                                                     \
+   } while (0)
+
+/*---------------------------------------------------------------------------*/
+
+/* Create a temporary file holding `contents` and reopen it for reading. */
+static ALLEGRO_FILE *open_temp(const char *contents, ALLEGRO_PATH **path)
+{
+   ALLEGRO_FILE *f;
+
+   f = al_make_temp_file("ex_file_test_XXXXXX", path);
+   if (!f)
+      return NULL;
+   al_fputs(f, contents);
+   al_fclose(f);
+
+   return al_fopen(al_path_cstr(*path, ALLEGRO_NATIVE_PATH_SEP), "rb");
+}
+
+static void close_temp(ALLEGRO_FILE *f, ALLEGRO_PATH *path)
+{
+   al_fclose(f);
+   al_remove_filename(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+   al_destroy_path(path);
+}
+
+/* Test that al_fungetc on a buffered stdio file keeps every pushed back
+ * byte.
+ */
+static void t1(void)
+{
+   ALLEGRO_PATH *path;
+   ALLEGRO_FILE *f;
+
+   CHECK(f = open_temp("abcdef", &path));
+   if (!f)
+      return;
+
+   CHECK(al_fgetc(f) == 'a');
+   CHECK(al_fgetc(f) == 'b');
+   CHECK(al_fungetc(f, 'X') == 'X');
+   CHECK(al_fungetc(f, 'Y') == 'Y');
+   CHECK(al_fgetc(f) == 'Y');
+   CHECK(al_fungetc(f, 'Z') == 'Z');
+   CHECK(al_fgetc(f) == 'Z');
+   CHECK(al_fgetc(f) == 'X');
+   CHECK(al_fgetc(f) == 'c');
+
+   close_temp(f, path);
+}
+
+/* Test al_ftell, al_fseek and al_fread with pushed back bytes. */
+static void t2(void)
+{
+   ALLEGRO_PATH *path;
+   ALLEGRO_FILE *f;
+   char buf[8];
+
+   CHECK(f = open_temp("abcdef", &path));
+   if (!f)
+      return;
+
+   CHECK(al_fgetc(f) == 'a');
+   CHECK(al_fgetc(f) == 'b');
+   CHECK(al_ftell(f) == 2);
+   CHECK(al_fungetc(f, 'b') == 'b');
+   CHECK(al_ftell(f) == 1);
+   CHECK(al_fread(f, buf, 3) == 3);
+   CHECK(memcmp(buf, "bcd", 3) == 0);
+
+   CHECK(al_fungetc(f, 'd') == 'd');
+   CHECK(al_fseek(f, 1, ALLEGRO_SEEK_CUR));
+   CHECK(al_fgetc(f) == 'e');
+   CHECK(al_fgetc(f) == 'f');
+   CHECK(al_fgetc(f) == EOF);
+   CHECK(al_feof(f));
+
+   CHECK(al_fungetc(f, 'f') == 'f');
+   CHECK(!al_feof(f));
+   CHECK(al_fgetc(f) == 'f');
+
+   close_temp(f, path);
+}
+
+/* Test that detaching a memfile buffer leaves nothing of it buffered in
+ * the file handle.
+ */
+static void t3(void)
+{
+   ALLEGRO_FILE *f;
+   char buf[8];
+   void *mem;
+   int64_t size;
+
+   CHECK(f = al_open_growable_memfile(0));
+   if (!f)
+      return;
+
+   CHECK(al_fputs(f, "abcdef") >= 0);
+   CHECK(al_fseek(f, 0, ALLEGRO_SEEK_SET));
+   CHECK(al_fgetc(f) == 'a');
+   CHECK(al_fgetc(f) == 'b');
+   CHECK(al_fungetc(f, 'b') == 'b');
+
+   CHECK(mem = al_detach_memfile_buffer(f, &size));
+   CHECK(size == 6);
+   memset(mem, 'X', size);
+   al_free(mem);
+
+   CHECK(al_ftell(f) == 0);
+   CHECK(al_fgetc(f) == EOF);
+   CHECK(al_fread(f, buf, sizeof(buf)) == 0);
+   CHECK(al_feof(f));
+
+   al_fclose(f);
+}
+
+/*---------------------------------------------------------------------------*/
+
+const test_t all_tests[] =
+{
+   NULL, t1, t2, t3
+};
+
+#define NUM_TESTS (int)(sizeof(all_tests) / sizeof(all_tests[0]))
+
+int main(int argc, char **argv)
+{
+   int i;
+
+   if (!al_init()) {
+      abort_example("Could not initialise Allegro.\n");
+   }
+   open_log();
+
+   if (argc < 2) {
+      for (i = 1; i < NUM_TESTS; i++) {
+         log_printf("# t%d\n\n", i);
+         all_tests[i]();
+         log_printf("\n");
+      }
+   }
+   else {
+      i = atoi(argv[1]);
+      if (i > 0 && i < NUM_TESTS) {
+         all_tests[i]();
+      }
+   }
+   log_printf("Done\n");
+
+   close_log(true);
+
+   if (error) {
+      exit(EXIT_FAILURE);
+   }
+
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -0,0 +1,316 @@
+/*
+ *    Example program for the Allegro library.
+ *
+ *    Test the compression filters.
+ */
+
+#define ALLEGRO_UNSTABLE
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_memfile.h>
+#include <stdio.h>
+
+#include "common.c"
+
+typedef void (*test_t)(void);
+
+typedef ALLEGRO_FILE *(*filter_t)(ALLEGRO_FILE *fp, const char *mode);
+
+int error = 0;
+
+#define CHECK(x)                                                            \
+   do {                                                                     \
+      bool ok = (bool)(x);                                                  \
+      if (!ok) {                                                            \
+         log_printf("FAIL %s\n", #x);                                       \
+         error++;                                                           \
+      } else {                                                              \
+         log_printf("OK   %s\n", #x);                                       \
+      }                                                                     \
+   } while (0)
+
+/* More than one LZ4 block, so that seeking back has to decode again. */
+#define DATA_SIZE    (600 * 1024)
+
+static unsigned char data[DATA_SIZE];
+static unsigned char buf[DATA_SIZE];
+
+/*---------------------------------------------------------------------------*/
+
+/* Alternate between runs of text, which compress, and noise, which does
+ * not, so that both compressed and stored blocks are written.
+ */
+static void make_data(void)
+{
+   static const char text[] = "the quick brown fox jumps over the lazy dog ";
+   unsigned int seed = 12345;
+   int i;
+
+   for (i = 0; i < DATA_SIZE; i++) {
+      if ((i / 50000) % 3 == 2) {
+         seed = seed * 1103515245 + 12345;
+         data[i] = seed >> 16;
+      }
+      else {
+         data[i] = text[i % (sizeof(text) - 1)];
+      }
+   }
+}
+
+/* Compress `size` bytes of data and return the result, to be freed with
+ * al_free.
+ */
+static unsigned char *compress(filter_t filter, size_t size, int64_t *out)
+{
+   ALLEGRO_FILE *mf;
+   ALLEGRO_FILE *f;
+   unsigned char *mem;
+
+   mf = al_open_growable_memfile(0);
+   if (!mf)
+      return NULL;
+   f = filter(mf, "w");
+   if (!f) {
+      al_fclose(mf);
+      return NULL;
+   }
+   al_fwrite(f, data, size);
+   al_fclose(f);
+
+   mem = al_detach_memfile_buffer(mf, out);
+   al_fclose(mf);
+   return mem;
+}
+
+/* Decode `size` bytes of `mem` into buf.  Returns the number of bytes
+ * read and whether the filter reported an error.
+ */
+static size_t decode(filter_t filter, void *mem, int64_t size, bool *err)
+{
+   ALLEGRO_FILE *mf;
+   ALLEGRO_FILE *f;
+   size_t n = 0;
+
+   *err = true;
+   mf = al_open_memfile(mem, size, "r");
+   if (!mf)
+      return 0;
+   f = filter(mf, "r");
+   if (f) {
+      n = al_fread(f, buf, sizeof(buf));
+      *err = al_ferror(f);
+      al_fclose(f);
+   }
+   al_fclose(mf);
+   return n;
+}
+
+static void round_trip(filter_t filter)
+{
+   ALLEGRO_FILE *mf;
+   ALLEGRO_FILE *f;
+   unsigned char *mem;
+   int64_t size;
+
+   CHECK(mem = compress(filter, DATA_SIZE, &size));
+   if (!mem)
+      return;
+   log_printf("%d bytes compressed to %d\n", DATA_SIZE, (int)size);
+   CHECK(size < DATA_SIZE);
+
+   mf = al_open_memfile(mem, size, "r");
+   f = filter(mf, "r");
+   CHECK(al_fread(f, buf, DATA_SIZE) == DATA_SIZE);
+   CHECK(memcmp(buf, data, DATA_SIZE) == 0);
+   CHECK(al_fgetc(f) == EOF);
+   CHECK(al_feof(f));
+   CHECK(!al_ferror(f));
+
+   /* Back into the first block, then forward again. */
+   CHECK(al_fseek(f, 1000, ALLEGRO_SEEK_SET));
+   CHECK(!al_feof(f));
+   CHECK(al_ftell(f) == 1000);
+   CHECK(al_fread(f, buf, 5000) == 5000);
+   CHECK(memcmp(buf, data + 1000, 5000) == 0);
+   CHECK(al_fseek(f, 400000, ALLEGRO_SEEK_CUR));
+   CHECK(al_ftell(f) == 406000);
+   CHECK(al_fread(f, buf, 1000) == 1000);
+   CHECK(memcmp(buf, data + 406000, 1000) == 0);
+   CHECK(!al_fseek(f, 0, ALLEGRO_SEEK_END));
+
+   al_fclose(f);
+   al_fclose(mf);
+   al_free(mem);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Test reading back what al_fopen_lz4 wrote, with seeks both ways. */
+static void t1(void)
+{
+   round_trip(al_fopen_lz4);
+}
+
+/* Test the same with al_fopen_deflate, if zlib is available. */
+static void t2(void)
+{
+   ALLEGRO_FILE *mf = al_open_growable_memfile(0);
+   ALLEGRO_FILE *f = al_fopen_deflate(mf, "w");
+
+   if (!f) {
+      CHECK(al_get_errno() == ENOSYS);
+      log_printf("Built without zlib\n");
+      al_fclose(mf);
+      return;
+   }
+   al_fclose(f);
+   al_fclose(mf);
+
+   round_trip(al_fopen_deflate);
+}
+
+/* Test that truncated streams are reported as errors, not as a short but
+ * successful read.
+ */
+static void t3(void)
+{
+   unsigned char *mem;
+   int64_t size;
+   size_t n;
+   bool err;
+
+   CHECK(mem = compress(al_fopen_lz4, 100000, &size));
+   if (!mem)
+      return;
+
+   n = decode(al_fopen_lz4, mem, size, &err);
+   CHECK(n == 100000 && !err);
+
+   /* Without the end mark. */
+   n = decode(al_fopen_lz4, mem, size - 4, &err);
+   CHECK(n == 100000 && err);
+
+   /* In the middle of a block. */
+   n = decode(al_fopen_lz4, mem, size / 2, &err);
+   CHECK(n < 100000 && err);
+
+   /* In the middle of the frame header. */
+   n = decode(al_fopen_lz4, mem, 5, &err);
+   CHECK(n == 0 && err);
+
+   al_free(mem);
+
+   mem = compress(al_fopen_deflate, 100000, &size);
+   if (mem) {
+      n = decode(al_fopen_deflate, mem, size / 2, &err);
+      CHECK(n < 100000 && err);
+      al_free(mem);
+   }
+}
+
+/* Test that frames with a corrupt header are rejected. */
+static void t4(void)
+{
+   unsigned char *mem;
+   int64_t size;
+   size_t n;
+   bool err;
+
+   CHECK(mem = compress(al_fopen_lz4, 1000, &size));
+   if (!mem)
+      return;
+
+   /* Wrong magic number. */
+   mem[0] ^= 0xFF;
+   n = decode(al_fopen_lz4, mem, size, &err);
+   CHECK(n == 0 && err);
+   mem[0] ^= 0xFF;
+
+   /* Unknown version. */
+   mem[4] ^= 0xC0;
+   n = decode(al_fopen_lz4, mem, size, &err);
+   CHECK(n == 0 && err);
+   mem[4] ^= 0xC0;
+
+   /* Block size below the smallest allowed. */
+   mem[5] = 0x30;
+   n = decode(al_fopen_lz4, mem, size, &err);
+   CHECK(n == 0 && err);
+
+   al_free(mem);
+}
+
+/* Test that a match reaching back before the start of the data is
+ * rejected.
+ */
+static void t5(void)
+{
+   unsigned char frame[] = {
+      0x04, 0x22, 0x4D, 0x18,    /* magic */
+      0x60, 0x40, 0x00,          /* independent blocks of 64 KiB */
+      0x04, 0x00, 0x00, 0x00,    /* compressed block of 4 bytes */
+      0x10, 'a', 0x01, 0x00,     /* one literal, then 4 bytes at offset 1 */
+      0x00, 0x00, 0x00, 0x00     /* end mark */
+   };
+   size_t n;
+   bool err;
+
+   n = decode(al_fopen_lz4, frame, sizeof(frame), &err);
+   CHECK(n == 5 && !err);
+   CHECK(memcmp(buf, "aaaaa", 5) == 0);
+
+   /* Offset 2, with only one byte decoded so far. */
+   frame[13] = 0x02;
+   n = decode(al_fopen_lz4, frame, sizeof(frame), &err);
+   CHECK(n == 0 && err);
+
+   /* Offset 0 is never valid. */
+   frame[13] = 0x00;
+   n = decode(al_fopen_lz4, frame, sizeof(frame), &err);
+   CHECK(n == 0 && err);
+}
+
+/*---------------------------------------------------------------------------*/
+
+const test_t all_tests[] =
+{
+   NULL, t1, t2, t3, t4, t5
+};
+
+#define NUM_TESTS (int)(sizeof(all_tests) / sizeof(all_tests[0]))
+
+int main(int argc, char **argv)
+{
+   int i;
+
+   if (!al_init()) {
+      abort_example("Could not initialise Allegro.\n");
+   }
+   open_log();
+
+   make_data();
+
+   if (argc < 2) {
+      for (i = 1; i < NUM_TESTS; i++) {
+         log_printf("# t%d\n\n", i);
+         all_tests[i]();
+         log_printf("\n");
+      }
+   }
+   else {
+      i = atoi(argv[1]);
+      if (i > 0 && i < NUM_TESTS) {
+         all_tests[i]();
+      }
+   }
+   log_printf("Done\n");
+
+   close_log(true);
+
+   if (error) {
+      exit(EXIT_FAILURE);
+   }
+
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -0,0 +1,246 @@
+/*
+ *    Example program for the Allegro library.
+ *
+ *    Test the job system.
+ */
+
+#define ALLEGRO_UNSTABLE
+#include <allegro5/allegro.h>
+#include <stdio.h>
+
+#include "common.c"
+
+typedef void (*test_t)(void);
+
+int error = 0;
+
+#define CHECK(x)                                                            \
+   do {                                                                     \
+      bool ok = (bool)(x);                                                  \
+      if (!ok) {                                                            \
+         log_printf("FAIL %s\n", #x);                                       \
+         error++;                                                           \
+      } else {                                                              \
+         log_printf("OK   %s\n", #x);                                       \
+      }                                                                     \
+   } while (0)
+
+#define NUM_ITEMS    10000
+
+static int items[NUM_ITEMS];
+static ALLEGRO_MUTEX *mutex;
+
+/*---------------------------------------------------------------------------*/
+
+static void add_one(int begin, int end, void *arg)
+{
+   int i;
+   (void)arg;
+
+   for (i = begin; i < end; i++)
+      items[i]++;
+}
+
+/* Returns true if every item in [begin, end) was visited exactly once and
+ * every other item not at all.
+ */
+static bool visited_once(int begin, int end)
+{
+   int i;
+
+   for (i = 0; i < NUM_ITEMS; i++) {
+      if (items[i] != (i >= begin && i < end))
+         return false;
+   }
+   return true;
+}
+
+/* Test that al_run_parallel_for visits every index exactly once. */
+static void t1(void)
+{
+   ALLEGRO_JOB_COUNTER *counter = al_create_job_counter();
+   static const int grains[] = { 0, 1, 7, 100, NUM_ITEMS };
+   int i;
+
+   CHECK(counter);
+   if (!counter)
+      return;
+
+   for (i = 0; i < (int)(sizeof(grains) / sizeof(grains[0])); i++) {
+      memset(items, 0, sizeof(items));
+      al_run_parallel_for(0, NUM_ITEMS, grains[i], add_one, NULL, counter);
+      al_wait_for_job_counter(counter);
+      CHECK(al_is_job_counter_done(counter));
+      CHECK(visited_once(0, NUM_ITEMS));
+   }
+
+   memset(items, 0, sizeof(items));
+   al_run_parallel_for(123, 4567, 0, add_one, NULL, counter);
+   al_wait_for_job_counter(counter);
+   CHECK(visited_once(123, 4567));
+
+   /* Empty ranges do nothing. */
+   memset(items, 0, sizeof(items));
+   al_run_parallel_for(10, 10, 0, add_one, NULL, counter);
+   al_run_parallel_for(10, 5, 0, add_one, NULL, counter);
+   CHECK(al_is_job_counter_done(counter));
+   CHECK(visited_once(0, 0));
+
+   al_destroy_job_counter(counter);
+}
+
+/*---------------------------------------------------------------------------*/
+
+#define NUM_STAGES   4
+#define STAGE_JOBS   16
+
+static int stage_done[NUM_STAGES];
+static bool stage_ok[NUM_STAGES];
+
+static void stage_proc(void *arg)
+{
+   int stage = (int)(intptr_t)arg;
+
+   /* Take a little while, so that later stages would overtake this one
+    * if they were not held back.
+    */
+   al_rest(0.001);
+
+   al_lock_mutex(mutex);
+   if (stage > 0 && stage_done[stage - 1] != STAGE_JOBS)
+      stage_ok[stage] = false;
+   stage_done[stage]++;
+   al_unlock_mutex(mutex);
+}
+
+/* Test that jobs started with al_run_job_after only run once every job of
+ * their dependency has finished.
+ */
+static void t2(void)
+{
+   ALLEGRO_JOB_COUNTER *counters[NUM_STAGES];
+   int stage, i;
+
+   for (stage = 0; stage < NUM_STAGES; stage++) {
+      counters[stage] = al_create_job_counter();
+      stage_done[stage] = 0;
+      stage_ok[stage] = true;
+   }
+
+   for (stage = 0; stage < NUM_STAGES; stage++) {
+      for (i = 0; i < STAGE_JOBS; i++) {
+         al_run_job_after(stage > 0 ? counters[stage - 1] : NULL,
+            stage_proc, (void *)(intptr_t)stage, counters[stage]);
+      }
+   }
+
+   al_wait_for_job_counter(counters[NUM_STAGES - 1]);
+
+   for (stage = 0; stage < NUM_STAGES; stage++) {
+      log_printf("stage %d: %d jobs\n", stage, stage_done[stage]);
+      CHECK(stage_done[stage] == STAGE_JOBS);
+      CHECK(stage_ok[stage]);
+   }
+
+   for (stage = 0; stage < NUM_STAGES; stage++) {
+      al_destroy_job_counter(counters[stage]);
+   }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int jobs_run;
+
+static void nothing(void *arg)
+{
+   (void)arg;
+}
+
+static void count_job(void *arg)
+{
+   (void)arg;
+
+   al_lock_mutex(mutex);
+   jobs_run++;
+   al_unlock_mutex(mutex);
+}
+
+/* Test that a counter emits an event when it drops to zero, and can be
+ * destroyed straight after waiting for it.
+ */
+static void t3(void)
+{
+   ALLEGRO_EVENT_QUEUE *queue = al_create_event_queue();
+   ALLEGRO_JOB_COUNTER *counter;
+   ALLEGRO_EVENT event;
+   int i;
+
+   counter = al_create_job_counter();
+   al_register_event_source(queue, al_get_job_counter_event_source(counter));
+
+   for (i = 0; i < 100; i++)
+      al_run_job(nothing, NULL, counter);
+
+   CHECK(al_wait_for_event_timed(queue, &event, 5.0));
+   CHECK(event.type == ALLEGRO_EVENT_JOB_COUNTER_DONE);
+   CHECK(event.job.counter == counter);
+
+   al_destroy_job_counter(counter);
+   al_destroy_event_queue(queue);
+
+   jobs_run = 0;
+   for (i = 0; i < 1000; i++) {
+      counter = al_create_job_counter();
+      al_run_job(count_job, NULL, counter);
+      al_destroy_job_counter(counter);
+   }
+   CHECK(jobs_run == 1000);
+}
+
+/*---------------------------------------------------------------------------*/
+
+const test_t all_tests[] =
+{
+   NULL, t1, t2, t3
+};
+
+#define NUM_TESTS (int)(sizeof(all_tests) / sizeof(all_tests[0]))
+
+int main(int argc, char **argv)
+{
+   int i;
+
+   if (!al_init()) {
+      abort_example("Could not initialise Allegro.\n");
+   }
+   open_log();
+
+   mutex = al_create_mutex();
+   log_printf("%d job workers\n\n", al_get_num_job_workers());
+
+   if (argc < 2) {
+      for (i = 1; i < NUM_TESTS; i++) {
+         log_printf("# t%d\n\n", i);
+         all_tests[i]();
+         log_printf("\n");
+      }
+   }
+   else {
+      i = atoi(argv[1]);
+      if (i > 0 && i < NUM_TESTS) {
+         all_tests[i]();
+      }
+   }
+   log_printf("Done\n");
+
+   al_destroy_mutex(mutex);
+   close_log(true);
+
+   if (error) {
+      exit(EXIT_FAILURE);
+   }
+
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
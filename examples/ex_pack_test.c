@@ -0,0 +1,301 @@
+/*
+ *    Example program for the Allegro library.
+ *
+ *    Test opening pack archives, in particular that damaged ones are
+ *    rejected.
+ */
+
+#define ALLEGRO_UNSTABLE
+#include <allegro5/allegro.h>
+#include <stdio.h>
+
+#include "common.c"
+
+typedef void (*test_t)(void);
+
+int error = 0;
+
+#define CHECK(x)                                                            \
+   do {                                                                     \
+      bool ok = (bool)(x);                                                  \
+      if (!ok) {                                                            \
+         log_printf("FAIL %s\n", #x);                                       \
+         error++;                                                           \
+      } else {                                                              \
+         log_printf("OK   %s\n", #x);                                       \
+      }                                                                     \
+   } while (0)
+
+/* A pack with two entries in a single hash chain, laid out as described
+ * in misc/make_pack.py: the header, the data of both entries, the index
+ * and finally the names.
+ */
+#define HEADER_SIZE  48
+#define ENTRY_SIZE   48
+#define DATA_OFFSET  HEADER_SIZE
+#define INDEX_OFFSET 64
+#define ENTRIES      (INDEX_OFFSET + 4)
+#define NAMES_OFFSET (ENTRIES + 2 * ENTRY_SIZE)
+#define NAMES_SIZE   12
+#define PACK_SIZE    (NAMES_OFFSET + NAMES_SIZE)
+
+#define NO_ENTRY     0xFFFFFFFFu
+#define FLAG_LZ4     1
+
+static unsigned char image[PACK_SIZE];
+
+/*---------------------------------------------------------------------------*/
+
+static void put32(unsigned char *p, uint32_t v)
+{
+   p[0] = v;
+   p[1] = v >> 8;
+   p[2] = v >> 16;
+   p[3] = v >> 24;
+}
+
+static void put64(unsigned char *p, uint64_t v)
+{
+   put32(p, (uint32_t)v);
+   put32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint32_t fnv1a(const char *s)
+{
+   uint32_t h = 2166136261u;
+
+   while (*s) {
+      h ^= (unsigned char)*s++;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+static void put_entry(int i, const char *name, uint32_t next,
+   uint32_t name_offset, uint64_t offset, uint64_t size,
+   uint64_t stored_size, uint32_t flags)
+{
+   unsigned char *p = image + ENTRIES + i * ENTRY_SIZE;
+
+   put32(p, fnv1a(name));
+   put32(p + 4, next);
+   put32(p + 8, name_offset);
+   put32(p + 12, strlen(name));
+   put64(p + 16, offset);
+   put64(p + 24, size);
+   put64(p + 32, stored_size);
+   put32(p + 40, flags);
+}
+
+/* "a.txt" is stored, "b.txt" is an LZ4 block decoding to "aaaaa". */
+static void make_pack(void)
+{
+   static const unsigned char lz4[4] = { 0x10, 'a', 0x01, 0x00 };
+
+   memset(image, 0, sizeof(image));
+   memcpy(image, "ALPK", 4);
+   put32(image + 4, 1);
+   put32(image + 8, 2);
+   put32(image + 12, 1);
+   put64(image + 16, INDEX_OFFSET);
+   put64(image + 24, NAMES_OFFSET);
+   put64(image + 32, NAMES_SIZE);
+
+   memcpy(image + DATA_OFFSET, "hello world", 11);
+   memcpy(image + DATA_OFFSET + 11, lz4, 4);
+
+   put32(image + INDEX_OFFSET, 0);
+   put_entry(0, "a.txt", 1, 0, DATA_OFFSET, 11, 11, 0);
+   put_entry(1, "b.txt", NO_ENTRY, 6, DATA_OFFSET + 11, 5, 4, FLAG_LZ4);
+
+   memcpy(image + NAMES_OFFSET, "a.txt\0b.txt", NAMES_SIZE);
+}
+
+/* Write the first `size` bytes of the image to a file and open it as a
+ * pack.
+ */
+static ALLEGRO_PACK *open_image(size_t size)
+{
+   ALLEGRO_PATH *path;
+   ALLEGRO_PACK *pack;
+   ALLEGRO_FILE *f;
+   const char *name;
+
+   f = al_make_temp_file("ex_pack_test_XXXXXX", &path);
+   if (!f)
+      return NULL;
+   al_fwrite(f, image, size);
+   al_fclose(f);
+
+   name = al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP);
+   pack = al_open_pack(name);
+   /* The mapping stays valid on systems which allow this at all. */
+   al_remove_filename(name);
+   al_destroy_path(path);
+   return pack;
+}
+
+/* Returns true if the image is rejected by al_open_pack. */
+static bool rejected(void)
+{
+   ALLEGRO_PACK *pack = open_image(PACK_SIZE);
+
+   if (pack) {
+      al_close_pack(pack);
+      return false;
+   }
+   make_pack();
+   return true;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Test reading both kinds of entries from an intact pack. */
+static void t1(void)
+{
+   ALLEGRO_PACK *pack;
+   ALLEGRO_FILE *f;
+   char buf[16];
+
+   CHECK(pack = open_image(PACK_SIZE));
+   if (!pack)
+      return;
+
+   CHECK(f = al_fopen_pack(pack, "a.txt"));
+   if (f) {
+      CHECK(al_fsize(f) == 11);
+      CHECK(al_fread(f, buf, sizeof(buf)) == 11);
+      CHECK(memcmp(buf, "hello world", 11) == 0);
+      al_fclose(f);
+   }
+
+   CHECK(f = al_fopen_pack(pack, "/b.txt"));
+   if (f) {
+      CHECK(al_fread(f, buf, sizeof(buf)) == 5);
+      CHECK(memcmp(buf, "aaaaa", 5) == 0);
+      al_fclose(f);
+   }
+
+   CHECK(!al_fopen_pack(pack, "c.txt"));
+   CHECK(al_get_errno() == ENOENT);
+
+   al_close_pack(pack);
+}
+
+/* Test that a damaged header or index is rejected by al_open_pack. */
+static void t2(void)
+{
+   unsigned char *e1 = image + ENTRIES + ENTRY_SIZE;
+
+   CHECK(!rejected());
+
+   CHECK(!open_image(HEADER_SIZE - 1));
+   CHECK(!open_image(NAMES_OFFSET));
+
+   image[0] = 'X';
+   CHECK(rejected());
+
+   put32(image + 4, 2);
+   CHECK(rejected());
+
+   /* The bucket count must be a power of two. */
+   put32(image + 12, 3);
+   CHECK(rejected());
+
+   /* The index would run past the end of the file. */
+   put32(image + 8, 1000);
+   CHECK(rejected());
+
+   /* Bucket and chain links out of range. */
+   put32(image + INDEX_OFFSET, 2);
+   CHECK(rejected());
+   put32(e1 + 4, 2);
+   CHECK(rejected());
+
+   /* Name not terminated within the name table. */
+   image[PACK_SIZE - 1] = 'x';
+   CHECK(rejected());
+   put32(e1 + 8, NAMES_SIZE);
+   CHECK(rejected());
+
+   /* Data past the end of the file. */
+   put64(e1 + 16, PACK_SIZE - 2);
+   CHECK(rejected());
+
+   /* A stored entry whose sizes disagree. */
+   put32(e1 + 40, 0);
+   CHECK(rejected());
+}
+
+/* Test that an LZ4 entry which does not decode is refused when opened. */
+static void t3(void)
+{
+   ALLEGRO_PACK *pack;
+
+   /* Match offset 2 with only one byte decoded. */
+   image[DATA_OFFSET + 13] = 0x02;
+   pack = open_image(PACK_SIZE);
+   CHECK(pack);
+   if (pack) {
+      CHECK(!al_fopen_pack(pack, "b.txt"));
+      CHECK(al_get_errno() == EINVAL);
+      al_close_pack(pack);
+   }
+   make_pack();
+
+   /* Decodes to fewer bytes than the index says. */
+   put64(image + ENTRIES + ENTRY_SIZE + 24, 6);
+   pack = open_image(PACK_SIZE);
+   CHECK(pack);
+   if (pack) {
+      CHECK(!al_fopen_pack(pack, "b.txt"));
+      al_close_pack(pack);
+   }
+   make_pack();
+}
+
+/*---------------------------------------------------------------------------*/
+
+const test_t all_tests[] =
+{
+   NULL, t1, t2, t3
+};
+
+#define NUM_TESTS (int)(sizeof(all_tests) / sizeof(all_tests[0]))
+
+int main(int argc, char **argv)
+{
+   int i;
+
+   if (!al_init()) {
+      abort_example("Could not initialise Allegro.\n");
+   }
+   open_log();
+
+   make_pack();
+
+   if (argc < 2) {
+      for (i = 1; i < NUM_TESTS; i++) {
+         log_printf("# t%d\n\n", i);
+         all_tests[i]();
+         log_printf("\n");
+      }
+   }
+   else {
+      i = atoi(argv[1]);
+      if (i > 0 && i < NUM_TESTS) {
+         all_tests[i]();
+      }
+   }
+   log_printf("Done\n");
+
+   close_log(true);
+
+   if (error) {
+      exit(EXIT_FAILURE);
+   }
+
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
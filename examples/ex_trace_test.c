@@ -0,0 +1,88 @@
+/*
+ *    Example program for the Allegro library.
+ *
+ *    Test that trace messages are written by the log writer thread when
+ *    asynchronous logging is enabled.
+ */
+
+#include <allegro5/allegro.h>
+#include <stdio.h>
+
+#include "common.c"
+
+/* Thread local, so the handler can tell which thread calls it. */
+#define MAIN_THREAD_FLAGS  (ALLEGRO_MEMORY_BITMAP | ALLEGRO_MIN_LINEAR)
+
+static volatile int messages_on_main_thread = 0;
+static volatile int messages_on_other_threads = 0;
+
+static void trace_handler(char const *msg)
+{
+   (void)msg;
+
+   if (al_get_new_bitmap_flags() == MAIN_THREAD_FLAGS)
+      messages_on_main_thread++;
+   else
+      messages_on_other_threads++;
+}
+
+int main(int argc, char **argv)
+{
+   ALLEGRO_CONFIG *config;
+   ALLEGRO_BITMAP *bmp;
+   double t;
+   int error = 0;
+
+   (void)argc;
+   (void)argv;
+
+   /* The system configuration can be set up before al_init. */
+   config = al_get_system_config();
+   al_set_config_value(config, "trace", "level", "debug");
+   al_set_config_value(config, "trace", "async", "1");
+
+   al_register_trace_handler(trace_handler);
+
+   if (!al_init()) {
+      abort_example("Could not initialise Allegro.\n");
+   }
+   open_log();
+
+   /* Messages logged by al_init before this are not counted. */
+   al_set_new_bitmap_flags(MAIN_THREAD_FLAGS);
+   messages_on_main_thread = 0;
+   messages_on_other_threads = 0;
+
+   /* Anything which logs will do. */
+   bmp = al_create_bitmap(8, 8);
+   al_destroy_bitmap(bmp);
+
+   t = al_get_time();
+   while (messages_on_other_threads == 0 && al_get_time() - t < 5.0) {
+      al_rest(0.01);
+   }
+
+   log_printf("%d messages written by the main thread\n",
+      messages_on_main_thread);
+   log_printf("%d messages written by other threads\n",
+      messages_on_other_threads);
+
+   if (messages_on_other_threads == 0) {
+      log_printf("FAIL the log writer thread did not run\n");
+      error = 1;
+   }
+   else {
+      log_printf("OK   the log writer thread ran\n");
+   }
+
+   close_log(true);
+   al_register_trace_handler(NULL);
+
+   if (error) {
+      exit(EXIT_FAILURE);
+   }
+
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -18,6 +18,9 @@ struct ALLEGRO_TIMEOUT {
 
 
 AL_FUNC(double, al_get_time, (void));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(int64_t, al_get_time_ns, (void));
+#endif
 AL_FUNC(void, al_rest, (double seconds));
 AL_FUNC(void, al_init_timeout, (ALLEGRO_TIMEOUT *timeout, double seconds));
 
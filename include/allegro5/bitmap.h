@@ -86,6 +86,25 @@ AL_FUNC(void, al_convert_memory_bitmaps, (void));
 AL_FUNC(void, al_backup_dirty_bitmap, (ALLEGRO_BITMAP *bitmap));
 #endif
 
+/* Render statistics */
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_RENDER_STATS
+ */
+typedef struct ALLEGRO_RENDER_STATS ALLEGRO_RENDER_STATS;
+
+struct ALLEGRO_RENDER_STATS
+{
+   int draw_calls;
+   int vertex_cache_flushes;
+   int bitmap_locks;
+   int format_conversions;
+   int64_t software_pixels;
+};
+
+AL_FUNC(void, al_get_render_stats, (ALLEGRO_RENDER_STATS *stats));
+AL_FUNC(void, al_reset_render_stats, (void));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
@@ -31,24 +31,46 @@ AL_FUNC(bool, _al_trace_prefix, (char const *channel, int level,
 
 AL_PRINTFUNC(void, _al_trace_suffix, (const char *msg, ...), 1, 2);
 
+/* A channel declared with ALLEGRO_DEBUG_CHANNEL is resolved to a small
+ * integer id the first time it logs.  _al_trace_channel_mute caches, for
+ * each id, a bit per level which is set if that level is filtered out, so
+ * a disabled log statement costs a single test.  Id 0 is never muted and
+ * means "not resolved yet".
+ */
+typedef struct _AL_TRACE_CHANNEL {
+   char const *name;
+   int id;
+} _AL_TRACE_CHANNEL;
+
+AL_ARRAY(unsigned char, _al_trace_channel_mute);
+
+AL_FUNC(bool, _al_trace_prefix_channel, (_AL_TRACE_CHANNEL *channel,
+   int level, char const *file, int line, char const *function));
+
 #if defined(DEBUGMODE) || defined(ALLEGRO_CFG_RELEASE_LOGGING)
    /* Must not be used with a trailing semicolon. */
    #ifdef ALLEGRO_GCC
       #define ALLEGRO_DEBUG_CHANNEL(x) \
-         static char const *__al_debug_channel __attribute__((unused)) = x;
+         static _AL_TRACE_CHANNEL __al_debug_channel __attribute__((unused)) \
+            = { x, 0 };
    #else
       #define ALLEGRO_DEBUG_CHANNEL(x) \
-         static char const *__al_debug_channel = x;
+         static _AL_TRACE_CHANNEL __al_debug_channel = { x, 0 };
    #endif
    #define ALLEGRO_TRACE_CHANNEL_LEVEL(channel, level)                        \
       !_al_trace_prefix(channel, level, __FILE__, __LINE__, __func__)         \
       ? (void)0 : _al_trace_suffix
+   #define ALLEGRO_TRACE_LEVEL(level)                                         \
+      ((_al_trace_channel_mute[__al_debug_channel.id] >> (level)) & 1)        \
+      || !_al_trace_prefix_channel(&__al_debug_channel, level,                \
+         __FILE__, __LINE__, __func__)                                        \
+      ? (void)0 : _al_trace_suffix
 #else
    #define ALLEGRO_TRACE_CHANNEL_LEVEL(channel, x)  1 ? (void) 0 : _al_trace_suffix
+   #define ALLEGRO_TRACE_LEVEL(x)   1 ? (void) 0 : _al_trace_suffix
    #define ALLEGRO_DEBUG_CHANNEL(x)
 #endif
 
-#define ALLEGRO_TRACE_LEVEL(x)   ALLEGRO_TRACE_CHANNEL_LEVEL(__al_debug_channel, x)
 #define ALLEGRO_DEBUG            ALLEGRO_TRACE_LEVEL(0)
 #define ALLEGRO_INFO             ALLEGRO_TRACE_LEVEL(1)
 #define ALLEGRO_WARN             ALLEGRO_TRACE_LEVEL(2)
@@ -49,7 +49,10 @@ enum
    ALLEGRO_EVENT_TOUCH_CANCEL                = 53,
    
    ALLEGRO_EVENT_DISPLAY_CONNECTED           = 60,
-   ALLEGRO_EVENT_DISPLAY_DISCONNECTED        = 61
+   ALLEGRO_EVENT_DISPLAY_DISCONNECTED        = 61,
+
+   ALLEGRO_EVENT_ASYNC_READ                  = 70,
+   ALLEGRO_EVENT_JOB_COUNTER_DONE            = 71
 };
 
 
@@ -181,6 +184,26 @@ typedef struct ALLEGRO_TOUCH_EVENT
 
 
 
+typedef struct ALLEGRO_ASYNC_READ_EVENT
+{
+   _AL_EVENT_HEADER(struct ALLEGRO_EVENT_SOURCE)
+   struct ALLEGRO_ASYNC_READ *request;
+   void *buffer;
+   size_t size;                 /* number of bytes read */
+   int error;                   /* errno value, or 0 */
+   bool cancelled;
+} ALLEGRO_ASYNC_READ_EVENT;
+
+
+
+typedef struct ALLEGRO_JOB_EVENT
+{
+   _AL_EVENT_HEADER(struct ALLEGRO_EVENT_SOURCE)
+   struct ALLEGRO_JOB_COUNTER *counter;
+} ALLEGRO_JOB_EVENT;
+
+
+
 /* Type: ALLEGRO_USER_EVENT
  */
 typedef struct ALLEGRO_USER_EVENT ALLEGRO_USER_EVENT;
@@ -216,6 +239,8 @@ union ALLEGRO_EVENT
    ALLEGRO_MOUSE_EVENT    mouse;
    ALLEGRO_TIMER_EVENT    timer;
    ALLEGRO_TOUCH_EVENT    touch;
+   ALLEGRO_ASYNC_READ_EVENT async_read;
+   ALLEGRO_JOB_EVENT      job;
    ALLEGRO_USER_EVENT     user;
 };
 
@@ -231,6 +256,10 @@ AL_FUNC(void, al_destroy_user_event_source, (ALLEGRO_EVENT_SOURCE *));
 AL_FUNC(bool, al_emit_user_event, (ALLEGRO_EVENT_SOURCE *, ALLEGRO_EVENT *,
                                    void (*dtor)(ALLEGRO_USER_EVENT *)));
 AL_FUNC(void, al_unref_user_event, (ALLEGRO_USER_EVENT *));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(bool, al_emit_user_events, (ALLEGRO_EVENT_SOURCE *, ALLEGRO_EVENT *,
+                                    int num, void (*dtor)(ALLEGRO_USER_EVENT *)));
+#endif
 AL_FUNC(void, al_set_event_source_data, (ALLEGRO_EVENT_SOURCE*, intptr_t data));
 AL_FUNC(intptr_t, al_get_event_source_data, (const ALLEGRO_EVENT_SOURCE*));
 
@@ -247,11 +276,23 @@ AL_FUNC(void, al_destroy_event_queue, (ALLEGRO_EVENT_QUEUE*));
 AL_FUNC(bool, al_is_event_source_registered, (ALLEGRO_EVENT_QUEUE *, 
          ALLEGRO_EVENT_SOURCE *));
 AL_FUNC(void, al_register_event_source, (ALLEGRO_EVENT_QUEUE*, ALLEGRO_EVENT_SOURCE*));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(void, al_register_event_source_filtered, (ALLEGRO_EVENT_QUEUE*,
+         ALLEGRO_EVENT_SOURCE*, const ALLEGRO_EVENT_TYPE *types, int num_types));
+#endif
 AL_FUNC(void, al_unregister_event_source, (ALLEGRO_EVENT_QUEUE*, ALLEGRO_EVENT_SOURCE*));
 AL_FUNC(void, al_pause_event_queue, (ALLEGRO_EVENT_QUEUE*, bool));
 AL_FUNC(bool, al_is_event_queue_paused, (const ALLEGRO_EVENT_QUEUE*));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(void, al_set_event_queue_coalescing, (ALLEGRO_EVENT_QUEUE*, bool));
+AL_FUNC(bool, al_is_event_queue_coalescing, (const ALLEGRO_EVENT_QUEUE*));
+#endif
 AL_FUNC(bool, al_is_event_queue_empty, (ALLEGRO_EVENT_QUEUE*));
 AL_FUNC(bool, al_get_next_event, (ALLEGRO_EVENT_QUEUE*, ALLEGRO_EVENT *ret_event));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(int, al_get_next_events, (ALLEGRO_EVENT_QUEUE*, ALLEGRO_EVENT *ret_events,
+                                  int max));
+#endif
 AL_FUNC(bool, al_peek_next_event, (ALLEGRO_EVENT_QUEUE*, ALLEGRO_EVENT *ret_event));
 AL_FUNC(bool, al_drop_next_event, (ALLEGRO_EVENT_QUEUE*));
 AL_FUNC(void, al_flush_event_queue, (ALLEGRO_EVENT_QUEUE*));
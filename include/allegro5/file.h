@@ -2,6 +2,7 @@
 #define __al_included_allegro5_file_h
 
 #include "allegro5/base.h"
+#include "allegro5/events.h"
 #include "allegro5/path.h"
 #include "allegro5/utf8.h"
 
@@ -84,10 +85,39 @@ AL_FUNC(ALLEGRO_FILE*, al_fopen_fd, (int fd, const char *mode));
 AL_FUNC(ALLEGRO_FILE*, al_make_temp_file, (const char *tmpl,
       ALLEGRO_PATH **ret_path));
 
+/* Specific to memory mapped files. */
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(ALLEGRO_FILE*, al_fopen_mmap, (const char *path, const char *mode));
+AL_FUNC(void, al_set_mmap_file_interface, (void));
+AL_FUNC(const void *, al_fview, (ALLEGRO_FILE *f, int64_t offset,
+      size_t *size));
+#endif
+
+/* Asynchronous reads. */
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_ASYNC_READ
+ */
+typedef struct ALLEGRO_ASYNC_READ ALLEGRO_ASYNC_READ;
+
+AL_FUNC(ALLEGRO_ASYNC_READ *, al_fread_async, (ALLEGRO_FILE *f,
+      int64_t offset, void *ptr, size_t size, int priority));
+AL_FUNC(bool, al_cancel_async_read, (ALLEGRO_ASYNC_READ *req));
+AL_FUNC(size_t, al_wait_for_async_read, (ALLEGRO_ASYNC_READ *req));
+AL_FUNC(void, al_destroy_async_read, (ALLEGRO_ASYNC_READ *req));
+AL_FUNC(ALLEGRO_EVENT_SOURCE *, al_get_async_read_event_source, (void));
+#endif
+
 /* Specific to slices. */
 AL_FUNC(ALLEGRO_FILE*, al_fopen_slice, (ALLEGRO_FILE *fp,
       size_t initial_size, const char *mode));
 
+/* Compression filters. */
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(ALLEGRO_FILE*, al_fopen_deflate, (ALLEGRO_FILE *fp,
+      const char *mode));
+AL_FUNC(ALLEGRO_FILE*, al_fopen_lz4, (ALLEGRO_FILE *fp, const char *mode));
+#endif
+
 /* Thread-local state. */
 AL_FUNC(const ALLEGRO_FILE_INTERFACE *, al_get_new_file_interface, (void));
 AL_FUNC(void, al_set_new_file_interface, (const ALLEGRO_FILE_INTERFACE *
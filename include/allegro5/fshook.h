@@ -132,6 +132,34 @@ AL_FUNC(int,  al_for_each_fs_entry, (ALLEGRO_FS_ENTRY *dir,
                                      int (*callback)(ALLEGRO_FS_ENTRY *entry, void *extra),
                                      void *extra));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Enum: ALLEGRO_FOR_EACH_FS_ENTRY_FLAGS
+ */
+typedef enum ALLEGRO_FOR_EACH_FS_ENTRY_FLAGS {
+   ALLEGRO_FOR_EACH_FS_ENTRY_PARALLEL = 1,
+   ALLEGRO_FOR_EACH_FS_ENTRY_STAT     = 2
+} ALLEGRO_FOR_EACH_FS_ENTRY_FLAGS;
+
+AL_FUNC(int,  al_for_each_fs_entry_batch, (ALLEGRO_FS_ENTRY *dir, int flags,
+                                     int (*callback)(ALLEGRO_FS_ENTRY **entries, int num_entries, void *extra),
+                                     void *extra));
+#endif
+
+
+/* Pack archives. */
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_PACK
+ */
+typedef struct ALLEGRO_PACK ALLEGRO_PACK;
+
+AL_FUNC(ALLEGRO_PACK *, al_open_pack, (const char *path));
+AL_FUNC(void, al_close_pack, (ALLEGRO_PACK *pack));
+AL_FUNC(ALLEGRO_FILE *, al_fopen_pack, (ALLEGRO_PACK *pack, const char *path));
+AL_FUNC(bool, al_mount_pack, (ALLEGRO_PACK *pack));
+AL_FUNC(bool, al_unmount_pack, (ALLEGRO_PACK *pack));
+AL_FUNC(void, al_set_pack_file_interface, (void));
+#endif
+
 
 /* Thread-local state. */
 AL_FUNC(const ALLEGRO_FS_INTERFACE *, al_get_fs_interface, (void));
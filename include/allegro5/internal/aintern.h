@@ -47,6 +47,12 @@ AL_FUNC(int, _al_rand, (void));
 
 AL_FUNC(int, _al_stricmp, (const char *s1, const char *s2));
 
+/* pooled allocator */
+AL_FUNC(void, _al_release_memory_pool_cache, (void));
+
+/* UTF-8 strings */
+void _al_init_ustr_indexes(void);
+
 #ifdef __cplusplus
    }
 #endif
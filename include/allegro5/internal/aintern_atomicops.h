@@ -19,6 +19,11 @@
       return __sync_sub_and_fetch(ptr, 1);
    })
 
+   AL_INLINE(void, _al_memory_barrier, (void),
+   {
+      __sync_synchronize();
+   })
+
 #elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
 
    /* gcc, x86 or x86-64 */
@@ -49,6 +54,15 @@
       return old - 1;
    })
 
+   AL_INLINE(void, _al_memory_barrier, (void),
+   {
+   #ifdef __x86_64__
+      __asm__ __volatile__ ("lock; orl $0, (%%rsp)" : : : "memory");
+   #else
+      __asm__ __volatile__ ("lock; orl $0, (%%esp)" : : : "memory");
+   #endif
+   })
+
 #elif defined(_MSC_VER) && _M_IX86 >= 400
 
    /* MSVC, x86 */
@@ -68,6 +82,11 @@
       return InterlockedDecrement(ptr);
    })
 
+   AL_INLINE(void, _al_memory_barrier, (void),
+   {
+      MemoryBarrier();
+   })
+
 #elif defined(ALLEGRO_HAVE_OSATOMIC_H)
 
    /* OS X, GCC < 4.1
@@ -93,12 +112,22 @@
       return OSAtomicDecrement32Barrier((_AL_ATOMIC *)ptr);
    })
 
+   AL_INLINE(void, _al_memory_barrier, (void),
+   {
+      OSMemoryBarrier();
+   })
+
 
 #else
 
    /* Hope for the best? */
    #warning Atomic operations undefined for your compiler/architecture.
 
+   /* Code which relies on atomics for more than reference counts must
+    * check this and fall back to locking.
+    */
+   #define _AL_NO_ATOMICS
+
    typedef int _AL_ATOMIC;
 
    AL_INLINE(_AL_ATOMIC,
@@ -113,6 +142,11 @@
       return --(*ptr);
    })
 
+   /* Not a fence, only here so that callers compile. */
+   AL_INLINE(void, _al_memory_barrier, (void),
+   {
+   })
+
 #endif
 
 #endif
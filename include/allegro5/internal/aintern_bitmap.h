@@ -6,6 +6,7 @@
 #include "allegro5/display.h"
 #include "allegro5/render_state.h"
 #include "allegro5/transformations.h"
+#include "allegro5/internal/aintern_dtor.h"
 #include "allegro5/internal/aintern_list.h"
 
 #ifdef __cplusplus
@@ -98,7 +99,7 @@ struct ALLEGRO_BITMAP
    /* Extra data for display bitmaps, like texture id and so on. */
    void *extra;
 
-   _AL_LIST_ITEM *dtor_item;
+   _AL_DTOR_ITEM dtor_item;
 
    /* set_target_bitmap and lock_bitmap mark bitmaps as dirty for preservation */
    bool dirty;
@@ -168,7 +169,7 @@ void _al_convert_to_display_bitmap(ALLEGRO_BITMAP *bitmap);
 void _al_convert_to_memory_bitmap(ALLEGRO_BITMAP *bitmap);
 
 /* Simple bitmap drawing */
-void _al_put_pixel(ALLEGRO_BITMAP *bitmap, int x, int y, ALLEGRO_COLOR color);
+bool _al_put_pixel(ALLEGRO_BITMAP *bitmap, int x, int y, ALLEGRO_COLOR color);
 
 /* Bitmap I/O */
 void _al_init_iio_table(void);
@@ -176,6 +177,18 @@ void _al_init_iio_table(void);
 
 int _al_get_bitmap_memory_format(ALLEGRO_BITMAP *bitmap);
 
+/* Render statistics, kept per thread like the target bitmap. */
+#if defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(ALLEGRO_RENDER_STATS *, _al_get_render_stats, (void));
+
+#define _AL_RENDER_STATS_ADD(field, n)                                  \
+   do {                                                                 \
+      ALLEGRO_RENDER_STATS *_rs = _al_get_render_stats();               \
+      if (_rs)                                                          \
+         _rs->field += (n);                                             \
+   } while (0)
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,7 +1,18 @@
 #ifndef __al_included_allegro5_aintern_config_h
 #define __al_included_allegro5_aintern_config_h
 
-#include "allegro5/internal/aintern_aatree.h"
+/* Open addressing hash table from names to sections or entries. */
+typedef struct _AL_CONFIG_SLOT {
+   uint32_t hash;
+   const ALLEGRO_USTR *key;      /* NULL if the slot is free */
+   void *item;
+} _AL_CONFIG_SLOT;
+
+typedef struct _AL_CONFIG_INDEX {
+   _AL_CONFIG_SLOT *slots;
+   size_t capacity;              /* zero or a power of two */
+   size_t count;
+} _AL_CONFIG_INDEX;
 
 struct ALLEGRO_CONFIG_ENTRY {
    bool is_comment;
@@ -14,14 +25,14 @@ struct ALLEGRO_CONFIG_SECTION {
    ALLEGRO_USTR *name;
    ALLEGRO_CONFIG_ENTRY *head;
    ALLEGRO_CONFIG_ENTRY *last;
-   _AL_AATREE *tree;
+   _AL_CONFIG_INDEX index;
    ALLEGRO_CONFIG_SECTION *prev, *next;
 };
 
 struct ALLEGRO_CONFIG {
    ALLEGRO_CONFIG_SECTION *head;
    ALLEGRO_CONFIG_SECTION *last;
-   _AL_AATREE *tree;
+   _AL_CONFIG_INDEX index;
 };
 
 
@@ -6,7 +6,22 @@
 #endif
 
 
+/* Trace messages a thread has started but not finished.  Messages nest
+ * when evaluating the arguments of one logs another; nested messages, and
+ * those logged by a trace handler, bypass the ring buffer.
+ */
+#define _AL_TRACE_MAX_NESTING    4
+
+typedef struct _AL_TRACE_NESTING {
+   int depth;
+   int draining;
+   unsigned int direct;    /* bit set if message is not in the ring */
+   unsigned int tickets[_AL_TRACE_MAX_NESTING];
+} _AL_TRACE_NESTING;
+
+
 void _al_configure_logging(void);
+void _al_start_logging(void);
 void _al_shutdown_logging(void);
 
 
@@ -1,8 +1,6 @@
 #ifndef __al_included_allegro5_aintern_dtor_h
 #define __al_included_allegro5_aintern_dtor_h
 
-#include "allegro5/internal/aintern_list.h"
-
 #ifdef __cplusplus
    extern "C" {
 #endif
@@ -10,15 +8,31 @@
 
 typedef struct _AL_DTOR_LIST _AL_DTOR_LIST;
 
+/* Embedded in each object which registers a destructor.  Zeroed memory
+ * counts as not registered.
+ */
+typedef struct _AL_DTOR_ITEM _AL_DTOR_ITEM;
+
+struct _AL_DTOR_ITEM {
+   struct _AL_DTOR_SHARD *shard;    /* NULL if not in the list */
+   _AL_DTOR_ITEM *prev;
+   _AL_DTOR_ITEM *next;
+   unsigned int seq;
+   char const *name;
+   void *object;
+   void (*func)(void*);
+};
+
 
 AL_FUNC(_AL_DTOR_LIST *, _al_init_destructors, (void));
 AL_FUNC(void, _al_push_destructor_owner, (void));
 AL_FUNC(void, _al_pop_destructor_owner, (void));
 AL_FUNC(void, _al_run_destructors, (_AL_DTOR_LIST *dtors));
 AL_FUNC(void, _al_shutdown_destructors, (_AL_DTOR_LIST *dtors));
-AL_FUNC(_AL_LIST_ITEM*, _al_register_destructor, (_AL_DTOR_LIST *dtors, char const *name,
-   void *object, void (*func)(void*)));
-AL_FUNC(void, _al_unregister_destructor, (_AL_DTOR_LIST *dtors, _AL_LIST_ITEM* dtor_item));
+AL_FUNC(void, _al_register_destructor, (_AL_DTOR_LIST *dtors, _AL_DTOR_ITEM *item,
+   char const *name, void *object, void (*func)(void*)));
+AL_FUNC(void, _al_unregister_destructor, (_AL_DTOR_LIST *dtors, _AL_DTOR_ITEM *item));
+AL_FUNC(void, _al_reregister_destructor, (_AL_DTOR_LIST *dtors, _AL_DTOR_ITEM *item));
 AL_FUNC(void, _al_foreach_destructor, (_AL_DTOR_LIST *dtors,
                                           void (*callback)(void *object, void (*func)(void *), void *udata),
                                           void *userdata));
@@ -14,7 +14,7 @@ typedef struct ALLEGRO_EVENT_SOURCE_REAL ALLEGRO_EVENT_SOURCE_REAL;
 struct ALLEGRO_EVENT_SOURCE_REAL
 {
    _AL_MUTEX mutex;
-   _AL_VECTOR queues;
+   _AL_VECTOR queues;   /* queues registered with, and their event types */
    intptr_t data;
 };
 
@@ -31,12 +31,16 @@ void _al_event_source_init(ALLEGRO_EVENT_SOURCE*);
 void _al_event_source_free(ALLEGRO_EVENT_SOURCE*);
 void _al_event_source_lock(ALLEGRO_EVENT_SOURCE*);
 void _al_event_source_unlock(ALLEGRO_EVENT_SOURCE*);
-void _al_event_source_on_registration_to_queue(ALLEGRO_EVENT_SOURCE*, ALLEGRO_EVENT_QUEUE*);
+void _al_event_source_on_registration_to_queue(ALLEGRO_EVENT_SOURCE*, ALLEGRO_EVENT_QUEUE*,
+   const ALLEGRO_EVENT_TYPE *types, int num_types);
 void _al_event_source_on_unregistration_from_queue(ALLEGRO_EVENT_SOURCE*, ALLEGRO_EVENT_QUEUE*);
 bool _al_event_source_needs_to_generate_event(ALLEGRO_EVENT_SOURCE*);
+bool _al_event_source_wants_event_type(ALLEGRO_EVENT_SOURCE*, ALLEGRO_EVENT_TYPE type);
 void _al_event_source_emit_event(ALLEGRO_EVENT_SOURCE *, ALLEGRO_EVENT*);
+void _al_event_source_emit_events(ALLEGRO_EVENT_SOURCE *, ALLEGRO_EVENT*, unsigned int num);
 
 void _al_event_queue_push_event(ALLEGRO_EVENT_QUEUE*, const ALLEGRO_EVENT*);
+void _al_event_queue_push_events(ALLEGRO_EVENT_QUEUE*, const ALLEGRO_EVENT*, unsigned int num);
 
 
 #ifdef __cplusplus
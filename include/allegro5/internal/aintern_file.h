@@ -7,15 +7,61 @@
 
 
 extern const ALLEGRO_FILE_INTERFACE _al_file_interface_stdio;
+extern const ALLEGRO_FILE_INTERFACE _al_file_interface_mmap;
+extern const ALLEGRO_FILE_INTERFACE _al_file_interface_pack;
+extern const ALLEGRO_FILE_INTERFACE _al_file_interface_slice;
+extern const ALLEGRO_FILE_INTERFACE _al_file_interface_filter;
 
 #define ALLEGRO_UNGETC_SIZE 16
 
+/* Optional entry points which are not part of the public
+ * ALLEGRO_FILE_INTERFACE.  Any of them may be NULL.
+ */
+typedef struct _AL_FILE_EXTENSION
+{
+   /* Return a pointer to the file contents at `offset`, valid until the
+    * file is closed.  On entry *size holds the number of bytes wanted, on
+    * return the number of bytes actually addressable.
+    */
+   const void *(*fi_fview)(ALLEGRO_FILE *f, int64_t offset, size_t *size);
+
+   /* Point the read window of an empty window at the next chunk of data
+    * and advance the backend position past it.  Returns the number of
+    * bytes made available, or 0 at end of file, on error, or if the handle
+    * does not support a read window.  End of file should only be reported
+    * by later reads, once the window has been consumed.
+    */
+   size_t (*fi_ffill)(ALLEGRO_FILE *f);
+} _AL_FILE_EXTENSION;
+
+extern const _AL_FILE_EXTENSION _al_file_extension_stdio;
+extern const _AL_FILE_EXTENSION _al_file_extension_mmap;
+extern const _AL_FILE_EXTENSION _al_file_extension_pack;
+extern const _AL_FILE_EXTENSION _al_file_extension_slice;
+extern const _AL_FILE_EXTENSION _al_file_extension_filter;
+
+AL_FUNC(void, _al_register_file_extension,
+   (const ALLEGRO_FILE_INTERFACE *drv, const _AL_FILE_EXTENSION *ext));
+AL_FUNC(void, _al_discard_file_buffers, (ALLEGRO_FILE *f));
+
+void _al_init_async_reads(void);
+void _al_init_packs(void);
+
 struct ALLEGRO_FILE
 {
    const ALLEGRO_FILE_INTERFACE *vtable;
+   const _AL_FILE_EXTENSION *ext;
    void *userdata;
    unsigned char ungetc[ALLEGRO_UNGETC_SIZE];
    int ungetc_len;
+   /* Read window: bytes delivered by fi_ffill but not yet consumed.
+    * The backend position is at window_end, so these bytes logically
+    * follow the ungetc buffer and precede the backend position.
+    * Bytes from window_start on are still valid, so seeks may move back.
+    */
+   const unsigned char *window_start;
+   const unsigned char *window_pos;
+   const unsigned char *window_end;
 };
 
 #ifdef __cplusplus
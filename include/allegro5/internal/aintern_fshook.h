@@ -25,6 +25,11 @@
 
 extern struct ALLEGRO_FS_INTERFACE _al_fs_interface_stdio;
 
+/* Returns the ALLEGRO_FILEMODE_ISDIR or ALLEGRO_FILEMODE_ISFILE bit of the
+ * entry's mode, without fetching its other attributes where possible.
+ */
+uint32_t _al_get_fs_entry_type(ALLEGRO_FS_ENTRY *e);
+
 
 #ifdef __cplusplus
    }
@@ -3,6 +3,7 @@
 
 #include "allegro5/joystick.h"
 #include "allegro5/internal/aintern_joystick.h"
+#include "allegro5/internal/aintern_seqlock.h"
 
 
 /* XXX reconsider what needs to be exposed after the haptics driver is in */
@@ -50,6 +51,9 @@ typedef struct {
 } BUTTON_MAPPING;
 
 
+/* Maximum number of changes held back until the end of an input report. */
+#define LJOY_MAX_REPORT_EVENTS   64
+
 typedef struct ALLEGRO_JOYSTICK_LINUX
 {
    ALLEGRO_JOYSTICK parent;
@@ -61,7 +65,15 @@ typedef struct ALLEGRO_JOYSTICK_LINUX
    AXIS_MAPPING axis_mapping[TOTAL_JOYSTICK_AXES];
    BUTTON_MAPPING button_mapping[_AL_MAX_JOYSTICK_BUTTONS];
    ALLEGRO_JOYSTICK_STATE joystate;
+   _AL_SEQLOCK joystate_lock;
    char name[100];
+
+   /* Changes read since the last EV_SYN report.  They are applied to
+    * joystate and emitted together when the report ends.
+    */
+   ALLEGRO_EVENT report_events[LJOY_MAX_REPORT_EVENTS];
+   int num_report_events;
+   bool report_dropped;
 } ALLEGRO_JOYSTICK_LINUX;
 
 
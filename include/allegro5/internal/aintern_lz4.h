@@ -0,0 +1,30 @@
+#ifndef __al_included_allegro5_aintern_lz4_h
+#define __al_included_allegro5_aintern_lz4_h
+
+#ifdef __cplusplus
+   extern "C" {
+#endif
+
+
+/* Number of entries in the hash table passed to _al_lz4_compress. */
+#define _AL_LZ4_TABLE_SIZE    (1 << 16)
+
+/* Matches reach back at most this far. */
+#define _AL_LZ4_WINDOW_SIZE   65536
+
+#define _AL_LZ4_ERROR         ((size_t)-1)
+
+
+size_t _al_lz4_compress(const unsigned char *src, size_t src_size,
+   unsigned char *dst, size_t dst_size, uint32_t *table);
+size_t _al_lz4_decompress(const unsigned char *src, size_t src_size,
+   unsigned char *dst, size_t dst_size, size_t dict_size);
+
+
+#ifdef __cplusplus
+   }
+#endif
+
+#endif
+
+/* vim: set sts=3 sw=3 et: */
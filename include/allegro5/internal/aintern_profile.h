@@ -0,0 +1,61 @@
+#ifndef __al_included_allegro5_aintern_profile_h
+#define __al_included_allegro5_aintern_profile_h
+
+#ifdef __cplusplus
+   extern "C" {
+#endif
+
+
+/* Profiling spans and counters.  Spans nest and must be closed on the
+ * thread that opened them; every _AL_PROFILE_BEGIN needs an
+ * _AL_PROFILE_END on all paths out of the code it measures.  The names
+ * must be string literals, as they are only read when the trace is saved.
+ *
+ * Without ALLEGRO_CFG_PROFILING the macros compile to nothing, otherwise
+ * they cost a test of _al_profile_enabled until profiling is started.
+ */
+#ifdef ALLEGRO_CFG_PROFILING
+
+AL_VAR(bool, _al_profile_enabled);
+
+AL_FUNC(void, _al_profile_begin, (const char *name));
+AL_FUNC(void, _al_profile_end, (void));
+AL_FUNC(void, _al_profile_counter, (const char *name, double value));
+
+#define _AL_PROFILE_BEGIN(name) \
+   (_al_profile_enabled ? _al_profile_begin(name) : (void)0)
+#define _AL_PROFILE_END() \
+   (_al_profile_enabled ? _al_profile_end() : (void)0)
+#define _AL_PROFILE_COUNTER(name, value) \
+   (_al_profile_enabled ? _al_profile_counter(name, (double)(value)) : (void)0)
+
+#else
+
+#define _AL_PROFILE_BEGIN(name)           ((void)0)
+#define _AL_PROFILE_END()                 ((void)0)
+#define _AL_PROFILE_COUNTER(name, value)  ((void)0)
+
+#endif
+
+
+/* The recording buffer of the current thread, kept in thread local
+ * storage.  The generation tells whether it has been freed since.
+ */
+typedef struct _AL_PROFILE_TLS {
+   struct _AL_PROFILE_THREAD *thread;
+   int generation;
+} _AL_PROFILE_TLS;
+
+
+void _al_init_profiling(void);
+void _al_shutdown_profiling(void);
+void _al_free_profiling(void);
+
+
+#ifdef __cplusplus
+   }
+#endif
+
+#endif
+
+/* vim: set sts=3 sw=3 et: */
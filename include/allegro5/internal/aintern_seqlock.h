@@ -0,0 +1,80 @@
+#ifndef __al_included_allegro5_aintern_seqlock_h
+#define __al_included_allegro5_aintern_seqlock_h
+
+#include "allegro5/internal/aintern_atomicops.h"
+
+#ifdef __cplusplus
+   extern "C" {
+#endif
+
+
+/* A sequence lock lets input drivers publish state snapshots which
+ * al_get_*_state can copy without taking a lock.  The counter is odd
+ * while a write is in progress; readers copy the state and retry if the
+ * counter changed underneath them.  Writers never wait for readers, but
+ * must be serialised among themselves (the drivers use the event source
+ * lock for that).
+ */
+typedef struct _AL_SEQLOCK {
+   volatile _AL_ATOMIC seq;
+} _AL_SEQLOCK;
+
+
+AL_INLINE(void, _al_seqlock_write_begin, (_AL_SEQLOCK *sl),
+{
+   _al_fetch_and_add1(&sl->seq);
+})
+
+AL_INLINE(void, _al_seqlock_write_end, (_AL_SEQLOCK *sl),
+{
+   _al_fetch_and_add1(&sl->seq);
+})
+
+AL_INLINE(_AL_ATOMIC, _al_seqlock_read_begin, (const _AL_SEQLOCK *sl),
+{
+   _AL_ATOMIC seq;
+   while ((seq = sl->seq) & 1)
+      ;
+   _al_memory_barrier();
+   return seq;
+})
+
+AL_INLINE(bool, _al_seqlock_read_retry, (const _AL_SEQLOCK *sl,
+   _AL_ATOMIC seq),
+{
+   _al_memory_barrier();
+   return sl->seq != seq;
+})
+
+
+/* Copy `src`, which is guarded by `sl`, into `dst`.  `es` is the event
+ * source whose lock serialises the writers.  Without real atomic
+ * operations the counter gives readers no ordering guarantees, so they
+ * take that lock as well.
+ */
+#ifdef _AL_NO_ATOMICS
+   #define _AL_SEQLOCK_READ(sl, es, dst, src)                                 \
+      do {                                                                    \
+         _al_event_source_lock(es);                                           \
+         (dst) = (src);                                                       \
+         _al_event_source_unlock(es);                                         \
+      } while (0)
+#else
+   #define _AL_SEQLOCK_READ(sl, es, dst, src)                                 \
+      do {                                                                    \
+         _AL_ATOMIC _al_seq;                                                  \
+         do {                                                                 \
+            _al_seq = _al_seqlock_read_begin(sl);                             \
+            (dst) = (src);                                                    \
+         } while (_al_seqlock_read_retry(sl, _al_seq));                       \
+      } while (0)
+#endif
+
+
+#ifdef __cplusplus
+   }
+#endif
+
+#endif
+
+/* vim: set sts=3 sw=3 et: */
@@ -26,8 +26,9 @@ void _al_mutex_destroy(_AL_MUTEX*);
 /* static inline void _al_mutex_lock(_AL_MUTEX*); */
 /* static inline void _al_mutex_unlock(_AL_MUTEX*); */
 
-/* All 5 functions below are declared inline in aintuthr.h.
- * FIXME: Why are they all inline? And if they have to be, why not treat them
+/* The 5 functions below are declared in aintuthr.h, all but _al_cond_init
+ * inline.
+ * FIXME: Why are they inline? And if they have to be, why not treat them
  * the same as the two functions above?
  */
 #ifdef ALLEGRO_WINDOWS
@@ -41,6 +42,9 @@ void _al_cond_signal(_AL_COND*);
 int _al_cond_timedwait(_AL_COND*, _AL_MUTEX*, const ALLEGRO_TIMEOUT *timeout);
 
 
+void _al_init_jobs(void);
+
+
 #ifdef __cplusplus
    }
 #endif
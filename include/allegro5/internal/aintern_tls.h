@@ -1,6 +1,9 @@
 #ifndef __al_included_allegro5_aintern_tls_h
 #define __al_included_allegro5_aintern_tls_h
 
+#include "allegro5/internal/aintern_debug.h"
+#include "allegro5/internal/aintern_profile.h"
+
 #ifdef __cplusplus
    extern "C" {
 #endif
@@ -10,6 +13,12 @@ void _al_tls_init_once(void);
 
 int *_al_tls_get_dtor_owner_count(void);
 
+int *_al_tls_get_job_worker(void);
+
+_AL_TRACE_NESTING *_al_tls_get_trace_nesting(void);
+
+_AL_PROFILE_TLS *_al_tls_get_profile(void);
+
 
 #ifdef __cplusplus
    }
@@ -67,6 +67,25 @@ AL_FUNC(void *, al_realloc_with_context, (void *ptr, size_t n,
 AL_FUNC(void *, al_calloc_with_context, (size_t count, size_t n,
    int line, const char *file, const char *func));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+
+/* Type: ALLEGRO_MEMORY_STATS
+ */
+typedef struct ALLEGRO_MEMORY_STATS ALLEGRO_MEMORY_STATS;
+
+struct ALLEGRO_MEMORY_STATS {
+   const char *tag;
+   size_t live_bytes;
+   size_t live_count;
+   size_t total_count;
+};
+
+AL_FUNC(ALLEGRO_MEMORY_INTERFACE *, al_get_pool_memory_interface, (void));
+AL_FUNC(int, al_get_num_memory_tags, (void));
+AL_FUNC(bool, al_get_memory_stats, (int tag, ALLEGRO_MEMORY_STATS *stats));
+
+#endif
+
 
 #ifdef __cplusplus
    }
@@ -44,6 +44,15 @@ struct ALLEGRO_TIMEOUT_UNIX
    struct timespec abstime;
 };
 
+/* The clock which timeouts are measured against.  Condition variables are
+ * made to use the monotonic clock where possible, so that timed waits are
+ * not affected by changes to the system time.
+ */
+#if defined(ALLEGRO_HAVE_CLOCK_GETTIME) && \
+    defined(ALLEGRO_HAVE_PTHREAD_CONDATTR_SETCLOCK)
+   #define _AL_TIMEOUT_CLOCK  CLOCK_MONOTONIC
+#endif
+
 
 AL_INLINE(bool, _al_get_thread_should_stop, (struct _AL_THREAD *t),
 {
@@ -68,10 +77,7 @@ AL_INLINE(void, _al_mutex_unlock, (struct _AL_MUTEX *m),
       pthread_mutex_unlock(&m->mutex);
 })
 
-AL_INLINE(void, _al_cond_init, (struct _AL_COND *cond),
-{
-   pthread_cond_init(&cond->cond, NULL);
-})
+AL_FUNC(void, _al_cond_init, (struct _AL_COND*));
 
 AL_INLINE(void, _al_cond_destroy, (struct _AL_COND *cond),
 {
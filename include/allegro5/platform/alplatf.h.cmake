@@ -11,6 +11,7 @@
 #cmakedefine ALLEGRO_CFG_DLL_TLS
 #cmakedefine ALLEGRO_CFG_PTHREADS_TLS
 #cmakedefine ALLEGRO_CFG_RELEASE_LOGGING
+#cmakedefine ALLEGRO_CFG_PROFILING
 
 #cmakedefine ALLEGRO_CFG_D3D
 #cmakedefine ALLEGRO_CFG_D3D9EX
@@ -27,6 +28,8 @@
 
 #cmakedefine ALLEGRO_CFG_ANDROID_LEGACY
 
+#cmakedefine ALLEGRO_CFG_ZLIB
+
 /*---------------------------------------------------------------------------*/
 
 /* Define to 1 if you have the corresponding header file. */
@@ -49,6 +52,8 @@
 #cmakedefine ALLEGRO_HAVE_SYS_TYPES_H
 #cmakedefine ALLEGRO_HAVE_OSATOMIC_H
 #cmakedefine ALLEGRO_HAVE_SYS_INOTIFY_H
+#cmakedefine ALLEGRO_HAVE_SYS_EPOLL_H
+#cmakedefine ALLEGRO_HAVE_SYS_EVENTFD_H
 #cmakedefine ALLEGRO_HAVE_SAL_H
 
 /* Define to 1 if the corresponding functions are available. */
@@ -64,6 +69,8 @@
 #cmakedefine ALLEGRO_HAVE_FTELLO
 #cmakedefine ALLEGRO_HAVE_STRERROR_R
 #cmakedefine ALLEGRO_HAVE_STRERROR_S
+#cmakedefine ALLEGRO_HAVE_CLOCK_GETTIME
+#cmakedefine ALLEGRO_HAVE_PTHREAD_CONDATTR_SETCLOCK
 #cmakedefine ALLEGRO_HAVE_VA_COPY
 
 /* Define to 1 if procfs reveals argc and argv */
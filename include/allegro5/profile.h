@@ -0,0 +1,44 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Profiling.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+#ifndef __al_included_allegro5_profile_h
+#define __al_included_allegro5_profile_h
+
+#include "allegro5/base.h"
+#include "allegro5/file.h"
+
+#ifdef __cplusplus
+   extern "C" {
+#endif
+
+
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+
+AL_FUNC(bool, al_start_profiling, (void));
+AL_FUNC(void, al_stop_profiling, (void));
+AL_FUNC(bool, al_is_profiling, (void));
+AL_FUNC(bool, al_save_profile_trace, (const char *filename));
+AL_FUNC(bool, al_save_profile_trace_f, (ALLEGRO_FILE *file));
+
+#endif
+
+
+#ifdef __cplusplus
+   }
+#endif
+
+#endif
+
+/* vim: set ts=8 sts=3 sw=3 et: */
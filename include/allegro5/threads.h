@@ -17,6 +17,7 @@
 #define __al_included_allegro5_threads_h
 
 #include "allegro5/altime.h"
+#include "allegro5/events.h"
 
 #ifdef __cplusplus
    extern "C" {
@@ -58,6 +59,28 @@ AL_FUNC(int, al_wait_cond_until, (ALLEGRO_COND *cond, ALLEGRO_MUTEX *mutex,
 AL_FUNC(void, al_broadcast_cond, (ALLEGRO_COND *cond));
 AL_FUNC(void, al_signal_cond, (ALLEGRO_COND *cond));
 
+/* Job system. */
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_JOB_COUNTER
+ */
+typedef struct ALLEGRO_JOB_COUNTER ALLEGRO_JOB_COUNTER;
+
+AL_FUNC(ALLEGRO_JOB_COUNTER *, al_create_job_counter, (void));
+AL_FUNC(void, al_destroy_job_counter, (ALLEGRO_JOB_COUNTER *counter));
+AL_FUNC(bool, al_is_job_counter_done, (ALLEGRO_JOB_COUNTER *counter));
+AL_FUNC(void, al_wait_for_job_counter, (ALLEGRO_JOB_COUNTER *counter));
+AL_FUNC(ALLEGRO_EVENT_SOURCE *, al_get_job_counter_event_source,
+   (ALLEGRO_JOB_COUNTER *counter));
+AL_FUNC(void, al_run_job, (void (*proc)(void *arg), void *arg,
+   ALLEGRO_JOB_COUNTER *counter));
+AL_FUNC(void, al_run_job_after, (ALLEGRO_JOB_COUNTER *dependency,
+   void (*proc)(void *arg), void *arg, ALLEGRO_JOB_COUNTER *counter));
+AL_FUNC(void, al_run_parallel_for, (int begin, int end, int grain,
+   void (*proc)(int begin, int end, void *arg), void *arg,
+   ALLEGRO_JOB_COUNTER *counter));
+AL_FUNC(int, al_get_num_job_workers, (void));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
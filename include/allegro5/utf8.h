@@ -53,6 +53,10 @@ AL_FUNC(int, al_ustr_offset, (const ALLEGRO_USTR *us, int index));
 AL_FUNC(bool, al_ustr_next, (const ALLEGRO_USTR *us, int *pos));
 AL_FUNC(bool, al_ustr_prev, (const ALLEGRO_USTR *us, int *pos));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(bool, al_ustr_set_indexed, (ALLEGRO_USTR *us, bool indexed));
+#endif
+
 /* Get codepoints */
 AL_FUNC(int32_t, al_ustr_get, (const ALLEGRO_USTR *us, int pos));
 AL_FUNC(int32_t, al_ustr_get_next, (const ALLEGRO_USTR *us, int *pos));
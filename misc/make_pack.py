@@ -0,0 +1,195 @@
+#!/usr/bin/env python
+#
+# Build a pack archive for al_open_pack.
+# Run:
+#  python misc/make_pack.py [--lz4] -o data.pack data/
+#
+# Every file below the given directories is stored under its path relative
+# to that directory, using forward slashes.  Directories get entries of
+# their own so that they can be listed through the file system interface.
+#
+# Layout (all integers little endian):
+#
+#  header (48 bytes):
+#     char magic[4] = "ALPK"
+#     u32 version = 1
+#     u32 num_entries
+#     u32 num_buckets         power of two
+#     u64 index_offset
+#     u64 names_offset
+#     u64 names_size
+#     i64 mtime               time the pack was built
+#
+#  file data, each entry aligned to --align bytes
+#
+#  index at index_offset:
+#     u32 buckets[num_buckets]   first entry of each chain, or 0xffffffff
+#     entries[num_entries] (48 bytes each):
+#        u32 hash                FNV-1a of the path
+#        u32 next                next entry in the chain, or 0xffffffff
+#        u32 name_offset         into the name table
+#        u32 name_length         excluding the terminating NUL
+#        u64 data_offset
+#        u64 size                uncompressed size
+#        u64 stored_size         size in the archive
+#        u32 flags               1 = LZ4 block, 2 = directory
+#        u32 reserved
+#
+#  name table at names_offset: NUL terminated paths
+
+import optparse, os, struct, sys, time
+
+FLAG_LZ4 = 1
+FLAG_DIR = 2
+NO_ENTRY = 0xffffffff
+
+
+def fnv1a(data):
+   h = 2166136261
+   for c in bytearray(data):
+      h ^= c
+      h = (h * 16777619) & 0xffffffff
+   return h
+
+
+def lz4_lengths(out, n):
+   while n >= 255:
+      out.append(255)
+      n -= 255
+   out.append(n)
+
+
+def lz4_sequence(out, literals, offset, match_length):
+   lit = len(literals)
+   token = min(lit, 15) << 4
+   if match_length:
+      token |= min(match_length - 4, 15)
+   out.append(token)
+   if lit >= 15:
+      lz4_lengths(out, lit - 15)
+   out += literals
+   if match_length:
+      out += struct.pack("<H", offset)
+      if match_length - 4 >= 15:
+         lz4_lengths(out, match_length - 4 - 15)
+
+
+def lz4_compress(src):
+   """Greedy LZ4 block compressor; not fast, but the output is valid."""
+   n = len(src)
+   out = bytearray()
+   table = {}
+   anchor = 0
+   i = 0
+   # The block format requires the last match to start 12 bytes before
+   # the end, and the last 5 bytes to be literals.
+   match_limit = n - 5
+   while i < n - 12:
+      key = src[i:i + 4]
+      ref = table.get(key)
+      table[key] = i
+      if ref is None or i - ref > 65535:
+         i += 1
+         continue
+      length = 4
+      while i + length < match_limit and src[ref + length] == src[i + length]:
+         length += 1
+      lz4_sequence(out, src[anchor:i], i - ref, length)
+      i += length
+      anchor = i
+   lz4_sequence(out, src[anchor:], 0, 0)
+   return bytes(out)
+
+
+def collect(roots):
+   entries = {}
+   for root in roots:
+      for dirpath, dirnames, filenames in os.walk(root):
+         dirnames.sort()
+         rel = os.path.relpath(dirpath, root).replace(os.sep, "/")
+         if rel != ".":
+            entries[rel] = None
+         for name in sorted(filenames):
+            path = name if rel == "." else rel + "/" + name
+            entries[path] = os.path.join(dirpath, name)
+   return entries
+
+
+def main():
+   p = optparse.OptionParser(usage="%prog [options] directory...")
+   p.add_option("-o", "--output", help="pack file to write")
+   p.add_option("--lz4", action="store_true",
+      help="compress entries with LZ4 where it saves space")
+   p.add_option("--align", type="int", default=16,
+      help="alignment of entry data (default: %default)")
+   options, args = p.parse_args()
+   if not options.output or not args:
+      p.error("need an output file and at least one directory")
+   if options.align < 1 or options.align & (options.align - 1):
+      p.error("alignment must be a power of two")
+
+   entries = collect(args)
+   paths = sorted(entries)
+
+   out = open(options.output, "wb")
+   out.write(b"\0" * 48)
+
+   records = []
+   names = bytearray()
+   for path in paths:
+      name = path.encode("utf-8")
+      name_offset = len(names)
+      names += name + b"\0"
+
+      source = entries[path]
+      if source is None:
+         records.append([fnv1a(name), NO_ENTRY, name_offset, len(name),
+            0, 0, 0, FLAG_DIR])
+         continue
+
+      data = open(source, "rb").read()
+      stored, flags = data, 0
+      if options.lz4 and len(data) > 64:
+         packed = lz4_compress(data)
+         # Only worth decoding if it saves at least an eighth.
+         if len(packed) < len(data) - len(data) // 8:
+            stored, flags = packed, FLAG_LZ4
+
+      pos = out.tell()
+      pad = -pos & (options.align - 1)
+      out.write(b"\0" * pad)
+      records.append([fnv1a(name), NO_ENTRY, name_offset, len(name),
+         pos + pad, len(data), len(stored), flags])
+      out.write(stored)
+
+   num_buckets = 1
+   while num_buckets < len(records):
+      num_buckets *= 2
+   buckets = [NO_ENTRY] * num_buckets
+   for i in reversed(range(len(records))):
+      b = records[i][0] & (num_buckets - 1)
+      records[i][1] = buckets[b]
+      buckets[b] = i
+
+   pos = out.tell()
+   index_offset = pos + (-pos & 7)
+   out.write(b"\0" * (index_offset - pos))
+   out.write(struct.pack("<%dI" % num_buckets, *buckets))
+   for r in records:
+      out.write(struct.pack("<IIIIQQQII", *(r + [0])))
+
+   names_offset = out.tell()
+   out.write(names)
+
+   out.seek(0)
+   out.write(struct.pack("<4sIIIQQQq", b"ALPK", 1, len(records), num_buckets,
+      index_offset, names_offset, len(names), int(time.time())))
+   out.close()
+
+   sys.stdout.write("%s: %d entries\n" % (options.output, len(records)))
+
+
+if __name__ == "__main__":
+   main()
+
+# vim: set sts=3 sw=3 et:
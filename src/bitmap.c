@@ -25,6 +25,7 @@
 #include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_display.h"
 #include "allegro5/internal/aintern_pixels.h"
+#include "allegro5/internal/aintern_profile.h"
 #include "allegro5/internal/aintern_shader.h"
 #include "allegro5/internal/aintern_system.h"
 
@@ -188,7 +189,7 @@ ALLEGRO_BITMAP *al_create_bitmap(int w, int h)
       al_get_new_bitmap_format(), al_get_new_bitmap_flags(),
       al_get_new_bitmap_depth(), al_get_new_bitmap_samples());
    if (bitmap) {
-      bitmap->dtor_item = _al_register_destructor(_al_dtor_list, "bitmap", bitmap,
+      _al_register_destructor(_al_dtor_list, &bitmap->dtor_item, "bitmap", bitmap,
          (void (*)(void *))al_destroy_bitmap);
    }
 
@@ -217,7 +218,7 @@ void al_destroy_bitmap(ALLEGRO_BITMAP *bitmap)
 
    _al_set_bitmap_shader_field(bitmap, NULL);
 
-   _al_unregister_destructor(_al_dtor_list, bitmap->dtor_item);
+   _al_unregister_destructor(_al_dtor_list, &bitmap->dtor_item);
 
    if (!al_is_sub_bitmap(bitmap)) {
       ALLEGRO_DISPLAY* disp = _al_get_bitmap_display(bitmap);
@@ -468,7 +469,7 @@ ALLEGRO_BITMAP *al_create_sub_bitmap(ALLEGRO_BITMAP *parent,
    bitmap->yofs = y;
    bitmap->memory = NULL;
 
-   bitmap->dtor_item = _al_register_destructor(_al_dtor_list, "sub_bitmap", bitmap,
+   _al_register_destructor(_al_dtor_list, &bitmap->dtor_item, "sub_bitmap", bitmap,
       (void (*)(void *))al_destroy_bitmap);
 
    return bitmap;
@@ -641,8 +642,10 @@ void _al_convert_bitmap_data(
 
    /* Use memcpy if no conversion is needed. */
    if (src_format == dst_format) {
+      _AL_PROFILE_BEGIN("copy bitmap data");
       _al_copy_bitmap_data(src, src_pitch, dst, dst_pitch, sx, sy,
          dx, dy, width, height, src_format);
+      _AL_PROFILE_END();
       return;
    }
 
@@ -651,8 +654,11 @@ void _al_convert_bitmap_data(
    ASSERT(!_al_pixel_format_is_video_only(src_format));
    ASSERT(!_al_pixel_format_is_video_only(dst_format));
 
+   _AL_PROFILE_BEGIN("convert bitmap data");
+   _AL_RENDER_STATS_ADD(format_conversions, 1);
    (_al_convert_funcs[src_format][dst_format])(src, src_pitch,
       dst, dst_pitch, sx, sy, dx, dy, width, height);
+   _AL_PROFILE_END();
 }
 
 
@@ -19,6 +19,7 @@
 #include "allegro5/internal/aintern_display.h"
 #include "allegro5/internal/aintern_memblit.h"
 #include "allegro5/internal/aintern_pixels.h"
+#include "allegro5/internal/aintern_profile.h"
 
 
 static ALLEGRO_COLOR solid_white = {1, 1, 1, 1};
@@ -33,6 +34,9 @@ static void _bitmap_drawer(ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR tint,
    ASSERT(!(flags & (ALLEGRO_FLIP_HORIZONTAL | ALLEGRO_FLIP_VERTICAL)));
    ASSERT(bitmap != dest && bitmap != dest->parent);
 
+   _AL_PROFILE_BEGIN("draw bitmap");
+   _AL_RENDER_STATS_ADD(draw_calls, 1);
+
    /* If destination is memory, do a memory blit */
    if (al_get_bitmap_flags(dest) & ALLEGRO_MEMORY_BITMAP ||
        _al_pixel_format_is_compressed(al_get_bitmap_format(dest))) {
@@ -56,6 +60,8 @@ static void _bitmap_drawer(ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR tint,
          bitmap->vt->draw_bitmap_region(bitmap, tint, sx, sy, sw, sh, flags);
       }
    }
+
+   _AL_PROFILE_END();
 }
 
 
@@ -17,6 +17,7 @@
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_profile.h"
 #include "allegro5/internal/aintern_vector.h"
 
 #include <string.h>
@@ -206,7 +207,9 @@ ALLEGRO_BITMAP *al_load_bitmap_flags(const char *filename, int flags)
 
    h = find_handler(ext, false);
    if (h && h->loader) {
+      _AL_PROFILE_BEGIN("load bitmap");
       ret = h->loader(filename, flags);
+      _AL_PROFILE_END();
       if (!ret)
          ALLEGRO_WARN("Failed loading %s with %s handler.\n", filename,
             ext);
@@ -265,12 +268,17 @@ ALLEGRO_BITMAP *al_load_bitmap_flags_f(ALLEGRO_FILE *fp,
    const char *ident, int flags)
 {
    Handler *h;
+   ALLEGRO_BITMAP *ret;
    if (ident)
       h = find_handler(ident, false);
    else
       h = find_handler_for_file(fp);
-   if (h && h->fs_loader)
-      return h->fs_loader(fp, flags);
+   if (h && h->fs_loader) {
+      _AL_PROFILE_BEGIN("load bitmap");
+      ret = h->fs_loader(fp, flags);
+      _AL_PROFILE_END();
+      return ret;
+   }
    else
       return NULL;
 }
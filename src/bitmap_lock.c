@@ -18,6 +18,7 @@
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_pixels.h"
+#include "allegro5/internal/aintern_profile.h"
 
 
 /* Function: al_lock_bitmap_region
@@ -77,9 +78,12 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
       flags = ALLEGRO_LOCK_READWRITE;
    }
 
+   _AL_PROFILE_BEGIN("al_lock_bitmap_region");
+
    if (bitmap_flags & ALLEGRO_MEMORY_BITMAP) {
       int f = _al_get_real_pixel_format(al_get_current_display(), format);
       if (f < 0) {
+         _AL_PROFILE_END();
          return NULL;
       }
       ASSERT(bitmap->memory);
@@ -107,15 +111,19 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
    else {
       lr = bitmap->vt->lock_region(bitmap, xc, yc, wc, hc, format, flags);
       if (!lr) {
+         _AL_PROFILE_END();
          return NULL;
       }
    }
 
+   _AL_PROFILE_END();
+
    bitmap->lock_data = lr->data;
    /* Fixup the data pointer for unaligned access */
    lr->data = (char*)lr->data + (x - xc) * lr->pixel_size + (y - yc) * lr->pitch;
 
    bitmap->locked = true;
+   _AL_RENDER_STATS_ADD(bitmap_locks, 1);
 
    return lr;
 }
@@ -140,6 +148,8 @@ void al_unlock_bitmap(ALLEGRO_BITMAP *bitmap)
       bitmap = bitmap->parent;
    }
 
+   _AL_PROFILE_BEGIN("al_unlock_bitmap");
+
    if (!(al_get_bitmap_flags(bitmap) & ALLEGRO_MEMORY_BITMAP)) {
       if (_al_pixel_format_is_compressed(bitmap->locked_region.format))
          bitmap->vt->unlock_compressed_region(bitmap);
@@ -158,6 +168,8 @@ void al_unlock_bitmap(ALLEGRO_BITMAP *bitmap)
       }
    }
 
+   _AL_PROFILE_END();
+
    bitmap->locked = false;
 }
 
@@ -243,6 +255,7 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region_blocked(ALLEGRO_BITMAP *bitmap,
    }
 
    bitmap->locked = true;
+   _AL_RENDER_STATS_ADD(bitmap_locks, 1);
 
    return lr;
 }
@@ -77,7 +77,8 @@ ALLEGRO_COLOR al_get_pixel(ALLEGRO_BITMAP *bitmap, int x, int y)
 }
 
 
-void _al_put_pixel(ALLEGRO_BITMAP *bitmap, int x, int y, ALLEGRO_COLOR color)
+/* Returns true if the pixel was inside the clipping rectangle and written. */
+bool _al_put_pixel(ALLEGRO_BITMAP *bitmap, int x, int y, ALLEGRO_COLOR color)
 {
    ALLEGRO_LOCKED_REGION *lr;
    char *data;
@@ -90,18 +91,18 @@ void _al_put_pixel(ALLEGRO_BITMAP *bitmap, int x, int y, ALLEGRO_COLOR color)
 
    if (x < bitmap->cl || y < bitmap->ct ||
        x >= bitmap->cr_excl || y >= bitmap->cb_excl) {
-      return;
+      return false;
    }
 
    if (bitmap->locked) {
       if (_al_pixel_format_is_video_only(bitmap->locked_region.format)) {
          ALLEGRO_ERROR("Invalid lock format.");
-         return;
+         return false;
       }
       x -= bitmap->lock_x;
       y -= bitmap->lock_y;
       if (x < 0 || y < 0 || x >= bitmap->lock_w || y >= bitmap->lock_h) {
-         return;
+         return false;
       }
 
       data = bitmap->locked_region.data;
@@ -114,7 +115,7 @@ void _al_put_pixel(ALLEGRO_BITMAP *bitmap, int x, int y, ALLEGRO_COLOR color)
       lr = al_lock_bitmap_region(bitmap, x, y, 1, 1,
          ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_WRITEONLY);
       if (!lr)
-         return;
+         return false;
 
       /* FIXME: check for valid pixel format */
 
@@ -123,6 +124,8 @@ void _al_put_pixel(ALLEGRO_BITMAP *bitmap, int x, int y, ALLEGRO_COLOR color)
 
       al_unlock_bitmap(bitmap);
    }
+
+   return true;
 }
 
 
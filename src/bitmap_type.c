@@ -85,8 +85,7 @@ void _al_unregister_convert_bitmap(ALLEGRO_BITMAP *bitmap)
 static void swap_bitmaps(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP *other)
 {
    ALLEGRO_BITMAP temp;
-   _AL_LIST_ITEM *bitmap_dtor_item = bitmap->dtor_item;
-   _AL_LIST_ITEM *other_dtor_item = other->dtor_item;
+   _AL_DTOR_ITEM dtor_item;
    ALLEGRO_DISPLAY *bitmap_display, *other_display;
 
    _al_unregister_convert_bitmap(bitmap);
@@ -97,6 +96,12 @@ static void swap_bitmaps(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP *other)
    if (bitmap->shader)
       _al_unregister_shader_bitmap(bitmap->shader, bitmap);
 
+   /* The destructor items are linked into the list by address, so take
+    * them out while the structures are swapped.
+    */
+   _al_unregister_destructor(_al_dtor_list, &bitmap->dtor_item);
+   _al_unregister_destructor(_al_dtor_list, &other->dtor_item);
+
    temp = *bitmap;
    *bitmap = *other;
    *other = temp;
@@ -104,8 +109,11 @@ static void swap_bitmaps(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP *other)
    /* Re-associate the destructors back, as they are tied to the object
     * pointers.
     */
-   bitmap->dtor_item = bitmap_dtor_item;
-   other->dtor_item = other_dtor_item;
+   dtor_item = bitmap->dtor_item;
+   bitmap->dtor_item = other->dtor_item;
+   other->dtor_item = dtor_item;
+   _al_reregister_destructor(_al_dtor_list, &bitmap->dtor_item);
+   _al_reregister_destructor(_al_dtor_list, &other->dtor_item);
 
    bitmap_display = _al_get_bitmap_display(bitmap);
    other_display = _al_get_bitmap_display(other);
@@ -21,14 +21,154 @@
 #include <ctype.h>
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
-#include "allegro5/internal/aintern_aatree.h"
 #include "allegro5/internal/aintern_config.h"
 
 
+/* Smallest non-empty index. */
+#define MIN_INDEX_CAPACITY    8
 
-static int cmp_ustr(void const *a, void const *b)
+/* Initial buffer size for files of unknown size. */
+#define LOAD_CHUNK_SIZE       4096
+
+
+static uint32_t hash_ustr(const ALLEGRO_USTR *us)
+{
+   const unsigned char *p = (const unsigned char *)al_cstr(us);
+   size_t n = al_ustr_size(us);
+   uint32_t h = 2166136261u;
+
+   while (n--) {
+      h ^= *p++;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
+static bool same_key(const _AL_CONFIG_SLOT *slot, const ALLEGRO_USTR *key,
+   uint32_t hash)
+{
+   return slot->hash == hash &&
+      al_ustr_size(slot->key) == al_ustr_size(key) &&
+      memcmp(al_cstr(slot->key), al_cstr(key), al_ustr_size(key)) == 0;
+}
+
+
+static void *index_find(const _AL_CONFIG_INDEX *index,
+   const ALLEGRO_USTR *key, uint32_t hash)
+{
+   size_t mask = index->capacity - 1;
+   size_t i;
+
+   if (index->capacity == 0)
+      return NULL;
+
+   for (i = hash & mask; index->slots[i].key; i = (i + 1) & mask) {
+      if (same_key(&index->slots[i], key, hash))
+         return index->slots[i].item;
+   }
+   return NULL;
+}
+
+
+static void index_put(_AL_CONFIG_INDEX *index, const ALLEGRO_USTR *key,
+   uint32_t hash, void *item)
+{
+   size_t mask = index->capacity - 1;
+   size_t i;
+
+   for (i = hash & mask; index->slots[i].key; i = (i + 1) & mask)
+      ;
+   index->slots[i].hash = hash;
+   index->slots[i].key = key;
+   index->slots[i].item = item;
+   index->count++;
+}
+
+
+/* The key must not be in the index yet, and must stay alive as long as
+ * the item is indexed.  Returns false if the index is full and could not
+ * be grown.
+ */
+static bool index_insert(_AL_CONFIG_INDEX *index, const ALLEGRO_USTR *key,
+   uint32_t hash, void *item)
+{
+   /* Keep the load factor below 3/4. */
+   if ((index->count + 1) * 4 > index->capacity * 3) {
+      _AL_CONFIG_INDEX bigger;
+      size_t i;
+
+      bigger.capacity = index->capacity ? index->capacity * 2 :
+         MIN_INDEX_CAPACITY;
+      bigger.count = 0;
+      bigger.slots = al_calloc(bigger.capacity, sizeof(_AL_CONFIG_SLOT));
+
+      if (bigger.slots) {
+         for (i = 0; i < index->capacity; i++) {
+            if (index->slots[i].key) {
+               index_put(&bigger, index->slots[i].key, index->slots[i].hash,
+                  index->slots[i].item);
+            }
+         }
+         al_free(index->slots);
+         *index = bigger;
+      }
+      else if (index->count + 1 >= index->capacity) {
+         /* Probing relies on at least one slot staying empty. */
+         al_set_errno(ENOMEM);
+         return false;
+      }
+      /* Otherwise keep using the old table, just more crowded. */
+   }
+
+   index_put(index, key, hash, item);
+   return true;
+}
+
+
+/* Returns the removed item, or NULL. */
+static void *index_remove(_AL_CONFIG_INDEX *index, const ALLEGRO_USTR *key)
 {
-   return al_ustr_compare(a, b);
+   uint32_t hash = hash_ustr(key);
+   size_t mask = index->capacity - 1;
+   size_t i, j;
+   void *item;
+
+   if (index->capacity == 0)
+      return NULL;
+
+   for (i = hash & mask; index->slots[i].key; i = (i + 1) & mask) {
+      if (same_key(&index->slots[i], key, hash))
+         break;
+   }
+   if (!index->slots[i].key)
+      return NULL;
+
+   item = index->slots[i].item;
+   index->count--;
+
+   /* Shift later members of the probe sequence back into the hole, so
+    * that lookups never need to skip deleted slots.
+    */
+   for (j = (i + 1) & mask; index->slots[j].key; j = (j + 1) & mask) {
+      size_t home = index->slots[j].hash & mask;
+      if (((j - home) & mask) >= ((j - i) & mask)) {
+         index->slots[i] = index->slots[j];
+         i = j;
+      }
+   }
+   index->slots[i].key = NULL;
+
+   return item;
+}
+
+
+static void index_free(_AL_CONFIG_INDEX *index)
+{
+   al_free(index->slots);
+   index->slots = NULL;
+   index->capacity = 0;
+   index->count = 0;
 }
 
 
@@ -46,33 +186,14 @@ ALLEGRO_CONFIG *al_create_config(void)
 static ALLEGRO_CONFIG_SECTION *find_section(const ALLEGRO_CONFIG *config,
    const ALLEGRO_USTR *section)
 {
-   return _al_aa_search(config->tree, section, cmp_ustr);
+   return index_find(&config->index, section, hash_ustr(section));
 }
 
 
 static ALLEGRO_CONFIG_ENTRY *find_entry(const ALLEGRO_CONFIG_SECTION *section,
    const ALLEGRO_USTR *key)
 {
-   return _al_aa_search(section->tree, key, cmp_ustr);
-}
-
-
-static void get_key_and_value(const ALLEGRO_USTR *buf,
-   ALLEGRO_USTR *key, ALLEGRO_USTR *value)
-{
-   int eq = al_ustr_find_chr(buf, 0, '=');
-
-   if (eq == -1) {
-      al_ustr_assign(key, buf);
-      al_ustr_assign_cstr(value, "");
-   }
-   else {
-      al_ustr_assign_substr(key, buf, 0, eq);
-      al_ustr_assign_substr(value, buf, eq + 1, al_ustr_size(buf));
-   }
-
-   al_ustr_trim_ws(key);
-   al_ustr_trim_ws(value);
+   return index_find(&section->index, key, hash_ustr(key));
 }
 
 
@@ -81,13 +202,20 @@ static ALLEGRO_CONFIG_SECTION *config_add_section(ALLEGRO_CONFIG *config,
 {
    ALLEGRO_CONFIG_SECTION *sec = config->head;
    ALLEGRO_CONFIG_SECTION *section;
+   uint32_t hash = hash_ustr(name);
 
-   if ((section = find_section(config, name)))
+   if ((section = index_find(&config->index, name, hash)))
       return section;
 
    section = al_calloc(1, sizeof(ALLEGRO_CONFIG_SECTION));
    section->name = al_ustr_dup(name);
 
+   if (!index_insert(&config->index, section->name, hash, section)) {
+      al_ustr_free(section->name);
+      al_free(section);
+      return NULL;
+   }
+
    if (sec == NULL) {
       config->head = section;
       config->last = section;
@@ -99,8 +227,6 @@ static ALLEGRO_CONFIG_SECTION *config_add_section(ALLEGRO_CONFIG *config,
       config->last = section;
    }
 
-   config->tree = _al_aa_insert(config->tree, section->name, section, cmp_ustr);
-
    return section;
 }
 
@@ -117,21 +243,17 @@ void al_add_config_section(ALLEGRO_CONFIG *config, const char *name)
 }
 
 
-static void config_set_value(ALLEGRO_CONFIG *config,
-   const ALLEGRO_USTR *section, const ALLEGRO_USTR *key,
-   const ALLEGRO_USTR *value)
+static void section_set_value(ALLEGRO_CONFIG_SECTION *s,
+   const ALLEGRO_USTR *key, const ALLEGRO_USTR *value)
 {
-   ALLEGRO_CONFIG_SECTION *s;
    ALLEGRO_CONFIG_ENTRY *entry;
+   uint32_t hash = hash_ustr(key);
 
-   s = find_section(config, section);
-   if (s) {
-      entry = find_entry(s, key);
-      if (entry) {
-         al_ustr_assign(entry->value, value);
-         al_ustr_trim_ws(entry->value);
-         return;
-      }
+   entry = index_find(&s->index, key, hash);
+   if (entry) {
+      al_ustr_assign(entry->value, value);
+      al_ustr_trim_ws(entry->value);
+      return;
    }
 
    entry = al_calloc(1, sizeof(ALLEGRO_CONFIG_ENTRY));
@@ -140,8 +262,11 @@ static void config_set_value(ALLEGRO_CONFIG *config,
    entry->value = al_ustr_dup(value);
    al_ustr_trim_ws(entry->value);
 
-   if (!s) {
-      s = config_add_section(config, section);
+   if (!index_insert(&s->index, entry->key, hash, entry)) {
+      al_ustr_free(entry->key);
+      al_ustr_free(entry->value);
+      al_free(entry);
+      return;
    }
 
    if (s->head == NULL) {
@@ -154,8 +279,17 @@ static void config_set_value(ALLEGRO_CONFIG *config,
       entry->prev = s->last;
       s->last = entry;
    }
+}
+
 
-   s->tree = _al_aa_insert(s->tree, entry->key, entry, cmp_ustr);
+static void config_set_value(ALLEGRO_CONFIG *config,
+   const ALLEGRO_USTR *section, const ALLEGRO_USTR *key,
+   const ALLEGRO_USTR *value)
+{
+   ALLEGRO_CONFIG_SECTION *s = config_add_section(config, section);
+
+   if (s)
+      section_set_value(s, key, value);
 }
 
 
@@ -186,14 +320,11 @@ void al_set_config_value(ALLEGRO_CONFIG *config,
 }
 
 
-static void config_add_comment(ALLEGRO_CONFIG *config,
-   const ALLEGRO_USTR *section, const ALLEGRO_USTR *comment)
+static void section_add_comment(ALLEGRO_CONFIG_SECTION *s,
+   const ALLEGRO_USTR *comment)
 {
-   ALLEGRO_CONFIG_SECTION *s;
    ALLEGRO_CONFIG_ENTRY *entry;
 
-   s = find_section(config, section);
-
    entry = al_calloc(1, sizeof(ALLEGRO_CONFIG_ENTRY));
    entry->is_comment = true;
    entry->key = al_ustr_dup(comment);
@@ -203,10 +334,6 @@ static void config_add_comment(ALLEGRO_CONFIG *config,
     */
    al_ustr_find_replace_cstr(entry->key, 0, "\n", " ");
 
-   if (!s) {
-      s = config_add_section(config, section);
-   }
-
    if (s->head == NULL) {
       s->head = entry;
       s->last = entry;
@@ -220,6 +347,16 @@ static void config_add_comment(ALLEGRO_CONFIG *config,
 }
 
 
+static void config_add_comment(ALLEGRO_CONFIG *config,
+   const ALLEGRO_USTR *section, const ALLEGRO_USTR *comment)
+{
+   ALLEGRO_CONFIG_SECTION *s = config_add_section(config, section);
+
+   if (s)
+      section_add_comment(s, comment);
+}
+
+
 /* Function: al_add_config_comment
  */
 void al_add_config_comment(ALLEGRO_CONFIG *config,
@@ -288,21 +425,55 @@ const char *al_get_config_value(const ALLEGRO_CONFIG *config,
 }
 
 
-static bool readline(ALLEGRO_FILE *file, ALLEGRO_USTR *line)
+/* Read the rest of the file into memory, in one piece where the size is
+ * known up front.
+ */
+static char *read_whole_file(ALLEGRO_FILE *file, size_t *ret_size)
 {
-   char buf[128];
+   int64_t fsize = al_fsize(file);
+   int64_t pos = al_ftell(file);
+   size_t capacity = LOAD_CHUNK_SIZE;
+   size_t size = 0;
+   char *buf;
+   size_t n;
 
-   if (!al_fgets(file, buf, sizeof(buf))) {
-      return false;
+   if (fsize > 0 && pos >= 0 && fsize > pos &&
+         (uint64_t)(fsize - pos) < (size_t)-1) {
+      /* One spare byte, so that end of file is seen without a resize. */
+      capacity = fsize - pos + 1;
    }
 
-   do {
-      al_ustr_append_cstr(line, buf);
-      if (al_ustr_has_suffix_cstr(line, "\n"))
+   buf = al_malloc(capacity);
+   if (!buf)
+      return NULL;
+
+   for (;;) {
+      if (size == capacity) {
+         char *bigger = al_realloc(buf, capacity * 2);
+         if (!bigger) {
+            al_free(buf);
+            return NULL;
+         }
+         buf = bigger;
+         capacity *= 2;
+      }
+      n = al_fread(file, buf + size, capacity - size);
+      if (n == 0)
          break;
-   } while (al_fgets(file, buf, sizeof(buf)));
+      size += n;
+   }
 
-   return true;
+   *ret_size = size;
+   return buf;
+}
+
+
+static void trim_ws(const char **start, const char **end)
+{
+   while (*start < *end && isspace((unsigned char)**start))
+      (*start)++;
+   while (*end > *start && isspace((unsigned char)(*end)[-1]))
+      (*end)--;
 }
 
 
@@ -329,10 +500,12 @@ ALLEGRO_CONFIG *al_load_config_file_f(ALLEGRO_FILE *file)
 {
    ALLEGRO_CONFIG *config;
    ALLEGRO_CONFIG_SECTION *current_section = NULL;
-   ALLEGRO_USTR *line;
-   ALLEGRO_USTR *section;
-   ALLEGRO_USTR *key;
-   ALLEGRO_USTR *value;
+   ALLEGRO_USTR_INFO key_info, value_info;
+   const ALLEGRO_USTR *key;
+   const ALLEGRO_USTR *value;
+   const char *p, *end;
+   char *buf;
+   size_t size;
    ASSERT(file);
 
    config = al_create_config();
@@ -340,48 +513,67 @@ ALLEGRO_CONFIG *al_load_config_file_f(ALLEGRO_FILE *file)
       return NULL;
    }
 
-   line = al_ustr_new("");
-   section = al_ustr_new("");
-   key = al_ustr_new("");
-   value = al_ustr_new("");
+   /* Lines are parsed in place; only the entries themselves allocate. */
+   buf = read_whole_file(file, &size);
+   if (!buf) {
+      al_destroy_config(config);
+      return NULL;
+   }
+
+   for (p = buf, end = buf + size; p < end; ) {
+      const char *eol = memchr(p, '\n', end - p);
+      const char *s = p;
+      const char *e = eol ? eol : end;
+      p = eol ? eol + 1 : end;
 
-   while (1) {
-      al_ustr_assign_cstr(line, "");
-      if (!readline(file, line))
-         break;
-      al_ustr_trim_ws(line);
+      trim_ws(&s, &e);
+
+      if (!current_section && (s == e || *s != '[')) {
+         current_section = config_add_section(config,
+            al_ustr_empty_string());
+         if (!current_section)
+            goto fail;
+      }
 
-      if (al_ustr_has_prefix_cstr(line, "#") || al_ustr_size(line) == 0) {
+      if (s == e || *s == '#') {
          /* Preserve comments and blank lines */
-         const ALLEGRO_USTR *name;
-         if (current_section)
-            name = current_section->name;
-         else
-            name = al_ustr_empty_string();
-         config_add_comment(config, name, line);
+         section_add_comment(current_section,
+            al_ref_buffer(&key_info, s, e - s));
       }
-      else if (al_ustr_has_prefix_cstr(line, "[")) {
-         int rbracket = al_ustr_rfind_chr(line, al_ustr_size(line), ']');
-         if (rbracket == -1)
-            rbracket = al_ustr_size(line);
-         al_ustr_assign_substr(section, line, 1, rbracket);
-         current_section = config_add_section(config, section);
+      else if (*s == '[') {
+         const char *rbracket = e;
+         while (rbracket > s && rbracket[-1] != ']')
+            rbracket--;
+         if (rbracket == s)
+            rbracket = e + 1;
+         current_section = config_add_section(config,
+            al_ref_buffer(&key_info, s + 1, rbracket - 1 - (s + 1)));
+         if (!current_section)
+            goto fail;
       }
       else {
-         get_key_and_value(line, key, value);
-         if (current_section == NULL)
-            config_set_value(config, al_ustr_empty_string(), key, value);
-         else
-            config_set_value(config, current_section->name, key, value);
+         const char *eq = memchr(s, '=', e - s);
+         const char *ks = s;
+         const char *ke = eq ? eq : e;
+         const char *vs = eq ? eq + 1 : e;
+         const char *ve = e;
+
+         trim_ws(&ks, &ke);
+         trim_ws(&vs, &ve);
+         key = al_ref_buffer(&key_info, ks, ke - ks);
+         value = al_ref_buffer(&value_info, vs, ve - vs);
+         section_set_value(current_section, key, value);
       }
    }
 
-   al_ustr_free(line);
-   al_ustr_free(section);
-   al_ustr_free(key);
-   al_ustr_free(value);
+   al_free(buf);
 
    return config;
+
+fail:
+   al_free(buf);
+   al_destroy_config(config);
+   return NULL;
 }
 
 
@@ -556,7 +748,7 @@ static void destroy_section(ALLEGRO_CONFIG_SECTION *s)
       e = tmp;
    }
    al_ustr_free(s->name);
-   _al_aa_free(s->tree);
+   index_free(&s->index);
    al_free(s);
 }
 
@@ -578,7 +770,7 @@ void al_destroy_config(ALLEGRO_CONFIG *config)
       s = tmp;
    }
 
-   _al_aa_free(config->tree);
+   index_free(&config->index);
    al_free(config);
 }
 
@@ -666,15 +858,11 @@ bool al_remove_config_section(ALLEGRO_CONFIG *config, char const *section)
 {
    ALLEGRO_USTR_INFO section_info;
    ALLEGRO_USTR const *usection = al_ref_cstr(&section_info, section);
-   void *value;
    ALLEGRO_CONFIG_SECTION *s;
-   
-   value = NULL;
-   config->tree = _al_aa_delete(config->tree, usection, cmp_ustr, &value);
-   if (!value)
+
+   s = index_remove(&config->index, usection);
+   if (!s)
       return false;
-   
-   s = value;
 
    if (s->prev) {
       s->prev->next = s->next;
@@ -706,20 +894,16 @@ bool al_remove_config_key(ALLEGRO_CONFIG *config, char const *section,
    ALLEGRO_USTR_INFO key_info;
    ALLEGRO_USTR const *usection = al_ref_cstr(&section_info, section);
    ALLEGRO_USTR const *ukey = al_ref_cstr(&key_info, key);
-   void *value;
    ALLEGRO_CONFIG_ENTRY * e;
 
    ALLEGRO_CONFIG_SECTION *s = find_section(config, usection);
    if (!s)
       return false;
 
-   value = NULL;
-   s->tree = _al_aa_delete(s->tree, ukey, cmp_ustr, &value);
-   if (!value)
+   e = index_remove(&s->index, ukey);
+   if (!e)
       return false;
    
-   e = value;
-   
    if (e->prev) {
       e->prev->next = e->next;
    }
@@ -17,8 +17,10 @@
 #include <stdio.h>
 
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern_atomicops.h"
 #include "allegro5/internal/aintern_debug.h"
 #include "allegro5/internal/aintern_thread.h"
+#include "allegro5/internal/aintern_tls.h"
 #include "allegro5/internal/aintern_vector.h"
 
 #ifdef ALLEGRO_ANDROID
@@ -26,11 +28,23 @@
 #endif
 
 
+/* Must be a power of two. */
+#define TRACE_RING_SIZE          256
+#define TRACE_RING_MASK          (TRACE_RING_SIZE - 1)
+
+#define TRACE_SLOT_MIN_SIZE      256
+#define TRACE_MESSAGE_MAX        16384
+
+#define MAX_TRACE_CHANNELS       256
+#define TRACE_CHANNEL_NAME_SIZE  32
+
+
 /* tracing */
 typedef struct TRACE_INFO
 {
    bool trace_virgin;
    FILE *trace_file;
+   /* Protects the settings below and the channel table. */
    _AL_MUTEX trace_mutex;
 
    /* 0: debug, 1: info, 2: warn, 3: error */
@@ -40,6 +54,8 @@ typedef struct TRACE_INFO
    /* List of channels to log. NULL to log all channels. */
    _AL_VECTOR channels;
    _AL_VECTOR excluded;
+   /* Whether messages are written by a background thread. */
+   bool async;
    /* Whether settings have been read from allegro5.cfg or not. */
    bool configured;
 } TRACE_INFO;
@@ -54,10 +70,62 @@ static TRACE_INFO trace_info =
    7,
    _AL_VECTOR_INITIALIZER(ALLEGRO_USTR *),
    _AL_VECTOR_INITIALIZER(ALLEGRO_USTR *),
+   true,
    false
 };
 
-static char static_trace_buffer[2048];
+
+/* Messages are formatted straight into a slot of a bounded ring buffer,
+ * so threads never wait for each other or for the output to be written.
+ * A producer takes a ticket, waits for the slot of that ticket to be
+ * free (which only happens if the ring is full), fills it in between
+ * _al_trace_prefix and _al_trace_suffix and then publishes it.  The
+ * writer consumes slots strictly in ticket order.
+ *
+ * The slot state is relative to the lap of the ticket, so that the
+ * zero-initialised ring is ready for the first lap: it equals the lap
+ * while the slot is free for that ticket, and the lap plus one once the
+ * message has been published.
+ */
+typedef struct TRACE_SLOT
+{
+   volatile _AL_ATOMIC state;
+   char *buf;
+   size_t size;
+   size_t len;
+   int level;
+} TRACE_SLOT;
+
+static TRACE_SLOT trace_ring[TRACE_RING_SIZE];
+static volatile _AL_ATOMIC trace_head;
+
+/* A thread which already has a message open in the ring, or which is
+ * running a trace handler, must not wait for ring space; it might be
+ * waiting for itself.  Such messages are formatted here instead, under
+ * writer_mutex, and written out immediately.
+ */
+static TRACE_SLOT trace_direct[_AL_TRACE_MAX_NESTING];
+
+/* The writer.  Everything here is protected by writer_mutex, which also
+ * serialises all output.
+ */
+static _AL_MUTEX writer_mutex = _AL_MUTEX_UNINITED;
+static _AL_COND writer_cond;
+static _AL_THREAD writer_thread;
+static unsigned int trace_tail;
+static bool writer_draining;
+static bool writer_stop;
+static bool writer_running;
+static volatile _AL_ATOMIC writer_sleeping;
+static bool mutexes_inited;
+
+/* Channels declared with ALLEGRO_DEBUG_CHANNEL, indexed by id.  Entries
+ * are never removed, as the ids are cached in the channel variables.
+ */
+static char trace_channel_names[MAX_TRACE_CHANNELS][TRACE_CHANNEL_NAME_SIZE];
+static int num_trace_channels = 1;
+
+unsigned char _al_trace_channel_mute[MAX_TRACE_CHANNELS];
 
 /* run-time assertions */
 void (*_al_user_assert_handler)(char const *expr, char const *file,
@@ -78,11 +146,93 @@ static void delete_string_list(_AL_VECTOR *v)
 }
 
 
+static bool string_list_contains(_AL_VECTOR const *v, char const *channel)
+{
+   size_t i;
+
+   for (i = 0; i < _al_vector_size(v); i++) {
+      ALLEGRO_USTR **iter = _al_vector_ref(v, i);
+      if (!strcmp(al_cstr(*iter), channel))
+         return true;
+   }
+   return false;
+}
+
+
+static bool channel_enabled(char const *channel, int level)
+{
+   if (level < trace_info.level)
+      return false;
+
+   if (_al_vector_is_nonempty(&trace_info.channels) &&
+         !string_list_contains(&trace_info.channels, channel))
+      return false;
+
+   return !string_list_contains(&trace_info.excluded, channel);
+}
+
+
+static unsigned char compute_channel_mute(char const *channel)
+{
+   unsigned char mute = 0;
+   int level;
+
+   for (level = 0; level < 8; level++) {
+      if (!channel_enabled(channel, level))
+         mute |= 1 << level;
+   }
+   return mute;
+}
+
+
+/* resolve_channel:
+ *  Return the id of a channel, adding it to the table if necessary, or 0
+ *  if it does not fit.  trace_mutex must be held.
+ */
+static int resolve_channel(char const *channel)
+{
+   int id;
+
+   if (strlen(channel) >= TRACE_CHANNEL_NAME_SIZE)
+      return 0;
+
+   for (id = 1; id < num_trace_channels; id++) {
+      if (!strcmp(trace_channel_names[id], channel))
+         return id;
+   }
+
+   if (num_trace_channels == MAX_TRACE_CHANNELS)
+      return 0;
+
+   id = num_trace_channels++;
+   strcpy(trace_channel_names[id], channel);
+   _al_trace_channel_mute[id] = compute_channel_mute(channel);
+   return id;
+}
+
+
+static void writer_proc(_AL_THREAD *self, void *arg);
+
+
 void _al_configure_logging(void)
 {
    ALLEGRO_CONFIG *config;
    char const *v;
    bool got_all = false;
+   int id;
+
+   if (!mutexes_inited) {
+      _al_mutex_init(&trace_info.trace_mutex);
+      _al_mutex_init_recursive(&writer_mutex);
+      _al_cond_init(&writer_cond);
+      mutexes_inited = true;
+   }
+
+   _al_mutex_lock(&trace_info.trace_mutex);
+
+   /* We are called again once allegro5.cfg has been read. */
+   delete_string_list(&trace_info.channels);
+   delete_string_list(&trace_info.excluded);
 
    config = al_get_system_config();
    v = al_get_config_value(config, "trace", "channels");
@@ -156,9 +306,39 @@ void _al_configure_logging(void)
    else
       trace_info.flags &= ~1;
 
-   _al_mutex_init(&trace_info.trace_mutex);
+   v = al_get_config_value(config, "trace", "async");
+   trace_info.async = (!v || strcmp(v, "0"));
+
+   for (id = 1; id < num_trace_channels; id++) {
+      _al_trace_channel_mute[id] =
+         compute_channel_mute(trace_channel_names[id]);
+   }
 
    trace_info.configured = true;
+
+   _al_mutex_unlock(&trace_info.trace_mutex);
+
+   _al_start_logging();
+}
+
+
+/* Start the writer thread if logging is asynchronous.  This only happens
+ * while the system is installed, so that _al_shutdown_logging gets to stop
+ * it again; al_install_system calls this once it is.
+ */
+void _al_start_logging(void)
+{
+   if (!mutexes_inited)
+      return;
+
+   _al_mutex_lock(&writer_mutex);
+   if (trace_info.configured && trace_info.async && !writer_running &&
+         trace_info.level < 9999 && al_is_system_installed()) {
+      writer_stop = false;
+      _al_thread_create(&writer_thread, writer_proc, NULL);
+      writer_running = true;
+   }
+   _al_mutex_unlock(&writer_mutex);
 }
 
 
@@ -187,89 +367,256 @@ static void open_trace_file(void)
 }
 
 
-static void do_trace(const char *msg, ...)
+static void write_message(TRACE_SLOT *slot)
 {
-   va_list ap;
+   if (!slot->buf)
+      return;
+
+   if (_al_user_trace_handler) {
+      _al_user_trace_handler(slot->buf);
+      return;
+   }
 
 #ifdef ALLEGRO_ANDROID
-   if (true)
+   (void)__android_log_print(ANDROID_LOG_INFO, "allegro", "%s", slot->buf);
 #else
-   if (_al_user_trace_handler)
+   open_trace_file();
+   if (trace_info.trace_file)
+      fwrite(slot->buf, 1, slot->len, trace_info.trace_file);
 #endif
-   {
-      int s = strlen(static_trace_buffer);
-      va_start(ap, msg);
-      vsnprintf(static_trace_buffer + s, sizeof(static_trace_buffer) - s,
-         msg, ap);
-      va_end(ap);
+}
+
+
+/* drain_ring:
+ *  Write out published messages in order, stopping at the first one which
+ *  is still being formatted.  writer_mutex must be held.  Returns true if
+ *  anything was written.
+ */
+static bool drain_ring(void)
+{
+   _AL_TRACE_NESTING *nesting = _al_tls_get_trace_nesting();
+   bool written = false;
+
+   /* A trace handler which logs would re-enter through the recursive
+    * mutex; its messages are picked up by the loop below instead.
+    */
+   if (writer_draining)
+      return false;
+   writer_draining = true;
+   if (nesting)
+      nesting->draining++;
+
+   for (;;) {
+      TRACE_SLOT *slot = &trace_ring[trace_tail & TRACE_RING_MASK];
+      unsigned int lap = trace_tail & ~TRACE_RING_MASK;
+
+      if ((unsigned int)slot->state != lap + 1)
+         break;
+      _al_memory_barrier();
+
+      write_message(slot);
+
+      _al_memory_barrier();
+      slot->state = lap + TRACE_RING_SIZE;
+      trace_tail++;
+      written = true;
    }
-   else if (trace_info.trace_file) {
-      va_start(ap, msg);
-      vfprintf(trace_info.trace_file, msg, ap);
-      va_end(ap);
+
+   if (written && trace_info.trace_file && !_al_user_trace_handler)
+      fflush(trace_info.trace_file);
+
+   if (nesting)
+      nesting->draining--;
+   writer_draining = false;
+   return written;
+}
+
+
+static bool message_ready(void)
+{
+   TRACE_SLOT *slot = &trace_ring[trace_tail & TRACE_RING_MASK];
+   unsigned int lap = trace_tail & ~TRACE_RING_MASK;
+
+   return (unsigned int)slot->state == lap + 1;
+}
+
+
+static void writer_proc(_AL_THREAD *self, void *arg)
+{
+   (void)self;
+   (void)arg;
+
+   _al_mutex_lock(&writer_mutex);
+   while (!writer_stop) {
+      if (drain_ring())
+         continue;
+
+      _al_fetch_and_add1(&writer_sleeping);
+      if (!message_ready() && !writer_stop)
+         _al_cond_wait(&writer_cond, &writer_mutex);
+      _al_sub1_and_fetch(&writer_sleeping);
    }
+   drain_ring();
+   _al_mutex_unlock(&writer_mutex);
 }
 
 
-/* _al_trace_prefix:
- *  Conditionally write the initial part of a trace message.  If we do, return true
- *  and continue to hold the trace_mutex lock.
- */
-bool _al_trace_prefix(char const *channel, int level,
-   char const *file, int line, char const *function)
+static void flush_ring(void)
 {
-   size_t i;
-   char *name;
-   _AL_VECTOR const *v;
+   _al_mutex_lock(&writer_mutex);
+   drain_ring();
+   _al_mutex_unlock(&writer_mutex);
+}
 
-   if (!trace_info.configured) {
-      _al_configure_logging();
+
+static unsigned int acquire_slot(void)
+{
+   unsigned int ticket = (unsigned int)_al_fetch_and_add1(&trace_head);
+   TRACE_SLOT *slot = &trace_ring[ticket & TRACE_RING_MASK];
+   unsigned int lap = ticket & ~TRACE_RING_MASK;
+
+   /* The ring is full; help the writer along. */
+   while ((unsigned int)slot->state != lap) {
+      flush_ring();
+      if ((unsigned int)slot->state != lap)
+         al_rest(0.001);
    }
+   _al_memory_barrier();
 
-   if (level < trace_info.level)
-      return false;
+   return ticket;
+}
 
-   v = &trace_info.channels;
-   if (_al_vector_is_empty(v))
-      goto channel_included;
 
-   for (i = 0; i < _al_vector_size(v); i++) {
-      ALLEGRO_USTR **iter = _al_vector_ref(v, i);
-      if (!strcmp(al_cstr(*iter), channel))
-         goto channel_included;
+static void publish_slot(unsigned int ticket)
+{
+   TRACE_SLOT *slot = &trace_ring[ticket & TRACE_RING_MASK];
+   unsigned int lap = ticket & ~TRACE_RING_MASK;
+   int level = slot->level;
+
+   _al_memory_barrier();
+   slot->state = lap + 1;
+   _al_memory_barrier();
+
+   /* Errors are written before returning, in case we are about to
+    * crash.
+    */
+   if (!writer_running || level >= 3) {
+      flush_ring();
    }
+   else if (writer_sleeping > 0) {
+      _al_mutex_lock(&writer_mutex);
+      _al_cond_signal(&writer_cond);
+      _al_mutex_unlock(&writer_mutex);
+   }
+}
 
-   return false;
 
-channel_included:
+static bool grow_slot(TRACE_SLOT *slot, size_t size)
+{
+   char *buf;
 
-   v = &trace_info.excluded;
-   if (_al_vector_is_nonempty(v)) {
-      for (i = 0; i < _al_vector_size(v); i++) {
-         ALLEGRO_USTR **iter = _al_vector_ref(v, i);
-         if (!strcmp(al_cstr(*iter), channel))
-            return false;
-      }
+   if (size <= slot->size)
+      return true;
+   if (slot->size >= TRACE_MESSAGE_MAX)
+      return false;
+   if (size < slot->size * 2)
+      size = slot->size * 2;
+   if (size > TRACE_MESSAGE_MAX)
+      size = TRACE_MESSAGE_MAX;
+
+   buf = al_realloc(slot->buf, size);
+   if (!buf)
+      return false;
+   slot->buf = buf;
+   slot->size = size;
+   return true;
+}
+
+
+/* slot_append:
+ *  Append formatted text to a message.  Returns false if the buffer had
+ *  to be grown first, in which case the caller must try again with a
+ *  fresh va_list.  Overlong messages are truncated.
+ */
+static bool slot_append(TRACE_SLOT *slot, const char *msg, va_list ap)
+{
+   size_t avail = slot->size - slot->len;
+   size_t want;
+   int n;
+
+   if (avail == 0)
+      return true;
+
+   n = vsnprintf(slot->buf + slot->len, avail, msg, ap);
+   if (n >= 0 && (size_t)n < avail) {
+      slot->len += n;
+      return true;
    }
 
-   /* Avoid interleaved output from different threads. */
-   _al_mutex_lock(&trace_info.trace_mutex);
+   /* Some vsnprintf implementations return -1 on truncation. */
+   want = (n >= 0) ? slot->len + n + 1 : slot->size * 2;
+   if (grow_slot(slot, want))
+      return false;
 
-   if (!_al_user_trace_handler)
-      open_trace_file();
+   slot->buf[slot->size - 1] = '\0';
+   slot->len = slot->size - 1;
+   return true;
+}
 
-   do_trace("%-8s ", channel);
-   if (level == 0) do_trace("D ");
-   if (level == 1) do_trace("I ");
-   if (level == 2) do_trace("W ");
-   if (level == 3) do_trace("E ");
 
-#ifdef ALLEGRO_ANDROID
-   {
-      char pid_buf[16];
-      snprintf(pid_buf, sizeof(pid_buf), "%i: ", gettid());
-      do_trace(pid_buf);
+static void slot_printf(TRACE_SLOT *slot, const char *msg, ...)
+{
+   va_list ap;
+   bool done;
+
+   do {
+      va_start(ap, msg);
+      done = slot_append(slot, msg, ap);
+      va_end(ap);
+   } while (!done);
+}
+
+
+/* begin_message:
+ *  Reserve a slot and write the message header into it.  The ticket is
+ *  kept in thread local storage for _al_trace_suffix.
+ */
+static bool begin_message(char const *channel, int level,
+   char const *file, int line, char const *function)
+{
+   _AL_TRACE_NESTING *nesting = _al_tls_get_trace_nesting();
+   TRACE_SLOT *slot;
+   unsigned int ticket;
+   char const *name;
+
+   if (!nesting || nesting->depth == _AL_TRACE_MAX_NESTING)
+      return false;
+
+   if (nesting->depth > 0 || nesting->draining > 0) {
+      _al_mutex_lock(&writer_mutex);
+      nesting->direct |= 1 << nesting->depth;
+      slot = &trace_direct[nesting->depth++];
+   }
+   else {
+      ticket = acquire_slot();
+      nesting->tickets[nesting->depth++] = ticket;
+      slot = &trace_ring[ticket & TRACE_RING_MASK];
    }
+
+   slot->len = 0;
+   slot->level = level;
+   grow_slot(slot, TRACE_SLOT_MIN_SIZE);
+   if (slot->buf)
+      slot->buf[0] = '\0';
+
+   slot_printf(slot, "%-8s ", channel);
+   if (level == 0) slot_printf(slot, "D ");
+   if (level == 1) slot_printf(slot, "I ");
+   if (level == 2) slot_printf(slot, "W ");
+   if (level == 3) slot_printf(slot, "E ");
+
+#ifdef ALLEGRO_ANDROID
+   slot_printf(slot, "%i: ", gettid());
 #endif
 
 #ifdef ALLEGRO_MSVC
@@ -278,77 +625,171 @@ channel_included:
    name = strrchr(file, '/');
 #endif
    if (trace_info.flags & 1) {
-      do_trace("%20s:%-4d ", name ? name + 1 : file, line);
+      slot_printf(slot, "%20s:%-4d ", name ? name + 1 : file, line);
    }
    if (trace_info.flags & 2) {
-      do_trace("%-32s ", function);
+      slot_printf(slot, "%-32s ", function);
    }
    if (trace_info.flags & 4) {
       double t = 0;
       if (al_is_system_installed())
          t = al_get_time();
-      do_trace("[%10.5f] ", t);
+      slot_printf(slot, "[%10.5f] ", t);
    }
 
-   /* Do not unlocked trace_mutex here; that is done by _al_trace_suffix. */
    return true;
 }
 
 
+/* _al_trace_prefix:
+ *  Conditionally write the initial part of a trace message.  If we do,
+ *  return true; the message is finished by _al_trace_suffix.
+ */
+bool _al_trace_prefix(char const *channel, int level,
+   char const *file, int line, char const *function)
+{
+   if (!trace_info.configured) {
+      _al_configure_logging();
+   }
+
+   if (!channel_enabled(channel, level))
+      return false;
+
+   return begin_message(channel, level, file, line, function);
+}
+
+
+/* _al_trace_prefix_channel:
+ *  Like _al_trace_prefix, for channels declared with
+ *  ALLEGRO_DEBUG_CHANNEL.  Only called when the cached mute bit is clear,
+ *  that is when the message is enabled or the channel is not resolved yet.
+ */
+bool _al_trace_prefix_channel(_AL_TRACE_CHANNEL *channel, int level,
+   char const *file, int line, char const *function)
+{
+   int id;
+
+   if (!trace_info.configured) {
+      _al_configure_logging();
+   }
+
+   id = channel->id;
+   if (id == 0) {
+      _al_mutex_lock(&trace_info.trace_mutex);
+      id = channel->id = resolve_channel(channel->name);
+      _al_mutex_unlock(&trace_info.trace_mutex);
+   }
+
+   if (id == 0 || level < 0 || level >= 8) {
+      if (!channel_enabled(channel->name, level))
+         return false;
+   }
+   else if ((_al_trace_channel_mute[id] >> level) & 1) {
+      return false;
+   }
+
+   return begin_message(channel->name, level, file, line, function);
+}
+
+
 /* _al_trace_suffix:
- *  Output the final part of a trace message, and release the trace_mutex lock.
+ *  Output the final part of a trace message and queue it for writing.
  */
 void _al_trace_suffix(const char *msg, ...)
 {
    int olderr = errno;
+   _AL_TRACE_NESTING *nesting = _al_tls_get_trace_nesting();
+   TRACE_SLOT *slot;
+   unsigned int ticket;
+   int depth;
    va_list ap;
+   bool done;
 
-#ifdef ALLEGRO_ANDROID
-   if (true)
-#else
-   if (_al_user_trace_handler)
-#endif
-   {
-      int s = strlen(static_trace_buffer);
-      va_start(ap, msg);
-      vsnprintf(static_trace_buffer + s, sizeof(static_trace_buffer) - s,
-         msg, ap);
-      va_end(ap);
-
-      if (_al_user_trace_handler) {
-         _al_user_trace_handler(static_trace_buffer);
-      }
-      #ifdef ALLEGRO_ANDROID
-      else {
-         (void)__android_log_print(ANDROID_LOG_INFO, "allegro",
-            static_trace_buffer);
-      }
-      #endif
-      static_trace_buffer[0] = '\0';
+   ASSERT(nesting && nesting->depth > 0);
+   depth = --nesting->depth;
+   if (nesting->direct & (1 << depth)) {
+      slot = &trace_direct[depth];
+      ticket = 0;
    }
-   else if (trace_info.trace_file) {
+   else {
+      ticket = nesting->tickets[depth];
+      slot = &trace_ring[ticket & TRACE_RING_MASK];
+   }
+
+   do {
       va_start(ap, msg);
-      vfprintf(trace_info.trace_file, msg, ap);
+      done = slot_append(slot, msg, ap);
       va_end(ap);
-      fflush(trace_info.trace_file);
+   } while (!done);
+
+   if (nesting->direct & (1 << depth)) {
+      nesting->direct &= ~(1 << depth);
+      /* Keep the output in order as far as we can. */
+      drain_ring();
+      nesting->draining++;
+      write_message(slot);
+      if (trace_info.trace_file && !_al_user_trace_handler)
+         fflush(trace_info.trace_file);
+      nesting->draining--;
+      _al_mutex_unlock(&writer_mutex);
+   }
+   else {
+      publish_slot(ticket);
    }
-
-   _al_mutex_unlock(&trace_info.trace_mutex);
 
    errno = olderr;
 }
 
 
+static void stop_writer(void)
+{
+   bool running;
+
+   _al_mutex_lock(&writer_mutex);
+   running = writer_running;
+   /* From now on producers write their own messages. */
+   writer_running = false;
+   writer_stop = true;
+   _al_cond_signal(&writer_cond);
+   _al_mutex_unlock(&writer_mutex);
+
+   if (running)
+      _al_thread_join(&writer_thread);
+}
+
+
 void _al_shutdown_logging(void)
 {
-   if (trace_info.configured) {
-      _al_mutex_destroy(&trace_info.trace_mutex);
+   int i;
+
+   stop_writer();
+   flush_ring();
 
+   if (trace_info.configured) {
+      _al_mutex_lock(&trace_info.trace_mutex);
       delete_string_list(&trace_info.channels);
       delete_string_list(&trace_info.excluded);
-
+      /* Make every channel take the slow path, which reconfigures. */
+      memset(_al_trace_channel_mute, 0, sizeof(_al_trace_channel_mute));
       trace_info.configured = false;
+      _al_mutex_unlock(&trace_info.trace_mutex);
+   }
+
+   /* Free the message buffers unless somebody is still logging. */
+   _al_mutex_lock(&writer_mutex);
+   if ((unsigned int)trace_head == trace_tail) {
+      for (i = 0; i < TRACE_RING_SIZE; i++) {
+         al_free(trace_ring[i].buf);
+         trace_ring[i].buf = NULL;
+         trace_ring[i].size = 0;
+      }
+      for (i = 0; i < _AL_TRACE_MAX_NESTING; i++) {
+         al_free(trace_direct[i].buf);
+         trace_direct[i].buf = NULL;
+         trace_direct[i].size = 0;
+      }
    }
+   _al_mutex_unlock(&writer_mutex);
 
    if (trace_info.trace_file && trace_info.trace_file != stderr) {
       fclose(trace_info.trace_file);
@@ -28,6 +28,8 @@ void al_clear_to_color(ALLEGRO_COLOR color)
    ALLEGRO_BITMAP *target = al_get_target_bitmap();
    ASSERT(target);
 
+   _AL_RENDER_STATS_ADD(draw_calls, 1);
+
    if (al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP ||
        _al_pixel_format_is_compressed(al_get_bitmap_format(target))) {
       _al_clear_bitmap_by_locking(target, &color);
@@ -67,6 +69,8 @@ void al_draw_pixel(float x, float y, ALLEGRO_COLOR color)
 
    ASSERT(target);
 
+   _AL_RENDER_STATS_ADD(draw_calls, 1);
+
    if (al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP ||
        _al_pixel_format_is_compressed(al_get_bitmap_format(target))) {
       _al_draw_pixel_memory(target, x, y, &color);
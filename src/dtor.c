@@ -26,10 +26,10 @@
 
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_atomicops.h"
 #include "allegro5/internal/aintern_dtor.h"
 #include "allegro5/internal/aintern_thread.h"
 #include "allegro5/internal/aintern_tls.h"
-#include "allegro5/internal/aintern_list.h"
 
 /* XXX The dependency on tls.c is not nice but the DllMain stuff for Windows
  * does not it easy to make abstract away TLS API differences.
@@ -38,17 +38,86 @@
 ALLEGRO_DEBUG_CHANNEL("dtor")
 
 
-struct _AL_DTOR_LIST {
+/* The registry is split into shards, chosen by object address, so that
+ * threads creating and destroying objects concurrently rarely contend.
+ * The items themselves are embedded in the objects, so registering never
+ * allocates.
+ */
+#define NUM_SHARDS   16
+
+
+typedef struct _AL_DTOR_SHARD {
    _AL_MUTEX mutex;
-   _AL_LIST* dtors;
+   _AL_DTOR_ITEM *head;
+   _AL_DTOR_ITEM *tail;
+} _AL_DTOR_SHARD;
+
+
+struct _AL_DTOR_LIST {
+   _AL_DTOR_SHARD shards[NUM_SHARDS];
+   /* Registration order, so destructors can run in reverse across shards. */
+   volatile _AL_ATOMIC next_seq;
 };
 
 
-typedef struct DTOR {
-   char const *name;
-   void *object;
-   void (*func)(void*);
-} DTOR;
+static _AL_DTOR_SHARD *shard_for_object(_AL_DTOR_LIST *dtors, void *object)
+{
+   uintptr_t p = (uintptr_t)object;
+   return &dtors->shards[((p >> 4) ^ (p >> 12)) % NUM_SHARDS];
+}
+
+
+
+/* Whether A was registered after B.  Sequence numbers may wrap around. */
+static bool is_newer(const _AL_DTOR_ITEM *a, const _AL_DTOR_ITEM *b)
+{
+   return (int)((unsigned int)a->seq - (unsigned int)b->seq) > 0;
+}
+
+
+
+/* Link ITEM into its shard, keeping the shard sorted by sequence number.
+ * The shard must be locked.
+ */
+static void link_item(_AL_DTOR_SHARD *shard, _AL_DTOR_ITEM *item)
+{
+   _AL_DTOR_ITEM *after = shard->tail;
+
+   while (after && is_newer(after, item))
+      after = after->prev;
+
+   item->prev = after;
+   item->next = after ? after->next : shard->head;
+   if (item->next)
+      item->next->prev = item;
+   else
+      shard->tail = item;
+   if (after)
+      after->next = item;
+   else
+      shard->head = item;
+   item->shard = shard;
+}
+
+
+
+/* Unlink ITEM from its shard, which must be locked. */
+static void unlink_item(_AL_DTOR_ITEM *item)
+{
+   _AL_DTOR_SHARD *shard = item->shard;
+
+   if (item->prev)
+      item->prev->next = item->next;
+   else
+      shard->head = item->next;
+   if (item->next)
+      item->next->prev = item->prev;
+   else
+      shard->tail = item->prev;
+   item->prev = item->next = NULL;
+   item->shard = NULL;
+}
+
 
 
 /* Internal function: _al_init_destructors
@@ -57,10 +126,16 @@ typedef struct DTOR {
 _AL_DTOR_LIST *_al_init_destructors(void)
 {
    _AL_DTOR_LIST *dtors = al_malloc(sizeof(*dtors));
-
-   _AL_MARK_MUTEX_UNINITED(dtors->mutex);
-   _al_mutex_init(&dtors->mutex);
-   dtors->dtors = _al_list_create();
+   int i;
+
+   for (i = 0; i < NUM_SHARDS; i++) {
+      _AL_DTOR_SHARD *shard = &dtors->shards[i];
+      _AL_MARK_MUTEX_UNINITED(shard->mutex);
+      _al_mutex_init(&shard->mutex);
+      shard->head = NULL;
+      shard->tail = NULL;
+   }
+   dtors->next_seq = 0;
 
    return dtors;
 }
@@ -105,27 +180,33 @@ void _al_run_destructors(_AL_DTOR_LIST *dtors)
    }
 
    /* call the destructors in reverse order */
-   _al_mutex_lock(&dtors->mutex);
-   {
-      _AL_LIST_ITEM *iter = _al_list_back(dtors->dtors);
-      while (iter) {
-         DTOR *dtor = _al_list_item_data(iter);
-         void *object = dtor->object;
-         void (*func)(void *) = dtor->func;
-
-         ALLEGRO_DEBUG("calling dtor for %s %p, func %p\n",
-            dtor->name, object, func);
-         _al_mutex_unlock(&dtors->mutex);
-         {
-            (*func)(object);
+   for (;;) {
+      _AL_DTOR_ITEM last;
+      bool found = false;
+      int i;
+
+      /* The newest item is at the tail of one of the shards.  Destructors
+       * will possibly run multiple destructors at once, so look again
+       * every time.
+       */
+      for (i = 0; i < NUM_SHARDS; i++) {
+         _AL_DTOR_SHARD *shard = &dtors->shards[i];
+
+         _al_mutex_lock(&shard->mutex);
+         if (shard->tail && (!found || is_newer(shard->tail, &last))) {
+            last = *shard->tail;
+            found = true;
          }
-         _al_mutex_lock(&dtors->mutex);
-         /* Don't do normal iteration as the destructors will possibly run
-          * multiple destructors at once. */
-         iter = _al_list_back(dtors->dtors);
+         _al_mutex_unlock(&shard->mutex);
       }
+
+      if (!found)
+         break;
+
+      ALLEGRO_DEBUG("calling dtor for %s %p, func %p\n",
+         last.name, last.object, last.func);
+      (*last.func)(last.object);
    }
-   _al_mutex_unlock(&dtors->mutex);
 }
 
 
@@ -135,15 +216,17 @@ void _al_run_destructors(_AL_DTOR_LIST *dtors)
  */
 void _al_shutdown_destructors(_AL_DTOR_LIST *dtors)
 {
+   int i;
+
    if (!dtors) {
       return;
    }
 
    /* free resources used by the destructor subsystem */
-   ASSERT(_al_list_is_empty(dtors->dtors));
-   _al_list_destroy(dtors->dtors);
-
-   _al_mutex_destroy(&dtors->mutex);
+   for (i = 0; i < NUM_SHARDS; i++) {
+      ASSERT(dtors->shards[i].head == NULL);
+      _al_mutex_destroy(&dtors->shards[i].mutex);
+   }
 
    al_free(dtors);
 }
@@ -152,59 +235,42 @@ void _al_shutdown_destructors(_AL_DTOR_LIST *dtors)
 
 /* Internal function: _al_register_destructor
  *  Register OBJECT to be destroyed by FUNC during Allegro shutdown.
- *  This would be done in the object's constructor function.
- *
- *  Returns a list item representing the destructor's position in the list
- *  (possibly null).
+ *  This would be done in the object's constructor function.  ITEM is
+ *  embedded in the object and records its place in the list.
  *
  *  [thread-safe]
  */
-_AL_LIST_ITEM *_al_register_destructor(_AL_DTOR_LIST *dtors, char const *name,
-   void *object, void (*func)(void*))
+void _al_register_destructor(_AL_DTOR_LIST *dtors, _AL_DTOR_ITEM *item,
+   char const *name, void *object, void (*func)(void*))
 {
    int *dtor_owner_count;
-   _AL_LIST_ITEM *ret = NULL;
+   _AL_DTOR_SHARD *shard;
+   ASSERT(item);
    ASSERT(object);
    ASSERT(func);
 
+   item->shard = NULL;
+   item->prev = item->next = NULL;
+   item->func = NULL;
+
    dtor_owner_count = _al_tls_get_dtor_owner_count();
    if (*dtor_owner_count > 0)
-      return NULL;
-
-   _al_mutex_lock(&dtors->mutex);
-   {
-#ifdef DEBUGMODE
-      /* make sure the object is not registered twice */
-      {
-         _AL_LIST_ITEM *iter = _al_list_front(dtors->dtors);
+      return;
 
-         while (iter) {
-            DTOR *dtor = _al_list_item_data(iter);
-            ASSERT(dtor->object != object);
-            iter = _al_list_next(dtors->dtors, iter);
-         }
-      }
-#endif /* DEBUGMODE */
+   item->name = name;
+   item->object = object;
+   item->func = func;
 
-      /* add the destructor to the list */
-      {
-         DTOR *new_dtor = al_malloc(sizeof(DTOR));
-         if (new_dtor) {
-            new_dtor->object = object;
-            new_dtor->func = func;
-            new_dtor->name = name;
-            ALLEGRO_DEBUG("added dtor for %s %p, func %p\n", name,
-               object, func);
-            ret = _al_list_push_back(dtors->dtors, new_dtor);
-         }
-         else {
-            ALLEGRO_WARN("failed to add dtor for %s %p\n", name,
-               object);
-         }
-      }
+   shard = shard_for_object(dtors, object);
+   _al_mutex_lock(&shard->mutex);
+   {
+      /* Taking the number under the lock keeps each shard in order. */
+      item->seq = _al_fetch_and_add1(&dtors->next_seq);
+      link_item(shard, item);
+      ALLEGRO_DEBUG("added dtor for %s %p, func %p\n", name,
+         object, func);
    }
-   _al_mutex_unlock(&dtors->mutex);
-   return ret;
+   _al_mutex_unlock(&shard->mutex);
 }
 
 
@@ -212,23 +278,50 @@ _AL_LIST_ITEM *_al_register_destructor(_AL_DTOR_LIST *dtors, char const *name,
 /* Internal function: _al_unregister_destructor
  *  Unregister a previously registered object.  This must be called
  *  in the normal object destroyer routine, e.g. al_destroy_timer.
+ *  Does nothing if the item was not registered.
  *
  *  [thread-safe]
  */
-void _al_unregister_destructor(_AL_DTOR_LIST *dtors, _AL_LIST_ITEM *dtor_item)
+void _al_unregister_destructor(_AL_DTOR_LIST *dtors, _AL_DTOR_ITEM *item)
 {
-   if (!dtor_item) {
+   _AL_DTOR_SHARD *shard;
+   (void)dtors;
+
+   /* Only the thread destroying the object changes this. */
+   shard = item->shard;
+   if (!shard) {
       return;
    }
 
-   _al_mutex_lock(&dtors->mutex);
+   _al_mutex_lock(&shard->mutex);
    {
-      DTOR *dtor = _al_list_item_data(dtor_item);
-      ALLEGRO_DEBUG("removed dtor for %s %p\n", dtor->name, dtor->object);
-      al_free(dtor);
-      _al_list_erase(dtors->dtors, dtor_item);
+      ALLEGRO_DEBUG("removed dtor for %s %p\n", item->name, item->object);
+      unlink_item(item);
    }
-   _al_mutex_unlock(&dtors->mutex);
+   _al_mutex_unlock(&shard->mutex);
+}
+
+
+
+/* Internal function: _al_reregister_destructor
+ *  Put an item taken out with _al_unregister_destructor back in its old
+ *  place.  Used when the object's memory is about to be rewritten but the
+ *  object itself lives on.  Does nothing if the item was never registered.
+ *
+ *  [thread-safe]
+ */
+void _al_reregister_destructor(_AL_DTOR_LIST *dtors, _AL_DTOR_ITEM *item)
+{
+   _AL_DTOR_SHARD *shard;
+
+   if (!item->func || item->shard) {
+      return;
+   }
+
+   shard = shard_for_object(dtors, item->object);
+   _al_mutex_lock(&shard->mutex);
+   link_item(shard, item);
+   _al_mutex_unlock(&shard->mutex);
 }
 
 
@@ -241,17 +334,22 @@ void _al_foreach_destructor(_AL_DTOR_LIST *dtors,
    void (*callback)(void *object, void (*func)(void *), void *udata),
    void *userdata)
 {
-   _al_mutex_lock(&dtors->mutex);
-   {
-      _AL_LIST_ITEM *iter = _al_list_front(dtors->dtors);
+   int i;
+
+   for (i = 0; i < NUM_SHARDS; i++) {
+      _AL_DTOR_SHARD *shard = &dtors->shards[i];
 
-      while (iter) {
-         DTOR *dtor = _al_list_item_data(iter);
-         callback(dtor->object, dtor->func, userdata);
-         iter = _al_list_next(dtors->dtors, iter);
+      _al_mutex_lock(&shard->mutex);
+      {
+         _AL_DTOR_ITEM *iter = shard->head;
+
+         while (iter) {
+            callback(iter->object, iter->func, userdata);
+            iter = iter->next;
+         }
       }
+      _al_mutex_unlock(&shard->mutex);
    }
-   _al_mutex_unlock(&dtors->mutex);
 }
 
 
@@ -29,6 +29,7 @@
 #include "allegro5/internal/aintern_dtor.h"
 #include "allegro5/internal/aintern_exitfunc.h"
 #include "allegro5/internal/aintern_events.h"
+#include "allegro5/internal/aintern_profile.h"
 #include "allegro5/internal/aintern_system.h"
 
 
@@ -36,17 +37,25 @@
 struct ALLEGRO_EVENT_QUEUE
 {
    _AL_VECTOR sources;  /* vector of (ALLEGRO_EVENT_SOURCE *) */
-   _AL_VECTOR events;   /* vector of ALLEGRO_EVENT, used as circular array */
+   ALLEGRO_EVENT *events;     /* circular array */
+   unsigned int events_mask;  /* size of circular array minus one */
    unsigned int events_head;  /* write end of circular array */
    unsigned int events_tail;  /* read end of circular array */
    bool paused;
+   bool coalescing;     /* merge consecutive motion events */
+   int waiters;         /* threads blocked on cond */
    _AL_MUTEX mutex;
    _AL_COND cond;
-   _AL_LIST_ITEM *dtor_item;
+   _AL_DTOR_ITEM dtor_item;
 };
 
 
 
+/* Initial size of the circular array, which must be a power of two. */
+#define INITIAL_EVENTS_SIZE   16
+
+
+
 /* to prevent concurrent modification of user event reference counts */
 static _AL_MUTEX user_event_refcount_mutex = _AL_MUTEX_UNINITED;
 
@@ -94,19 +103,26 @@ ALLEGRO_EVENT_QUEUE *al_create_event_queue(void)
    ASSERT(queue);
 
    if (queue) {
+      queue->events = al_malloc(INITIAL_EVENTS_SIZE * sizeof(ALLEGRO_EVENT));
+      if (!queue->events) {
+         al_free(queue);
+         return NULL;
+      }
+
       _al_vector_init(&queue->sources, sizeof(ALLEGRO_EVENT_SOURCE *));
 
-      _al_vector_init(&queue->events, sizeof(ALLEGRO_EVENT));
-      _al_vector_alloc_back(&queue->events);
+      queue->events_mask = INITIAL_EVENTS_SIZE - 1;
       queue->events_head = 0;
       queue->events_tail = 0;
       queue->paused = false;
+      queue->coalescing = false;
+      queue->waiters = 0;
 
       _AL_MARK_MUTEX_UNINITED(queue->mutex);
       _al_mutex_init(&queue->mutex);
       _al_cond_init(&queue->cond);
 
-      queue->dtor_item = _al_register_destructor(_al_dtor_list, "queue", queue,
+      _al_register_destructor(_al_dtor_list, &queue->dtor_item, "queue", queue,
          (void (*)(void *)) al_destroy_event_queue);
    }
 
@@ -121,7 +137,7 @@ void al_destroy_event_queue(ALLEGRO_EVENT_QUEUE *queue)
 {
    ASSERT(queue);
 
-   _al_unregister_destructor(_al_dtor_list, queue->dtor_item);
+   _al_unregister_destructor(_al_dtor_list, &queue->dtor_item);
 
    /* Unregister any event sources registered with this queue.  */
    while (_al_vector_is_nonempty(&queue->sources)) {
@@ -133,7 +149,7 @@ void al_destroy_event_queue(ALLEGRO_EVENT_QUEUE *queue)
    _al_vector_free(&queue->sources);
 
    ASSERT(queue->events_head == queue->events_tail);
-   _al_vector_free(&queue->events);
+   al_free(queue->events);
 
    _al_cond_destroy(&queue->cond);
    _al_mutex_destroy(&queue->mutex);
@@ -160,13 +176,33 @@ bool al_is_event_source_registered(ALLEGRO_EVENT_QUEUE *queue,
  */
 void al_register_event_source(ALLEGRO_EVENT_QUEUE *queue,
    ALLEGRO_EVENT_SOURCE *source)
+{
+   ASSERT(queue);
+   ASSERT(source);
+
+   if (!_al_vector_contains(&queue->sources, &source)) {
+      al_register_event_source_filtered(queue, source, NULL, 0);
+   }
+}
+
+
+
+/* Function: al_register_event_source_filtered
+ */
+void al_register_event_source_filtered(ALLEGRO_EVENT_QUEUE *queue,
+   ALLEGRO_EVENT_SOURCE *source, const ALLEGRO_EVENT_TYPE *types,
+   int num_types)
 {
    ALLEGRO_EVENT_SOURCE **slot;
    ASSERT(queue);
    ASSERT(source);
 
+   /* If the source is already registered this only changes the types;
+    * events already in the queue are kept.
+    */
+   _al_event_source_on_registration_to_queue(source, queue, types, num_types);
+
    if (!_al_vector_contains(&queue->sources, &source)) {
-      _al_event_source_on_registration_to_queue(source, queue);
       _al_mutex_lock(&queue->mutex);
       slot = _al_vector_alloc_back(&queue->sources);
       *slot = source;
@@ -227,6 +263,30 @@ bool al_is_event_queue_paused(const ALLEGRO_EVENT_QUEUE *queue)
 
 
 
+/* Function: al_set_event_queue_coalescing
+ */
+void al_set_event_queue_coalescing(ALLEGRO_EVENT_QUEUE *queue, bool coalesce)
+{
+   ASSERT(queue);
+
+   _al_mutex_lock(&queue->mutex);
+   queue->coalescing = coalesce;
+   _al_mutex_unlock(&queue->mutex);
+}
+
+
+
+/* Function: al_is_event_queue_coalescing
+ */
+bool al_is_event_queue_coalescing(const ALLEGRO_EVENT_QUEUE *queue)
+{
+   ASSERT(queue);
+
+   return queue->coalescing;
+}
+
+
+
 static void heartbeat(void)
 {
    ALLEGRO_SYSTEM *system = al_get_system_driver();
@@ -257,11 +317,12 @@ bool al_is_event_queue_empty(ALLEGRO_EVENT_QUEUE *queue)
 
 
 /* circ_array_next:
- *  Return the next index in a circular array.
+ *  Return the next index in the circular array.
  */
-static unsigned int circ_array_next(const _AL_VECTOR *vector, unsigned int i)
+static unsigned int circ_array_next(const ALLEGRO_EVENT_QUEUE *queue,
+   unsigned int i)
 {
-   return (i + 1) % _al_vector_size(vector);
+   return (i + 1) & queue->events_mask;
 }
 
 
@@ -282,9 +343,9 @@ static ALLEGRO_EVENT *get_next_event_if_any(ALLEGRO_EVENT_QUEUE *queue,
       return NULL;
    }
 
-   event = _al_vector_ref(&queue->events, queue->events_tail);
+   event = &queue->events[queue->events_tail];
    if (delete) {
-      queue->events_tail = circ_array_next(&queue->events, queue->events_tail);
+      queue->events_tail = circ_array_next(queue, queue->events_tail);
    }
    return event;
 }
@@ -316,6 +377,39 @@ bool al_get_next_event(ALLEGRO_EVENT_QUEUE *queue, ALLEGRO_EVENT *ret_event)
 
 
 
+/* Function: al_get_next_events
+ */
+int al_get_next_events(ALLEGRO_EVENT_QUEUE *queue, ALLEGRO_EVENT *ret_events,
+   int max)
+{
+   int n = 0;
+   ASSERT(queue);
+   ASSERT(ret_events || max <= 0);
+
+   heartbeat();
+
+   _al_mutex_lock(&queue->mutex);
+
+   while (n < max && !is_event_queue_empty(queue)) {
+      /* Copy the contiguous run of events at the read end. */
+      unsigned int tail = queue->events_tail;
+      unsigned int end = (queue->events_head > tail)
+         ? queue->events_head : queue->events_mask + 1;
+      unsigned int run = _ALLEGRO_MIN(end - tail, (unsigned int)(max - n));
+
+      memcpy(ret_events + n, &queue->events[tail], run * sizeof(ALLEGRO_EVENT));
+      queue->events_tail = (tail + run) & queue->events_mask;
+      n += run;
+      /* Don't increment reference count on user events. */
+   }
+
+   _al_mutex_unlock(&queue->mutex);
+
+   return n;
+}
+
+
+
 /* Function: al_peek_next_event
  */
 bool al_peek_next_event(ALLEGRO_EVENT_QUEUE *queue, ALLEGRO_EVENT *ret_event)
@@ -378,9 +472,8 @@ void al_flush_event_queue(ALLEGRO_EVENT_QUEUE *queue)
    /* Decrement reference counts on all user events. */
    i = queue->events_tail;
    while (i != queue->events_head) {
-      ALLEGRO_EVENT *old_ev = _al_vector_ref(&queue->events, i);
-      unref_if_user_event(old_ev);
-      i = circ_array_next(&queue->events, i);
+      unref_if_user_event(&queue->events[i]);
+      i = circ_array_next(queue, i);
    }
 
    queue->events_head = queue->events_tail = 0;
@@ -403,7 +496,9 @@ void al_wait_for_event(ALLEGRO_EVENT_QUEUE *queue, ALLEGRO_EVENT *ret_event)
    _al_mutex_lock(&queue->mutex);
    {
       while (is_event_queue_empty(queue)) {
+         queue->waiters++;
          _al_cond_wait(&queue->cond, &queue->mutex);
+         queue->waiters--;
       }
 
       if (ret_event) {
@@ -468,7 +563,9 @@ static bool do_wait_for_event(ALLEGRO_EVENT_QUEUE *queue,
        * the queue.
        */
       while (is_event_queue_empty(queue) && (result != -1)) {
+         queue->waiters++;
          result = _al_cond_timedwait(&queue->cond, &queue->mutex, timeout);
+         queue->waiters--;
       }
 
       if (result == -1)
@@ -489,32 +586,33 @@ static bool do_wait_for_event(ALLEGRO_EVENT_QUEUE *queue,
 
 
 /* expand_events_array:
- *  Expand the circular array holding events.
+ *  Double the size of the circular array holding events.
  */
-static void expand_events_array(ALLEGRO_EVENT_QUEUE *queue)
+static bool expand_events_array(ALLEGRO_EVENT_QUEUE *queue)
 {
-   /* The underlying vector grows by powers of two. */
-   const size_t old_size = _al_vector_size(&queue->events);
-   const size_t new_size = old_size * 2;
-   unsigned int i;
+   const unsigned int old_size = queue->events_mask + 1;
+   ALLEGRO_EVENT *events;
 
-   for (i = old_size; i < new_size; i++) {
-      _al_vector_alloc_back(&queue->events);
-   }
+   events = al_realloc(queue->events, 2 * old_size * sizeof(ALLEGRO_EVENT));
+   if (!events)
+      return false;
 
    /* Move wrapped-around elements at the start of the array to the back. */
    if (queue->events_head < queue->events_tail) {
-      for (i = 0; i < queue->events_head; i++) {
-         ALLEGRO_EVENT *old_ev = _al_vector_ref(&queue->events, i);
-         ALLEGRO_EVENT *new_ev = _al_vector_ref(&queue->events, old_size + i);
-         copy_event(new_ev, old_ev);
-      }
+      memcpy(events + old_size, events,
+         queue->events_head * sizeof(ALLEGRO_EVENT));
       queue->events_head += old_size;
    }
+
+   queue->events = events;
+   queue->events_mask = 2 * old_size - 1;
+   return true;
 }
 
 
 /* alloc_event:
+ *  Return a free slot at the write end of the queue, or NULL if the
+ *  queue is full and could not be expanded.
  *
  *  The event source must be _locked_ before calling this function.
  *
@@ -525,19 +623,88 @@ static ALLEGRO_EVENT *alloc_event(ALLEGRO_EVENT_QUEUE *queue)
    ALLEGRO_EVENT *event;
    unsigned int adv_head;
 
-   adv_head = circ_array_next(&queue->events, queue->events_head);
+   adv_head = circ_array_next(queue, queue->events_head);
    if (adv_head == queue->events_tail) {
-      expand_events_array(queue);
-      adv_head = circ_array_next(&queue->events, queue->events_head);
+      if (!expand_events_array(queue))
+         return NULL;
+      adv_head = circ_array_next(queue, queue->events_head);
    }
 
-   event = _al_vector_ref(&queue->events, queue->events_head);
+   event = &queue->events[queue->events_head];
    queue->events_head = adv_head;
    return event;
 }
 
 
 
+/* coalesce_event:
+ *  If the most recently queued event is a motion event of the same kind
+ *  as EVENT, from the same source, merge EVENT into it and return true.
+ *  The merged event has the latest position and timestamp, and the sum
+ *  of the relative motion.  The queue must be locked.
+ */
+static bool coalesce_event(ALLEGRO_EVENT_QUEUE *queue,
+   const ALLEGRO_EVENT *event)
+{
+   ALLEGRO_EVENT *last;
+
+   if (is_event_queue_empty(queue))
+      return false;
+
+   last = &queue->events[(queue->events_head - 1) & queue->events_mask];
+   if (last->type != event->type || last->any.source != event->any.source)
+      return false;
+
+   switch (event->type) {
+      case ALLEGRO_EVENT_MOUSE_AXES: {
+         ALLEGRO_MOUSE_EVENT *m = &last->mouse;
+         int dx, dy, dz, dw;
+
+         if (m->display != event->mouse.display)
+            return false;
+         dx = m->dx + event->mouse.dx;
+         dy = m->dy + event->mouse.dy;
+         dz = m->dz + event->mouse.dz;
+         dw = m->dw + event->mouse.dw;
+         copy_event(last, event);
+         m->dx = dx;
+         m->dy = dy;
+         m->dz = dz;
+         m->dw = dw;
+         return true;
+      }
+
+      case ALLEGRO_EVENT_TOUCH_MOVE: {
+         ALLEGRO_TOUCH_EVENT *t = &last->touch;
+         float dx, dy;
+
+         if (t->display != event->touch.display || t->id != event->touch.id)
+            return false;
+         dx = t->dx + event->touch.dx;
+         dy = t->dy + event->touch.dy;
+         copy_event(last, event);
+         t->dx = dx;
+         t->dy = dy;
+         return true;
+      }
+
+      case ALLEGRO_EVENT_JOYSTICK_AXIS: {
+         ALLEGRO_JOYSTICK_EVENT *j = &last->joystick;
+
+         if (j->id != event->joystick.id || j->stick != event->joystick.stick
+               || j->axis != event->joystick.axis)
+            return false;
+         copy_event(last, event);
+         return true;
+      }
+
+      default:
+         return false;
+   }
+}
+
+
+
 /* copy_event:
  *  Copies the contents of the event SRC to DEST.
  */
@@ -590,110 +757,82 @@ static void unref_if_user_event(ALLEGRO_EVENT *event)
  */
 void _al_event_queue_push_event(ALLEGRO_EVENT_QUEUE *queue,
    const ALLEGRO_EVENT *orig_event)
+{
+   _al_event_queue_push_events(queue, orig_event, 1);
+}
+
+
+
+/* Internal function: _al_event_queue_push_events
+ *  Like _al_event_queue_push_event but adds an array of events while
+ *  holding the queue lock once.
+ */
+void _al_event_queue_push_events(ALLEGRO_EVENT_QUEUE *queue,
+   const ALLEGRO_EVENT *orig_events, unsigned int num)
 {
    ALLEGRO_EVENT *new_event;
+   unsigned int i;
    ASSERT(queue);
-   ASSERT(orig_event);
+   ASSERT(orig_events || num == 0);
 
    if (queue->paused)
       return;
 
+   _AL_PROFILE_BEGIN("push events");
    _al_mutex_lock(&queue->mutex);
    {
-      new_event = alloc_event(queue);
-      copy_event(new_event, orig_event);
-      ref_if_user_event(new_event);
+      for (i = 0; i < num; i++) {
+         if (queue->coalescing && coalesce_event(queue, &orig_events[i]))
+            continue;
+         new_event = alloc_event(queue);
+         if (!new_event)
+            break;
+         copy_event(new_event, &orig_events[i]);
+         ref_if_user_event(new_event);
+      }
 
       /* Wake up threads that are waiting for an event to be placed in
-       * the queue.
+       * the queue.  Most of the time there are none.
        */
-      _al_cond_broadcast(&queue->cond);
-   }
-   _al_mutex_unlock(&queue->mutex);
-}
+      if (i > 0 && queue->waiters > 0)
+         _al_cond_broadcast(&queue->cond);
 
-
-
-/* contains_event_of_source:
- *  Return true iff the event queue contains an event from the given source.
- *  The queue must be locked.
- */
-static bool contains_event_of_source(const ALLEGRO_EVENT_QUEUE *queue,
-   const ALLEGRO_EVENT_SOURCE *source)
-{
-   ALLEGRO_EVENT *event;
-   unsigned int i;
-
-   i = queue->events_tail;
-   while (i != queue->events_head) {
-      event = _al_vector_ref(&queue->events, i);
-      if (event->any.source == source) {
-         return true;
-      }
-      i = circ_array_next(&queue->events, i);
+      _AL_PROFILE_COUNTER("queued events",
+         (queue->events_head - queue->events_tail) & queue->events_mask);
    }
-
-   return false;
-}
-
-
-
-/* Helper to get smallest fitting power of two. */
-static int pot(int x)
-{
-   int y = 1;
-   while (y < x) y *= 2;
-   return y;
+   _al_mutex_unlock(&queue->mutex);
+   _AL_PROFILE_END();
 }
 
 
 
 /* discard_events_of_source:
- *  Discard all the events in the queue that belong to the source.
+ *  Discard all the events in the queue that belong to the source,
+ *  compacting the remaining events in place.
  *  The queue must be locked.
  */
 static void discard_events_of_source(ALLEGRO_EVENT_QUEUE *queue,
    const ALLEGRO_EVENT_SOURCE *source)
 {
-   _AL_VECTOR old_events;
-   ALLEGRO_EVENT *old_event;
-   ALLEGRO_EVENT *new_event;
-   size_t old_size;
-   size_t new_size;
+   ALLEGRO_EVENT *event;
    unsigned int i;
+   unsigned int j;
 
-   if (!contains_event_of_source(queue, source)) {
-      return;
-   }
-
-   /* Copy elements we want to keep from the old vector to a new one. */
-   old_events = queue->events;
-   _al_vector_init(&queue->events, sizeof(ALLEGRO_EVENT));
-
-   i = queue->events_tail;
+   i = j = queue->events_tail;
    while (i != queue->events_head) {
-      old_event = _al_vector_ref(&old_events, i);
-      if (old_event->any.source != source) {
-         new_event = _al_vector_alloc_back(&queue->events);
-         copy_event(new_event, old_event);
+      event = &queue->events[i];
+      if (event->any.source != source) {
+         if (i != j)
+            copy_event(&queue->events[j], event);
+         j = circ_array_next(queue, j);
       }
       else {
-         unref_if_user_event(old_event);
+         unref_if_user_event(event);
       }
-      i = circ_array_next(&old_events, i);
-   }
-
-   queue->events_tail = 0;
-   queue->events_head = _al_vector_size(&queue->events);
-
-   /* The circular array always needs at least one unused element. */
-   old_size = _al_vector_size(&queue->events);
-   new_size = pot(old_size + 1);
-   for (i = old_size; i < new_size; i++) {
-      _al_vector_alloc_back(&queue->events);
+      i = circ_array_next(queue, i);
    }
 
-   _al_vector_free(&old_events);
+   queue->events_head = j;
 }
 
 
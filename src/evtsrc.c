@@ -30,6 +30,70 @@ ALLEGRO_STATIC_ASSERT(evtsrc,
    sizeof(ALLEGRO_EVENT_SOURCE_REAL) <= sizeof(ALLEGRO_EVENT_SOURCE));
 
 
+/* A queue that an event source is registered with.  If `types` is not
+ * NULL then only events of those types are pushed to the queue.
+ */
+typedef struct EVENT_SUBSCRIBER
+{
+   ALLEGRO_EVENT_QUEUE *queue;
+   ALLEGRO_EVENT_TYPE *types;
+   int num_types;
+} EVENT_SUBSCRIBER;
+
+
+
+static EVENT_SUBSCRIBER *find_subscriber(ALLEGRO_EVENT_SOURCE_REAL *this,
+   const ALLEGRO_EVENT_QUEUE *queue)
+{
+   unsigned int i;
+
+   for (i = 0; i < _al_vector_size(&this->queues); i++) {
+      EVENT_SUBSCRIBER *sub = _al_vector_ref(&this->queues, i);
+      if (sub->queue == queue)
+         return sub;
+   }
+
+   return NULL;
+}
+
+
+
+static void set_subscriber_types(EVENT_SUBSCRIBER *sub,
+   const ALLEGRO_EVENT_TYPE *types, int num_types)
+{
+   al_free(sub->types);
+   sub->types = NULL;
+   sub->num_types = 0;
+
+   if (types && num_types > 0) {
+      sub->types = al_malloc(num_types * sizeof(*types));
+      /* If we run out of memory the queue gets all events. */
+      if (sub->types) {
+         memcpy(sub->types, types, num_types * sizeof(*types));
+         sub->num_types = num_types;
+      }
+   }
+}
+
+
+
+static bool subscriber_accepts(const EVENT_SUBSCRIBER *sub,
+   ALLEGRO_EVENT_TYPE type)
+{
+   int i;
+
+   if (!sub->types)
+      return true;
+
+   for (i = 0; i < sub->num_types; i++) {
+      if (sub->types[i] == type)
+         return true;
+   }
+
+   return false;
+}
+
+
 
 /* Internal function: _al_event_source_init
  *  Initialise an event source structure.
@@ -41,7 +105,7 @@ void _al_event_source_init(ALLEGRO_EVENT_SOURCE *es)
    memset(es, 0, sizeof(*es));
    _AL_MARK_MUTEX_UNINITED(this->mutex);
    _al_mutex_init(&this->mutex);
-   _al_vector_init(&this->queues, sizeof(ALLEGRO_EVENT_QUEUE *));
+   _al_vector_init(&this->queues, sizeof(EVENT_SUBSCRIBER));
    this->data = 0;
 }
 
@@ -58,8 +122,8 @@ void _al_event_source_free(ALLEGRO_EVENT_SOURCE *es)
 
    /* Unregister from all queues. */
    while (!_al_vector_is_empty(&this->queues)) {
-      ALLEGRO_EVENT_QUEUE **slot = _al_vector_ref_back(&this->queues);
-      al_unregister_event_source(*slot, es);
+      EVENT_SUBSCRIBER *sub = _al_vector_ref_back(&this->queues);
+      al_unregister_event_source(sub->queue, es);
    }
 
    _al_vector_free(&this->queues);
@@ -97,18 +161,24 @@ void _al_event_source_unlock(ALLEGRO_EVENT_SOURCE *es)
  *  This function is called by al_register_event_source() when an
  *  event source is registered to an event queue.  This gives the
  *  event source a chance to remember which queues it is registered
- *  to.
+ *  to, and which event types each queue wants.  If `types` is NULL the
+ *  queue wants all events.  Registering again replaces the types.
  */
 void _al_event_source_on_registration_to_queue(ALLEGRO_EVENT_SOURCE *es,
-   ALLEGRO_EVENT_QUEUE *queue)
+   ALLEGRO_EVENT_QUEUE *queue, const ALLEGRO_EVENT_TYPE *types, int num_types)
 {
    _al_event_source_lock(es);
    {
       ALLEGRO_EVENT_SOURCE_REAL *this = (ALLEGRO_EVENT_SOURCE_REAL *)es;
+      EVENT_SUBSCRIBER *sub = find_subscriber(this, queue);
 
       /* Add the queue to the source's list.  */
-      ALLEGRO_EVENT_QUEUE **slot = _al_vector_alloc_back(&this->queues);
-      *slot = queue;
+      if (!sub) {
+         sub = _al_vector_alloc_back(&this->queues);
+         sub->queue = queue;
+         sub->types = NULL;
+      }
+      set_subscriber_types(sub, types, num_types);
    }
    _al_event_source_unlock(es);
 }
@@ -125,8 +195,13 @@ void _al_event_source_on_unregistration_from_queue(ALLEGRO_EVENT_SOURCE *es,
    _al_event_source_lock(es);
    {
       ALLEGRO_EVENT_SOURCE_REAL *this = (ALLEGRO_EVENT_SOURCE_REAL *)es;
+      EVENT_SUBSCRIBER *sub = find_subscriber(this, queue);
 
-      _al_vector_find_and_delete(&this->queues, &queue);
+      if (sub) {
+         al_free(sub->types);
+         _al_vector_delete_at(&this->queues,
+            sub - (EVENT_SUBSCRIBER *)_al_vector_ref_front(&this->queues));
+      }
    }
    _al_event_source_unlock(es);
 }
@@ -157,6 +232,30 @@ bool _al_event_source_needs_to_generate_event(ALLEGRO_EVENT_SOURCE *es)
 
 
 
+/* Internal function: _al_event_source_wants_event_type
+ *  Like _al_event_source_needs_to_generate_event, but also checks that
+ *  at least one of the queues accepts events of the given type.
+ *
+ *  The event source must be _locked_ before calling this function.
+ *
+ *  [runs in background threads]
+ */
+bool _al_event_source_wants_event_type(ALLEGRO_EVENT_SOURCE *es,
+   ALLEGRO_EVENT_TYPE type)
+{
+   ALLEGRO_EVENT_SOURCE_REAL *this = (ALLEGRO_EVENT_SOURCE_REAL *)es;
+   unsigned int i;
+
+   for (i = 0; i < _al_vector_size(&this->queues); i++) {
+      if (subscriber_accepts(_al_vector_ref(&this->queues, i), type))
+         return true;
+   }
+
+   return false;
+}
+
+
+
 /* Internal function: _al_event_source_emit_event
  *  After an event structure has been filled in, it is time for the
  *  event source to tell the event queues it knows of about the new
@@ -168,22 +267,59 @@ bool _al_event_source_needs_to_generate_event(ALLEGRO_EVENT_SOURCE *es)
  *  [runs in background threads]
  */
 void _al_event_source_emit_event(ALLEGRO_EVENT_SOURCE *es, ALLEGRO_EVENT *event)
+{
+   _al_event_source_emit_events(es, event, 1);
+}
+
+
+
+/* Internal function: _al_event_source_emit_events
+ *  Like _al_event_source_emit_event but emits an array of events,
+ *  pushing them to each queue in one go.
+ *
+ *  The event source must be _locked_ before calling this function.
+ *
+ *  [runs in background threads]
+ */
+void _al_event_source_emit_events(ALLEGRO_EVENT_SOURCE *es,
+   ALLEGRO_EVENT *events, unsigned int num)
 {
    ALLEGRO_EVENT_SOURCE_REAL *this = (ALLEGRO_EVENT_SOURCE_REAL *)es;
+   unsigned int i;
 
-   event->any.source = es;
+   for (i = 0; i < num; i++) {
+      events[i].any.source = es;
+   }
 
-   /* Push the event to all the queues that this event source is
-    * registered to.
+   /* Push the events to all the queues that this event source is
+    * registered to, skipping events the queues don't want.
     */
    {
       size_t num_queues = _al_vector_size(&this->queues);
-      unsigned int i;
-      ALLEGRO_EVENT_QUEUE **slot;
-
-      for (i = 0; i < num_queues; i++) {
-         slot = _al_vector_ref(&this->queues, i);
-         _al_event_queue_push_event(*slot, event);
+      unsigned int q;
+      EVENT_SUBSCRIBER *sub;
+
+      for (q = 0; q < num_queues; q++) {
+         sub = _al_vector_ref(&this->queues, q);
+         if (!sub->types) {
+            _al_event_queue_push_events(sub->queue, events, num);
+            continue;
+         }
+
+         /* Push each run of wanted events. */
+         i = 0;
+         while (i < num) {
+            unsigned int start;
+
+            while (i < num && !subscriber_accepts(sub, events[i].type))
+               i++;
+            start = i;
+            while (i < num && subscriber_accepts(sub, events[i].type))
+               i++;
+            if (i > start)
+               _al_event_queue_push_events(sub->queue, events + start,
+                  i - start);
+         }
       }
    }
 }
@@ -216,21 +352,39 @@ void al_destroy_user_event_source(ALLEGRO_EVENT_SOURCE *src)
  */
 bool al_emit_user_event(ALLEGRO_EVENT_SOURCE *src,
    ALLEGRO_EVENT *event, void (*dtor)(ALLEGRO_USER_EVENT *))
+{
+   ASSERT(event);
+
+   return al_emit_user_events(src, event, 1, dtor);
+}
+
+
+
+/* Function: al_emit_user_events
+ */
+bool al_emit_user_events(ALLEGRO_EVENT_SOURCE *src,
+   ALLEGRO_EVENT *events, int num, void (*dtor)(ALLEGRO_USER_EVENT *))
 {
    size_t num_queues;
    bool rc;
+   int i;
 
    ASSERT(src);
-   ASSERT(event);
+   ASSERT(events || num <= 0);
 
-   if (dtor) {
-      ALLEGRO_USER_EVENT_DESCRIPTOR *descr = al_malloc(sizeof(*descr));
-      descr->refcount = 0;
-      descr->dtor = dtor;
-      event->user.__internal__descr = descr;
-   }
-   else {
-      event->user.__internal__descr = NULL;
+   if (num <= 0)
+      return false;
+
+   for (i = 0; i < num; i++) {
+      if (dtor) {
+         ALLEGRO_USER_EVENT_DESCRIPTOR *descr = al_malloc(sizeof(*descr));
+         descr->refcount = 0;
+         descr->dtor = dtor;
+         events[i].user.__internal__descr = descr;
+      }
+      else {
+         events[i].user.__internal__descr = NULL;
+      }
    }
 
    _al_event_source_lock(src);
@@ -239,9 +393,18 @@ bool al_emit_user_event(ALLEGRO_EVENT_SOURCE *src,
 
       num_queues = _al_vector_size(&rsrc->queues);
       if (num_queues > 0) {
-         event->any.timestamp = al_get_time();
-         _al_event_source_emit_event(src, event);
+         double timestamp = al_get_time();
+         for (i = 0; i < num; i++) {
+            events[i].any.timestamp = timestamp;
+         }
+         _al_event_source_emit_events(src, events, num);
          rc = true;
+
+         /* Mark events which no queue wanted, to be destroyed below. */
+         for (i = 0; i < num; i++) {
+            if (!_al_event_source_wants_event_type(src, events[i].type))
+               events[i].any.source = NULL;
+         }
       }
       else {
          rc = false;
@@ -249,9 +412,13 @@ bool al_emit_user_event(ALLEGRO_EVENT_SOURCE *src,
    }
    _al_event_source_unlock(src);
 
-   if (dtor && !rc) {
-      dtor(&event->user);
-      al_free(event->user.__internal__descr);
+   if (dtor) {
+      for (i = 0; i < num; i++) {
+         if (!rc || !events[i].any.source) {
+            dtor(&events[i].user);
+            al_free(events[i].user.__internal__descr);
+         }
+      }
    }
 
    return rc;
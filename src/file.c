@@ -19,6 +19,131 @@
 #include "allegro5/internal/aintern_file.h"
 
 
+/* Reads at least this large bypass the read window. */
+#define DIRECT_READ_SIZE   4096
+
+
+#define MAX_FILE_EXTENSIONS   8
+
+static struct {
+   const ALLEGRO_FILE_INTERFACE *drv;
+   const _AL_FILE_EXTENSION *ext;
+} file_extensions[MAX_FILE_EXTENSIONS] = {
+   { &_al_file_interface_stdio, &_al_file_extension_stdio },
+   { &_al_file_interface_mmap,  &_al_file_extension_mmap },
+   { &_al_file_interface_pack,  &_al_file_extension_pack },
+   { &_al_file_interface_slice, &_al_file_extension_slice },
+   { &_al_file_interface_filter, &_al_file_extension_filter }
+};
+static int num_file_extensions = 5;
+
+
+/* Entries are only ever added, and are filled in before they are counted,
+ * so a lookup racing with a registration at worst misses the new entry.
+ */
+void _al_register_file_extension(const ALLEGRO_FILE_INTERFACE *drv,
+   const _AL_FILE_EXTENSION *ext)
+{
+   int i;
+
+   for (i = 0; i < num_file_extensions; i++) {
+      if (file_extensions[i].drv == drv) {
+         file_extensions[i].ext = ext;
+         return;
+      }
+   }
+
+   ASSERT(num_file_extensions < MAX_FILE_EXTENSIONS);
+   if (num_file_extensions < MAX_FILE_EXTENSIONS) {
+      file_extensions[num_file_extensions].drv = drv;
+      file_extensions[num_file_extensions].ext = ext;
+      num_file_extensions++;
+   }
+}
+
+
+static const _AL_FILE_EXTENSION *find_extension(
+   const ALLEGRO_FILE_INTERFACE *drv)
+{
+   int i;
+
+   for (i = 0; i < num_file_extensions; i++) {
+      if (file_extensions[i].drv == drv)
+         return file_extensions[i].ext;
+   }
+   return NULL;
+}
+
+
+static size_t window_len(ALLEGRO_FILE *f)
+{
+   return f->window_end - f->window_pos;
+}
+
+
+static void clear_window(ALLEGRO_FILE *f)
+{
+   f->window_start = f->window_pos = f->window_end = NULL;
+}
+
+
+static size_t fill_window(ALLEGRO_FILE *f)
+{
+   size_t n = 0;
+   ASSERT(f->window_pos == f->window_end);
+
+   if (f->ext && f->ext->fi_ffill)
+      n = f->ext->fi_ffill(f);
+
+   if (n > 0)
+      f->window_start = f->window_pos;
+   else
+      clear_window(f);
+   return n;
+}
+
+
+/* Return a pointer to the next `n` bytes and consume them if they are all
+ * in the read window, otherwise return NULL.
+ */
+static INLINE const unsigned char *take_window(ALLEGRO_FILE *f, size_t n)
+{
+   const unsigned char *p = f->window_pos;
+
+   if (f->ungetc_len == 0 && (size_t)(f->window_end - p) >= n) {
+      f->window_pos = p + n;
+      return p;
+   }
+
+   return NULL;
+}
+
+
+/* Discard the read window, moving the backend back to the logical file
+ * position.  Required before any operation which relies on the backend
+ * position.
+ */
+static void drop_window(ALLEGRO_FILE *f)
+{
+   size_t n = window_len(f);
+
+   clear_window(f);
+   if (n > 0) {
+      f->vtable->fi_fseek(f, -(int64_t)n, ALLEGRO_SEEK_CUR);
+   }
+}
+
+
+/* Forget the read window and any pushed back bytes without moving the
+ * backend.  For backends about to free the memory the window points into.
+ */
+void _al_discard_file_buffers(ALLEGRO_FILE *f)
+{
+   clear_window(f);
+   f->ungetc_len = 0;
+}
+
+
 /* Function: al_fopen
  */
 ALLEGRO_FILE *al_fopen(const char *path, const char *mode)
@@ -45,8 +170,10 @@ ALLEGRO_FILE *al_fopen_interface(const ALLEGRO_FILE_INTERFACE *drv,
       }
       else {
          f->vtable = drv;
+         f->ext = find_extension(drv);
          f->userdata = drv->fi_fopen(path, mode);
          f->ungetc_len = 0;
+         f->window_start = f->window_pos = f->window_end = NULL;
          if (!f->userdata) {
             al_free(f);
             f = NULL;
@@ -73,8 +200,10 @@ ALLEGRO_FILE *al_create_file_handle(const ALLEGRO_FILE_INTERFACE *drv,
    }
    else {
       f->vtable = drv;
+      f->ext = find_extension(drv);
       f->userdata = userdata;
       f->ungetc_len = 0;
+      f->window_start = f->window_pos = f->window_end = NULL;
    }
 
    return f;
@@ -100,24 +229,45 @@ bool al_fclose(ALLEGRO_FILE *f)
  */
 size_t al_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
 {
+   unsigned char *cptr = ptr;
+   size_t bytes = 0;
+   size_t n;
    ASSERT(f);
    ASSERT(ptr);
 
-   if (f->ungetc_len) {
-      int bytes_ungetc = 0;
-      unsigned char *cptr = ptr;
+   while (f->ungetc_len > 0 && size > 0) {
+      *cptr++ = f->ungetc[--f->ungetc_len];
+      ++bytes;
+      --size;
+   }
 
-      while (f->ungetc_len > 0 && size > 0) {
-         *cptr++ = f->ungetc[--f->ungetc_len];
-         ++bytes_ungetc;
-         --size;
-      }
+   /* Small reads are served from the read window, refilling it once if
+    * empty.  Whatever is left over goes straight to the backend.
+    */
+   if (size > 0 && size < DIRECT_READ_SIZE && window_len(f) == 0) {
+      fill_window(f);
+   }
 
-      return bytes_ungetc + f->vtable->fi_fread(f, cptr, size);
+   n = window_len(f);
+   if (n > 0) {
+      if (n > size)
+         n = size;
+      memcpy(cptr, f->window_pos, n);
+      f->window_pos += n;
+      cptr += n;
+      bytes += n;
+      size -= n;
    }
-   else {
-      return f->vtable->fi_fread(f, ptr, size);
+
+   if (size > 0) {
+      /* The backend moves past the window, so it can no longer be
+       * seeked back into.
+       */
+      clear_window(f);
+      bytes += f->vtable->fi_fread(f, cptr, size);
    }
+
+   return bytes;
 }
 
 
@@ -129,6 +279,7 @@ size_t al_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size)
    ASSERT(ptr);
 
    f->ungetc_len = 0;
+   drop_window(f);
    return f->vtable->fi_fwrite(f, ptr, size);
 }
 
@@ -139,6 +290,7 @@ bool al_fflush(ALLEGRO_FILE *f)
 {
    ASSERT(f);
 
+   drop_window(f);
    return f->vtable->fi_fflush(f);
 }
 
@@ -149,7 +301,7 @@ int64_t al_ftell(ALLEGRO_FILE *f)
 {
    ASSERT(f);
 
-   return f->vtable->fi_ftell(f) - f->ungetc_len;
+   return f->vtable->fi_ftell(f) - window_len(f) - f->ungetc_len;
 }
 
 
@@ -172,6 +324,28 @@ bool al_fseek(ALLEGRO_FILE *f, int64_t offset, int whence)
       f->ungetc_len = 0;
    }
 
+   /* Seeks which land inside the read window just move within it. */
+   if (f->window_start && whence != ALLEGRO_SEEK_END) {
+      int64_t delta = offset;
+      int64_t pos = 0;
+
+      if (whence == ALLEGRO_SEEK_SET) {
+         pos = f->vtable->fi_ftell(f);
+         delta = offset - (pos - (int64_t)window_len(f));
+      }
+
+      if (pos >= 0 && delta >= f->window_start - f->window_pos &&
+            delta <= f->window_end - f->window_pos) {
+         f->window_pos += delta;
+         return true;
+      }
+   }
+
+   if (whence == ALLEGRO_SEEK_CUR) {
+      offset -= window_len(f);
+   }
+   clear_window(f);
+
    return f->vtable->fi_fseek(f, offset, whence);
 }
 
@@ -182,7 +356,7 @@ bool al_feof(ALLEGRO_FILE *f)
 {
    ASSERT(f);
 
-   return f->ungetc_len == 0 && f->vtable->fi_feof(f);
+   return f->ungetc_len == 0 && window_len(f) == 0 && f->vtable->fi_feof(f);
 }
 
 
@@ -223,9 +397,14 @@ void al_fclearerr(ALLEGRO_FILE *f)
  */
 int al_fgetc(ALLEGRO_FILE *f)
 {
+   const unsigned char *p;
    uint8_t c;
    ASSERT(f);
 
+   if ((p = take_window(f, 1))) {
+      return *p;
+   }
+
    if (al_fread(f, &c, 1) != 1) {
       return EOF;
    }
@@ -253,14 +432,18 @@ int al_fputc(ALLEGRO_FILE *f, int c)
  */
 int16_t al_fread16le(ALLEGRO_FILE *f)
 {
-   unsigned char b[2];
+   unsigned char buf[2];
+   const unsigned char *b;
    ASSERT(f);
 
-   if (al_fread(f, b, 2) == 2) {
-      return (((int16_t)b[1] << 8) | (int16_t)b[0]);
+   b = take_window(f, 2);
+   if (!b) {
+      if (al_fread(f, buf, 2) != 2)
+         return EOF;
+      b = buf;
    }
 
-   return EOF;
+   return (((int16_t)b[1] << 8) | (int16_t)b[0]);
 }
 
 
@@ -268,15 +451,19 @@ int16_t al_fread16le(ALLEGRO_FILE *f)
  */
 int32_t al_fread32le(ALLEGRO_FILE *f)
 {
-   unsigned char b[4];
+   unsigned char buf[4];
+   const unsigned char *b;
    ASSERT(f);
 
-   if (al_fread(f, b, 4) == 4) {
-      return (((int32_t)b[3] << 24) | ((int32_t)b[2] << 16) |
-              ((int32_t)b[1] << 8) | (int32_t)b[0]);
+   b = take_window(f, 4);
+   if (!b) {
+      if (al_fread(f, buf, 4) != 4)
+         return EOF;
+      b = buf;
    }
 
-   return EOF;
+   return (((int32_t)b[3] << 24) | ((int32_t)b[2] << 16) |
+           ((int32_t)b[1] << 8) | (int32_t)b[0]);
 }
 
 
@@ -332,14 +519,18 @@ size_t al_fwrite32le(ALLEGRO_FILE *f, int32_t l)
  */
 int16_t al_fread16be(ALLEGRO_FILE *f)
 {
-   unsigned char b[2];
+   unsigned char buf[2];
+   const unsigned char *b;
    ASSERT(f);
 
-   if (al_fread(f, b, 2) == 2) {
-      return (((int16_t)b[0] << 8) | (int16_t)b[1]);
+   b = take_window(f, 2);
+   if (!b) {
+      if (al_fread(f, buf, 2) != 2)
+         return EOF;
+      b = buf;
    }
 
-   return EOF;
+   return (((int16_t)b[0] << 8) | (int16_t)b[1]);
 }
 
 
@@ -347,15 +538,19 @@ int16_t al_fread16be(ALLEGRO_FILE *f)
  */
 int32_t al_fread32be(ALLEGRO_FILE *f)
 {
-   unsigned char b[4];
+   unsigned char buf[4];
+   const unsigned char *b;
    ASSERT(f);
 
-   if (al_fread(f, b, 4) == 4) {
-      return (((int32_t)b[0] << 24) | ((int32_t)b[1] << 16) |
-              ((int32_t)b[2] << 8) | (int32_t)b[3]);
+   b = take_window(f, 4);
+   if (!b) {
+      if (al_fread(f, buf, 4) != 4)
+         return EOF;
+      b = buf;
    }
 
-   return EOF;
+   return (((int32_t)b[0] << 24) | ((int32_t)b[1] << 16) |
+           ((int32_t)b[2] << 8) | (int32_t)b[3]);
 }
 
 
@@ -498,14 +693,19 @@ int al_fungetc(ALLEGRO_FILE *f, int c)
 {
    ASSERT(f != NULL);
 
-   if (f->vtable->fi_fungetc) {
+   /* Backends which fill a read window must not be given pushed back
+    * bytes: filling the window would consume them, and seeking back over
+    * the window would lose them.  They always use the buffer below.
+    */
+   if (f->vtable->fi_fungetc && !(f->ext && f->ext->fi_ffill)) {
       return f->vtable->fi_fungetc(f, c);
    }
    else {
       /* If the interface does not provide an implementation for ungetc,
        * then a default one will be used. (Note that if the interface does
-       * implement it, then this ungetc buffer will never be filled, and all
-       * other references to it within this file will always be ignored.)
+       * implement it and has no read window, then this ungetc buffer will
+       * never be filled, and all other references to it within this file
+       * will always be ignored.)
        */
       if (f->ungetc_len == ALLEGRO_UNGETC_SIZE) {
          return EOF;
@@ -528,6 +728,22 @@ int64_t al_fsize(ALLEGRO_FILE *f)
 }
 
 
+/* Function: al_fview
+ */
+const void *al_fview(ALLEGRO_FILE *f, int64_t offset, size_t *size)
+{
+   ASSERT(f != NULL);
+   ASSERT(size != NULL);
+
+   if (offset < 0 || !f->ext || !f->ext->fi_fview) {
+      *size = 0;
+      return NULL;
+   }
+
+   return f->ext->fi_fview(f, offset, size);
+}
+
+
 /* Function: al_get_file_userdata
  */
 void *al_get_file_userdata(ALLEGRO_FILE *f)
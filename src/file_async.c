@@ -0,0 +1,362 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Asynchronous file reads.
+ *
+ *      Requests are queued by priority and serviced by a small pool of
+ *      worker threads shared by all files.  Completion is reported through
+ *      a single event source.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_events.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_file.h"
+#include "allegro5/internal/aintern_thread.h"
+#include "allegro5/internal/aintern_vector.h"
+
+ALLEGRO_DEBUG_CHANNEL("file")
+
+
+#define NUM_WORKERS     4
+#define NUM_FILE_LOCKS  16
+
+
+enum {
+   ASYNC_PENDING,
+   ASYNC_RUNNING,
+   ASYNC_DONE,
+   ASYNC_CANCELLED
+};
+
+
+struct ALLEGRO_ASYNC_READ
+{
+   ALLEGRO_FILE *fp;
+   int64_t offset;
+   void *buffer;
+   size_t size;
+   int priority;
+   int state;
+   size_t bytes_read;
+   int error;
+};
+
+
+static ALLEGRO_MUTEX *async_mutex;
+static ALLEGRO_COND *async_cond;         /* signalled on new requests */
+static ALLEGRO_COND *async_done_cond;    /* signalled on completion */
+/* Pending requests, sorted by ascending priority.  The back is taken
+ * first, and requests of equal priority are served in submission order.
+ */
+static _AL_VECTOR pending = _AL_VECTOR_INITIALIZER(ALLEGRO_ASYNC_READ *);
+static _AL_THREAD *workers;
+static bool shutting_down;
+static ALLEGRO_EVENT_SOURCE async_es;
+/* The worker threads may run several requests on the same file handle, so
+ * seek+read pairs are serialised per file through a set of lock stripes.
+ */
+static ALLEGRO_MUTEX *file_locks[NUM_FILE_LOCKS];
+
+
+static ALLEGRO_MUTEX *file_lock(ALLEGRO_FILE *fp)
+{
+   return file_locks[((uintptr_t)fp / sizeof(void *)) % NUM_FILE_LOCKS];
+}
+
+
+static void do_read(ALLEGRO_ASYNC_READ *req)
+{
+   ALLEGRO_MUTEX *lock;
+   const void *view;
+   size_t n = req->size;
+
+   /* Directly addressable files need no seeking, hence no locking. */
+   view = al_fview(req->fp, req->offset, &n);
+   if (view) {
+      memcpy(req->buffer, view, n);
+      req->bytes_read = n;
+      return;
+   }
+
+   lock = file_lock(req->fp);
+   al_lock_mutex(lock);
+   if (!al_fseek(req->fp, req->offset, ALLEGRO_SEEK_SET)) {
+      req->error = al_get_errno();
+   }
+   else {
+      req->bytes_read = al_fread(req->fp, req->buffer, req->size);
+      if (req->bytes_read < req->size && al_ferror(req->fp)) {
+         req->error = al_get_errno();
+      }
+   }
+   al_unlock_mutex(lock);
+}
+
+
+static void make_event(ALLEGRO_EVENT *event, ALLEGRO_ASYNC_READ *req)
+{
+   event->async_read.type = ALLEGRO_EVENT_ASYNC_READ;
+   event->async_read.timestamp = al_get_time();
+   event->async_read.request = req;
+   event->async_read.buffer = req->buffer;
+   event->async_read.size = req->bytes_read;
+   event->async_read.error = req->error;
+   event->async_read.cancelled = (req->state == ASYNC_CANCELLED);
+}
+
+
+static void emit_event(ALLEGRO_EVENT *event)
+{
+   _al_event_source_lock(&async_es);
+   if (_al_event_source_needs_to_generate_event(&async_es)) {
+      _al_event_source_emit_event(&async_es, event);
+   }
+   _al_event_source_unlock(&async_es);
+}
+
+
+/* [worker threads] */
+static void async_read_thread_proc(_AL_THREAD *self, void *unused)
+{
+   ALLEGRO_ASYNC_READ *req;
+   ALLEGRO_EVENT event;
+   (void)self;
+   (void)unused;
+
+   al_lock_mutex(async_mutex);
+   for (;;) {
+      while (_al_vector_is_empty(&pending) && !shutting_down) {
+         al_wait_cond(async_cond, async_mutex);
+      }
+      if (shutting_down)
+         break;
+
+      req = *(ALLEGRO_ASYNC_READ **)_al_vector_ref_back(&pending);
+      _al_vector_delete_at(&pending, _al_vector_size(&pending) - 1);
+      req->state = ASYNC_RUNNING;
+      al_unlock_mutex(async_mutex);
+
+      do_read(req);
+
+      al_lock_mutex(async_mutex);
+      req->state = ASYNC_DONE;
+      /* The request may be destroyed as soon as it is marked done, so
+       * the event must not refer back to it after this point.
+       */
+      make_event(&event, req);
+      al_broadcast_cond(async_done_cond);
+      al_unlock_mutex(async_mutex);
+
+      emit_event(&event);
+
+      al_lock_mutex(async_mutex);
+   }
+   al_unlock_mutex(async_mutex);
+}
+
+
+static void shutdown_async_reads(void)
+{
+   int i;
+
+   if (workers) {
+      al_lock_mutex(async_mutex);
+      shutting_down = true;
+      al_broadcast_cond(async_cond);
+      al_unlock_mutex(async_mutex);
+
+      for (i = 0; i < NUM_WORKERS; i++) {
+         _al_thread_join(&workers[i]);
+      }
+      al_free(workers);
+      workers = NULL;
+   }
+
+   if (_al_vector_is_nonempty(&pending)) {
+      ALLEGRO_WARN("%d asynchronous reads still pending at exit\n",
+         (int)_al_vector_size(&pending));
+   }
+   _al_vector_free(&pending);
+
+   _al_event_source_free(&async_es);
+
+   for (i = 0; i < NUM_FILE_LOCKS; i++) {
+      al_destroy_mutex(file_locks[i]);
+   }
+   al_destroy_cond(async_done_cond);
+   al_destroy_cond(async_cond);
+   al_destroy_mutex(async_mutex);
+}
+
+
+void _al_init_async_reads(void)
+{
+   int i;
+
+   async_mutex = al_create_mutex();
+   async_cond = al_create_cond();
+   async_done_cond = al_create_cond();
+   for (i = 0; i < NUM_FILE_LOCKS; i++) {
+      file_locks[i] = al_create_mutex();
+   }
+   shutting_down = false;
+   _al_event_source_init(&async_es);
+   _al_add_exit_func(shutdown_async_reads, "shutdown_async_reads");
+}
+
+
+/* Must be called with async_mutex held. */
+static bool start_workers(void)
+{
+   int i;
+
+   workers = al_malloc(NUM_WORKERS * sizeof(_AL_THREAD));
+   if (!workers)
+      return false;
+   for (i = 0; i < NUM_WORKERS; i++) {
+      _al_thread_create(&workers[i], async_read_thread_proc, NULL);
+   }
+   return true;
+}
+
+
+/* Function: al_fread_async
+ */
+ALLEGRO_ASYNC_READ *al_fread_async(ALLEGRO_FILE *f, int64_t offset,
+   void *ptr, size_t size, int priority)
+{
+   ALLEGRO_ASYNC_READ *req;
+   ALLEGRO_ASYNC_READ **slot;
+   unsigned int i;
+   ASSERT(f);
+   ASSERT(ptr);
+   ASSERT(offset >= 0);
+
+   req = al_calloc(1, sizeof(*req));
+   if (!req) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+
+   req->fp = f;
+   req->offset = offset;
+   req->buffer = ptr;
+   req->size = size;
+   req->priority = priority;
+   req->state = ASYNC_PENDING;
+
+   al_lock_mutex(async_mutex);
+
+   if (!workers && !start_workers()) {
+      goto fail;
+   }
+
+   /* Insert before any request of equal or higher priority. */
+   for (i = 0; i < _al_vector_size(&pending); i++) {
+      slot = _al_vector_ref(&pending, i);
+      if ((*slot)->priority >= priority)
+         break;
+   }
+   slot = _al_vector_alloc_mid(&pending, i);
+   if (!slot) {
+      goto fail;
+   }
+   *slot = req;
+
+   al_signal_cond(async_cond);
+   al_unlock_mutex(async_mutex);
+
+   return req;
+
+fail:
+   al_unlock_mutex(async_mutex);
+   al_free(req);
+   al_set_errno(ENOMEM);
+   return NULL;
+}
+
+
+/* Function: al_cancel_async_read
+ */
+bool al_cancel_async_read(ALLEGRO_ASYNC_READ *req)
+{
+   ALLEGRO_EVENT event;
+   ASSERT(req);
+
+   al_lock_mutex(async_mutex);
+   if (req->state != ASYNC_PENDING) {
+      al_unlock_mutex(async_mutex);
+      return false;
+   }
+   _al_vector_find_and_delete(&pending, &req);
+   req->state = ASYNC_CANCELLED;
+   make_event(&event, req);
+   al_broadcast_cond(async_done_cond);
+   al_unlock_mutex(async_mutex);
+
+   emit_event(&event);
+   return true;
+}
+
+
+/* Function: al_wait_for_async_read
+ */
+size_t al_wait_for_async_read(ALLEGRO_ASYNC_READ *req)
+{
+   size_t ret;
+   ASSERT(req);
+
+   al_lock_mutex(async_mutex);
+   while (req->state == ASYNC_PENDING || req->state == ASYNC_RUNNING) {
+      al_wait_cond(async_done_cond, async_mutex);
+   }
+   ret = req->bytes_read;
+   al_unlock_mutex(async_mutex);
+
+   return ret;
+}
+
+
+/* Function: al_destroy_async_read
+ */
+void al_destroy_async_read(ALLEGRO_ASYNC_READ *req)
+{
+   if (!req)
+      return;
+
+   al_lock_mutex(async_mutex);
+   if (req->state == ASYNC_PENDING) {
+      /* Silently dropped; no completion event is generated. */
+      _al_vector_find_and_delete(&pending, &req);
+      req->state = ASYNC_CANCELLED;
+   }
+   while (req->state == ASYNC_RUNNING) {
+      al_wait_cond(async_done_cond, async_mutex);
+   }
+   al_unlock_mutex(async_mutex);
+
+   al_free(req);
+}
+
+
+/* Function: al_get_async_read_event_source
+ */
+ALLEGRO_EVENT_SOURCE *al_get_async_read_event_source(void)
+{
+   return &async_es;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
@@ -0,0 +1,993 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Compression filters - compress or decompress the data of
+ *      another file on the fly.
+ *
+ *      The generic part below deals with buffering, seeking and the
+ *      ALLEGRO_FILE interface; each codec only turns the parent's data
+ *      into chunks of decoded data, or encodes a buffer of written data.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_file.h"
+#include "allegro5/internal/aintern_lz4.h"
+
+#ifdef ALLEGRO_CFG_ZLIB
+#include <zlib.h>
+#endif
+
+ALLEGRO_DEBUG_CHANNEL("file")
+
+
+/* Amount of written data collected before it is handed to the codec. */
+#define WRITE_BUFFER_SIZE  (256 * 1024)
+
+
+typedef struct FILTER FILTER;
+typedef struct FILTER_CODEC FILTER_CODEC;
+
+enum {
+   ENCODE_NONE,
+   ENCODE_FLUSH,
+   ENCODE_FINISH
+};
+
+struct FILTER_CODEC
+{
+   const char *name;
+   bool (*init)(FILTER *filter);
+   void (*destroy)(FILTER *filter);
+   /* Start decoding again from the beginning of the stream. */
+   bool (*reset)(FILTER *filter);
+   /* Point out/out_len at the next chunk of decoded data.  Sets end
+    * instead once the stream is exhausted.
+    */
+   bool (*decode)(FILTER *filter);
+   /* Encode and write in/in_len, then empty the buffer. */
+   bool (*encode)(FILTER *filter, int how);
+};
+
+struct FILTER
+{
+   const FILTER_CODEC *codec;
+   ALLEGRO_FILE *fp;          /* parent file handle */
+   int64_t origin;            /* start of the stream in the parent */
+   bool writing;
+   int level;                 /* compression level, or -1 for default */
+
+   /* Reading: the current chunk of decoded data. */
+   const unsigned char *out;
+   size_t out_len;
+   size_t out_pos;
+   int64_t out_offset;        /* uncompressed offset of out[0] */
+   bool end;
+   bool eof;
+
+   /* Writing: data not yet given to the codec. */
+   unsigned char *in;
+   size_t in_len;
+   int64_t written;
+
+   bool error;
+   char errmsg[80];
+
+   void *state;               /* codec specific */
+};
+
+
+static void set_error(FILTER *filter, int err, const char *msg)
+{
+   ALLEGRO_ERROR("%s filter: %s\n", filter->codec->name, msg);
+   filter->error = true;
+   _al_sane_strncpy(filter->errmsg, msg, sizeof(filter->errmsg));
+   al_set_errno(err);
+}
+
+
+/* Read exactly `size` bytes from the parent.  Returns false on a short
+ * read; *got (if given) receives the number of bytes read.
+ */
+static bool read_parent(FILTER *filter, void *ptr, size_t size,
+   size_t *got)
+{
+   size_t n = al_fread(filter->fp, ptr, size);
+
+   if (got)
+      *got = n;
+   if (n == size)
+      return true;
+   if (al_ferror(filter->fp))
+      set_error(filter, al_get_errno(), "read error");
+   else if (!got || n > 0)
+      set_error(filter, EINVAL, "truncated stream");
+   return false;
+}
+
+
+static bool write_parent(FILTER *filter, const void *ptr, size_t size)
+{
+   if (al_fwrite(filter->fp, ptr, size) != size) {
+      set_error(filter, al_get_errno(), "write error");
+      return false;
+   }
+   return true;
+}
+
+
+/* Move to the next chunk of decoded data.  Returns false at the end of
+ * the stream or on error.
+ */
+static bool next_chunk(FILTER *filter)
+{
+   filter->out_offset += filter->out_len;
+   filter->out_len = 0;
+   filter->out_pos = 0;
+
+   while (filter->out_len == 0) {
+      if (filter->end || filter->error)
+         return false;
+      if (!filter->codec->decode(filter))
+         return false;
+   }
+   return true;
+}
+
+
+static bool filter_fclose(ALLEGRO_FILE *f)
+{
+   FILTER *filter = al_get_file_userdata(f);
+   bool ret = true;
+
+   if (filter->writing && !filter->error) {
+      ret = filter->codec->encode(filter, ENCODE_FINISH);
+   }
+
+   filter->codec->destroy(filter);
+   al_free(filter->in);
+   al_free(filter);
+
+   return ret;
+}
+
+
+static size_t filter_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
+{
+   FILTER *filter = al_get_file_userdata(f);
+   unsigned char *cptr = ptr;
+   size_t total = 0;
+
+   if (filter->writing) {
+      al_set_errno(EBADF);
+      return 0;
+   }
+
+   while (total < size) {
+      size_t n = filter->out_len - filter->out_pos;
+
+      if (n == 0) {
+         if (!next_chunk(filter)) {
+            if (filter->end)
+               filter->eof = true;
+            break;
+         }
+         continue;
+      }
+
+      if (n > size - total)
+         n = size - total;
+      memcpy(cptr + total, filter->out + filter->out_pos, n);
+      filter->out_pos += n;
+      total += n;
+   }
+
+   return total;
+}
+
+
+static size_t filter_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size)
+{
+   FILTER *filter = al_get_file_userdata(f);
+   const unsigned char *cptr = ptr;
+   size_t total = 0;
+
+   if (!filter->writing) {
+      al_set_errno(EBADF);
+      return 0;
+   }
+
+   while (total < size && !filter->error) {
+      size_t n = WRITE_BUFFER_SIZE - filter->in_len;
+
+      if (n > size - total)
+         n = size - total;
+      memcpy(filter->in + filter->in_len, cptr + total, n);
+      filter->in_len += n;
+      filter->written += n;
+      total += n;
+
+      if (filter->in_len == WRITE_BUFFER_SIZE &&
+            !filter->codec->encode(filter, ENCODE_NONE))
+         break;
+   }
+
+   return total;
+}
+
+
+static bool filter_fflush(ALLEGRO_FILE *f)
+{
+   FILTER *filter = al_get_file_userdata(f);
+
+   if (!filter->writing)
+      return true;
+
+   if (filter->error || !filter->codec->encode(filter, ENCODE_FLUSH))
+      return false;
+
+   return al_fflush(filter->fp);
+}
+
+
+static int64_t filter_ftell(ALLEGRO_FILE *f)
+{
+   FILTER *filter = al_get_file_userdata(f);
+
+   if (filter->writing)
+      return filter->written;
+
+   return filter->out_offset + filter->out_pos;
+}
+
+
+static bool rewind_filter(FILTER *filter)
+{
+   if (!al_fseek(filter->fp, filter->origin, ALLEGRO_SEEK_SET))
+      return false;
+
+   filter->out = NULL;
+   filter->out_len = 0;
+   filter->out_pos = 0;
+   filter->out_offset = 0;
+   filter->end = false;
+   filter->error = false;
+   return filter->codec->reset(filter);
+}
+
+
+static bool filter_fseek(ALLEGRO_FILE *f, int64_t offset, int whence)
+{
+   FILTER *filter = al_get_file_userdata(f);
+   int64_t pos;
+
+   switch (whence) {
+      case ALLEGRO_SEEK_SET:
+         pos = offset;
+         break;
+      case ALLEGRO_SEEK_CUR:
+         pos = filter_ftell(f) + offset;
+         break;
+      default:
+         /* The decoded size is not known in advance. */
+         al_set_errno(EINVAL);
+         return false;
+   }
+
+   if (pos < 0) {
+      al_set_errno(EINVAL);
+      return false;
+   }
+
+   if (filter->writing) {
+      if (pos != filter->written) {
+         al_set_errno(EINVAL);
+         return false;
+      }
+      return true;
+   }
+
+   filter->eof = false;
+
+   /* Seeking backwards out of the current chunk means decoding again
+    * from the start, forwards means decoding and discarding.
+    */
+   if (pos < filter->out_offset && !rewind_filter(filter))
+      return false;
+
+   while (pos > filter->out_offset + (int64_t)filter->out_len) {
+      if (!next_chunk(filter)) {
+         filter->out_pos = filter->out_len;
+         if (!filter->error)
+            al_set_errno(EINVAL);
+         return false;
+      }
+   }
+
+   filter->out_pos = pos - filter->out_offset;
+   return true;
+}
+
+
+static bool filter_feof(ALLEGRO_FILE *f)
+{
+   FILTER *filter = al_get_file_userdata(f);
+
+   return filter->eof;
+}
+
+
+static int filter_ferror(ALLEGRO_FILE *f)
+{
+   FILTER *filter = al_get_file_userdata(f);
+
+   return filter->error ? 1 : 0;
+}
+
+
+static const char *filter_ferrmsg(ALLEGRO_FILE *f)
+{
+   FILTER *filter = al_get_file_userdata(f);
+
+   return filter->error ? filter->errmsg : "";
+}
+
+
+static void filter_fclearerr(ALLEGRO_FILE *f)
+{
+   FILTER *filter = al_get_file_userdata(f);
+
+   filter->eof = false;
+}
+
+
+static off_t filter_fsize(ALLEGRO_FILE *f)
+{
+   FILTER *filter = al_get_file_userdata(f);
+
+   if (filter->writing)
+      return filter->written;
+
+   al_set_errno(ENOSYS);
+   return -1;
+}
+
+
+static size_t filter_ffill(ALLEGRO_FILE *f)
+{
+   FILTER *filter = al_get_file_userdata(f);
+   size_t n;
+
+   if (filter->writing)
+      return 0;
+
+   if (filter->out_pos == filter->out_len && !next_chunk(filter))
+      return 0;
+
+   /* The rest of the decoded chunk becomes the window. */
+   n = filter->out_len - filter->out_pos;
+   f->window_pos = filter->out + filter->out_pos;
+   f->window_end = f->window_pos + n;
+   filter->out_pos = filter->out_len;
+   return n;
+}
+
+
+const ALLEGRO_FILE_INTERFACE _al_file_interface_filter =
+{
+   NULL,    /* open */
+   filter_fclose,
+   filter_fread,
+   filter_fwrite,
+   filter_fflush,
+   filter_ftell,
+   filter_fseek,
+   filter_feof,
+   filter_ferror,
+   filter_ferrmsg,
+   filter_fclearerr,
+   NULL,    /* ungetc */
+   filter_fsize
+};
+
+
+const _AL_FILE_EXTENSION _al_file_extension_filter =
+{
+   NULL,    /* fview */
+   filter_ffill
+};
+
+
+/*
+ * LZ4 frames
+ *
+ * The standard LZ4 frame format, so the output of the lz4 command line
+ * tool can be read and vice versa.  Dictionary IDs are not supported.
+ */
+
+#define LZ4_MAGIC             0x184D2204u
+#define LZ4_SKIPPABLE_MASK    0xFFFFFFF0u
+#define LZ4_SKIPPABLE_MAGIC   0x184D2A50u
+
+#define LZ4_FLG_VERSION       0x40
+#define LZ4_FLG_INDEPENDENT   0x20
+#define LZ4_FLG_BLOCK_SUM     0x10
+#define LZ4_FLG_CONTENT_SIZE  0x08
+#define LZ4_FLG_CONTENT_SUM   0x04
+#define LZ4_FLG_DICT_ID       0x01
+
+#define LZ4_UNCOMPRESSED_BIT  0x80000000u
+
+/* Frames we write: version 1, independent blocks, no checksums, 256 KiB
+ * blocks.  The header checksum is the second byte of the xxHash32 of the
+ * two descriptor bytes.
+ */
+#define LZ4_WRITE_FLG         (LZ4_FLG_VERSION | LZ4_FLG_INDEPENDENT)
+#define LZ4_WRITE_BD          0x50
+#define LZ4_WRITE_HC          0xFB
+
+typedef struct LZ4_STATE
+{
+   bool in_frame;
+   int flags;                 /* LZ4_FLG_* of the current frame */
+   size_t block_size;
+   unsigned char *src;        /* compressed block */
+   unsigned char *dst;        /* history window followed by one block */
+   size_t history;            /* bytes of history before the block */
+   size_t last_len;           /* size of the block last decoded */
+   uint32_t *table;           /* compressor hash table */
+} LZ4_STATE;
+
+
+static uint32_t get32le(const unsigned char *p)
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+static void put32le(unsigned char *p, uint32_t v)
+{
+   p[0] = v;
+   p[1] = v >> 8;
+   p[2] = v >> 16;
+   p[3] = v >> 24;
+}
+
+
+static bool skip_parent(FILTER *filter, uint32_t n)
+{
+   unsigned char buf[256];
+
+   while (n > 0) {
+      size_t chunk = n < sizeof(buf) ? n : sizeof(buf);
+      if (!read_parent(filter, buf, chunk, NULL))
+         return false;
+      n -= chunk;
+   }
+   return true;
+}
+
+
+static bool lz4_alloc_block(FILTER *filter, size_t block_size)
+{
+   LZ4_STATE *lz = filter->state;
+
+   if (lz->block_size >= block_size)
+      return true;
+
+   al_free(lz->src);
+   al_free(lz->dst);
+   lz->src = al_malloc(block_size);
+   lz->dst = al_malloc(_AL_LZ4_WINDOW_SIZE + block_size);
+   if (!lz->src || !lz->dst) {
+      al_free(lz->src);
+      al_free(lz->dst);
+      lz->src = lz->dst = NULL;
+      lz->block_size = 0;
+      set_error(filter, ENOMEM, "out of memory");
+      return false;
+   }
+   lz->block_size = block_size;
+   return true;
+}
+
+
+/* Read a frame header, skipping skippable frames.  Sets end if the parent
+ * has no more frames.
+ */
+static bool lz4_read_frame_header(FILTER *filter)
+{
+   LZ4_STATE *lz = filter->state;
+   unsigned char b[8];
+   uint32_t magic;
+   size_t got;
+   int bd;
+
+   for (;;) {
+      if (!read_parent(filter, b, 4, &got)) {
+         if (got == 0 && !filter->error)
+            filter->end = true;
+         return false;
+      }
+      magic = get32le(b);
+      if ((magic & LZ4_SKIPPABLE_MASK) == LZ4_SKIPPABLE_MAGIC) {
+         if (!read_parent(filter, b, 4, NULL) ||
+               !skip_parent(filter, get32le(b)))
+            return false;
+         continue;
+      }
+      break;
+   }
+
+   if (magic != LZ4_MAGIC) {
+      set_error(filter, EINVAL, "not an LZ4 frame");
+      return false;
+   }
+
+   if (!read_parent(filter, b, 2, NULL))
+      return false;
+   lz->flags = b[0];
+   bd = (b[1] >> 4) & 7;
+   if ((lz->flags & 0xC0) != LZ4_FLG_VERSION || bd < 4) {
+      set_error(filter, EINVAL, "unsupported LZ4 frame");
+      return false;
+   }
+   if (lz->flags & LZ4_FLG_DICT_ID) {
+      set_error(filter, EINVAL, "LZ4 dictionaries are not supported");
+      return false;
+   }
+
+   /* The content size and header checksum are not needed. */
+   if (!skip_parent(filter,
+         ((lz->flags & LZ4_FLG_CONTENT_SIZE) ? 8 : 0) + 1))
+      return false;
+
+   if (!lz4_alloc_block(filter, (size_t)1 << (8 + 2 * bd)))
+      return false;
+
+   lz->history = 0;
+   lz->last_len = 0;
+   lz->in_frame = true;
+   return true;
+}
+
+
+static bool lz4_decode(FILTER *filter)
+{
+   LZ4_STATE *lz = filter->state;
+   unsigned char b[4];
+   unsigned char *block;
+   uint32_t size;
+   size_t n;
+
+   if (!lz->in_frame && !lz4_read_frame_header(filter))
+      return false;
+
+   if (!read_parent(filter, b, 4, NULL))
+      return false;
+   size = get32le(b);
+
+   if (size == 0) {
+      /* End mark; the next frame, if any, follows the checksum. */
+      lz->in_frame = false;
+      return skip_parent(filter,
+         (lz->flags & LZ4_FLG_CONTENT_SUM) ? 4 : 0);
+   }
+
+   /* Blocks which depend on earlier ones may refer back to the last
+    * 64 KiB of decoded data, which is kept in front of the new block.
+    */
+   block = lz->dst + _AL_LZ4_WINDOW_SIZE;
+   if (!(lz->flags & LZ4_FLG_INDEPENDENT) && lz->last_len > 0) {
+      size_t keep = lz->history + lz->last_len;
+      if (keep > _AL_LZ4_WINDOW_SIZE)
+         keep = _AL_LZ4_WINDOW_SIZE;
+      memmove(block - keep, block + lz->last_len - keep, keep);
+      lz->history = keep;
+   }
+   lz->last_len = 0;
+
+   if ((size & ~LZ4_UNCOMPRESSED_BIT) > lz->block_size) {
+      set_error(filter, EINVAL, "corrupt LZ4 block");
+      return false;
+   }
+
+   if (size & LZ4_UNCOMPRESSED_BIT) {
+      size &= ~LZ4_UNCOMPRESSED_BIT;
+      if (!read_parent(filter, block, size, NULL))
+         return false;
+      n = size;
+   }
+   else {
+      if (!read_parent(filter, lz->src, size, NULL))
+         return false;
+      n = _al_lz4_decompress(lz->src, size, block, lz->block_size,
+         (lz->flags & LZ4_FLG_INDEPENDENT) ? 0 : lz->history);
+      if (n == _AL_LZ4_ERROR) {
+         set_error(filter, EINVAL, "corrupt LZ4 block");
+         return false;
+      }
+   }
+
+   if ((lz->flags & LZ4_FLG_BLOCK_SUM) && !skip_parent(filter, 4))
+      return false;
+
+   lz->last_len = n;
+   filter->out = block;
+   filter->out_len = n;
+   return true;
+}
+
+
+static bool lz4_encode(FILTER *filter, int how)
+{
+   LZ4_STATE *lz = filter->state;
+   unsigned char b[4];
+   size_t n;
+
+   if (filter->in_len > 0) {
+      /* Blocks which do not shrink are stored as they are. */
+      n = _al_lz4_compress(filter->in, filter->in_len, lz->src,
+         filter->in_len - 1, lz->table);
+      if (n > 0) {
+         put32le(b, n);
+         if (!write_parent(filter, b, 4) ||
+               !write_parent(filter, lz->src, n))
+            return false;
+      }
+      else {
+         put32le(b, filter->in_len | LZ4_UNCOMPRESSED_BIT);
+         if (!write_parent(filter, b, 4) ||
+               !write_parent(filter, filter->in, filter->in_len))
+            return false;
+      }
+      filter->in_len = 0;
+   }
+
+   if (how == ENCODE_FINISH) {
+      put32le(b, 0);
+      return write_parent(filter, b, 4);
+   }
+
+   return true;
+}
+
+
+static bool lz4_reset(FILTER *filter)
+{
+   LZ4_STATE *lz = filter->state;
+
+   lz->in_frame = false;
+   lz->history = 0;
+   lz->last_len = 0;
+   return true;
+}
+
+
+static void lz4_destroy(FILTER *filter)
+{
+   LZ4_STATE *lz = filter->state;
+
+   if (lz) {
+      al_free(lz->src);
+      al_free(lz->dst);
+      al_free(lz->table);
+      al_free(lz);
+   }
+}
+
+
+static bool lz4_init(FILTER *filter)
+{
+   static const unsigned char header[7] = {
+      0x04, 0x22, 0x4D, 0x18, LZ4_WRITE_FLG, LZ4_WRITE_BD, LZ4_WRITE_HC
+   };
+   LZ4_STATE *lz;
+
+   lz = filter->state = al_calloc(1, sizeof(LZ4_STATE));
+   if (!lz) {
+      al_set_errno(ENOMEM);
+      return false;
+   }
+
+   /* Buffers for reading are sized by the frames themselves. */
+   if (!filter->writing)
+      return true;
+
+   lz->src = al_malloc(WRITE_BUFFER_SIZE);
+   lz->table = al_malloc(_AL_LZ4_TABLE_SIZE * sizeof(uint32_t));
+   if (!lz->src || !lz->table) {
+      al_set_errno(ENOMEM);
+      return false;
+   }
+
+   return write_parent(filter, header, sizeof(header));
+}
+
+
+static const FILTER_CODEC lz4_codec =
+{
+   "LZ4",
+   lz4_init,
+   lz4_destroy,
+   lz4_reset,
+   lz4_decode,
+   lz4_encode
+};
+
+
+/*
+ * Deflate, through zlib
+ *
+ * Written streams use the zlib wrapper; zlib and gzip streams are both
+ * accepted when reading.
+ */
+
+#ifdef ALLEGRO_CFG_ZLIB
+
+#define ZLIB_BUFFER_SIZE   (64 * 1024)    /* compressed data */
+#define ZLIB_OUT_SIZE      (256 * 1024)   /* decoded chunks */
+
+typedef struct ZLIB_STATE
+{
+   z_stream zs;
+   bool initialised;
+   unsigned char *zbuf;
+   unsigned char *out;
+} ZLIB_STATE;
+
+
+static bool zlib_decode(FILTER *filter)
+{
+   ZLIB_STATE *z = filter->state;
+   size_t got;
+   int ret;
+
+   z->zs.next_out = z->out;
+   z->zs.avail_out = ZLIB_OUT_SIZE;
+
+   while (z->zs.avail_out > 0) {
+      if (z->zs.avail_in == 0) {
+         got = al_fread(filter->fp, z->zbuf, ZLIB_BUFFER_SIZE);
+         if (got == 0) {
+            /* Hand out what was decoded; the error shows up next time. */
+            if (z->zs.avail_out < ZLIB_OUT_SIZE)
+               break;
+            if (al_ferror(filter->fp))
+               set_error(filter, al_get_errno(), "read error");
+            else
+               set_error(filter, EINVAL, "truncated stream");
+            return false;
+         }
+         z->zs.next_in = z->zbuf;
+         z->zs.avail_in = got;
+      }
+
+      ret = inflate(&z->zs, Z_NO_FLUSH);
+      if (ret == Z_STREAM_END) {
+         filter->end = true;
+         break;
+      }
+      if (ret != Z_OK && ret != Z_BUF_ERROR) {
+         set_error(filter, EINVAL,
+            z->zs.msg ? z->zs.msg : "corrupt deflate stream");
+         return false;
+      }
+   }
+
+   filter->out = z->out;
+   filter->out_len = ZLIB_OUT_SIZE - z->zs.avail_out;
+   return true;
+}
+
+
+static bool zlib_encode(FILTER *filter, int how)
+{
+   ZLIB_STATE *z = filter->state;
+   int flush;
+   size_t n;
+
+   switch (how) {
+      case ENCODE_FLUSH:  flush = Z_SYNC_FLUSH; break;
+      case ENCODE_FINISH: flush = Z_FINISH; break;
+      default:            flush = Z_NO_FLUSH; break;
+   }
+
+   z->zs.next_in = filter->in;
+   z->zs.avail_in = filter->in_len;
+
+   do {
+      z->zs.next_out = z->zbuf;
+      z->zs.avail_out = ZLIB_BUFFER_SIZE;
+      if (deflate(&z->zs, flush) == Z_STREAM_ERROR) {
+         set_error(filter, EINVAL, "deflate failed");
+         return false;
+      }
+      n = ZLIB_BUFFER_SIZE - z->zs.avail_out;
+      if (n > 0 && !write_parent(filter, z->zbuf, n))
+         return false;
+   } while (z->zs.avail_out == 0);
+
+   filter->in_len = 0;
+   return true;
+}
+
+
+static bool zlib_reset(FILTER *filter)
+{
+   ZLIB_STATE *z = filter->state;
+
+   z->zs.avail_in = 0;
+   return inflateReset(&z->zs) == Z_OK;
+}
+
+
+static void zlib_destroy(FILTER *filter)
+{
+   ZLIB_STATE *z = filter->state;
+
+   if (!z)
+      return;
+
+   if (z->initialised) {
+      if (filter->writing)
+         deflateEnd(&z->zs);
+      else
+         inflateEnd(&z->zs);
+   }
+   al_free(z->zbuf);
+   al_free(z->out);
+   al_free(z);
+}
+
+
+static bool zlib_init(FILTER *filter)
+{
+   ZLIB_STATE *z;
+   int ret;
+
+   z = filter->state = al_calloc(1, sizeof(ZLIB_STATE));
+   if (!z) {
+      al_set_errno(ENOMEM);
+      return false;
+   }
+
+   z->zbuf = al_malloc(ZLIB_BUFFER_SIZE);
+   if (!filter->writing)
+      z->out = al_malloc(ZLIB_OUT_SIZE);
+   if (!z->zbuf || (!filter->writing && !z->out)) {
+      al_set_errno(ENOMEM);
+      return false;
+   }
+
+   if (filter->writing) {
+      ret = deflateInit(&z->zs,
+         filter->level < 0 ? Z_DEFAULT_COMPRESSION : filter->level);
+   }
+   else {
+      /* 32 enables automatic detection of zlib and gzip headers. */
+      ret = inflateInit2(&z->zs, 15 + 32);
+   }
+   if (ret != Z_OK) {
+      ALLEGRO_ERROR("zlib initialisation failed: %d\n", ret);
+      al_set_errno(ret == Z_MEM_ERROR ? ENOMEM : EINVAL);
+      return false;
+   }
+
+   z->initialised = true;
+   return true;
+}
+
+
+static const FILTER_CODEC zlib_codec =
+{
+   "deflate",
+   zlib_init,
+   zlib_destroy,
+   zlib_reset,
+   zlib_decode,
+   zlib_encode
+};
+
+#endif /* ALLEGRO_CFG_ZLIB */
+
+
+static ALLEGRO_FILE *open_filter(const FILTER_CODEC *codec, ALLEGRO_FILE *fp,
+   const char *mode)
+{
+   FILTER *filter;
+   ALLEGRO_FILE *f;
+   bool read = false;
+   const char *p;
+   ASSERT(fp);
+   ASSERT(mode);
+
+   filter = al_calloc(1, sizeof(*filter));
+   if (!filter) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+
+   filter->codec = codec;
+   filter->fp = fp;
+   filter->level = -1;
+
+   for (p = mode; *p; p++) {
+      if (*p == 'r')
+         read = true;
+      else if (*p == 'w')
+         filter->writing = true;
+      else if (*p >= '0' && *p <= '9')
+         filter->level = *p - '0';
+      else if (*p != 'b')
+         break;
+   }
+   if (*p || read == filter->writing) {
+      /* Streams can only be read or written, from start to end. */
+      al_free(filter);
+      al_set_errno(EINVAL);
+      return NULL;
+   }
+
+   /* Rewinding is only possible if the parent can seek back here. */
+   filter->origin = al_ftell(fp);
+
+   if (filter->writing) {
+      filter->in = al_malloc(WRITE_BUFFER_SIZE);
+      if (!filter->in) {
+         al_set_errno(ENOMEM);
+         goto Error;
+      }
+   }
+
+   if (!codec->init(filter))
+      goto Error;
+
+   f = al_create_file_handle(&_al_file_interface_filter, filter);
+   if (!f)
+      goto Error;
+   return f;
+
+Error:
+   codec->destroy(filter);
+   al_free(filter->in);
+   al_free(filter);
+   return NULL;
+}
+
+
+/* Function: al_fopen_lz4
+ */
+ALLEGRO_FILE *al_fopen_lz4(ALLEGRO_FILE *fp, const char *mode)
+{
+   return open_filter(&lz4_codec, fp, mode);
+}
+
+
+/* Function: al_fopen_deflate
+ */
+ALLEGRO_FILE *al_fopen_deflate(ALLEGRO_FILE *fp, const char *mode)
+{
+#ifdef ALLEGRO_CFG_ZLIB
+   return open_filter(&zlib_codec, fp, mode);
+#else
+   (void)fp;
+   (void)mode;
+   ALLEGRO_ERROR("Allegro was built without zlib.\n");
+   al_set_errno(ENOSYS);
+   return NULL;
+#endif
+}
+
+
+/* vim: set sts=3 sw=3 et: */
@@ -0,0 +1,358 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Memory mapped file I/O.
+ *
+ *      Read-only files are mapped into memory in one piece, so reads are
+ *      plain copies out of the page cache and al_fview can hand out
+ *      pointers into the mapping.  Anything which cannot be mapped (write
+ *      modes, pipes, platforms without mmap) is passed on to the stdio
+ *      backend.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_file.h"
+
+#ifdef ALLEGRO_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+ALLEGRO_DEBUG_CHANNEL("mmap")
+
+
+typedef struct
+{
+   ALLEGRO_FILE *fallback;    /* stdio file if the file is not mapped */
+   unsigned char *map;
+   int64_t size;
+   int64_t pos;
+   bool eof;
+} USERDATA;
+
+
+#ifdef ALLEGRO_HAVE_MMAP
+static bool want_mapping(const char *mode)
+{
+   return !strpbrk(mode, "wWaA+");
+}
+
+
+static bool map_file(USERDATA *userdata, const char *path)
+{
+   struct stat st;
+   void *map;
+   int fd;
+
+   fd = open(path, O_RDONLY);
+   if (fd == -1) {
+      al_set_errno(errno);
+      return false;
+   }
+
+   if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+      /* Empty and special files are left to stdio. */
+      close(fd);
+      return false;
+   }
+
+   map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED) {
+      ALLEGRO_WARN("mmap failed for %s: %s\n", path, strerror(errno));
+      return false;
+   }
+
+   userdata->map = map;
+   userdata->size = st.st_size;
+   return true;
+}
+#endif
+
+
+static void *file_mmap_fopen(const char *path, const char *mode)
+{
+   USERDATA *userdata;
+
+   ALLEGRO_DEBUG("opening %s %s\n", path, mode);
+
+   userdata = al_calloc(1, sizeof(USERDATA));
+   if (!userdata) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+
+#ifdef ALLEGRO_HAVE_MMAP
+   if (want_mapping(mode) && map_file(userdata, path))
+      return userdata;
+#endif
+
+   userdata->fallback = al_fopen_interface(&_al_file_interface_stdio,
+      path, mode);
+   if (!userdata->fallback) {
+      al_free(userdata);
+      return NULL;
+   }
+
+   return userdata;
+}
+
+
+static bool file_mmap_fclose(ALLEGRO_FILE *f)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+   bool ret = true;
+
+   if (userdata->fallback) {
+      ret = al_fclose(userdata->fallback);
+   }
+#ifdef ALLEGRO_HAVE_MMAP
+   else if (userdata->map) {
+      munmap(userdata->map, userdata->size);
+   }
+#endif
+
+   al_free(userdata);
+   return ret;
+}
+
+
+static size_t file_mmap_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+   size_t n;
+
+   if (userdata->fallback)
+      return al_fread(userdata->fallback, ptr, size);
+
+   if (userdata->pos >= userdata->size) {
+      userdata->eof = true;
+      return 0;
+   }
+
+   if (userdata->size - userdata->pos < (int64_t)size) {
+      n = userdata->size - userdata->pos;
+      userdata->eof = true;
+   }
+   else {
+      n = size;
+   }
+
+   memcpy(ptr, userdata->map + userdata->pos, n);
+   userdata->pos += n;
+   return n;
+}
+
+
+static size_t file_mmap_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+
+   if (userdata->fallback)
+      return al_fwrite(userdata->fallback, ptr, size);
+
+   /* Mappings are read-only. */
+   al_set_errno(EBADF);
+   return 0;
+}
+
+
+static bool file_mmap_fflush(ALLEGRO_FILE *f)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+
+   if (userdata->fallback)
+      return al_fflush(userdata->fallback);
+
+   return true;
+}
+
+
+static int64_t file_mmap_ftell(ALLEGRO_FILE *f)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+
+   if (userdata->fallback)
+      return al_ftell(userdata->fallback);
+
+   return userdata->pos;
+}
+
+
+static bool file_mmap_fseek(ALLEGRO_FILE *f, int64_t offset, int whence)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+   int64_t pos;
+
+   if (userdata->fallback)
+      return al_fseek(userdata->fallback, offset, whence);
+
+   switch (whence) {
+      case ALLEGRO_SEEK_SET: pos = offset; break;
+      case ALLEGRO_SEEK_CUR: pos = userdata->pos + offset; break;
+      case ALLEGRO_SEEK_END: pos = userdata->size + offset; break;
+      default:
+         al_set_errno(EINVAL);
+         return false;
+   }
+
+   /* Like stdio, seeking past the end is allowed; reads there just fail. */
+   if (pos < 0) {
+      al_set_errno(EINVAL);
+      return false;
+   }
+
+   userdata->pos = pos;
+   userdata->eof = false;
+   return true;
+}
+
+
+static bool file_mmap_feof(ALLEGRO_FILE *f)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+
+   if (userdata->fallback)
+      return al_feof(userdata->fallback);
+
+   return userdata->eof;
+}
+
+
+static int file_mmap_ferror(ALLEGRO_FILE *f)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+
+   if (userdata->fallback)
+      return al_ferror(userdata->fallback);
+
+   return 0;
+}
+
+
+static const char *file_mmap_ferrmsg(ALLEGRO_FILE *f)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+
+   if (userdata->fallback)
+      return al_ferrmsg(userdata->fallback);
+
+   return "";
+}
+
+
+static void file_mmap_fclearerr(ALLEGRO_FILE *f)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+
+   if (userdata->fallback)
+      al_fclearerr(userdata->fallback);
+   else
+      userdata->eof = false;
+}
+
+
+static off_t file_mmap_fsize(ALLEGRO_FILE *f)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+
+   if (userdata->fallback)
+      return al_fsize(userdata->fallback);
+
+   return userdata->size;
+}
+
+
+static const void *file_mmap_fview(ALLEGRO_FILE *f, int64_t offset,
+   size_t *size)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+
+   if (userdata->fallback || offset > userdata->size) {
+      *size = 0;
+      return NULL;
+   }
+
+   if (userdata->size - offset < (int64_t)*size)
+      *size = userdata->size - offset;
+
+   return userdata->map + offset;
+}
+
+
+static size_t file_mmap_ffill(ALLEGRO_FILE *f)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+   size_t n;
+
+   if (userdata->fallback)
+      return 0;
+
+   if (userdata->pos >= userdata->size) {
+      userdata->eof = true;
+      return 0;
+   }
+
+   /* The whole remainder of the mapping becomes the window. */
+   n = userdata->size - userdata->pos;
+   f->window_pos = userdata->map + userdata->pos;
+   f->window_end = f->window_pos + n;
+   userdata->pos = userdata->size;
+   return n;
+}
+
+
+const struct ALLEGRO_FILE_INTERFACE _al_file_interface_mmap =
+{
+   file_mmap_fopen,
+   file_mmap_fclose,
+   file_mmap_fread,
+   file_mmap_fwrite,
+   file_mmap_fflush,
+   file_mmap_ftell,
+   file_mmap_fseek,
+   file_mmap_feof,
+   file_mmap_ferror,
+   file_mmap_ferrmsg,
+   file_mmap_fclearerr,
+   NULL,    /* ungetc */
+   file_mmap_fsize
+};
+
+
+const _AL_FILE_EXTENSION _al_file_extension_mmap =
+{
+   file_mmap_fview,
+   file_mmap_ffill
+};
+
+
+/* Function: al_fopen_mmap
+ */
+ALLEGRO_FILE *al_fopen_mmap(const char *path, const char *mode)
+{
+   return al_fopen_interface(&_al_file_interface_mmap, path, mode);
+}
+
+
+/* Function: al_set_mmap_file_interface
+ */
+void al_set_mmap_file_interface(void)
+{
+   al_set_new_file_interface(&_al_file_interface_mmap);
+}
+
+
+/* vim: set sts=3 sw=3 et: */
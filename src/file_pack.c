@@ -0,0 +1,1088 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Read-only pack archives.
+ *
+ *      A pack is a single file holding many others, with a hashed index so
+ *      that looking up an entry costs one hash and, usually, one string
+ *      comparison.  The archive is memory mapped, so stored entries are
+ *      handed out as views into the mapping; LZ4 compressed entries are
+ *      decoded into a private buffer when they are opened.
+ *
+ *      Packs are built with misc/make_pack.py, which also documents the
+ *      on-disk layout.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_file.h"
+#include "allegro5/internal/aintern_lz4.h"
+#include "allegro5/internal/aintern_vector.h"
+
+ALLEGRO_DEBUG_CHANNEL("pack")
+
+
+#define PACK_MAGIC         "ALPK"
+#define PACK_VERSION       1
+#define PACK_HEADER_SIZE   48
+#define PACK_ENTRY_SIZE    48
+#define PACK_NO_ENTRY      0xFFFFFFFFu
+
+#define PACK_FLAG_LZ4      1
+#define PACK_FLAG_DIR      2
+
+#define PACK_MAX_PATH      1024
+
+
+struct ALLEGRO_PACK
+{
+   ALLEGRO_FILE *fp;             /* keeps the mapping alive */
+   unsigned char *copy;          /* used instead if fp has no view */
+   const unsigned char *base;
+   uint64_t size;
+   uint32_t num_entries;
+   uint32_t num_buckets;
+   const unsigned char *buckets;
+   const unsigned char *entries;
+   const char *names;
+   time_t mtime;
+};
+
+
+typedef struct PACK_ENTRY
+{
+   uint32_t hash;
+   uint32_t next;
+   const char *name;
+   uint32_t name_length;
+   uint64_t offset;
+   uint64_t size;
+   uint64_t stored_size;
+   uint32_t flags;
+} PACK_ENTRY;
+
+
+/* Per-file state of an opened entry. */
+typedef struct
+{
+   const unsigned char *data;
+   unsigned char *decoded;       /* owned copy of an LZ4 entry */
+   int64_t size;
+   int64_t pos;
+   bool eof;
+} USERDATA;
+
+
+typedef struct ALLEGRO_FS_ENTRY_PACK
+{
+   ALLEGRO_FS_ENTRY fs_entry;    /* must be first */
+   char *path;                   /* normalised, no leading slash */
+   char *name;                   /* as returned by al_get_fs_entry_name */
+   ALLEGRO_PACK *pack;           /* pack holding the entry, if any */
+   PACK_ENTRY entry;
+
+   /* Directory listing position. */
+   bool is_dir_open;
+   unsigned int dir_pack;
+   uint32_t dir_entry;
+} ALLEGRO_FS_ENTRY_PACK;
+
+
+static const ALLEGRO_FS_INTERFACE fs_pack_vtable;
+
+/* Mounted packs, searched from the back so that later packs override
+ * earlier ones.
+ */
+static _AL_VECTOR mounted = _AL_VECTOR_INITIALIZER(ALLEGRO_PACK *);
+static ALLEGRO_MUTEX *mounted_mutex;
+
+/* We cannot use ALLEGRO_USTR because we have nowhere to free it. */
+static char pack_cwd[PACK_MAX_PATH] = "";
+
+
+static uint32_t get32(const unsigned char *p)
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+static uint64_t get64(const unsigned char *p)
+{
+   return get32(p) | ((uint64_t)get32(p + 4) << 32);
+}
+
+
+/* FNV-1a, as computed by misc/make_pack.py. */
+static uint32_t hash_path(const char *path, size_t len)
+{
+   uint32_t h = 2166136261u;
+   size_t i;
+
+   for (i = 0; i < len; i++) {
+      h ^= (unsigned char)path[i];
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
+static void read_entry(const ALLEGRO_PACK *pack, uint32_t i, PACK_ENTRY *e)
+{
+   const unsigned char *p = pack->entries + (size_t)i * PACK_ENTRY_SIZE;
+
+   e->hash = get32(p);
+   e->next = get32(p + 4);
+   e->name = pack->names + get32(p + 8);
+   e->name_length = get32(p + 12);
+   e->offset = get64(p + 16);
+   e->size = get64(p + 24);
+   e->stored_size = get64(p + 32);
+   e->flags = get32(p + 40);
+}
+
+
+static bool find_entry(const ALLEGRO_PACK *pack, const char *path,
+   size_t len, PACK_ENTRY *e)
+{
+   uint32_t h = hash_path(path, len);
+   uint32_t i = get32(pack->buckets + 4 * (h & (pack->num_buckets - 1)));
+
+   while (i != PACK_NO_ENTRY) {
+      read_entry(pack, i, e);
+      if (e->hash == h && e->name_length == len &&
+            memcmp(e->name, path, len) == 0) {
+         return true;
+      }
+      i = e->next;
+   }
+
+   return false;
+}
+
+
+/* Resolve `path` relative to `cwd` into `buf`, without leading or trailing
+ * slashes and with "." and ".." components removed.  Backslashes are
+ * accepted as separators.  Returns the length or -1 if it does not fit.
+ */
+static int normalise_path(const char *cwd, const char *path, char *buf)
+{
+   int len = 0;
+   int pass;
+
+   if (path[0] == '/' || path[0] == '\\')
+      cwd = "";
+
+   for (pass = 0; pass < 2; pass++) {
+      const char *s = (pass == 0) ? cwd : path;
+
+      while (*s) {
+         const char *start;
+         int n;
+
+         while (*s == '/' || *s == '\\')
+            s++;
+         start = s;
+         while (*s && *s != '/' && *s != '\\')
+            s++;
+         n = s - start;
+
+         if (n == 0 || (n == 1 && start[0] == '.'))
+            continue;
+         if (n == 2 && start[0] == '.' && start[1] == '.') {
+            while (len > 0 && buf[len - 1] != '/')
+               len--;
+            if (len > 0)
+               len--;
+            continue;
+         }
+
+         if (len + n + 2 > PACK_MAX_PATH)
+            return -1;
+         if (len > 0)
+            buf[len++] = '/';
+         memcpy(buf + len, start, n);
+         len += n;
+      }
+   }
+
+   buf[len] = '\0';
+   return len;
+}
+
+
+static bool check_pack(ALLEGRO_PACK *pack)
+{
+   const unsigned char *h = pack->base;
+   uint64_t index_offset, names_offset, names_size, index_size;
+   PACK_ENTRY e;
+   uint32_t i;
+
+   if (pack->size < PACK_HEADER_SIZE || memcmp(h, PACK_MAGIC, 4) != 0) {
+      ALLEGRO_ERROR("Not a pack file.\n");
+      return false;
+   }
+   if (get32(h + 4) != PACK_VERSION) {
+      ALLEGRO_ERROR("Unsupported pack version %u.\n", get32(h + 4));
+      return false;
+   }
+
+   pack->num_entries = get32(h + 8);
+   pack->num_buckets = get32(h + 12);
+   index_offset = get64(h + 16);
+   names_offset = get64(h + 24);
+   names_size = get64(h + 32);
+   pack->mtime = (time_t)get64(h + 40);
+
+   if (pack->num_buckets == 0 ||
+         (pack->num_buckets & (pack->num_buckets - 1)) != 0) {
+      ALLEGRO_ERROR("Bad bucket count %u.\n", pack->num_buckets);
+      return false;
+   }
+
+   index_size = 4 * (uint64_t)pack->num_buckets +
+      PACK_ENTRY_SIZE * (uint64_t)pack->num_entries;
+   if (index_offset > pack->size || index_size > pack->size - index_offset ||
+         names_offset > pack->size || names_size > pack->size - names_offset) {
+      ALLEGRO_ERROR("Truncated pack index.\n");
+      return false;
+   }
+
+   pack->buckets = pack->base + index_offset;
+   pack->entries = pack->buckets + 4 * (size_t)pack->num_buckets;
+   pack->names = (const char *)pack->base + names_offset;
+
+   /* Validate everything once so that lookups need no checks. */
+   for (i = 0; i < pack->num_buckets; i++) {
+      uint32_t first = get32(pack->buckets + 4 * i);
+      if (first != PACK_NO_ENTRY && first >= pack->num_entries)
+         goto bad_entry;
+   }
+   for (i = 0; i < pack->num_entries; i++) {
+      const unsigned char *p = pack->entries + (size_t)i * PACK_ENTRY_SIZE;
+      uint64_t name_offset = get32(p + 8);
+
+      read_entry(pack, i, &e);
+      if (e.next != PACK_NO_ENTRY && e.next >= pack->num_entries)
+         goto bad_entry;
+      if (name_offset + e.name_length >= names_size ||
+            e.name[e.name_length] != '\0')
+         goto bad_entry;
+      if (e.offset > pack->size || e.stored_size > pack->size - e.offset)
+         goto bad_entry;
+      if (!(e.flags & PACK_FLAG_LZ4) && e.stored_size != e.size)
+         goto bad_entry;
+   }
+
+   return true;
+
+bad_entry:
+   ALLEGRO_ERROR("Corrupt pack index.\n");
+   return false;
+}
+
+
+/* Function: al_open_pack
+ */
+ALLEGRO_PACK *al_open_pack(const char *path)
+{
+   ALLEGRO_PACK *pack;
+   size_t size;
+   int64_t fsize;
+   ASSERT(path);
+
+   pack = al_calloc(1, sizeof(ALLEGRO_PACK));
+   if (!pack) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+
+   pack->fp = al_fopen_interface(&_al_file_interface_mmap, path, "rb");
+   if (!pack->fp)
+      goto fail;
+
+   fsize = al_fsize(pack->fp);
+   if (fsize < 0 || (int64_t)(size_t)fsize != fsize) {
+      al_set_errno(EFBIG);
+      goto fail;
+   }
+
+   size = fsize;
+   pack->base = al_fview(pack->fp, 0, &size);
+   if (!pack->base) {
+      /* No mmap; keep the whole archive in memory instead. */
+      ALLEGRO_DEBUG("%s cannot be mapped, reading it\n", path);
+      size = fsize;
+      pack->copy = al_malloc(size ? size : 1);
+      if (!pack->copy) {
+         al_set_errno(ENOMEM);
+         goto fail;
+      }
+      if (al_fread(pack->fp, pack->copy, size) != size)
+         goto fail;
+      al_fclose(pack->fp);
+      pack->fp = NULL;
+      pack->base = pack->copy;
+   }
+   pack->size = size;
+
+   if (!check_pack(pack)) {
+      al_set_errno(EINVAL);
+      goto fail;
+   }
+
+   ALLEGRO_DEBUG("Opened pack %s with %u entries\n", path,
+      pack->num_entries);
+   return pack;
+
+fail:
+   if (pack->fp)
+      al_fclose(pack->fp);
+   al_free(pack->copy);
+   al_free(pack);
+   return NULL;
+}
+
+
+/* Function: al_close_pack
+ */
+void al_close_pack(ALLEGRO_PACK *pack)
+{
+   if (!pack)
+      return;
+
+   al_unmount_pack(pack);
+
+   if (pack->fp)
+      al_fclose(pack->fp);
+   al_free(pack->copy);
+   al_free(pack);
+}
+
+
+/* Function: al_mount_pack
+ */
+bool al_mount_pack(ALLEGRO_PACK *pack)
+{
+   ALLEGRO_PACK **slot;
+   bool ret = true;
+   ASSERT(pack);
+
+   al_lock_mutex(mounted_mutex);
+   if (!_al_vector_contains(&mounted, &pack)) {
+      slot = _al_vector_alloc_back(&mounted);
+      if (slot) {
+         *slot = pack;
+      }
+      else {
+         al_set_errno(ENOMEM);
+         ret = false;
+      }
+   }
+   al_unlock_mutex(mounted_mutex);
+   return ret;
+}
+
+
+/* Function: al_unmount_pack
+ */
+bool al_unmount_pack(ALLEGRO_PACK *pack)
+{
+   bool ret;
+   ASSERT(pack);
+
+   al_lock_mutex(mounted_mutex);
+   ret = _al_vector_find_and_delete(&mounted, &pack);
+   al_unlock_mutex(mounted_mutex);
+   return ret;
+}
+
+
+/* Find `path` in the mounted packs.  Must be called with mounted_mutex
+ * held.  Returns the index of the pack after the one the entry is in, so
+ * that 0 means not found.
+ */
+static unsigned int find_mounted(const char *path, size_t len, PACK_ENTRY *e)
+{
+   unsigned int i;
+
+   for (i = _al_vector_size(&mounted); i > 0; i--) {
+      ALLEGRO_PACK *pack = *(ALLEGRO_PACK **)_al_vector_ref(&mounted, i - 1);
+      if (find_entry(pack, path, len, e))
+         return i;
+   }
+   return 0;
+}
+
+
+static void *file_pack_open_entry(ALLEGRO_PACK *pack, const PACK_ENTRY *e);
+
+
+static void *file_pack_fopen(const char *path, const char *mode)
+{
+   char buf[PACK_MAX_PATH];
+   ALLEGRO_PACK *pack = NULL;
+   PACK_ENTRY e;
+   unsigned int i;
+   int len;
+
+   if (strpbrk(mode, "wWaA+")) {
+      al_set_errno(EPERM);
+      return NULL;
+   }
+
+   len = normalise_path(pack_cwd, path, buf);
+   if (len < 0) {
+      al_set_errno(ENAMETOOLONG);
+      return NULL;
+   }
+
+   al_lock_mutex(mounted_mutex);
+   i = find_mounted(buf, len, &e);
+   if (i > 0)
+      pack = *(ALLEGRO_PACK **)_al_vector_ref(&mounted, i - 1);
+   al_unlock_mutex(mounted_mutex);
+
+   if (!pack) {
+      al_set_errno(ENOENT);
+      return NULL;
+   }
+
+   return file_pack_open_entry(pack, &e);
+}
+
+
+static void *file_pack_open_entry(ALLEGRO_PACK *pack, const PACK_ENTRY *e)
+{
+   USERDATA *userdata;
+
+   if (e->flags & PACK_FLAG_DIR) {
+      al_set_errno(EISDIR);
+      return NULL;
+   }
+
+   userdata = al_calloc(1, sizeof(USERDATA));
+   if (!userdata) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+
+   userdata->size = e->size;
+
+   if (e->flags & PACK_FLAG_LZ4) {
+      if ((uint64_t)(size_t)e->size != e->size ||
+            !(userdata->decoded = al_malloc(e->size ? e->size : 1))) {
+         al_free(userdata);
+         al_set_errno(ENOMEM);
+         return NULL;
+      }
+      if (_al_lz4_decompress(pack->base + e->offset, e->stored_size,
+            userdata->decoded, e->size, 0) != e->size) {
+         ALLEGRO_ERROR("Corrupt compressed entry %s.\n", e->name);
+         al_free(userdata->decoded);
+         al_free(userdata);
+         al_set_errno(EINVAL);
+         return NULL;
+      }
+      userdata->data = userdata->decoded;
+   }
+   else {
+      userdata->data = pack->base + e->offset;
+   }
+
+   return userdata;
+}
+
+
+static void free_userdata(USERDATA *userdata)
+{
+   al_free(userdata->decoded);
+   al_free(userdata);
+}
+
+
+static bool file_pack_fclose(ALLEGRO_FILE *f)
+{
+   free_userdata(al_get_file_userdata(f));
+   return true;
+}
+
+
+static size_t file_pack_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+   size_t n;
+
+   if (userdata->pos >= userdata->size) {
+      userdata->eof = true;
+      return 0;
+   }
+
+   if (userdata->size - userdata->pos < (int64_t)size) {
+      n = userdata->size - userdata->pos;
+      userdata->eof = true;
+   }
+   else {
+      n = size;
+   }
+
+   memcpy(ptr, userdata->data + userdata->pos, n);
+   userdata->pos += n;
+   return n;
+}
+
+
+static size_t file_pack_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size)
+{
+   (void)f;
+   (void)ptr;
+   (void)size;
+
+   al_set_errno(EBADF);
+   return 0;
+}
+
+
+static bool file_pack_fflush(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return true;
+}
+
+
+static int64_t file_pack_ftell(ALLEGRO_FILE *f)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+
+   return userdata->pos;
+}
+
+
+static bool file_pack_fseek(ALLEGRO_FILE *f, int64_t offset, int whence)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+   int64_t pos;
+
+   switch (whence) {
+      case ALLEGRO_SEEK_SET: pos = offset; break;
+      case ALLEGRO_SEEK_CUR: pos = userdata->pos + offset; break;
+      case ALLEGRO_SEEK_END: pos = userdata->size + offset; break;
+      default:
+         al_set_errno(EINVAL);
+         return false;
+   }
+
+   if (pos < 0) {
+      al_set_errno(EINVAL);
+      return false;
+   }
+
+   userdata->pos = pos;
+   userdata->eof = false;
+   return true;
+}
+
+
+static bool file_pack_feof(ALLEGRO_FILE *f)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+
+   return userdata->eof;
+}
+
+
+static int file_pack_ferror(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return 0;
+}
+
+
+static const char *file_pack_ferrmsg(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return "";
+}
+
+
+static void file_pack_fclearerr(ALLEGRO_FILE *f)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+
+   userdata->eof = false;
+}
+
+
+static off_t file_pack_fsize(ALLEGRO_FILE *f)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+
+   return userdata->size;
+}
+
+
+static const void *file_pack_fview(ALLEGRO_FILE *f, int64_t offset,
+   size_t *size)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+
+   if (offset > userdata->size) {
+      *size = 0;
+      return NULL;
+   }
+
+   if (userdata->size - offset < (int64_t)*size)
+      *size = userdata->size - offset;
+
+   return userdata->data + offset;
+}
+
+
+static size_t file_pack_ffill(ALLEGRO_FILE *f)
+{
+   USERDATA *userdata = al_get_file_userdata(f);
+   size_t n;
+
+   if (userdata->pos >= userdata->size) {
+      userdata->eof = true;
+      return 0;
+   }
+
+   n = userdata->size - userdata->pos;
+   f->window_pos = userdata->data + userdata->pos;
+   f->window_end = f->window_pos + n;
+   userdata->pos = userdata->size;
+   return n;
+}
+
+
+const struct ALLEGRO_FILE_INTERFACE _al_file_interface_pack =
+{
+   file_pack_fopen,
+   file_pack_fclose,
+   file_pack_fread,
+   file_pack_fwrite,
+   file_pack_fflush,
+   file_pack_ftell,
+   file_pack_fseek,
+   file_pack_feof,
+   file_pack_ferror,
+   file_pack_ferrmsg,
+   file_pack_fclearerr,
+   NULL,    /* ungetc */
+   file_pack_fsize
+};
+
+
+const _AL_FILE_EXTENSION _al_file_extension_pack =
+{
+   file_pack_fview,
+   file_pack_ffill
+};
+
+
+/* Function: al_fopen_pack
+ */
+ALLEGRO_FILE *al_fopen_pack(ALLEGRO_PACK *pack, const char *path)
+{
+   char buf[PACK_MAX_PATH];
+   ALLEGRO_FILE *f;
+   PACK_ENTRY e;
+   void *userdata;
+   int len;
+   ASSERT(pack);
+   ASSERT(path);
+
+   len = normalise_path("", path, buf);
+   if (len < 0) {
+      al_set_errno(ENAMETOOLONG);
+      return NULL;
+   }
+   if (!find_entry(pack, buf, len, &e)) {
+      al_set_errno(ENOENT);
+      return NULL;
+   }
+
+   userdata = file_pack_open_entry(pack, &e);
+   if (!userdata)
+      return NULL;
+
+   f = al_create_file_handle(&_al_file_interface_pack, userdata);
+   if (!f) {
+      al_set_errno(ENOMEM);
+      free_userdata(userdata);
+   }
+   return f;
+}
+
+
+/*
+ * File system interface over the mounted packs.
+ */
+
+
+static ALLEGRO_FS_ENTRY *fs_pack_create_entry_normalised(const char *path,
+   int len)
+{
+   ALLEGRO_FS_ENTRY_PACK *e;
+   unsigned int i;
+
+   e = al_calloc(1, sizeof *e);
+   if (!e) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+   e->fs_entry.vtable = &fs_pack_vtable;
+   e->path = al_malloc(len + 1);
+   e->name = al_malloc(len + 2);
+   if (!e->path || !e->name) {
+      al_free(e->path);
+      al_free(e->name);
+      al_free(e);
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+   memcpy(e->path, path, len + 1);
+   e->name[0] = '/';
+   memcpy(e->name + 1, path, len + 1);
+
+   al_lock_mutex(mounted_mutex);
+   i = find_mounted(path, len, &e->entry);
+   if (i > 0)
+      e->pack = *(ALLEGRO_PACK **)_al_vector_ref(&mounted, i - 1);
+   al_unlock_mutex(mounted_mutex);
+
+   return &e->fs_entry;
+}
+
+
+static ALLEGRO_FS_ENTRY *fs_pack_create_entry(const char *path)
+{
+   char buf[PACK_MAX_PATH];
+   int len;
+
+   len = normalise_path(pack_cwd, path, buf);
+   if (len < 0) {
+      al_set_errno(ENAMETOOLONG);
+      return NULL;
+   }
+
+   return fs_pack_create_entry_normalised(buf, len);
+}
+
+
+static bool fs_pack_close_directory(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_PACK *e = (ALLEGRO_FS_ENTRY_PACK *)fse;
+
+   e->is_dir_open = false;
+   return true;
+}
+
+
+static void fs_pack_destroy_entry(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_PACK *e = (ALLEGRO_FS_ENTRY_PACK *)fse;
+
+   al_free(e->path);
+   al_free(e->name);
+   al_free(e);
+}
+
+
+static const char *fs_pack_entry_name(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_PACK *e = (ALLEGRO_FS_ENTRY_PACK *)fse;
+
+   return e->name;
+}
+
+
+static bool fs_pack_update_entry(ALLEGRO_FS_ENTRY *fse)
+{
+   (void)fse;
+   return true;
+}
+
+
+static bool is_root(ALLEGRO_FS_ENTRY_PACK *e)
+{
+   return e->path[0] == '\0';
+}
+
+
+static uint32_t fs_pack_entry_mode(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_PACK *e = (ALLEGRO_FS_ENTRY_PACK *)fse;
+
+   if (is_root(e) || (e->pack && (e->entry.flags & PACK_FLAG_DIR)))
+      return ALLEGRO_FILEMODE_READ | ALLEGRO_FILEMODE_ISDIR |
+         ALLEGRO_FILEMODE_EXECUTE;
+   if (e->pack)
+      return ALLEGRO_FILEMODE_READ | ALLEGRO_FILEMODE_ISFILE;
+   return 0;
+}
+
+
+static time_t fs_pack_entry_time(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_PACK *e = (ALLEGRO_FS_ENTRY_PACK *)fse;
+
+   return e->pack ? e->pack->mtime : 0;
+}
+
+
+static off_t fs_pack_entry_size(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_PACK *e = (ALLEGRO_FS_ENTRY_PACK *)fse;
+
+   return e->pack ? (off_t)e->entry.size : 0;
+}
+
+
+static bool fs_pack_entry_exists(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_PACK *e = (ALLEGRO_FS_ENTRY_PACK *)fse;
+
+   return is_root(e) || e->pack != NULL;
+}
+
+
+static bool fs_pack_remove_entry(ALLEGRO_FS_ENTRY *fse)
+{
+   (void)fse;
+   al_set_errno(EPERM);
+   return false;
+}
+
+
+static bool fs_pack_open_directory(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_PACK *e = (ALLEGRO_FS_ENTRY_PACK *)fse;
+
+   if (!(fs_pack_entry_mode(fse) & ALLEGRO_FILEMODE_ISDIR)) {
+      al_set_errno(ENOTDIR);
+      return false;
+   }
+
+   al_lock_mutex(mounted_mutex);
+   e->dir_pack = _al_vector_size(&mounted);
+   al_unlock_mutex(mounted_mutex);
+   e->dir_entry = 0;
+   e->is_dir_open = true;
+   return true;
+}
+
+
+static bool is_child(const char *dir, size_t dir_len, const PACK_ENTRY *e)
+{
+   const char *rest = e->name;
+
+   if (dir_len > 0) {
+      if (e->name_length <= dir_len + 1 || memcmp(e->name, dir, dir_len) != 0
+            || e->name[dir_len] != '/')
+         return false;
+      rest += dir_len + 1;
+   }
+
+   return strchr(rest, '/') == NULL;
+}
+
+
+/* Directories are not indexed by their contents, so listing one scans the
+ * entries of every mounted pack.  Entries shadowed by a later pack are
+ * skipped.
+ */
+static ALLEGRO_FS_ENTRY *fs_pack_read_directory(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_PACK *e = (ALLEGRO_FS_ENTRY_PACK *)fse;
+   size_t dir_len = strlen(e->path);
+   PACK_ENTRY entry, shadow;
+   bool found = false;
+
+   if (!e->is_dir_open)
+      return NULL;
+
+   al_lock_mutex(mounted_mutex);
+   if (e->dir_pack > _al_vector_size(&mounted))
+      e->dir_pack = 0;
+
+   while (!found && e->dir_pack > 0) {
+      ALLEGRO_PACK *pack =
+         *(ALLEGRO_PACK **)_al_vector_ref(&mounted, e->dir_pack - 1);
+
+      while (e->dir_entry < pack->num_entries) {
+         read_entry(pack, e->dir_entry++, &entry);
+         if (is_child(e->path, dir_len, &entry) &&
+               find_mounted(entry.name, entry.name_length, &shadow)
+                  == e->dir_pack) {
+            found = true;
+            break;
+         }
+      }
+
+      if (!found) {
+         e->dir_pack--;
+         e->dir_entry = 0;
+      }
+   }
+   al_unlock_mutex(mounted_mutex);
+
+   if (!found)
+      return NULL;
+
+   return fs_pack_create_entry_normalised(entry.name, entry.name_length);
+}
+
+
+static bool fs_pack_filename_exists(const char *path)
+{
+   ALLEGRO_FS_ENTRY *e = fs_pack_create_entry(path);
+   bool ret;
+
+   if (!e)
+      return false;
+   ret = fs_pack_entry_exists(e);
+   fs_pack_destroy_entry(e);
+   return ret;
+}
+
+
+static bool fs_pack_remove_filename(const char *path)
+{
+   (void)path;
+   al_set_errno(EPERM);
+   return false;
+}
+
+
+static char *fs_pack_get_current_directory(void)
+{
+   size_t size = strlen(pack_cwd) + 2;
+   char *s = al_malloc(size);
+
+   if (s) {
+      s[0] = '/';
+      memcpy(s + 1, pack_cwd, size - 1);
+   }
+   return s;
+}
+
+
+static bool fs_pack_change_directory(const char *path)
+{
+   ALLEGRO_FS_ENTRY *e = fs_pack_create_entry(path);
+   bool ret = false;
+
+   if (e) {
+      if (fs_pack_entry_mode(e) & ALLEGRO_FILEMODE_ISDIR) {
+         /* The normalised path always fits. */
+         strcpy(pack_cwd, ((ALLEGRO_FS_ENTRY_PACK *)e)->path);
+         ret = true;
+      }
+      fs_pack_destroy_entry(e);
+   }
+   return ret;
+}
+
+
+static bool fs_pack_make_directory(const char *path)
+{
+   (void)path;
+   al_set_errno(EPERM);
+   return false;
+}
+
+
+static ALLEGRO_FILE *fs_pack_open_file(ALLEGRO_FS_ENTRY *fse,
+   const char *mode)
+{
+   ALLEGRO_FS_ENTRY_PACK *e = (ALLEGRO_FS_ENTRY_PACK *)fse;
+   ALLEGRO_FILE *f;
+   void *userdata;
+
+   if (strpbrk(mode, "wWaA+")) {
+      al_set_errno(EPERM);
+      return NULL;
+   }
+   if (!e->pack) {
+      al_set_errno(ENOENT);
+      return NULL;
+   }
+
+   userdata = file_pack_open_entry(e->pack, &e->entry);
+   if (!userdata)
+      return NULL;
+
+   f = al_create_file_handle(&_al_file_interface_pack, userdata);
+   if (!f) {
+      al_set_errno(ENOMEM);
+      free_userdata(userdata);
+   }
+   return f;
+}
+
+
+static const ALLEGRO_FS_INTERFACE fs_pack_vtable =
+{
+   fs_pack_create_entry,
+   fs_pack_destroy_entry,
+   fs_pack_entry_name,
+   fs_pack_update_entry,
+   fs_pack_entry_mode,
+   fs_pack_entry_time,
+   fs_pack_entry_time,
+   fs_pack_entry_time,
+   fs_pack_entry_size,
+   fs_pack_entry_exists,
+   fs_pack_remove_entry,
+
+   fs_pack_open_directory,
+   fs_pack_read_directory,
+   fs_pack_close_directory,
+
+   fs_pack_filename_exists,
+   fs_pack_remove_filename,
+   fs_pack_get_current_directory,
+   fs_pack_change_directory,
+   fs_pack_make_directory,
+
+   fs_pack_open_file
+};
+
+
+/* Function: al_set_pack_file_interface
+ */
+void al_set_pack_file_interface(void)
+{
+   al_set_new_file_interface(&_al_file_interface_pack);
+   al_set_fs_interface(&fs_pack_vtable);
+}
+
+
+static void shutdown_packs(void)
+{
+   _al_vector_free(&mounted);
+   al_destroy_mutex(mounted_mutex);
+   mounted_mutex = NULL;
+   pack_cwd[0] = '\0';
+}
+
+
+void _al_init_packs(void)
+{
+   mounted_mutex = al_create_mutex();
+   _al_add_exit_func(shutdown_packs, "shutdown_packs");
+}
+
+
+/* vim: set sts=3 sw=3 et: */
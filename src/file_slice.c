@@ -15,6 +15,7 @@
  */
 
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern_file.h"
 
 typedef struct SLICE_DATA SLICE_DATA;
 
@@ -183,7 +184,23 @@ static off_t slice_fsize(ALLEGRO_FILE *f)
    return slice->size;
 }
 
-static const ALLEGRO_FILE_INTERFACE fi =
+/* Views into the parent file are views into the slice, too. */
+static const void *slice_fview(ALLEGRO_FILE *f, int64_t offset, size_t *size)
+{
+   SLICE_DATA *slice = al_get_file_userdata(f);
+
+   if (!(slice->mode & SLICE_READ) || offset > (int64_t)slice->size) {
+      *size = 0;
+      return NULL;
+   }
+
+   if (slice->size - offset < *size)
+      *size = slice->size - offset;
+
+   return al_fview(slice->fp, slice->anchor + offset, size);
+}
+
+const ALLEGRO_FILE_INTERFACE _al_file_interface_slice =
 {
    NULL,
    slice_fclose,
@@ -200,11 +217,18 @@ static const ALLEGRO_FILE_INTERFACE fi =
    slice_fsize
 };
 
+const _AL_FILE_EXTENSION _al_file_extension_slice =
+{
+   slice_fview,
+   NULL     /* fill */
+};
+
 /* Function: al_fopen_slice
  */
 ALLEGRO_FILE *al_fopen_slice(ALLEGRO_FILE *fp, size_t initial_size, const char *mode)
 {
    SLICE_DATA *userdata = al_calloc(1, sizeof(*userdata));
+   ALLEGRO_FILE *f;
    
    if (!userdata) {
       return NULL;
@@ -226,6 +250,11 @@ ALLEGRO_FILE *al_fopen_slice(ALLEGRO_FILE *fp, size_t initial_size, const char *
    userdata->anchor = al_ftell(fp);
    userdata->size = initial_size;
    
-   return al_create_file_handle(&fi, userdata);
+   f = al_create_file_handle(&_al_file_interface_slice, userdata);
+   if (!f) {
+      al_free(userdata);
+   }
+
+   return f;
 }
 
@@ -47,12 +47,17 @@ const struct ALLEGRO_FILE_INTERFACE _al_file_interface_stdio;
 #define PATH_MAX 4096
 #endif
 
+/* Size of the chunks handed to the generic read window. */
+#define WINDOW_SIZE  16384
+
 
 typedef struct
 {
    FILE *fp;
    int errnum;
    char errmsg[80];
+   bool can_window;
+   unsigned char *window;
 } USERDATA;
 
 
@@ -65,6 +70,25 @@ static USERDATA *get_userdata(ALLEGRO_FILE *f)
 }
 
 
+/* The read window is rewound with a relative seek, so it is only usable on
+ * readable, seekable streams without newline translation.
+ */
+static bool want_window(FILE *fp, const char *mode)
+{
+#ifdef ALLEGRO_WINDOWS
+   if (!strchr(mode, 'b'))
+      return false;
+#endif
+   if (!strpbrk(mode, "r+"))
+      return false;
+#ifdef ALLEGRO_HAVE_FTELLO
+   return ftello(fp) != -1;
+#else
+   return ftell(fp) != -1;
+#endif
+}
+
+
 /* Function: al_fopen_fd
  */
 ALLEGRO_FILE *al_fopen_fd(int fd, const char *mode)
@@ -82,6 +106,8 @@ ALLEGRO_FILE *al_fopen_fd(int fd, const char *mode)
     */
    userdata->fp = NULL;
    userdata->errnum = 0;
+   userdata->can_window = false;
+   userdata->window = NULL;
 
    f = al_create_file_handle(&_al_file_interface_stdio, userdata);
    if (!f) {
@@ -97,6 +123,7 @@ ALLEGRO_FILE *al_fopen_fd(int fd, const char *mode)
    }
 
    userdata->fp = fp;
+   userdata->can_window = want_window(fp, mode);
    return f;
 }
 
@@ -133,6 +160,8 @@ static void *file_stdio_fopen(const char *path, const char *mode)
 
    userdata->fp = fp;
    userdata->errnum = 0;
+   userdata->can_window = want_window(fp, mode);
+   userdata->window = NULL;
 
    return userdata;
 }
@@ -155,6 +184,7 @@ static bool file_stdio_fclose(ALLEGRO_FILE *f)
       ret = false;
    }
 
+   al_free(userdata->window);
    al_free(userdata);
 
    return ret;
@@ -357,6 +387,40 @@ static off_t file_stdio_fsize(ALLEGRO_FILE *f)
 }
 
 
+static size_t file_stdio_ffill(ALLEGRO_FILE *f)
+{
+   USERDATA *userdata = get_userdata(f);
+   size_t n;
+
+   if (!userdata->can_window)
+      return 0;
+
+   if (!userdata->window) {
+      userdata->window = al_malloc(WINDOW_SIZE);
+      if (!userdata->window) {
+         userdata->can_window = false;
+         return 0;
+      }
+   }
+
+   n = fread(userdata->window, 1, WINDOW_SIZE, userdata->fp);
+   if (n < WINDOW_SIZE) {
+      if (ferror(userdata->fp)) {
+         userdata->errnum = errno;
+         al_set_errno(errno);
+      }
+      else if (n > 0) {
+         /* The caller has not read past the end yet. */
+         clearerr(userdata->fp);
+      }
+   }
+
+   f->window_pos = userdata->window;
+   f->window_end = userdata->window + n;
+   return n;
+}
+
+
 const struct ALLEGRO_FILE_INTERFACE _al_file_interface_stdio =
 {
    file_stdio_fopen,
@@ -375,6 +439,13 @@ const struct ALLEGRO_FILE_INTERFACE _al_file_interface_stdio =
 };
 
 
+const _AL_FILE_EXTENSION _al_file_extension_stdio =
+{
+   NULL,
+   file_stdio_ffill
+};
+
+
 /* Function: al_set_standard_file_interface
  */
 void al_set_standard_file_interface(void)
@@ -19,7 +19,10 @@
 */
 
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_fshook.h"
+#include "allegro5/internal/aintern_thread.h"
+#include "allegro5/internal/aintern_vector.h"
 
 
 
@@ -273,6 +276,271 @@ int al_for_each_fs_entry(ALLEGRO_FS_ENTRY *dir,
 }
 
 
+#define WALK_BATCH_SIZE       256
+#define WALK_MAX_THREADS      8
+
+typedef struct WALK_STATE WALK_STATE;
+
+struct WALK_STATE
+{
+   int flags;
+   int (*callback)(ALLEGRO_FS_ENTRY **entries, int num_entries, void *extra);
+   void *extra;
+   ALLEGRO_FS_ENTRY *root;
+
+   /* Only used by parallel walks. */
+   ALLEGRO_MUTEX *mutex;
+   ALLEGRO_COND *cond;
+   _AL_VECTOR queue;       /* directories still to be read */
+   int busy;               /* threads reading a directory */
+   int result;
+};
+
+
+static int walk_directory(WALK_STATE *state, ALLEGRO_FS_ENTRY *dir);
+
+
+static bool walk_stopped(WALK_STATE *state)
+{
+   bool ret = false;
+
+   if (state->mutex) {
+      al_lock_mutex(state->mutex);
+      ret = (state->result != ALLEGRO_FOR_EACH_FS_ENTRY_OK);
+      al_unlock_mutex(state->mutex);
+   }
+   return ret;
+}
+
+
+/* Hand a batch to the callback, then descend into its directories: directly
+ * for serial walks, through the queue for parallel ones.  Entries which are
+ * queued are owned by the queue afterwards and removed from the batch.
+ */
+static int walk_batch(WALK_STATE *state, ALLEGRO_FS_ENTRY **batch, int n)
+{
+   int result;
+   int i;
+
+   if (state->flags & ALLEGRO_FOR_EACH_FS_ENTRY_STAT) {
+      for (i = 0; i < n; i++)
+         al_update_fs_entry(batch[i]);
+   }
+
+   result = state->callback(batch, n, state->extra);
+   if (result != ALLEGRO_FOR_EACH_FS_ENTRY_OK)
+      return result;
+
+   for (i = 0; i < n; i++) {
+      if (!(_al_get_fs_entry_type(batch[i]) & ALLEGRO_FILEMODE_ISDIR))
+         continue;
+
+      if (state->mutex) {
+         ALLEGRO_FS_ENTRY **slot;
+         al_lock_mutex(state->mutex);
+         slot = _al_vector_alloc_back(&state->queue);
+         if (!slot) {
+            /* Stop the whole walk rather than silently miss a subtree. */
+            if (state->result == ALLEGRO_FOR_EACH_FS_ENTRY_OK)
+               state->result = ALLEGRO_FOR_EACH_FS_ENTRY_ERROR;
+            al_broadcast_cond(state->cond);
+            al_unlock_mutex(state->mutex);
+            al_set_errno(ENOMEM);
+            return ALLEGRO_FOR_EACH_FS_ENTRY_ERROR;
+         }
+         *slot = batch[i];
+         batch[i] = NULL;
+         al_signal_cond(state->cond);
+         al_unlock_mutex(state->mutex);
+      }
+      else {
+         result = walk_directory(state, batch[i]);
+         if (result != ALLEGRO_FOR_EACH_FS_ENTRY_OK)
+            return result;
+      }
+   }
+
+   return ALLEGRO_FOR_EACH_FS_ENTRY_OK;
+}
+
+
+static int walk_directory(WALK_STATE *state, ALLEGRO_FS_ENTRY *dir)
+{
+   ALLEGRO_FS_ENTRY *batch[WALK_BATCH_SIZE];
+   ALLEGRO_FS_ENTRY *entry;
+   int result = ALLEGRO_FOR_EACH_FS_ENTRY_OK;
+   int n = 0;
+   int i;
+
+   if (!al_open_directory(dir)) {
+      al_set_errno(ENOENT);
+      return ALLEGRO_FOR_EACH_FS_ENTRY_ERROR;
+   }
+
+   for (;;) {
+      entry = al_read_directory(dir);
+      if (entry)
+         batch[n++] = entry;
+
+      if (n > 0 && (n == WALK_BATCH_SIZE || !entry)) {
+         result = walk_batch(state, batch, n);
+         for (i = 0; i < n; i++)
+            al_destroy_fs_entry(batch[i]);
+         n = 0;
+         /* Skipping a batch only skips its subdirectories. */
+         if (result == ALLEGRO_FOR_EACH_FS_ENTRY_SKIP)
+            result = ALLEGRO_FOR_EACH_FS_ENTRY_OK;
+         if (result != ALLEGRO_FOR_EACH_FS_ENTRY_OK || walk_stopped(state))
+            break;
+      }
+
+      if (!entry)
+         break;
+   }
+
+   al_close_directory(dir);
+   return result;
+}
+
+
+static void walk_worker(WALK_STATE *state)
+{
+   ALLEGRO_FS_ENTRY *dir;
+   int result;
+
+   al_lock_mutex(state->mutex);
+   for (;;) {
+      while (_al_vector_is_empty(&state->queue) && state->busy > 0 &&
+            state->result == ALLEGRO_FOR_EACH_FS_ENTRY_OK) {
+         al_wait_cond(state->cond, state->mutex);
+      }
+      if (_al_vector_is_empty(&state->queue) ||
+            state->result != ALLEGRO_FOR_EACH_FS_ENTRY_OK) {
+         break;
+      }
+
+      dir = *(ALLEGRO_FS_ENTRY **)_al_vector_ref_back(&state->queue);
+      _al_vector_delete_at(&state->queue, _al_vector_size(&state->queue) - 1);
+      state->busy++;
+      al_unlock_mutex(state->mutex);
+
+      result = walk_directory(state, dir);
+      if (dir != state->root)
+         al_destroy_fs_entry(dir);
+
+      al_lock_mutex(state->mutex);
+      state->busy--;
+      if (result != ALLEGRO_FOR_EACH_FS_ENTRY_OK &&
+            state->result == ALLEGRO_FOR_EACH_FS_ENTRY_OK) {
+         state->result = result;
+      }
+   }
+   /* Wake up the others so that they notice the end too. */
+   al_broadcast_cond(state->cond);
+   al_unlock_mutex(state->mutex);
+}
+
+
+static void *walk_thread_proc(ALLEGRO_THREAD *thread, void *arg)
+{
+   (void)thread;
+   walk_worker(arg);
+   return NULL;
+}
+
+
+static int walk_parallel(WALK_STATE *state)
+{
+   ALLEGRO_THREAD *threads[WALK_MAX_THREADS];
+   ALLEGRO_FS_ENTRY **slot;
+   int num_threads;
+   int i;
+
+   state->mutex = al_create_mutex();
+   state->cond = al_create_cond();
+   _al_vector_init(&state->queue, sizeof(ALLEGRO_FS_ENTRY *));
+   state->busy = 0;
+   state->result = ALLEGRO_FOR_EACH_FS_ENTRY_OK;
+
+   slot = NULL;
+   if (state->mutex && state->cond)
+      slot = _al_vector_alloc_back(&state->queue);
+   if (!slot) {
+      /* Could not set up the shared state; walk on this thread instead. */
+      _al_vector_free(&state->queue);
+      al_destroy_cond(state->cond);
+      al_destroy_mutex(state->mutex);
+      state->cond = NULL;
+      state->mutex = NULL;
+      return walk_directory(state, state->root);
+   }
+   *slot = state->root;
+
+   num_threads = al_get_cpu_count() - 1;
+   if (num_threads > WALK_MAX_THREADS)
+      num_threads = WALK_MAX_THREADS;
+   for (i = 0; i < num_threads; i++) {
+      threads[i] = al_create_thread(walk_thread_proc, state);
+      if (!threads[i]) {
+         num_threads = i;
+         break;
+      }
+      al_start_thread(threads[i]);
+   }
+
+   /* The calling thread works, too. */
+   walk_worker(state);
+
+   for (i = 0; i < num_threads; i++) {
+      al_join_thread(threads[i], NULL);
+      al_destroy_thread(threads[i]);
+   }
+
+   /* Left over after a stop. */
+   while (_al_vector_is_nonempty(&state->queue)) {
+      ALLEGRO_FS_ENTRY *dir =
+         *(ALLEGRO_FS_ENTRY **)_al_vector_ref_back(&state->queue);
+      _al_vector_delete_at(&state->queue, _al_vector_size(&state->queue) - 1);
+      if (dir != state->root)
+         al_destroy_fs_entry(dir);
+   }
+   _al_vector_free(&state->queue);
+   al_destroy_cond(state->cond);
+   al_destroy_mutex(state->mutex);
+
+   return state->result;
+}
+
+
+/* Function: al_for_each_fs_entry_batch
+ */
+int al_for_each_fs_entry_batch(ALLEGRO_FS_ENTRY *dir, int flags,
+   int (*callback)(ALLEGRO_FS_ENTRY **entries, int num_entries, void *extra),
+   void *extra)
+{
+   WALK_STATE state;
+   int result;
+
+   if (!dir) {
+      al_set_errno(ENOENT);
+      return ALLEGRO_FOR_EACH_FS_ENTRY_ERROR;
+   }
+
+   memset(&state, 0, sizeof(state));
+   state.flags = flags;
+   state.callback = callback;
+   state.extra = extra;
+   state.root = dir;
+
+   if (flags & ALLEGRO_FOR_EACH_FS_ENTRY_PARALLEL)
+      result = walk_parallel(&state);
+   else
+      result = walk_directory(&state, dir);
+
+   return result;
+}
+
+
 
 
 /*
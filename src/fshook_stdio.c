@@ -142,6 +142,10 @@ struct ALLEGRO_FS_ENTRY_STDIO
    #define ABS_PATH_UTF8   abs_path
 #endif
    uint32_t stat_mode;
+   /* Entries read from a directory whose type was known from the
+    * directory listing are only stat()ed when an attribute is requested.
+    */
+   bool stat_pending;
    WRAP_STAT_TYPE st;
    WRAP_DIR_TYPE *dir;
 };
@@ -227,7 +231,16 @@ static WRAP_CHAR *make_absolute_path(const char *tail)
 }
 
 
-static ALLEGRO_FS_ENTRY *create_abs_path_entry(const WRAP_CHAR *abs_path)
+#if defined(ALLEGRO_UNIX) || defined(ALLEGRO_MACOSX)
+static bool unix_hidden_file(const char *path);
+#endif
+
+
+/* If `type` is 0 the entry is stat()ed straight away, otherwise it is
+ * taken as the ISDIR or ISFILE bit and the stat is deferred.
+ */
+static ALLEGRO_FS_ENTRY *create_entry(const WRAP_CHAR *abs_path,
+   uint32_t type)
 {
    ALLEGRO_FS_ENTRY_STDIO *fh;
    size_t len;
@@ -257,6 +270,16 @@ static ALLEGRO_FS_ENTRY *create_abs_path_entry(const WRAP_CHAR *abs_path)
    }
 #endif
 
+   if (type) {
+      fh->stat_mode = type;
+#if defined(ALLEGRO_UNIX) || defined(ALLEGRO_MACOSX)
+      if (unix_hidden_file(fh->abs_path))
+         fh->stat_mode |= ALLEGRO_FILEMODE_HIDDEN;
+#endif
+      fh->stat_pending = true;
+      return (ALLEGRO_FS_ENTRY *) fh;
+   }
+
    ALLEGRO_DEBUG("Creating entry for %s\n", fh->ABS_PATH_UTF8);
 
    fs_stdio_update_entry((ALLEGRO_FS_ENTRY *) fh);
@@ -265,6 +288,27 @@ static ALLEGRO_FS_ENTRY *create_abs_path_entry(const WRAP_CHAR *abs_path)
 }
 
 
+static ALLEGRO_FS_ENTRY *create_abs_path_entry(const WRAP_CHAR *abs_path)
+{
+   return create_entry(abs_path, 0);
+}
+
+
+static ALLEGRO_FS_ENTRY_STDIO *stat_entry(ALLEGRO_FS_ENTRY *fp)
+{
+   ALLEGRO_FS_ENTRY_STDIO *fp_stdio = (ALLEGRO_FS_ENTRY_STDIO *) fp;
+
+   if (fp_stdio->stat_pending) {
+      if (!fs_stdio_update_entry(fp)) {
+         /* Keep the type from the directory listing, and do not retry. */
+         fp_stdio->stat_pending = false;
+      }
+   }
+
+   return fp_stdio;
+}
+
+
 static ALLEGRO_FS_ENTRY *fs_stdio_create_entry(const char *orig_path)
 {
    ALLEGRO_FS_ENTRY *ret = NULL;
@@ -354,6 +398,7 @@ static bool fs_stdio_update_entry(ALLEGRO_FS_ENTRY *fp)
       return false;
    }
 
+   fp_stdio->stat_pending = false;
    fs_update_stat_mode(fp_stdio);
 
    return true;
@@ -444,7 +489,17 @@ static ALLEGRO_FS_ENTRY *fs_stdio_read_directory(ALLEGRO_FS_ENTRY *fp)
       buf[abs_path_len] = ALLEGRO_NATIVE_PATH_SEP;
       memcpy(buf + abs_path_len + 1, ent->d_name, ent_name_len);
       buf[abs_path_len + 1 + ent_name_len] = '\0';
-      ret = create_abs_path_entry(buf);
+#ifdef DT_DIR
+      /* Symbolic links and file systems which do not report the type
+       * still need a stat().
+       */
+      if (ent->d_type == DT_DIR)
+         ret = create_entry(buf, ALLEGRO_FILEMODE_ISDIR);
+      else if (ent->d_type == DT_REG)
+         ret = create_entry(buf, ALLEGRO_FILEMODE_ISFILE);
+      else
+#endif
+         ret = create_abs_path_entry(buf);
       al_free(buf);
    }
 #endif
@@ -470,40 +525,45 @@ static void fs_stdio_destroy_entry(ALLEGRO_FS_ENTRY *fh_)
 
 static off_t fs_stdio_entry_size(ALLEGRO_FS_ENTRY *fp)
 {
-   ALLEGRO_FS_ENTRY_STDIO *ent = (ALLEGRO_FS_ENTRY_STDIO *) fp;
-   ASSERT(ent);
+   ALLEGRO_FS_ENTRY_STDIO *ent;
+   ASSERT(fp);
+   ent = stat_entry(fp);
    return ent->st.st_size;
 }
 
 
 static uint32_t fs_stdio_entry_mode(ALLEGRO_FS_ENTRY *fp)
 {
-   ALLEGRO_FS_ENTRY_STDIO *ent = (ALLEGRO_FS_ENTRY_STDIO *) fp;
-   ASSERT(ent);
+   ALLEGRO_FS_ENTRY_STDIO *ent;
+   ASSERT(fp);
+   ent = stat_entry(fp);
    return ent->stat_mode;
 }
 
 
 static time_t fs_stdio_entry_atime(ALLEGRO_FS_ENTRY *fp)
 {
-   ALLEGRO_FS_ENTRY_STDIO *ent = (ALLEGRO_FS_ENTRY_STDIO *) fp;
-   ASSERT(ent);
+   ALLEGRO_FS_ENTRY_STDIO *ent;
+   ASSERT(fp);
+   ent = stat_entry(fp);
    return ent->st.st_atime;
 }
 
 
 static time_t fs_stdio_entry_mtime(ALLEGRO_FS_ENTRY *fp)
 {
-   ALLEGRO_FS_ENTRY_STDIO *ent = (ALLEGRO_FS_ENTRY_STDIO *) fp;
-   ASSERT(ent);
+   ALLEGRO_FS_ENTRY_STDIO *ent;
+   ASSERT(fp);
+   ent = stat_entry(fp);
    return ent->st.st_mtime;
 }
 
 
 static time_t fs_stdio_entry_ctime(ALLEGRO_FS_ENTRY *fp)
 {
-   ALLEGRO_FS_ENTRY_STDIO *ent = (ALLEGRO_FS_ENTRY_STDIO *) fp;
-   ASSERT(ent);
+   ALLEGRO_FS_ENTRY_STDIO *ent;
+   ASSERT(fp);
+   ent = stat_entry(fp);
    return ent->st.st_ctime;
 }
 
@@ -712,6 +772,19 @@ static bool fs_stdio_remove_filename(const char *path)
 }
 
 
+uint32_t _al_get_fs_entry_type(ALLEGRO_FS_ENTRY *fp)
+{
+   if (fp->vtable == &_al_fs_interface_stdio) {
+      ALLEGRO_FS_ENTRY_STDIO *fp_stdio = (ALLEGRO_FS_ENTRY_STDIO *) fp;
+      return fp_stdio->stat_mode &
+         (ALLEGRO_FILEMODE_ISDIR | ALLEGRO_FILEMODE_ISFILE);
+   }
+
+   return al_get_fs_entry_mode(fp) &
+      (ALLEGRO_FILEMODE_ISDIR | ALLEGRO_FILEMODE_ISFILE);
+}
+
+
 static const char *fs_stdio_name(ALLEGRO_FS_ENTRY *fp)
 {
    ALLEGRO_FS_ENTRY_STDIO *fp_stdio = (ALLEGRO_FS_ENTRY_STDIO *) fp;
@@ -33,8 +33,8 @@
    #include ALLEGRO_INTERNAL_HEADER
 #endif
 
-/* not used now */
-/* #include "allegro5/internal/aintern_atomicops.h" */
+#include "allegro5/internal/aintern_atomicops.h"
+#include "allegro5/internal/aintern_seqlock.h"
 
 #include "allegro5/internal/aintern_float.h"
 #include "allegro5/internal/aintern_vector.h"
@@ -0,0 +1,629 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Job system.
+ *
+ *      A fixed pool of worker threads, sized to the number of CPUs, runs
+ *      small jobs.  Each worker has its own deque: it pushes and pops jobs
+ *      at the bottom, and idle workers steal from the top of the others.
+ *      Jobs submitted from outside the pool go to a shared deque.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_atomicops.h"
+#include "allegro5/internal/aintern_events.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_thread.h"
+#include "allegro5/internal/aintern_tls.h"
+#include "allegro5/internal/aintern_vector.h"
+
+ALLEGRO_DEBUG_CHANNEL("jobs")
+
+
+#define MAX_WORKERS           64
+#define INITIAL_DEQUE_SIZE    64
+/* Ranges are split into about this many pieces per worker when no grain
+ * size is given.
+ */
+#define PIECES_PER_WORKER     4
+
+
+typedef struct JOB
+{
+   void (*proc)(void *arg);
+   void (*range_proc)(int begin, int end, void *arg);
+   void *arg;
+   int begin;
+   int end;
+   int grain;
+   ALLEGRO_JOB_COUNTER *counter;
+} JOB;
+
+
+/* A ring of jobs.  The owning worker pushes and pops at the bottom, so it
+ * works depth first on what it has just split off; everyone else takes
+ * from the top, getting the oldest and usually largest jobs.
+ */
+typedef struct JOB_DEQUE
+{
+   _AL_MUTEX mutex;
+   JOB *jobs;
+   unsigned int mask;            /* size - 1, size being a power of two */
+   volatile unsigned int top;
+   volatile unsigned int bottom;
+} JOB_DEQUE;
+
+
+struct ALLEGRO_JOB_COUNTER
+{
+   volatile _AL_ATOMIC pending;  /* jobs queued or running */
+   volatile _AL_ATOMIC finishing; /* threads inside finish_job */
+   _AL_MUTEX mutex;              /* guards continuations */
+   _AL_VECTOR continuations;     /* JOBs waiting for pending to drop to 0 */
+   ALLEGRO_EVENT_SOURCE es;
+};
+
+
+static _AL_MUTEX pool_mutex = _AL_MUTEX_UNINITED;
+static _AL_COND work_cond;       /* signalled when jobs are queued */
+static _AL_COND done_cond;       /* broadcast when a counter drops to 0 */
+static _AL_THREAD *workers;
+static int num_workers;
+/* One deque per worker, plus the shared deque at index num_workers. */
+static JOB_DEQUE *deques;
+static volatile bool workers_started;
+static volatile bool shutting_down;
+/* These three are updated atomically so that the common paths do not
+ * need pool_mutex.  A thread going to sleep increments its counter before
+ * looking at the other side's, and vice versa, so that no wakeup is lost.
+ */
+static volatile _AL_ATOMIC num_queued;
+static volatile _AL_ATOMIC num_sleeping;
+static volatile _AL_ATOMIC num_waiting;
+
+
+/* Returns the deque the calling thread pushes to. */
+static JOB_DEQUE *own_deque(void)
+{
+   int *worker = _al_tls_get_job_worker();
+
+   if (worker && *worker > 0)
+      return &deques[*worker - 1];
+   return &deques[num_workers];
+}
+
+
+static bool deque_push(JOB_DEQUE *deque, const JOB *job)
+{
+   unsigned int size;
+
+   _al_mutex_lock(&deque->mutex);
+
+   size = deque->jobs ? deque->mask + 1 : 0;
+   if (deque->bottom - deque->top == size) {
+      unsigned int new_size = size ? size * 2 : INITIAL_DEQUE_SIZE;
+      JOB *jobs = al_malloc(new_size * sizeof(JOB));
+      unsigned int i;
+
+      if (!jobs) {
+         _al_mutex_unlock(&deque->mutex);
+         return false;
+      }
+      for (i = 0; i < size; i++) {
+         jobs[i] = deque->jobs[(deque->top + i) & deque->mask];
+      }
+      al_free(deque->jobs);
+      deque->jobs = jobs;
+      deque->mask = new_size - 1;
+      deque->bottom -= deque->top;
+      deque->top = 0;
+   }
+
+   deque->jobs[deque->bottom & deque->mask] = *job;
+   deque->bottom++;
+
+   _al_mutex_unlock(&deque->mutex);
+   return true;
+}
+
+
+static bool deque_pop(JOB_DEQUE *deque, JOB *job, bool from_top)
+{
+   bool found = false;
+
+   /* Cheap check so that idle threads do not lock every deque. */
+   if (deque->top == deque->bottom)
+      return false;
+
+   _al_mutex_lock(&deque->mutex);
+   if (deque->top != deque->bottom) {
+      if (from_top) {
+         *job = deque->jobs[deque->top & deque->mask];
+         deque->top++;
+      }
+      else {
+         deque->bottom--;
+         *job = deque->jobs[deque->bottom & deque->mask];
+      }
+      found = true;
+   }
+   _al_mutex_unlock(&deque->mutex);
+
+   if (found)
+      _al_sub1_and_fetch(&num_queued);
+   return found;
+}
+
+
+static void wake_worker(void)
+{
+   if (num_sleeping > 0) {
+      _al_mutex_lock(&pool_mutex);
+      _al_cond_signal(&work_cond);
+      _al_mutex_unlock(&pool_mutex);
+   }
+}
+
+
+static bool start_workers(void);
+static void run_job(JOB *job);
+
+
+static void push_job(JOB *job)
+{
+   if (!workers_started && !start_workers()) {
+      /* No threads to run it; do the work here rather than losing it. */
+      run_job(job);
+      return;
+   }
+
+   /* Count the job before it becomes visible, otherwise a thief could
+    * take it and decrement num_queued below zero in between.
+    */
+   _al_fetch_and_add1(&num_queued);
+   if (!deque_push(own_deque(), job)) {
+      /* Out of memory; do the work here rather than losing it. */
+      _al_sub1_and_fetch(&num_queued);
+      run_job(job);
+      return;
+   }
+
+   wake_worker();
+}
+
+
+/* Takes a job for the calling thread, preferring its own deque. */
+static bool get_job(JOB *job)
+{
+   int *worker = _al_tls_get_job_worker();
+   int self = (worker && *worker > 0) ? *worker - 1 : num_workers;
+   int i;
+
+   if (!deques)
+      return false;
+   if (self < num_workers && deque_pop(&deques[self], job, false))
+      return true;
+   if (deque_pop(&deques[num_workers], job, true))
+      return true;
+   for (i = 1; i < num_workers; i++) {
+      if (deque_pop(&deques[(self + i) % num_workers], job, true))
+         return true;
+   }
+   if (self == num_workers && num_workers > 0)
+      return deque_pop(&deques[0], job, true);
+   return false;
+}
+
+
+static void counter_done(ALLEGRO_JOB_COUNTER *counter)
+{
+   ALLEGRO_EVENT event;
+   _AL_VECTOR ready;
+   unsigned int i;
+
+   /* Release the jobs which were waiting for this counter, unless new work
+    * was added to it in the meantime.  They are pushed after unlocking, as
+    * push_job may end up running a job here, which could add continuations
+    * to this same counter.
+    */
+   _al_vector_init(&ready, sizeof(JOB));
+   _al_mutex_lock(&counter->mutex);
+   if (counter->pending == 0) {
+      ready = counter->continuations;
+      _al_vector_init(&counter->continuations, sizeof(JOB));
+   }
+   _al_mutex_unlock(&counter->mutex);
+
+   for (i = 0; i < _al_vector_size(&ready); i++) {
+      push_job(_al_vector_ref(&ready, i));
+   }
+   _al_vector_free(&ready);
+
+   if (num_waiting > 0) {
+      _al_mutex_lock(&pool_mutex);
+      _al_cond_broadcast(&done_cond);
+      _al_mutex_unlock(&pool_mutex);
+   }
+
+   _al_event_source_lock(&counter->es);
+   if (_al_event_source_needs_to_generate_event(&counter->es)) {
+      event.job.type = ALLEGRO_EVENT_JOB_COUNTER_DONE;
+      event.job.timestamp = al_get_time();
+      event.job.counter = counter;
+      _al_event_source_emit_event(&counter->es, &event);
+   }
+   _al_event_source_unlock(&counter->es);
+}
+
+
+static void finish_job(ALLEGRO_JOB_COUNTER *counter)
+{
+   /* The counter may be destroyed as soon as pending reaches zero, so
+    * al_destroy_job_counter also waits for `finishing' to drop.
+    */
+   _al_fetch_and_add1(&counter->finishing);
+   if (_al_sub1_and_fetch(&counter->pending) == 0)
+      counter_done(counter);
+
+   /* The counter must not be touched once `finishing' drops to zero. */
+   if (_al_sub1_and_fetch(&counter->finishing) == 0 && num_waiting > 0) {
+      _al_mutex_lock(&pool_mutex);
+      _al_cond_broadcast(&done_cond);
+      _al_mutex_unlock(&pool_mutex);
+   }
+}
+
+
+static void run_job(JOB *job)
+{
+   if (job->range_proc) {
+      int begin = job->begin;
+      int end = job->end;
+
+      /* Hand off the upper half until the range is small enough.  Thieves
+       * take the large halves, so the range spreads out in few steps.
+       */
+      while (end - begin > job->grain) {
+         JOB half = *job;
+         int mid = begin + (end - begin) / 2;
+
+         half.begin = mid;
+         half.end = end;
+         if (half.counter)
+            _al_fetch_and_add1(&half.counter->pending);
+         push_job(&half);
+         end = mid;
+      }
+      job->range_proc(begin, end, job->arg);
+   }
+   else {
+      job->proc(job->arg);
+   }
+
+   if (job->counter)
+      finish_job(job->counter);
+}
+
+
+/* [worker threads] */
+static void job_worker_proc(_AL_THREAD *self, void *arg)
+{
+   JOB job;
+   int *worker;
+   (void)self;
+
+   worker = _al_tls_get_job_worker();
+   if (worker)
+      *worker = (int)(intptr_t)arg;
+
+   while (!shutting_down) {
+      if (get_job(&job)) {
+         run_job(&job);
+         continue;
+      }
+
+      _al_mutex_lock(&pool_mutex);
+      _al_fetch_and_add1(&num_sleeping);
+      while (num_queued == 0 && !shutting_down) {
+         _al_cond_wait(&work_cond, &pool_mutex);
+      }
+      _al_sub1_and_fetch(&num_sleeping);
+      _al_mutex_unlock(&pool_mutex);
+   }
+}
+
+
+/* Returns false if the workers could not be started. */
+static bool start_workers(void)
+{
+   int i;
+
+   if (!deques)
+      return false;
+
+   _al_mutex_lock(&pool_mutex);
+   if (!workers_started) {
+      workers = al_malloc(num_workers * sizeof(_AL_THREAD));
+      if (!workers) {
+         _al_mutex_unlock(&pool_mutex);
+         ALLEGRO_ERROR("Unable to allocate %d job workers\n", num_workers);
+         return false;
+      }
+      for (i = 0; i < num_workers; i++) {
+         _al_thread_create(&workers[i], job_worker_proc,
+            (void *)(intptr_t)(i + 1));
+      }
+      workers_started = true;
+   }
+   _al_mutex_unlock(&pool_mutex);
+   return true;
+}
+
+
+static void shutdown_jobs(void)
+{
+   int i;
+
+   if (workers_started) {
+      _al_mutex_lock(&pool_mutex);
+      shutting_down = true;
+      _al_cond_broadcast(&work_cond);
+      _al_mutex_unlock(&pool_mutex);
+
+      for (i = 0; i < num_workers; i++) {
+         _al_thread_join(&workers[i]);
+      }
+      al_free(workers);
+      workers = NULL;
+      workers_started = false;
+   }
+
+   if (num_queued > 0) {
+      ALLEGRO_WARN("%d jobs still queued at exit\n", (int)num_queued);
+      num_queued = 0;
+   }
+
+   if (deques) {
+      for (i = 0; i <= num_workers; i++) {
+         al_free(deques[i].jobs);
+         _al_mutex_destroy(&deques[i].mutex);
+      }
+      al_free(deques);
+   }
+   deques = NULL;
+
+   _al_cond_destroy(&done_cond);
+   _al_cond_destroy(&work_cond);
+   _al_mutex_destroy(&pool_mutex);
+}
+
+
+void _al_init_jobs(void)
+{
+   int i;
+
+   /* The thread waiting for the jobs helps to run them. */
+   num_workers = al_get_cpu_count() - 1;
+   if (num_workers < 1)
+      num_workers = 1;
+   if (num_workers > MAX_WORKERS)
+      num_workers = MAX_WORKERS;
+
+   /* Without the deques the workers are never started and every job is
+    * run by the thread that submits it.
+    */
+   deques = al_calloc(num_workers + 1, sizeof(JOB_DEQUE));
+   if (deques) {
+      for (i = 0; i <= num_workers; i++) {
+         _al_mutex_init(&deques[i].mutex);
+      }
+   }
+   else {
+      ALLEGRO_ERROR("Unable to allocate job deques\n");
+   }
+
+   _al_mutex_init(&pool_mutex);
+   _al_cond_init(&work_cond);
+   _al_cond_init(&done_cond);
+   workers_started = false;
+   shutting_down = false;
+   num_queued = 0;
+   num_sleeping = 0;
+   num_waiting = 0;
+
+   _al_add_exit_func(shutdown_jobs, "shutdown_jobs");
+}
+
+
+/* Function: al_get_num_job_workers
+ */
+int al_get_num_job_workers(void)
+{
+   return num_workers;
+}
+
+
+/* Function: al_create_job_counter
+ */
+ALLEGRO_JOB_COUNTER *al_create_job_counter(void)
+{
+   ALLEGRO_JOB_COUNTER *counter;
+
+   counter = al_calloc(1, sizeof(*counter));
+   if (!counter) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+
+   _al_mutex_init(&counter->mutex);
+   _al_vector_init(&counter->continuations, sizeof(JOB));
+   _al_event_source_init(&counter->es);
+
+   return counter;
+}
+
+
+/* Function: al_destroy_job_counter
+ */
+void al_destroy_job_counter(ALLEGRO_JOB_COUNTER *counter)
+{
+   if (!counter)
+      return;
+
+   al_wait_for_job_counter(counter);
+
+   /* A worker may still be inside finish_job for the last job. */
+   _al_fetch_and_add1(&num_waiting);
+   _al_mutex_lock(&pool_mutex);
+   while (counter->finishing > 0) {
+      _al_cond_wait(&done_cond, &pool_mutex);
+   }
+   _al_mutex_unlock(&pool_mutex);
+   _al_sub1_and_fetch(&num_waiting);
+
+   _al_event_source_free(&counter->es);
+   _al_vector_free(&counter->continuations);
+   _al_mutex_destroy(&counter->mutex);
+   al_free(counter);
+}
+
+
+/* Function: al_is_job_counter_done
+ */
+bool al_is_job_counter_done(ALLEGRO_JOB_COUNTER *counter)
+{
+   ASSERT(counter);
+
+   return counter->pending == 0;
+}
+
+
+/* Function: al_wait_for_job_counter
+ */
+void al_wait_for_job_counter(ALLEGRO_JOB_COUNTER *counter)
+{
+   JOB job;
+   ASSERT(counter);
+
+   while (counter->pending != 0) {
+      /* Help out rather than sit idle. */
+      if (get_job(&job)) {
+         run_job(&job);
+         continue;
+      }
+
+      _al_fetch_and_add1(&num_waiting);
+      _al_mutex_lock(&pool_mutex);
+      while (counter->pending != 0 && num_queued == 0) {
+         _al_cond_wait(&done_cond, &pool_mutex);
+      }
+      _al_mutex_unlock(&pool_mutex);
+      _al_sub1_and_fetch(&num_waiting);
+   }
+}
+
+
+/* Function: al_get_job_counter_event_source
+ */
+ALLEGRO_EVENT_SOURCE *al_get_job_counter_event_source(
+   ALLEGRO_JOB_COUNTER *counter)
+{
+   ASSERT(counter);
+
+   return &counter->es;
+}
+
+
+/* Function: al_run_job
+ */
+void al_run_job(void (*proc)(void *arg), void *arg,
+   ALLEGRO_JOB_COUNTER *counter)
+{
+   al_run_job_after(NULL, proc, arg, counter);
+}
+
+
+/* Function: al_run_job_after
+ */
+void al_run_job_after(ALLEGRO_JOB_COUNTER *dependency,
+   void (*proc)(void *arg), void *arg, ALLEGRO_JOB_COUNTER *counter)
+{
+   JOB job;
+   ASSERT(proc);
+
+   memset(&job, 0, sizeof(job));
+   job.proc = proc;
+   job.arg = arg;
+   job.counter = counter;
+
+   if (counter)
+      _al_fetch_and_add1(&counter->pending);
+
+   if (dependency) {
+      _al_mutex_lock(&dependency->mutex);
+      if (dependency->pending != 0) {
+         JOB *slot = _al_vector_alloc_back(&dependency->continuations);
+         if (slot) {
+            *slot = job;
+            _al_mutex_unlock(&dependency->mutex);
+            return;
+         }
+         _al_mutex_unlock(&dependency->mutex);
+         /* Out of memory; wait for the dependency here instead, which
+          * still keeps the job from starting before it is done.
+          */
+         al_wait_for_job_counter(dependency);
+      }
+      else {
+         _al_mutex_unlock(&dependency->mutex);
+      }
+   }
+
+   push_job(&job);
+}
+
+
+/* Function: al_run_parallel_for
+ */
+void al_run_parallel_for(int begin, int end, int grain,
+   void (*proc)(int begin, int end, void *arg), void *arg,
+   ALLEGRO_JOB_COUNTER *counter)
+{
+   JOB job;
+   ASSERT(proc);
+
+   if (end <= begin)
+      return;
+
+   if (grain <= 0) {
+      grain = (end - begin) / ((num_workers + 1) * PIECES_PER_WORKER);
+      if (grain < 1)
+         grain = 1;
+   }
+
+   memset(&job, 0, sizeof(job));
+   job.range_proc = proc;
+   job.arg = arg;
+   job.begin = begin;
+   job.end = end;
+   job.grain = grain;
+   job.counter = counter;
+
+   if (counter)
+      _al_fetch_and_add1(&counter->pending);
+   push_job(&job);
+}
+
+
+/* vim: set sts=3 sw=3 et: */
@@ -100,8 +100,9 @@ static const char *ljoy_get_name(ALLEGRO_JOYSTICK *joy_);
 static bool ljoy_get_active(ALLEGRO_JOYSTICK *joy_);
 
 static void ljoy_process_new_data(void *data);
-static void ljoy_generate_axis_event(ALLEGRO_JOYSTICK_LINUX *joy, int stick, int axis, float pos);
-static void ljoy_generate_button_event(ALLEGRO_JOYSTICK_LINUX *joy, int button, ALLEGRO_EVENT_TYPE event_type);
+static void ljoy_queue_axis_event(ALLEGRO_JOYSTICK_LINUX *joy, int stick, int axis, float pos);
+static void ljoy_queue_button_event(ALLEGRO_JOYSTICK_LINUX *joy, int button, ALLEGRO_EVENT_TYPE event_type);
+static void ljoy_flush_report(ALLEGRO_JOYSTICK_LINUX *joy);
 
 
 
@@ -128,6 +129,8 @@ static unsigned num_joysticks;   /* number of joysticks known to the user */
 static _AL_VECTOR joysticks;     /* of ALLEGRO_JOYSTICK_LINUX pointers */
 static volatile bool config_needs_merging;
 static ALLEGRO_MUTEX *config_mutex;
+/* Only emit the last change of each axis in a report, if it changed. */
+static bool dedup_axis_events = true;
 #ifdef SUPPORT_HOTPLUG
 static int inotify_fd = -1;
 static ALLEGRO_THREAD *hotplug_thread;
@@ -318,7 +321,11 @@ static void inactivate_joy(ALLEGRO_JOYSTICK_LINUX *joy)
    for (i = 0; i < joy->parent.info.num_buttons; i++)
       al_free((void *)joy->parent.info.button[i].name);
    memset(&joy->parent.info, 0, sizeof(joy->parent.info));
+   _al_seqlock_write_begin(&joy->joystate_lock);
    memset(&joy->joystate, 0, sizeof(joy->joystate));
+   _al_seqlock_write_end(&joy->joystate_lock);
+   joy->num_report_events = 0;
+   joy->report_dropped = false;
 
    al_ustr_free(joy->device_name);
    joy->device_name = NULL;
@@ -640,9 +647,15 @@ static void *hotplug_proc(ALLEGRO_THREAD *thread, void *data)
  */
 static bool ljoy_init_joystick(void)
 {
+   const char *value;
+
    _al_vector_init(&joysticks, sizeof(ALLEGRO_JOYSTICK_LINUX *));
    num_joysticks = 0;
 
+   value = al_get_config_value(al_get_system_config(), "joystick",
+      "dedup_axis_events");
+   dedup_axis_events = !(value && !strcmp(value, "false"));
+
    if (!(config_mutex = al_create_mutex())) {
       return false;
    }
@@ -801,18 +814,15 @@ static void ljoy_release_joystick(ALLEGRO_JOYSTICK *joy_)
 
 /* ljoy_get_joystick_state: [primary thread]
  *
- *  Copy the internal joystick state to a user-provided structure.
+ *  Copy the internal joystick state to a user-provided structure.  The
+ *  copy is retried if the fdwatch thread updated the state meanwhile,
+ *  rather than locking it out.
  */
 static void ljoy_get_joystick_state(ALLEGRO_JOYSTICK *joy_, ALLEGRO_JOYSTICK_STATE *ret_state)
 {
    ALLEGRO_JOYSTICK_LINUX *joy = (ALLEGRO_JOYSTICK_LINUX *) joy_;
-   ALLEGRO_EVENT_SOURCE *es = al_get_joystick_event_source();
-
-   _al_event_source_lock(es);
-   {
-      *ret_state = joy->joystate;
-   }
-   _al_event_source_unlock(es);
+   _AL_SEQLOCK_READ(&joy->joystate_lock, al_get_joystick_event_source(),
+      *ret_state, joy->joystate);
 }
 
 
@@ -856,9 +866,55 @@ static float norm_pos(const AXIS_MAPPING *map, float value)
 
 
 
+/* ljoy_resync: [fdwatch thread]
+ *
+ *  Queue events for anything that changed while the kernel was dropping
+ *  events, by asking the device for its current state.
+ */
+static void ljoy_resync(ALLEGRO_JOYSTICK_LINUX *joy)
+{
+   unsigned long key_bits[NLONGS(KEY_CNT)] = {0};
+   struct input_absinfo absinfo;
+   int i;
+
+   if (ioctl(joy->fd, EVIOCGKEY(sizeof(key_bits)), key_bits) >= 0) {
+      for (i = 0; i < joy->parent.info.num_buttons; i++) {
+         bool down = TEST_BIT(joy->button_mapping[i].ev_code, key_bits);
+
+         if (down != (joy->joystate.button[i] != 0)) {
+            ljoy_queue_button_event(joy, i,
+               (down
+                ? ALLEGRO_EVENT_JOYSTICK_BUTTON_DOWN
+                : ALLEGRO_EVENT_JOYSTICK_BUTTON_UP));
+         }
+      }
+   }
+
+   for (i = LJOY_AXIS_RANGE_START; i < LJOY_AXIS_RANGE_END; i++) {
+      const AXIS_MAPPING *map = &joy->axis_mapping[i];
+
+      /* Unmapped axes are left zeroed. */
+      if (map->max == map->min)
+         continue;
+      if (ioctl(joy->fd, EVIOCGABS(i), &absinfo) >= 0) {
+         float pos = norm_pos(map, absinfo.value);
+
+         if (pos != joy->joystate.stick[map->stick].axis[map->axis])
+            ljoy_queue_axis_event(joy, map->stick, map->axis, pos);
+      }
+   }
+}
+
+
+
 /* ljoy_process_new_data: [fdwatch thread]
  *
  *  Process new data arriving in the joystick's fd.
+ *
+ *  The kernel groups input events into reports ended by EV_SYN.  Changes
+ *  are held back until the end of each report, then applied to the state
+ *  and emitted together, so that a multi-axis update only takes the
+ *  event queue locks once and the state is never seen half-updated.
  */
 static void ljoy_process_new_data(void *data)
 {
@@ -872,7 +928,7 @@ static void ljoy_process_new_data(void *data)
 
    _al_event_source_lock(es);
    {
-      struct input_event input_events[32];
+      struct input_event input_events[256];
       int bytes, nr, i;
 
       while ((bytes = read(joy->fd, &input_events, sizeof input_events)) > 0) {
@@ -883,15 +939,29 @@ static void ljoy_process_new_data(void *data)
             int code = input_events[i].code;
             int value = input_events[i].value;
 
-            if (type == EV_KEY) {
+            if (type == EV_SYN) {
+               if (code == SYN_DROPPED) {
+                  /* Skip the rest of the report and query the device
+                   * state at its end instead.
+                   */
+                  joy->report_dropped = true;
+                  joy->num_report_events = 0;
+               }
+               else if (code == SYN_REPORT) {
+                  if (joy->report_dropped) {
+                     joy->report_dropped = false;
+                     ljoy_resync(joy);
+                  }
+                  ljoy_flush_report(joy);
+               }
+            }
+            else if (joy->report_dropped) {
+               continue;
+            }
+            else if (type == EV_KEY) {
                int number = map_button_number(joy, code);
                if (number >= 0) {
-                  if (value)
-                     joy->joystate.button[number] = 32767;
-                  else
-                     joy->joystate.button[number] = 0;
-
-                  ljoy_generate_button_event(joy, number,
+                  ljoy_queue_button_event(joy, number,
                      (value
                       ? ALLEGRO_EVENT_JOYSTICK_BUTTON_DOWN
                       : ALLEGRO_EVENT_JOYSTICK_BUTTON_UP));
@@ -905,8 +975,7 @@ static void ljoy_process_new_data(void *data)
                   int axis = map->axis;
                   float pos = norm_pos(map, value);
 
-                  joy->joystate.stick[stick].axis[axis] = pos;
-                  ljoy_generate_axis_event(joy, stick, axis, pos);
+                  ljoy_queue_axis_event(joy, stick, axis, pos);
                }
             }
          }
@@ -917,54 +986,125 @@ static void ljoy_process_new_data(void *data)
 
 
 
-/* ljoy_generate_axis_event: [fdwatch thread]
+/* ljoy_alloc_report_event: [fdwatch thread]
+ *
+ *  Returns a free slot in the current report, flushing the report early
+ *  if it is full.
+ */
+static ALLEGRO_EVENT *ljoy_alloc_report_event(ALLEGRO_JOYSTICK_LINUX *joy)
+{
+   if (joy->num_report_events == LJOY_MAX_REPORT_EVENTS)
+      ljoy_flush_report(joy);
+
+   return &joy->report_events[joy->num_report_events++];
+}
+
+
+
+/* ljoy_queue_axis_event: [fdwatch thread]
  *
- *  Helper to generate an event after an axis is moved.
+ *  Helper to add an axis movement to the current report.
  *  The joystick must be locked BEFORE entering this function.
  */
-static void ljoy_generate_axis_event(ALLEGRO_JOYSTICK_LINUX *joy, int stick, int axis, float pos)
+static void ljoy_queue_axis_event(ALLEGRO_JOYSTICK_LINUX *joy, int stick, int axis, float pos)
 {
-   ALLEGRO_EVENT event;
-   ALLEGRO_EVENT_SOURCE *es = al_get_joystick_event_source();
+   ALLEGRO_EVENT *event;
+   int i;
 
-   if (!_al_event_source_needs_to_generate_event(es))
-      return;
+   if (dedup_axis_events) {
+      for (i = joy->num_report_events - 1; i >= 0; i--) {
+         event = &joy->report_events[i];
+         if (event->type == ALLEGRO_EVENT_JOYSTICK_AXIS &&
+               event->joystick.stick == stick &&
+               event->joystick.axis == axis) {
+            event->joystick.pos = pos;
+            return;
+         }
+      }
+   }
+
+   event = ljoy_alloc_report_event(joy);
+   event->joystick.type = ALLEGRO_EVENT_JOYSTICK_AXIS;
+   event->joystick.id = (ALLEGRO_JOYSTICK *)joy;
+   event->joystick.stick = stick;
+   event->joystick.axis = axis;
+   event->joystick.pos = pos;
+   event->joystick.button = 0;
+}
 
-   event.joystick.type = ALLEGRO_EVENT_JOYSTICK_AXIS;
-   event.joystick.timestamp = al_get_time();
-   event.joystick.id = (ALLEGRO_JOYSTICK *)joy;
-   event.joystick.stick = stick;
-   event.joystick.axis = axis;
-   event.joystick.pos = pos;
-   event.joystick.button = 0;
 
-   _al_event_source_emit_event(es, &event);
+
+/* ljoy_queue_button_event: [fdwatch thread]
+ *
+ *  Helper to add a button press or release to the current report.
+ *  The joystick must be locked BEFORE entering this function.
+ */
+static void ljoy_queue_button_event(ALLEGRO_JOYSTICK_LINUX *joy, int button, ALLEGRO_EVENT_TYPE event_type)
+{
+   ALLEGRO_EVENT *event = ljoy_alloc_report_event(joy);
+
+   event->joystick.type = event_type;
+   event->joystick.id = (ALLEGRO_JOYSTICK *)joy;
+   event->joystick.stick = 0;
+   event->joystick.axis = 0;
+   event->joystick.pos = 0.0;
+   event->joystick.button = button;
 }
 
 
 
-/* ljoy_generate_button_event: [fdwatch thread]
+/* ljoy_flush_report: [fdwatch thread]
  *
- *  Helper to generate an event after a button is pressed or released.
+ *  Apply the changes of the current report to the joystick state and
+ *  emit them in one go.
  *  The joystick must be locked BEFORE entering this function.
  */
-static void ljoy_generate_button_event(ALLEGRO_JOYSTICK_LINUX *joy, int button, ALLEGRO_EVENT_TYPE event_type)
+static void ljoy_flush_report(ALLEGRO_JOYSTICK_LINUX *joy)
 {
-   ALLEGRO_EVENT event;
    ALLEGRO_EVENT_SOURCE *es = al_get_joystick_event_source();
+   double timestamp;
+   int num_events = 0;
+   int i;
 
-   if (!_al_event_source_needs_to_generate_event(es))
+   if (joy->num_report_events == 0)
       return;
 
-   event.joystick.type = event_type;
-   event.joystick.timestamp = al_get_time();
-   event.joystick.id = (ALLEGRO_JOYSTICK *)joy;
-   event.joystick.stick = 0;
-   event.joystick.axis = 0;
-   event.joystick.pos = 0.0;
-   event.joystick.button = button;
+   timestamp = al_get_time();
+
+   /* The whole report becomes visible to ljoy_get_joystick_state at once.
+    * Wanted events are packed to the front of the array as we go.
+    */
+   _al_seqlock_write_begin(&joy->joystate_lock);
+   for (i = 0; i < joy->num_report_events; i++) {
+      ALLEGRO_EVENT *event = &joy->report_events[i];
+
+      if (event->type == ALLEGRO_EVENT_JOYSTICK_AXIS) {
+         float *axis = &joy->joystate.stick[event->joystick.stick]
+            .axis[event->joystick.axis];
+
+         if (dedup_axis_events && *axis == event->joystick.pos)
+            continue;
+         *axis = event->joystick.pos;
+      }
+      else {
+         joy->joystate.button[event->joystick.button] =
+            (event->type == ALLEGRO_EVENT_JOYSTICK_BUTTON_DOWN) ? 32767 : 0;
+      }
+
+      if (!_al_event_source_wants_event_type(es, event->type))
+         continue;
+
+      event->joystick.timestamp = timestamp;
+      if (num_events != i)
+         joy->report_events[num_events] = *event;
+      num_events++;
+   }
+   _al_seqlock_write_end(&joy->joystate_lock);
+
+   joy->num_report_events = 0;
 
-   _al_event_source_emit_event(es, &event);
+   if (num_events > 0)
+      _al_event_source_emit_events(es, joy->report_events, num_events);
 }
 
 #endif /* ALLEGRO_HAVE_LINUX_INPUT_H */
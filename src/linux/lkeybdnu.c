@@ -49,6 +49,7 @@
 #include "allegro5/internal/aintern_driver.h"
 #include "allegro5/internal/aintern_events.h"
 #include "allegro5/internal/aintern_keyboard.h"
+#include "allegro5/internal/aintern_seqlock.h"
 #include "allegro5/platform/aintlnx.h"
 #include "allegro5/platform/aintunix.h"
 
@@ -70,6 +71,7 @@ typedef struct ALLEGRO_KEYBOARD_LINUX
    struct termios work_termio;
    int startup_kbmode;
    ALLEGRO_KEYBOARD_STATE state;
+   _AL_SEQLOCK state_lock;
    unsigned int modifiers;
    // Quit if Ctrl-Alt-Del is pressed.
    bool three_finger_flag;
@@ -314,7 +316,8 @@ static bool lkeybd_init_keyboard(void)
    if (__al_linux_use_console())
       return false;
 */
-   the_keyboard.fd = open("/dev/tty", O_RDWR);
+   /* Non-blocking, so that the fdwatch callback can read until EAGAIN. */
+   the_keyboard.fd = open("/dev/tty", O_RDWR | O_NONBLOCK);
 
    /* Save the current terminal attributes, which we will restore when
     * we close up shop.
@@ -464,15 +467,14 @@ static bool lkeybd_set_keyboard_leds(int leds)
 
 
 /* lkeybd_get_keyboard_state: [primary thread]
- *  Copy the current keyboard state into RET_STATE, with any necessary locking.
+ *  Copy the current keyboard state into RET_STATE.  Where atomics are
+ *  available this does not take the event source lock, so it never waits
+ *  for the fdwatch thread.
  */
 static void lkeybd_get_keyboard_state(ALLEGRO_KEYBOARD_STATE *ret_state)
 {
-   _al_event_source_lock(&the_keyboard.parent.es);
-   {
-      *ret_state = the_keyboard.state;
-   }
-   _al_event_source_unlock(&the_keyboard.parent.es);
+   _AL_SEQLOCK_READ(&the_keyboard.state_lock, &the_keyboard.parent.es, *ret_state,
+      the_keyboard.state);
 }
 
 
@@ -485,12 +487,13 @@ static void process_new_data(void *unused)
    _al_event_source_lock(&the_keyboard.parent.es);
    {
       unsigned char buf[128];
-      size_t bytes_read;
-      unsigned int ch;
+      ssize_t bytes_read;
+      ssize_t ch;
 
-      bytes_read = read(the_keyboard.fd, &buf, sizeof(buf));
-      for (ch = 0; ch < bytes_read; ch++)
-         process_character(buf[ch]);
+      while ((bytes_read = read(the_keyboard.fd, &buf, sizeof(buf))) > 0) {
+         for (ch = 0; ch < bytes_read; ch++)
+            process_character(buf[ch]);
+      }
    }
    _al_event_source_unlock(&the_keyboard.parent.es);
 
@@ -582,7 +585,9 @@ static void handle_key_press(int mycode, unsigned int ascii)
                  : ALLEGRO_EVENT_KEY_DOWN);
    
    /* Maintain the key_down array. */
+   _al_seqlock_write_begin(&the_keyboard.state_lock);
    _AL_KEYBOARD_STATE_SET_KEY_DOWN(the_keyboard.state, mycode);
+   _al_seqlock_write_end(&the_keyboard.state_lock);
 
    /* Generate key press/repeat events if necessary. */   
    if (!_al_event_source_needs_to_generate_event(&the_keyboard.parent.es))
@@ -621,7 +626,9 @@ static void handle_key_release(int mycode)
       return;
 
    /* Maintain the key_down array. */
+   _al_seqlock_write_begin(&the_keyboard.state_lock);
    _AL_KEYBOARD_STATE_CLEAR_KEY_DOWN(the_keyboard.state, mycode);
+   _al_seqlock_write_end(&the_keyboard.state_lock);
 
    /* Generate key release events if necessary. */
    if (!_al_event_source_needs_to_generate_event(&the_keyboard.parent.es))
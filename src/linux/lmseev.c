@@ -31,6 +31,7 @@ ALLEGRO_DEBUG_CHANNEL("lmseev");
 
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_mouse.h"
+#include "allegro5/internal/aintern_seqlock.h"
 #include "allegro5/platform/aintunix.h"
 #include "allegro5/platform/aintlnx.h"
 
@@ -55,6 +56,7 @@ typedef struct AL_MOUSE_EVDEV
    ALLEGRO_MOUSE parent;
    int fd;
    ALLEGRO_MOUSE_STATE state;
+   _AL_SEQLOCK state_lock;
 } AL_MOUSE_EVDEV;
 
 
@@ -394,6 +396,7 @@ static void handle_button_event(unsigned int button, bool is_down)
 {
    unsigned int event_type;
 
+   _al_seqlock_write_begin(&the_mouse.state_lock);
    if (is_down) {
       the_mouse.state.buttons |= (1 << (button-1));
       event_type = ALLEGRO_EVENT_MOUSE_BUTTON_DOWN;
@@ -402,6 +405,7 @@ static void handle_button_event(unsigned int button, bool is_down)
       the_mouse.state.buttons &=~ (1 << (button-1));
       event_type = ALLEGRO_EVENT_MOUSE_BUTTON_UP;
    }
+   _al_seqlock_write_end(&the_mouse.state_lock);
 
    generate_mouse_event(
       event_type,
@@ -484,9 +488,11 @@ static void handle_axis_event(int dx, int dy, int dz)
       y_axis.out_abs = _ALLEGRO_CLAMP(y_axis.out_min, y_axis.out_abs, y_axis.out_max);
       /* There's no range for z */
 
+      _al_seqlock_write_begin(&the_mouse.state_lock);
       the_mouse.state.x = x_axis.out_abs;
       the_mouse.state.y = y_axis.out_abs;
       the_mouse.state.z = z_axis.out_abs * al_get_mouse_wheel_precision();
+      _al_seqlock_write_end(&the_mouse.state_lock);
 
       dz *= al_get_mouse_wheel_precision();
 
@@ -651,8 +657,10 @@ static bool mouse_set_mouse_xy(ALLEGRO_DISPLAY *display, int x, int y)
       dy = y_axis.out_abs - the_mouse.state.y;
 
       if ((dx != 0) && (dy != 0)) {
+         _al_seqlock_write_begin(&the_mouse.state_lock);
          the_mouse.state.x = x_axis.out_abs;
          the_mouse.state.y = y_axis.out_abs;
+         _al_seqlock_write_end(&the_mouse.state_lock);
 
          generate_mouse_event(
             ALLEGRO_EVENT_MOUSE_AXES,
@@ -687,7 +695,9 @@ static bool mouse_set_mouse_axis(int which, int z)
       dz = z_axis.out_abs - the_mouse.state.z;
 
       if (dz != 0) {
+         _al_seqlock_write_begin(&the_mouse.state_lock);
          the_mouse.state.z = z_axis.out_abs;
+         _al_seqlock_write_end(&the_mouse.state_lock);
 
          generate_mouse_event(
             ALLEGRO_EVENT_MOUSE_AXES,
@@ -724,8 +734,10 @@ bool _al_evdev_set_mouse_range(int x1, int y1, int x2, int y2)
       dy = y_axis.out_abs - the_mouse.state.y;
 
       if ((dx != 0) && (dy != 0)) {
+         _al_seqlock_write_begin(&the_mouse.state_lock);
          the_mouse.state.x = x_axis.out_abs;
          the_mouse.state.y = y_axis.out_abs;
+         _al_seqlock_write_end(&the_mouse.state_lock);
 
          generate_mouse_event(
             ALLEGRO_EVENT_MOUSE_AXES,
@@ -742,15 +754,13 @@ bool _al_evdev_set_mouse_range(int x1, int y1, int x2, int y2)
 
 
 /* mouse_get_state:
- *  Copy the current mouse state into RET_STATE, with any necessary locking.
+ *  Copy the current mouse state into RET_STATE, without waiting for the
+ *  fdwatch thread.
  */
 static void mouse_get_state(ALLEGRO_MOUSE_STATE *ret_state)
 {
-   _al_event_source_lock(&the_mouse.parent.es);
-   {
-      *ret_state = the_mouse.state;
-   }
-   _al_event_source_unlock(&the_mouse.parent.es);
+   _AL_SEQLOCK_READ(&the_mouse.state_lock, &the_mouse.parent.es, *ret_state,
+      the_mouse.state);
 }
 
 
@@ -805,7 +815,7 @@ static void generate_mouse_event(unsigned int type,
 {
    ALLEGRO_EVENT event;
 
-   if (!_al_event_source_needs_to_generate_event(&the_mouse.parent.es))
+   if (!_al_event_source_wants_event_type(&the_mouse.parent.es, type))
       return;
 
    event.mouse.type = type;
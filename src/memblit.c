@@ -291,6 +291,8 @@ static void _al_draw_bitmap_region_memory_fast(ALLEGRO_BITMAP *bitmap,
       return;
    }
 
+   _AL_RENDER_STATS_ADD(software_pixels, (int64_t)sw * sh);
+
    /* will detect if no conversion is needed */
    _al_convert_bitmap_data(
       src_region->data, src_region->format, src_region->pitch,
@@ -47,7 +47,8 @@ void _al_draw_pixel_memory(ALLEGRO_BITMAP *bitmap, float x, float y,
    ix = (int)x;
    iy = (int)y;
    _al_blend_memory(color, bitmap, ix, iy, &result);
-   _al_put_pixel(bitmap, ix, iy, result);
+   if (_al_put_pixel(bitmap, ix, iy, result))
+      _AL_RENDER_STATS_ADD(software_pixels, 1);
 }
 
 
@@ -78,6 +79,8 @@ void _al_clear_bitmap_by_locking(ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR *color)
    if (!lr)
       return;
 
+   _AL_RENDER_STATS_ADD(software_pixels, (int64_t)w * h);
+
    /* Write a single pixel so we can get the raw value. */
    _al_put_pixel(bitmap, x1, y1, *color);
 
@@ -0,0 +1,704 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Pooled memory allocator.
+ *
+ *      Small blocks are carved out of slabs, one free list per size
+ *      class, and each thread keeps a short cache of free blocks per
+ *      class so most allocations take no lock at all.  Large blocks go
+ *      straight to malloc.  Every block is tagged with the subsystem
+ *      that allocated it, derived from the file name passed in by the
+ *      al_malloc macros, and live/count statistics are kept for
+ *      each tag.  The statistics are split into shards, one per thread
+ *      where possible, which are added up when they are read.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_atomicops.h"
+
+
+/* The locks below cannot be _AL_MUTEXes: on Windows those allocate
+ * through al_malloc, which may be us.
+ */
+#if defined(ALLEGRO_MSVC) || defined(ALLEGRO_BCC32)
+   #define POOL_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) && !defined(ALLEGRO_MACOSX) && \
+      !defined(ALLEGRO_IPHONE) && !defined(ALLEGRO_ANDROID)
+   #define POOL_THREAD_LOCAL __thread
+#endif
+
+
+#define NUM_CLASSES        7     /* 16, 32, ..., 1024 bytes */
+#define MIN_CLASS_SHIFT    4
+#define MAX_SMALL_SIZE     (1 << (MIN_CLASS_SHIFT + NUM_CLASSES - 1))
+#define LARGE_CLASS        0xffff
+#define SLAB_SIZE          (64 * 1024)
+
+/* A thread cache holds at most CACHE_MAX blocks per class, and moves
+ * CACHE_BATCH blocks at a time to or from the shared free lists.
+ */
+#define CACHE_MAX          64
+#define CACHE_BATCH        32
+
+#define MAX_TAGS           64
+#define TAG_NAME_SIZE      32
+#define TAG_CACHE_SIZE     64    /* power of two */
+#define NUM_SHARDS         16    /* power of two */
+
+
+typedef struct POOL_LOCK {
+   volatile _AL_ATOMIC held;
+} POOL_LOCK;
+
+/* Precedes every block.  The size keeps the payload 16-byte aligned. */
+typedef union POOL_HEADER {
+   struct {
+      size_t size;
+      unsigned short tag;
+      unsigned short size_class;
+   } info;
+   char align[16];
+} POOL_HEADER;
+
+/* A free block, overlaying its header. */
+typedef struct POOL_BLOCK {
+   struct POOL_BLOCK *next;
+} POOL_BLOCK;
+
+typedef struct POOL_CLASS {
+   POOL_LOCK lock;
+   POOL_BLOCK *free;
+   char *slab_pos;         /* not yet carved part of the current slab */
+   char *slab_end;
+} POOL_CLASS;
+
+typedef struct POOL_TAG {
+   char name[TAG_NAME_SIZE];
+} POOL_TAG;
+
+/* Per-tag counts kept by one shard.  A block may be freed through a
+ * different shard than it was allocated from, so these can be negative;
+ * only their sum over all shards is meaningful.
+ */
+typedef struct POOL_COUNTS {
+   int64_t live_bytes;
+   int64_t live_count;
+   int64_t total_count;
+} POOL_COUNTS;
+
+/* Padded to whole cache lines, so that threads using different shards
+ * only share a line if the array itself is misaligned.
+ */
+typedef union POOL_SHARD {
+   struct {
+      POOL_LOCK lock;
+      POOL_COUNTS counts[MAX_TAGS];
+   } s;
+   char align[64 * ((sizeof(POOL_LOCK) + MAX_TAGS * sizeof(POOL_COUNTS)
+      + 63) / 64)];
+} POOL_SHARD;
+
+typedef struct TAG_CACHE {
+   const char *file[TAG_CACHE_SIZE];
+   unsigned short tag[TAG_CACHE_SIZE];
+} TAG_CACHE;
+
+#ifdef POOL_THREAD_LOCAL
+typedef struct THREAD_CACHE {
+   POOL_BLOCK *free[NUM_CLASSES];
+   int num_free[NUM_CLASSES];
+   TAG_CACHE tags;
+   int shard;              /* plus one, or 0 if not yet assigned */
+} THREAD_CACHE;
+
+static POOL_THREAD_LOCAL THREAD_CACHE thread_cache;
+#else
+/* Shared by all threads, protected by tags_lock. */
+static TAG_CACHE shared_tag_cache;
+#endif
+
+static POOL_CLASS classes[NUM_CLASSES];
+
+static POOL_LOCK tags_lock;
+static POOL_TAG tags[MAX_TAGS];
+static int num_tags;
+
+static POOL_SHARD shards[NUM_SHARDS];
+#ifdef POOL_THREAD_LOCAL
+static volatile _AL_ATOMIC next_shard;
+#endif
+
+/* Length of the path to the top of the Allegro source tree, as seen in
+ * __FILE__, or -1 if not yet known.
+ */
+static int root_len = -1;
+
+
+
+/* A test-and-set lock built from the atomic increment.  A thread which
+ * does not see the count go from zero backs off and waits for it to drop.
+ */
+static void pool_lock(POOL_LOCK *lock)
+{
+   int spins = 0;
+
+   while (_al_fetch_and_add1(&lock->held) != 0) {
+      _al_sub1_and_fetch(&lock->held);
+      while (lock->held != 0) {
+         if (++spins == 100) {
+            al_rest(0);
+            spins = 0;
+         }
+      }
+   }
+}
+
+
+
+static void pool_unlock(POOL_LOCK *lock)
+{
+   _al_sub1_and_fetch(&lock->held);
+}
+
+
+
+static bool is_sep(char c)
+{
+   return c == '/' || c == '\\';
+}
+
+
+
+/* Return true if PATH starts with the directory component DIR. */
+static bool starts_with_dir(const char *path, const char *dir)
+{
+   size_t len = strlen(dir);
+   return strncmp(path, dir, len) == 0 && is_sep(path[len]);
+}
+
+
+
+static void copy_component(char *name, const char *path)
+{
+   int i;
+
+   for (i = 0; i < TAG_NAME_SIZE - 1 && path[i] && !is_sep(path[i]); i++)
+      name[i] = path[i];
+   name[i] = '\0';
+}
+
+
+
+/* Work out which subsystem FILE belongs to: the addon name for addons,
+ * the directory below src/ for platform and driver code, "core" for the
+ * rest of the library and "user" for files outside the Allegro tree.
+ */
+static void tag_name_from_file(const char *file, char *name)
+{
+   const char *p;
+
+   if (root_len < 0) {
+      const char *self = __FILE__;
+      size_t len = strlen(self);
+      size_t suffix = strlen("src/mempool.c");
+      root_len = (len >= suffix && starts_with_dir(self + len - suffix, "src"))
+         ? (int)(len - suffix) : 0;
+   }
+
+   if (!file || strncmp(file, __FILE__, root_len) != 0) {
+      strcpy(name, "user");
+      return;
+   }
+
+   p = file + root_len;
+   if (starts_with_dir(p, "addons")) {
+      copy_component(name, p + strlen("addons/"));
+      return;
+   }
+   if (starts_with_dir(p, "src")) {
+      const char *q = p + strlen("src/");
+      const char *r = q;
+      while (*r && !is_sep(*r))
+         r++;
+      if (*r && !starts_with_dir(q, "misc")) {
+         copy_component(name, q);
+         return;
+      }
+      strcpy(name, "core");
+      return;
+   }
+   if (starts_with_dir(p, "include")) {
+      strcpy(name, "core");
+      return;
+   }
+   strcpy(name, "user");
+}
+
+
+
+/* Find or add the tag named NAME.  tags_lock must be held.  Tag 0 is
+ * shared by everything once the table fills up.
+ */
+static int find_tag(const char *name)
+{
+   int i;
+
+   for (i = 0; i < num_tags; i++) {
+      if (strcmp(tags[i].name, name) == 0)
+         return i;
+   }
+   if (num_tags == 0) {
+      strcpy(tags[0].name, "other");
+      num_tags = 1;
+   }
+   if (num_tags == MAX_TAGS)
+      return 0;
+   strcpy(tags[num_tags].name, name);
+   return num_tags++;
+}
+
+
+
+static int lookup_tag_cached(TAG_CACHE *cache, const char *file)
+{
+   unsigned slot = ((uintptr_t)file >> 3) & (TAG_CACHE_SIZE - 1);
+   char name[TAG_NAME_SIZE];
+   int tag;
+
+   if (cache->file[slot] == file && file)
+      return cache->tag[slot];
+
+   tag_name_from_file(file, name);
+   tag = find_tag(name);
+   cache->file[slot] = file;
+   cache->tag[slot] = tag;
+   return tag;
+}
+
+
+
+/* The file name pointers come from __FILE__, so each translation unit
+ * normally passes the same pointer every time.
+ */
+static int lookup_tag(const char *file)
+{
+   int tag;
+
+#ifdef POOL_THREAD_LOCAL
+   unsigned slot = ((uintptr_t)file >> 3) & (TAG_CACHE_SIZE - 1);
+   if (thread_cache.tags.file[slot] == file && file)
+      return thread_cache.tags.tag[slot];
+
+   pool_lock(&tags_lock);
+   tag = lookup_tag_cached(&thread_cache.tags, file);
+   pool_unlock(&tags_lock);
+#else
+   pool_lock(&tags_lock);
+   tag = lookup_tag_cached(&shared_tag_cache, file);
+   pool_unlock(&tags_lock);
+#endif
+
+   return tag;
+}
+
+
+
+/* Threads are handed out shards in turn, so the locks are only contended
+ * once there are more threads than shards.  Without thread local storage
+ * the address of a local variable tells the threads' stacks apart.
+ */
+static POOL_SHARD *get_shard(void)
+{
+#ifdef POOL_THREAD_LOCAL
+   if (thread_cache.shard == 0) {
+      thread_cache.shard =
+         (_al_fetch_and_add1(&next_shard) & (NUM_SHARDS - 1)) + 1;
+   }
+   return &shards[thread_cache.shard - 1];
+#else
+   int local;
+   return &shards[((uintptr_t)&local >> 16) & (NUM_SHARDS - 1)];
+#endif
+}
+
+
+
+static void tag_alloc(int tag, size_t n)
+{
+   POOL_SHARD *shard = get_shard();
+   POOL_COUNTS *counts = &shard->s.counts[tag];
+
+   pool_lock(&shard->s.lock);
+   counts->live_bytes += n;
+   counts->live_count++;
+   counts->total_count++;
+   pool_unlock(&shard->s.lock);
+}
+
+
+
+static void tag_free(int tag, size_t n)
+{
+   POOL_SHARD *shard = get_shard();
+   POOL_COUNTS *counts = &shard->s.counts[tag];
+
+   pool_lock(&shard->s.lock);
+   counts->live_bytes -= n;
+   counts->live_count--;
+   pool_unlock(&shard->s.lock);
+}
+
+
+
+static int size_class(size_t n)
+{
+   int c = 0;
+
+   while (((size_t)1 << (MIN_CLASS_SHIFT + c)) < n)
+      c++;
+   return c;
+}
+
+
+
+static size_t class_stride(int c)
+{
+   return sizeof(POOL_HEADER) + ((size_t)1 << (MIN_CLASS_SHIFT + c));
+}
+
+
+
+/* Take up to MAX blocks of class C from the shared free list, carving
+ * new ones from a slab as needed.  Returns them as a linked list and the
+ * number taken in *COUNT.
+ */
+static POOL_BLOCK *take_blocks(int c, int max, int *count)
+{
+   POOL_CLASS *cls = &classes[c];
+   size_t stride = class_stride(c);
+   POOL_BLOCK *head = NULL;
+   int n = 0;
+
+   pool_lock(&cls->lock);
+
+   while (n < max && cls->free) {
+      POOL_BLOCK *b = cls->free;
+      cls->free = b->next;
+      b->next = head;
+      head = b;
+      n++;
+   }
+
+   while (n < max) {
+      POOL_BLOCK *b;
+
+      if ((size_t)(cls->slab_end - cls->slab_pos) < stride) {
+         /* The tail of the old slab is too small for a block. */
+         char *slab = malloc(SLAB_SIZE);
+         if (!slab)
+            break;
+         cls->slab_pos = slab;
+         cls->slab_end = slab + SLAB_SIZE;
+      }
+      b = (POOL_BLOCK *)cls->slab_pos;
+      cls->slab_pos += stride;
+      b->next = head;
+      head = b;
+      n++;
+   }
+
+   pool_unlock(&cls->lock);
+
+   *count = n;
+   return head;
+}
+
+
+
+/* Return a list of COUNT blocks of class C, ending in TAIL, to the
+ * shared free list.
+ */
+static void give_blocks(int c, POOL_BLOCK *head, POOL_BLOCK *tail)
+{
+   POOL_CLASS *cls = &classes[c];
+
+   pool_lock(&cls->lock);
+   tail->next = cls->free;
+   cls->free = head;
+   pool_unlock(&cls->lock);
+}
+
+
+
+static POOL_HEADER *alloc_small(int c)
+{
+#ifdef POOL_THREAD_LOCAL
+   POOL_BLOCK *b = thread_cache.free[c];
+
+   if (!b) {
+      int count;
+      b = take_blocks(c, CACHE_BATCH, &count);
+      if (!b)
+         return NULL;
+      thread_cache.num_free[c] = count;
+   }
+   thread_cache.free[c] = b->next;
+   thread_cache.num_free[c]--;
+   return (POOL_HEADER *)b;
+#else
+   int count;
+   return (POOL_HEADER *)take_blocks(c, 1, &count);
+#endif
+}
+
+
+
+static void free_small(int c, POOL_HEADER *h)
+{
+   POOL_BLOCK *b = (POOL_BLOCK *)h;
+
+#ifdef POOL_THREAD_LOCAL
+   b->next = thread_cache.free[c];
+   thread_cache.free[c] = b;
+
+   if (++thread_cache.num_free[c] > CACHE_MAX) {
+      POOL_BLOCK *head = thread_cache.free[c];
+      POOL_BLOCK *tail = head;
+      int i;
+
+      for (i = 1; i < CACHE_BATCH; i++)
+         tail = tail->next;
+      thread_cache.free[c] = tail->next;
+      thread_cache.num_free[c] -= CACHE_BATCH;
+      give_blocks(c, head, tail);
+   }
+#else
+   give_blocks(c, b, b);
+#endif
+}
+
+
+
+/* _al_release_memory_pool_cache:
+ *  Hand the calling thread's cached blocks back to the shared free lists.
+ *  Called as Allegro's own threads exit; blocks cached by other threads
+ *  stay with them.
+ */
+void _al_release_memory_pool_cache(void)
+{
+#ifdef POOL_THREAD_LOCAL
+   int c;
+
+   for (c = 0; c < NUM_CLASSES; c++) {
+      POOL_BLOCK *head = thread_cache.free[c];
+      POOL_BLOCK *tail = head;
+
+      if (!head)
+         continue;
+      while (tail->next)
+         tail = tail->next;
+      give_blocks(c, head, tail);
+      thread_cache.free[c] = NULL;
+      thread_cache.num_free[c] = 0;
+   }
+#endif
+}
+
+
+
+static void *pool_malloc(size_t n, int line, const char *file,
+   const char *func)
+{
+   POOL_HEADER *h;
+   int c;
+   int tag;
+   (void)line;
+   (void)func;
+
+   if (n <= MAX_SMALL_SIZE) {
+      c = size_class(n);
+      h = alloc_small(c);
+   }
+   else {
+      if (n > (size_t)-1 - sizeof(POOL_HEADER))
+         return NULL;
+      c = LARGE_CLASS;
+      h = malloc(sizeof(POOL_HEADER) + n);
+   }
+   if (!h)
+      return NULL;
+
+   tag = lookup_tag(file);
+   h->info.size = n;
+   h->info.tag = tag;
+   h->info.size_class = c;
+   tag_alloc(tag, n);
+
+   return h + 1;
+}
+
+
+
+static void pool_free(void *ptr, int line, const char *file,
+   const char *func)
+{
+   POOL_HEADER *h;
+   (void)line;
+   (void)file;
+   (void)func;
+
+   if (!ptr)
+      return;
+
+   h = (POOL_HEADER *)ptr - 1;
+   tag_free(h->info.tag, h->info.size);
+
+   if (h->info.size_class == LARGE_CLASS)
+      free(h);
+   else
+      free_small(h->info.size_class, h);
+}
+
+
+
+static void *pool_realloc(void *ptr, size_t n, int line, const char *file,
+   const char *func)
+{
+   POOL_HEADER *h;
+   void *p;
+
+   if (!ptr)
+      return pool_malloc(n, line, file, func);
+   if (n == 0) {
+      pool_free(ptr, line, file, func);
+      return NULL;
+   }
+
+   h = (POOL_HEADER *)ptr - 1;
+
+   /* Resize in place while the block stays in the same size class. */
+   if (h->info.size_class != LARGE_CLASS && n <= MAX_SMALL_SIZE &&
+         size_class(n) == h->info.size_class) {
+      POOL_SHARD *shard = get_shard();
+
+      pool_lock(&shard->s.lock);
+      shard->s.counts[h->info.tag].live_bytes += (int64_t)n - h->info.size;
+      pool_unlock(&shard->s.lock);
+      h->info.size = n;
+      return ptr;
+   }
+
+   p = pool_malloc(n, line, file, func);
+   if (!p)
+      return NULL;
+   memcpy(p, ptr, _ALLEGRO_MIN(n, h->info.size));
+   pool_free(ptr, line, file, func);
+   return p;
+}
+
+
+
+static void *pool_calloc(size_t count, size_t n, int line, const char *file,
+   const char *func)
+{
+   void *p;
+
+   if (n != 0 && count > (size_t)-1 / n)
+      return NULL;
+
+   p = pool_malloc(count * n, line, file, func);
+   if (p)
+      memset(p, 0, count * n);
+   return p;
+}
+
+
+
+static ALLEGRO_MEMORY_INTERFACE pool_interface = {
+   pool_malloc,
+   pool_free,
+   pool_realloc,
+   pool_calloc
+};
+
+
+
+/* Function: al_get_pool_memory_interface
+ */
+ALLEGRO_MEMORY_INTERFACE *al_get_pool_memory_interface(void)
+{
+   return &pool_interface;
+}
+
+
+
+/* Function: al_get_num_memory_tags
+ */
+int al_get_num_memory_tags(void)
+{
+   int n;
+
+   pool_lock(&tags_lock);
+   n = num_tags;
+   pool_unlock(&tags_lock);
+
+   return n;
+}
+
+
+
+/* Function: al_get_memory_stats
+ */
+bool al_get_memory_stats(int tag, ALLEGRO_MEMORY_STATS *stats)
+{
+   POOL_COUNTS sum = {0, 0, 0};
+   POOL_TAG *t;
+   int i;
+
+   ASSERT(stats);
+
+   if (tag < 0 || tag >= al_get_num_memory_tags())
+      return false;
+
+   for (i = 0; i < NUM_SHARDS; i++) {
+      POOL_SHARD *shard = &shards[i];
+
+      pool_lock(&shard->s.lock);
+      sum.live_bytes += shard->s.counts[tag].live_bytes;
+      sum.live_count += shard->s.counts[tag].live_count;
+      sum.total_count += shard->s.counts[tag].total_count;
+      pool_unlock(&shard->s.lock);
+   }
+
+   /* The shards are read one at a time, so the sums can be briefly off
+    * while other threads allocate and free.
+    */
+   if (sum.live_bytes < 0)
+      sum.live_bytes = 0;
+   if (sum.live_count < 0)
+      sum.live_count = 0;
+
+   t = &tags[tag];
+   stats->tag = t->name;
+   stats->live_bytes = sum.live_bytes;
+   stats->live_count = sum.live_count;
+   stats->total_count = sum.total_count;
+
+   return true;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
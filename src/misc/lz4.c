@@ -0,0 +1,229 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      LZ4 block compression.
+ *
+ *      A small, greedy implementation of the LZ4 block format, used by
+ *      pack archives and the LZ4 file filter.  The compressor favours
+ *      speed over ratio; its output can be decoded by any LZ4 decoder.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_lz4.h"
+
+
+#define MIN_MATCH       4
+/* The block format requires the last match to start at least 12 bytes
+ * before the end of the block, and the last 5 bytes to be literals.
+ */
+#define MF_LIMIT        12
+#define LAST_LITERALS   5
+
+
+static INLINE uint32_t read32(const unsigned char *p)
+{
+   uint32_t v;
+   memcpy(&v, p, sizeof(v));
+   return v;
+}
+
+
+static INLINE unsigned hash4(uint32_t v)
+{
+   return (v * 2654435761u) >> 16;
+}
+
+
+static void put_length(unsigned char **op, size_t n)
+{
+   while (n >= 255) {
+      *(*op)++ = 255;
+      n -= 255;
+   }
+   *(*op)++ = (unsigned char)n;
+}
+
+
+/* Append one sequence, or return false if it would not fit.  A match
+ * length of zero marks the final, literals-only sequence.
+ */
+static bool put_sequence(unsigned char **op, unsigned char *op_end,
+   const unsigned char *literals, size_t num_literals, size_t offset,
+   size_t match_length)
+{
+   size_t worst = 1 + num_literals / 255 + 1 + num_literals + 2 +
+      match_length / 255 + 1;
+   unsigned char *token;
+
+   if (worst > (size_t)(op_end - *op))
+      return false;
+
+   token = (*op)++;
+   *token = (num_literals < 15 ? num_literals : 15) << 4;
+   if (num_literals >= 15)
+      put_length(op, num_literals - 15);
+   memcpy(*op, literals, num_literals);
+   *op += num_literals;
+
+   if (match_length) {
+      match_length -= MIN_MATCH;
+      *token |= (match_length < 15 ? match_length : 15);
+      *(*op)++ = offset & 0xff;
+      *(*op)++ = offset >> 8;
+      if (match_length >= 15)
+         put_length(op, match_length - 15);
+   }
+
+   return true;
+}
+
+
+/* Compress `src` as a single LZ4 block.  `table` must have room for
+ * _AL_LZ4_TABLE_SIZE entries; its contents need not be initialised.
+ * Returns the compressed size, or 0 if the block does not fit in
+ * `dst_size` bytes.
+ */
+size_t _al_lz4_compress(const unsigned char *src, size_t src_size,
+   unsigned char *dst, size_t dst_size, uint32_t *table)
+{
+   unsigned char *op = dst;
+   unsigned char *op_end = dst + dst_size;
+   size_t ip = 0;
+   size_t anchor = 0;
+
+   if (src_size > MF_LIMIT) {
+      const size_t limit = src_size - MF_LIMIT;
+      const size_t match_limit = src_size - LAST_LITERALS;
+
+      memset(table, 0, _AL_LZ4_TABLE_SIZE * sizeof(*table));
+
+      while (ip < limit) {
+         uint32_t seq = read32(src + ip);
+         unsigned h = hash4(seq);
+         size_t ref = table[h];
+         size_t len;
+
+         table[h] = (uint32_t)ip;
+         if (ref >= ip || ip - ref >= _AL_LZ4_WINDOW_SIZE ||
+               read32(src + ref) != seq) {
+            /* Step faster through data which does not compress. */
+            ip += 1 + ((ip - anchor) >> 6);
+            continue;
+         }
+
+         while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+            ip--;
+            ref--;
+         }
+
+         len = MIN_MATCH;
+         while (ip + len < match_limit && src[ip + len] == src[ref + len])
+            len++;
+
+         if (!put_sequence(&op, op_end, src + anchor, ip - anchor, ip - ref,
+               len))
+            return 0;
+
+         ip += len;
+         anchor = ip;
+         if (ip < limit)
+            table[hash4(read32(src + ip - 2))] = (uint32_t)(ip - 2);
+      }
+   }
+
+   if (!put_sequence(&op, op_end, src + anchor, src_size - anchor, 0, 0))
+      return 0;
+
+   return op - dst;
+}
+
+
+static bool get_length(const unsigned char **src, const unsigned char *end,
+   size_t *n)
+{
+   unsigned b;
+
+   do {
+      if (*src >= end)
+         return false;
+      b = *(*src)++;
+      *n += b;
+   } while (b == 255);
+
+   return true;
+}
+
+
+/* Decode an LZ4 block into at most `dst_size` bytes at `dst`.  Matches may
+ * reach up to `dict_size` bytes back before `dst`, for blocks which depend
+ * on the previous block.  Returns the decoded size, or _AL_LZ4_ERROR if the
+ * data is malformed or does not fit.
+ */
+size_t _al_lz4_decompress(const unsigned char *src, size_t src_size,
+   unsigned char *dst, size_t dst_size, size_t dict_size)
+{
+   const unsigned char *src_end = src + src_size;
+   size_t out = 0;
+
+   while (src < src_end) {
+      unsigned token = *src++;
+      size_t n = token >> 4;
+      size_t offset;
+      unsigned char *op;
+      const unsigned char *match;
+
+      if (n == 15 && !get_length(&src, src_end, &n))
+         return _AL_LZ4_ERROR;
+      if (n > (size_t)(src_end - src) || n > dst_size - out)
+         return _AL_LZ4_ERROR;
+      memcpy(dst + out, src, n);
+      src += n;
+      out += n;
+
+      /* The last sequence has literals only. */
+      if (src == src_end)
+         break;
+
+      if (src_end - src < 2)
+         return _AL_LZ4_ERROR;
+      offset = src[0] | (src[1] << 8);
+      src += 2;
+      if (offset == 0 || offset > out + dict_size)
+         return _AL_LZ4_ERROR;
+
+      n = (token & 15);
+      if (n == 15 && !get_length(&src, src_end, &n))
+         return _AL_LZ4_ERROR;
+      n += MIN_MATCH;
+      if (n > dst_size - out)
+         return _AL_LZ4_ERROR;
+
+      /* Matches may overlap their own output. */
+      op = dst + out;
+      match = op - offset;
+      out += n;
+      if (offset >= n) {
+         memcpy(op, match, n);
+      }
+      else {
+         while (n--)
+            *op++ = *match++;
+      }
+   }
+
+   return out;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
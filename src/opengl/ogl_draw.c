@@ -15,6 +15,7 @@
 
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_opengl.h"
+#include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_display.h"
 #include "allegro5/internal/aintern_memdraw.h"
 #include "allegro5/internal/aintern_opengl.h"
@@ -461,6 +462,7 @@ static void ogl_flush_vertex_cache(ALLEGRO_DISPLAY *disp)
 
    glGetError(); /* clear error */
    glDrawArrays(GL_TRIANGLES, 0, disp->num_cache_vertices);
+   _AL_RENDER_STATS_ADD(vertex_cache_flushes, 1);
 
 #ifdef DEBUGMODE
    {
@@ -0,0 +1,421 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Profiling spans and counters.
+ *
+ *      Each thread records into its own ring buffer, so recording takes
+ *      no locks.  The buffers are written out in the Chrome trace event
+ *      format, which chrome://tracing and Perfetto can load.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_atomicops.h"
+#include "allegro5/internal/aintern_profile.h"
+#include "allegro5/internal/aintern_thread.h"
+#include "allegro5/internal/aintern_tls.h"
+
+ALLEGRO_DEBUG_CHANNEL("profile")
+
+
+static void write_json_string(ALLEGRO_FILE *file, const char *s)
+{
+   al_fputc(file, '"');
+   for (; *s; s++) {
+      if (*s == '"' || *s == '\\')
+         al_fputc(file, '\\');
+      al_fputc(file, *s);
+   }
+   al_fputc(file, '"');
+}
+
+
+#ifdef ALLEGRO_CFG_PROFILING
+
+/* Events kept per thread; older ones are overwritten.  Must be a power of
+ * two.
+ */
+#define PROFILE_RING_SIZE     16384
+#define PROFILE_MAX_DEPTH     32
+
+enum {
+   PROFILE_SPAN,
+   PROFILE_COUNTER
+};
+
+typedef struct PROFILE_EVENT {
+   const char *name;
+   double start;
+   double value;     /* duration of a span, or value of a counter */
+   int type;
+} PROFILE_EVENT;
+
+typedef struct _AL_PROFILE_THREAD PROFILE_THREAD;
+
+struct _AL_PROFILE_THREAD {
+   PROFILE_THREAD *next;
+   int id;
+   int session;
+   /* Spans which have been started but not ended. */
+   int depth;
+   const char *open_names[PROFILE_MAX_DEPTH];
+   double open_starts[PROFILE_MAX_DEPTH];
+   /* Only the owning thread writes these.  count is the number of events
+    * recorded so far, including overwritten ones.
+    */
+   volatile unsigned int count;
+   bool full;
+   PROFILE_EVENT events[PROFILE_RING_SIZE];
+};
+
+bool _al_profile_enabled = false;
+
+/* Protects the list of thread buffers. */
+static _AL_MUTEX profile_mutex = _AL_MUTEX_UNINITED;
+static bool profile_mutex_inited = false;
+static PROFILE_THREAD *profile_threads = NULL;
+static int num_profile_threads = 0;
+
+/* Bumped by al_start_profiling; threads clear their buffer when they
+ * notice.
+ */
+static volatile int profile_session = 0;
+
+/* Bumped when the thread buffers are freed. */
+static int profile_generation = 1;
+
+
+static void init_profile_mutex(void)
+{
+   if (!profile_mutex_inited) {
+      _al_mutex_init(&profile_mutex);
+      profile_mutex_inited = true;
+   }
+}
+
+
+static PROFILE_THREAD *get_profile_thread(void)
+{
+   _AL_PROFILE_TLS *tls = _al_tls_get_profile();
+   PROFILE_THREAD *thread;
+
+   if (!tls)
+      return NULL;
+
+   if (tls->thread && tls->generation == profile_generation) {
+      thread = tls->thread;
+   }
+   else {
+      thread = al_malloc(sizeof *thread);
+      if (!thread)
+         return NULL;
+      thread->session = profile_session - 1;
+
+      _al_mutex_lock(&profile_mutex);
+      thread->id = ++num_profile_threads;
+      thread->next = profile_threads;
+      profile_threads = thread;
+      _al_mutex_unlock(&profile_mutex);
+
+      tls->thread = thread;
+      tls->generation = profile_generation;
+   }
+
+   if (thread->session != profile_session) {
+      thread->depth = 0;
+      thread->count = 0;
+      thread->full = false;
+      _al_memory_barrier();
+      thread->session = profile_session;
+   }
+
+   return thread;
+}
+
+
+static void record_event(PROFILE_THREAD *thread, int type, const char *name,
+   double start, double value)
+{
+   PROFILE_EVENT *ev = &thread->events[thread->count & (PROFILE_RING_SIZE - 1)];
+
+   ev->name = name;
+   ev->start = start;
+   ev->value = value;
+   ev->type = type;
+
+   _al_memory_barrier();
+   thread->count++;
+   if (thread->count == PROFILE_RING_SIZE)
+      thread->full = true;
+}
+
+
+/* Internal function: _al_profile_begin
+ */
+void _al_profile_begin(const char *name)
+{
+   PROFILE_THREAD *thread = get_profile_thread();
+
+   if (!thread)
+      return;
+
+   if (thread->depth < PROFILE_MAX_DEPTH) {
+      thread->open_names[thread->depth] = name;
+      thread->open_starts[thread->depth] = al_get_time();
+   }
+   thread->depth++;
+}
+
+
+/* Internal function: _al_profile_end
+ */
+void _al_profile_end(void)
+{
+   PROFILE_THREAD *thread = get_profile_thread();
+   double start;
+
+   /* The span may have been opened before profiling was started. */
+   if (!thread || thread->depth == 0)
+      return;
+
+   thread->depth--;
+   if (thread->depth < PROFILE_MAX_DEPTH) {
+      start = thread->open_starts[thread->depth];
+      record_event(thread, PROFILE_SPAN, thread->open_names[thread->depth],
+         start, al_get_time() - start);
+   }
+}
+
+
+/* Internal function: _al_profile_counter
+ */
+void _al_profile_counter(const char *name, double value)
+{
+   PROFILE_THREAD *thread = get_profile_thread();
+
+   if (thread)
+      record_event(thread, PROFILE_COUNTER, name, al_get_time(), value);
+}
+
+
+static void write_event(ALLEGRO_FILE *file, int tid, PROFILE_EVENT *ev)
+{
+   al_fputs(file, ",\n{\"name\":");
+   write_json_string(file, ev->name);
+   if (ev->type == PROFILE_SPAN) {
+      al_fprintf(file,
+         ",\"cat\":\"allegro\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+         "\"pid\":1,\"tid\":%d}",
+         ev->start * 1e6, ev->value * 1e6, tid);
+   }
+   else {
+      al_fprintf(file,
+         ",\"cat\":\"allegro\",\"ph\":\"C\",\"ts\":%.3f,"
+         "\"pid\":1,\"tid\":%d,\"args\":{\"value\":%g}}",
+         ev->start * 1e6, tid, ev->value);
+   }
+}
+
+
+/* write_thread:
+ *  Write out the events of one thread.  The thread may still be
+ *  recording, so copy its ring first and then drop whatever it
+ *  overwrote in the meantime.
+ */
+static void write_thread(ALLEGRO_FILE *file, PROFILE_THREAD *thread,
+   PROFILE_EVENT *copy)
+{
+   unsigned int c0, c1, n, skip, i;
+
+   if (thread->session != profile_session)
+      return;
+
+   c0 = thread->count;
+   n = thread->full ? PROFILE_RING_SIZE : c0;
+   _al_memory_barrier();
+   for (i = 0; i < n; i++)
+      copy[i] = thread->events[(c0 - n + i) & (PROFILE_RING_SIZE - 1)];
+   _al_memory_barrier();
+   c1 = thread->count;
+
+   skip = 0;
+   if (c1 - c0 > PROFILE_RING_SIZE - n)
+      skip = (c1 - c0) - (PROFILE_RING_SIZE - n);
+   if (skip > n || thread->session != profile_session)
+      skip = n;
+
+   al_fprintf(file,
+      ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+      "\"args\":{\"name\":\"Thread %d\"}}", thread->id, thread->id);
+
+   for (i = skip; i < n; i++)
+      write_event(file, thread->id, &copy[i]);
+}
+
+#endif /* ALLEGRO_CFG_PROFILING */
+
+
+/* Function: al_start_profiling
+ */
+bool al_start_profiling(void)
+{
+#ifdef ALLEGRO_CFG_PROFILING
+   init_profile_mutex();
+   profile_session++;
+   _al_memory_barrier();
+   _al_profile_enabled = true;
+   return true;
+#else
+   ALLEGRO_WARN("Allegro was built without profiling support.\n");
+   return false;
+#endif
+}
+
+
+/* Function: al_stop_profiling
+ */
+void al_stop_profiling(void)
+{
+#ifdef ALLEGRO_CFG_PROFILING
+   _al_profile_enabled = false;
+#endif
+}
+
+
+/* Function: al_is_profiling
+ */
+bool al_is_profiling(void)
+{
+#ifdef ALLEGRO_CFG_PROFILING
+   return _al_profile_enabled;
+#else
+   return false;
+#endif
+}
+
+
+/* Function: al_save_profile_trace_f
+ */
+bool al_save_profile_trace_f(ALLEGRO_FILE *file)
+{
+#ifdef ALLEGRO_CFG_PROFILING
+   PROFILE_THREAD *thread;
+   PROFILE_EVENT *copy;
+#endif
+
+   ASSERT(file);
+
+   /* The metadata event saves worrying about commas. */
+   al_fputs(file, "{\"traceEvents\":[\n"
+      "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+      "\"args\":{\"name\":");
+   write_json_string(file, al_get_app_name());
+   al_fputs(file, "}}");
+
+#ifdef ALLEGRO_CFG_PROFILING
+   copy = al_malloc(PROFILE_RING_SIZE * sizeof *copy);
+   if (!copy)
+      return false;
+
+   _al_mutex_lock(&profile_mutex);
+   for (thread = profile_threads; thread; thread = thread->next)
+      write_thread(file, thread, copy);
+   _al_mutex_unlock(&profile_mutex);
+
+   al_free(copy);
+#endif
+
+   al_fputs(file, "\n],\n\"displayTimeUnit\":\"ms\"}\n");
+
+   return !al_ferror(file);
+}
+
+
+/* Function: al_save_profile_trace
+ */
+bool al_save_profile_trace(const char *filename)
+{
+   ALLEGRO_FILE *file;
+
+   file = al_fopen(filename, "w");
+   if (file) {
+      bool retsave = al_save_profile_trace_f(file);
+      bool retclose = al_fclose(file);
+      return retsave && retclose;
+   }
+
+   return false;
+}
+
+
+void _al_init_profiling(void)
+{
+   const char *v;
+
+   v = al_get_config_value(al_get_system_config(), "profiling", "output");
+   if (v && v[0] != '\0') {
+      if (al_start_profiling())
+         ALLEGRO_INFO("Profiling to %s\n", v);
+   }
+}
+
+
+/* Save the trace if one was requested in the configuration, and stop
+ * recording.  Threads may still be inside a span; the buffers stay until
+ * _al_free_profiling.
+ */
+void _al_shutdown_profiling(void)
+{
+#ifdef ALLEGRO_CFG_PROFILING
+   const char *v;
+
+   if (al_is_system_installed()) {
+      v = al_get_config_value(al_get_system_config(), "profiling", "output");
+      if (v && v[0] != '\0' && profile_threads) {
+         if (!al_save_profile_trace(v))
+            ALLEGRO_ERROR("Failed to save profile to %s\n", v);
+      }
+   }
+
+   al_stop_profiling();
+#endif
+}
+
+
+/* Free the recording buffers.  Only called once every thread which may
+ * record has been joined.
+ */
+void _al_free_profiling(void)
+{
+#ifdef ALLEGRO_CFG_PROFILING
+   PROFILE_THREAD *thread;
+
+   if (!profile_mutex_inited)
+      return;
+
+   _al_mutex_lock(&profile_mutex);
+   while (profile_threads) {
+      thread = profile_threads;
+      profile_threads = thread->next;
+      al_free(thread);
+   }
+   num_profile_threads = 0;
+   profile_generation++;
+   _al_mutex_unlock(&profile_mutex);
+#endif
+}
+
+
+/* vim: set sts=3 sw=3 et: */
@@ -7,6 +7,7 @@ static int thread_trampoline(void* data)
 {
    _AL_THREAD *thread = data;
    (*thread->proc)(thread, thread->arg);
+   _al_release_memory_pool_cache();
    return 0;
 }
 
@@ -13,6 +13,17 @@ double al_get_time(void)
 
 
 
+int64_t al_get_time_ns(void)
+{
+   uint64_t count = SDL_GetPerformanceCounter();
+   uint64_t freq = SDL_GetPerformanceFrequency();
+
+   /* Split the conversion so that it cannot overflow. */
+   return (count / freq) * 1000000000 + (count % freq) * 1000000000 / freq;
+}
+
+
+
 void al_rest(double seconds)
 {
    SDL_Delay(seconds * 1000);
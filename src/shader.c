@@ -69,7 +69,7 @@ ALLEGRO_SHADER *al_create_shader(ALLEGRO_SHADER_PLATFORM platform)
    if (shader) {
       ASSERT(shader->platform);
       ASSERT(shader->vt);
-      shader->dtor_item = _al_register_destructor(_al_dtor_list, "shader", shader,
+      _al_register_destructor(_al_dtor_list, &shader->dtor_item, "shader", shader,
          (void (*)(void *))al_destroy_shader);
    }
    else {
@@ -211,7 +211,7 @@ void al_destroy_shader(ALLEGRO_SHADER *shader)
       al_use_shader(NULL);
    }
 
-   _al_unregister_destructor(_al_dtor_list, shader->dtor_item);
+   _al_unregister_destructor(_al_dtor_list, &shader->dtor_item);
 
    al_ustr_free(shader->vertex_copy);
    shader->vertex_copy = NULL;
@@ -29,7 +29,9 @@
 #include "allegro5/internal/aintern_debug.h"
 #include "allegro5/internal/aintern_dtor.h"
 #include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_file.h"
 #include "allegro5/internal/aintern_pixels.h"
+#include "allegro5/internal/aintern_profile.h"
 #include "allegro5/internal/aintern_system.h"
 #include "allegro5/internal/aintern_thread.h"
 #include "allegro5/internal/aintern_timer.h"
@@ -274,6 +276,16 @@ bool al_install_system(int version, int (*atexit_ptr)(void (*)(void)))
 
    _al_init_timers();
 
+   _al_init_async_reads();
+
+   _al_init_jobs();
+
+   _al_init_packs();
+
+   _al_init_ustr_indexes();
+
+   _al_init_profiling();
+
 #ifdef ALLEGRO_CFG_SHADER_GLSL
    _al_glsl_init_shaders();
 #endif
@@ -293,6 +305,8 @@ bool al_install_system(int version, int (*atexit_ptr)(void (*)(void)))
 
    active_sysdrv->installed = true;
 
+   _al_start_logging();
+
    _al_srand(time(NULL));
 
    return true;
@@ -308,11 +322,16 @@ void al_uninstall_system(void)
     * because it's installed as an atexit function by al_init.
     */
 
+   _al_shutdown_profiling();
+
    _al_run_destructors(_al_dtor_list);
    _al_run_exit_funcs();
    _al_shutdown_destructors(_al_dtor_list);
    _al_dtor_list = NULL;
 
+   /* The threads which record spans have all been joined by now. */
+   _al_free_profiling();
+
 #ifdef ALLEGRO_CFG_SHADER_GLSL
    _al_glsl_shutdown_shaders();
 #endif
@@ -32,10 +32,11 @@
 #endif
 #endif
 
+ALLEGRO_DEBUG_CHANNEL("timer")
+
 
 /* forward declarations */
-static double timer_thread_handle_tick(double interval);
-static void timer_handle_tick(ALLEGRO_TIMER *timer);
+static void timer_handle_tick(ALLEGRO_TIMER *timer, double error);
 
 
 struct ALLEGRO_TIMER
@@ -44,23 +45,107 @@ struct ALLEGRO_TIMER
    bool started;
    double speed_secs;
    int64_t count;
-   double counter;		/* counts down to zero=blastoff */
-   _AL_LIST_ITEM *dtor_item;
+   double deadline;     /* time of the next tick, while started */
+   double remaining;    /* time left until the next tick, while stopped */
+   int heap_index;      /* position in active_timers, while started */
+   _AL_DTOR_ITEM dtor_item;
 };
 
 
 
 /*
  * The timer thread that runs in the background to drive the timers.
+ *
+ * Started timers are kept in a binary min-heap ordered by the absolute
+ * time of their next tick.  The thread sleeps until the earliest deadline
+ * or until it is woken because the earliest deadline changed.  Each tick
+ * advances the deadline by exactly one period, so late wakeups do not
+ * accumulate into drift.
  */
 
 static ALLEGRO_MUTEX *timers_mutex;
-static _AL_VECTOR active_timers = _AL_VECTOR_INITIALIZER(ALLEGRO_TIMER *);
+static ALLEGRO_TIMER **active_timers;
+static int num_active_timers;
+static int max_active_timers;
 static _AL_THREAD * volatile timer_thread = NULL;
 static ALLEGRO_COND *timer_cond = NULL;
 static bool destroy_thread = false;
 
 
+static void heap_set(int i, ALLEGRO_TIMER *timer)
+{
+   active_timers[i] = timer;
+   timer->heap_index = i;
+}
+
+
+static void heap_sift_up(int i)
+{
+   ALLEGRO_TIMER *timer = active_timers[i];
+
+   while (i > 0) {
+      int parent = (i - 1) / 2;
+      if (active_timers[parent]->deadline <= timer->deadline)
+         break;
+      heap_set(i, active_timers[parent]);
+      i = parent;
+   }
+
+   heap_set(i, timer);
+}
+
+
+static void heap_sift_down(int i)
+{
+   ALLEGRO_TIMER *timer = active_timers[i];
+
+   for (;;) {
+      int child = 2 * i + 1;
+      if (child >= num_active_timers)
+         break;
+      if (child + 1 < num_active_timers &&
+            active_timers[child + 1]->deadline < active_timers[child]->deadline)
+         child++;
+      if (timer->deadline <= active_timers[child]->deadline)
+         break;
+      heap_set(i, active_timers[child]);
+      i = child;
+   }
+
+   heap_set(i, timer);
+}
+
+
+static bool heap_insert(ALLEGRO_TIMER *timer)
+{
+   if (num_active_timers == max_active_timers) {
+      int new_max = max_active_timers ? 2 * max_active_timers : 16;
+      ALLEGRO_TIMER **p = al_realloc(active_timers, new_max * sizeof(*p));
+      if (!p)
+         return false;
+      active_timers = p;
+      max_active_timers = new_max;
+   }
+
+   heap_set(num_active_timers++, timer);
+   heap_sift_up(timer->heap_index);
+   return true;
+}
+
+
+static void heap_remove(ALLEGRO_TIMER *timer)
+{
+   int i = timer->heap_index;
+   ALLEGRO_TIMER *last = active_timers[--num_active_timers];
+
+   if (last != timer) {
+      heap_set(i, last);
+      heap_sift_up(i);
+      heap_sift_down(last->heap_index);
+   }
+}
+
+
 /* timer_thread_proc: [timer thread]
  *  The timer thread procedure itself.
  */
@@ -96,77 +181,57 @@ static void timer_thread_proc(_AL_THREAD *self, void *unused)
    }
 #endif
 
-   double old_time = al_get_time();
-   double new_time;
-   double interval = 0.032768;
+   al_lock_mutex(timers_mutex);
+
+   while (!_al_get_thread_should_stop(self) && !destroy_thread) {
+      ALLEGRO_TIMER *timer;
+      double now;
 
-   while (!_al_get_thread_should_stop(self)) {
-      al_lock_mutex(timers_mutex);
-      while (_al_vector_size(&active_timers) == 0 && !destroy_thread) {
+      if (num_active_timers == 0) {
          al_wait_cond(timer_cond, timers_mutex);
-         old_time = al_get_time() - interval;
+         continue;
       }
-      al_unlock_mutex(timers_mutex);
-
-      al_rest(interval);
 
-      al_lock_mutex(timers_mutex);
-      {
-         /* Calculate actual time elapsed.  */
-         new_time = al_get_time();
-         interval = new_time - old_time;
-         old_time = new_time;
+      now = al_get_time();
+      timer = active_timers[0];
 
-         /* Handle a tick.  */
-         interval = timer_thread_handle_tick(interval);
+      if (timer->deadline > now) {
+         ALLEGRO_TIMEOUT timeout;
+         al_init_timeout(&timeout, timer->deadline - now);
+         al_wait_cond_until(timer_cond, timers_mutex, &timeout);
+         continue;
       }
-      al_unlock_mutex(timers_mutex);
-   }
-
-   (void)unused;
-}
-
-
 
-/* timer_thread_handle_tick: [timer thread]
- *  Call handle_tick() method of every timer in active_timers, and
- *  returns the duration that the timer thread should try to sleep
- *  next time.
- */
-static double timer_thread_handle_tick(double interval)
-{
-   double new_delay = 0.032768;
-   unsigned int i;
-
-   for (i = 0; i < _al_vector_size(&active_timers); i++) {
-      ALLEGRO_TIMER **slot = _al_vector_ref(&active_timers, i);
-      ALLEGRO_TIMER *timer = *slot;
-
-      timer->counter -= interval;
-
-      while (timer->counter <= 0) {
-         timer_handle_tick(timer);
-         timer->counter += timer->speed_secs;
+      /* Fire every tick which is due, including any we were too late
+       * for.
+       */
+      while (num_active_timers > 0 && active_timers[0]->deadline <= now) {
+         timer = active_timers[0];
+         timer_handle_tick(timer, now - timer->deadline);
+         timer->deadline += timer->speed_secs;
+         heap_sift_down(0);
       }
-
-      if ((timer->counter > 0) && (timer->counter < new_delay))
-         new_delay = timer->counter;
    }
 
-   return new_delay;
+   al_unlock_mutex(timers_mutex);
+
+   (void)unused;
 }
 
 
 
 static void shutdown_timers(void)
 {
-   ASSERT(_al_vector_size(&active_timers) == 0);
+   ASSERT(num_active_timers == 0);
 
-   _al_vector_free(&active_timers);
+   al_free(active_timers);
+   active_timers = NULL;
+   num_active_timers = 0;
+   max_active_timers = 0;
 
    if (timer_thread != NULL) {
-      destroy_thread = true;
       al_lock_mutex(timers_mutex);
+      destroy_thread = true;
       al_signal_cond(timer_cond);
       al_unlock_mutex(timers_mutex);
       _al_thread_join(timer_thread);
@@ -195,17 +260,22 @@ static void enable_timer(ALLEGRO_TIMER *timer, bool reset_counter)
 
       al_lock_mutex(timers_mutex);
       {
-         ALLEGRO_TIMER **slot;
-
-         timer->started = true;
-
          if (reset_counter)
-            timer->counter = timer->speed_secs;
+            timer->remaining = timer->speed_secs;
+
+         timer->deadline = al_get_time() + timer->remaining;
 
-         slot = _al_vector_alloc_back(&active_timers);
-         *slot = timer;
+         if (heap_insert(timer)) {
+            timer->started = true;
 
-         al_signal_cond(timer_cond);
+            /* Wake the timer thread if it has to wake up earlier. */
+            if (timer->heap_index == 0)
+               al_signal_cond(timer_cond);
+         }
+         else {
+            ALLEGRO_ERROR("Unable to grow the active timer heap\n");
+            al_set_errno(ENOMEM);
+         }
       }
       al_unlock_mutex(timers_mutex);
 
@@ -230,7 +300,7 @@ void _al_init_timers(void)
 
 int _al_get_active_timers_count(void)
 {
-   return _al_vector_size(&active_timers);
+   return num_active_timers;
 }
 
 
@@ -254,9 +324,11 @@ ALLEGRO_TIMER *al_create_timer(double speed_secs)
          timer->started = false;
          timer->count = 0;
          timer->speed_secs = speed_secs;
-         timer->counter = 0;
+         timer->deadline = 0;
+         timer->remaining = 0;
+         timer->heap_index = -1;
 
-         timer->dtor_item = _al_register_destructor(_al_dtor_list, "timer", timer,
+         _al_register_destructor(_al_dtor_list, &timer->dtor_item, "timer", timer,
             (void (*)(void *)) al_destroy_timer);
       }
 
@@ -273,7 +345,7 @@ void al_destroy_timer(ALLEGRO_TIMER *timer)
    if (timer) {
       al_stop_timer(timer);
 
-      _al_unregister_destructor(_al_dtor_list, timer->dtor_item);
+      _al_unregister_destructor(_al_dtor_list, &timer->dtor_item);
 
       _al_event_source_free(&timer->es);
       al_free(timer);
@@ -311,7 +383,9 @@ void al_stop_timer(ALLEGRO_TIMER *timer)
 
       al_lock_mutex(timers_mutex);
       {
-         _al_vector_find_and_delete(&active_timers, &timer);
+         heap_remove(timer);
+         timer->remaining = _ALLEGRO_MAX(0.0, timer->deadline - al_get_time());
+         timer->heap_index = -1;
          timer->started = false;
       }
       al_unlock_mutex(timers_mutex);
@@ -352,8 +426,11 @@ void al_set_timer_speed(ALLEGRO_TIMER *timer, double new_speed_secs)
    al_lock_mutex(timers_mutex);
    {
       if (timer->started) {
-         timer->counter -= timer->speed_secs;
-         timer->counter += new_speed_secs;
+         timer->deadline += new_speed_secs - timer->speed_secs;
+         heap_sift_up(timer->heap_index);
+         heap_sift_down(timer->heap_index);
+         if (timer->heap_index == 0)
+            al_signal_cond(timer_cond);
       }
 
       timer->speed_secs = new_speed_secs;
@@ -404,9 +481,9 @@ void al_add_timer_count(ALLEGRO_TIMER *timer, int64_t diff)
 
 
 /* timer_handle_tick: [timer thread]
- *  Handle a single tick.
+ *  Handle a single tick, which is `error` seconds late.
  */
-static void timer_handle_tick(ALLEGRO_TIMER *timer)
+static void timer_handle_tick(ALLEGRO_TIMER *timer, double error)
 {
    /* Lock out event source helper functions (e.g. the release hook
     * could be invoked simultaneously with this function).
@@ -422,7 +499,7 @@ static void timer_handle_tick(ALLEGRO_TIMER *timer)
          event.timer.type = ALLEGRO_EVENT_TIMER;
          event.timer.timestamp = al_get_time();
          event.timer.count = timer->count;
-         event.timer.error = -timer->counter;
+         event.timer.error = error;
          _al_event_source_emit_event(&timer->es, &event);
       }
    }
@@ -107,6 +107,18 @@ typedef struct thread_local_state {
 
    /* Destructor ownership count */
    int dtor_owner_count;
+
+   /* Job worker running on this thread, plus one, or 0 */
+   int job_worker;
+
+   /* Trace messages being written by this thread */
+   _AL_TRACE_NESTING trace_nesting;
+
+   /* Profiling buffer of this thread */
+   _AL_PROFILE_TLS profile;
+
+   /* Render statistics */
+   ALLEGRO_RENDER_STATS render_stats;
 } thread_local_state;
 
 
@@ -964,4 +976,74 @@ int *_al_tls_get_dtor_owner_count(void)
 }
 
 
+int *_al_tls_get_job_worker(void)
+{
+   thread_local_state *tls;
+
+   if ((tls = tls_get()) == NULL)
+      return NULL;
+   return &tls->job_worker;
+}
+
+
+_AL_TRACE_NESTING *_al_tls_get_trace_nesting(void)
+{
+   thread_local_state *tls;
+
+   if ((tls = tls_get()) == NULL)
+      return NULL;
+   return &tls->trace_nesting;
+}
+
+
+_AL_PROFILE_TLS *_al_tls_get_profile(void)
+{
+   thread_local_state *tls;
+
+   if ((tls = tls_get()) == NULL)
+      return NULL;
+   return &tls->profile;
+}
+
+
+/* Internal function: _al_get_render_stats
+ */
+ALLEGRO_RENDER_STATS *_al_get_render_stats(void)
+{
+   thread_local_state *tls;
+
+   if ((tls = tls_get()) == NULL)
+      return NULL;
+   return &tls->render_stats;
+}
+
+
+/* Function: al_get_render_stats
+ */
+void al_get_render_stats(ALLEGRO_RENDER_STATS *stats)
+{
+   thread_local_state *tls;
+
+   ASSERT(stats);
+
+   if ((tls = tls_get()) == NULL) {
+      memset(stats, 0, sizeof *stats);
+      return;
+   }
+   *stats = tls->render_stats;
+}
+
+
+/* Function: al_reset_render_stats
+ */
+void al_reset_render_stats(void)
+{
+   thread_local_state *tls;
+
+   if ((tls = tls_get()) == NULL)
+      return;
+   memset(&tls->render_stats, 0, sizeof tls->render_stats);
+}
+
+
 /* vim: set sts=3 sw=3 et: */
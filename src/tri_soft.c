@@ -408,6 +408,35 @@ static void shader_texture_grad_any_step(uintptr_t state, int minor)
 #include "scanline_drawers.inc"
 
 
+/* The scanline drawers clip each span to the locked region of the target,
+ * so only count the pixels that they will actually write.
+ */
+static void get_span_bounds(ALLEGRO_BITMAP *target, int *x1, int *y1,
+   int *x2, int *y2)
+{
+   int xofs = 0, yofs = 0;
+
+   if (target->parent) {
+      xofs = target->xofs;
+      yofs = target->yofs;
+      target = target->parent;
+   }
+
+   /* The drawers take y one below the pixel row they write. */
+   *x1 = target->lock_x - xofs;
+   *y1 = target->lock_y - yofs + 1;
+   *x2 = target->lock_x + target->lock_w - 1 - xofs;
+   *y2 = target->lock_y + target->lock_h - yofs;
+}
+
+#define COUNT_SPAN(x1, y, x2)                                              \
+   if ((y) >= span_y1 && (y) <= span_y2) {                                 \
+      int a = MAX(x1, span_x1);                                            \
+      int b = MIN(x2, span_x2);                                            \
+      if (b >= a)                                                          \
+         pixels += b - a + 1;                                              \
+   }
+
 static void triangle_stepper(uintptr_t state,
    shader_init init, shader_first first, shader_step step, shader_draw draw,
    ALLEGRO_VERTEX* vtx1, ALLEGRO_VERTEX* vtx2, ALLEGRO_VERTEX* vtx3)
@@ -427,6 +456,8 @@ static void triangle_stepper(uintptr_t state,
    int left_first, right_first, left_step, right_step;
    int left_x, right_x, cur_y, mid_y, end_y;
    float left_d_er, right_d_er;
+   int span_x1, span_y1, span_x2, span_y2;
+   int64_t pixels = 0;
 
    /*
    The reason these things are declared implicitly, is because we need to determine which
@@ -464,6 +495,9 @@ static void triangle_stepper(uintptr_t state,
    if (cur_y == end_y)
       return;
 
+   get_span_bounds(al_get_target_bitmap(), &span_x1, &span_y1,
+      &span_x2, &span_y2);
+
    /*
    As per definition, we take the ceiling
    */
@@ -556,6 +590,7 @@ static void triangle_stepper(uintptr_t state,
 
          if (right_x >= left_x) {
             draw(state, left_x, cur_y, right_x);
+            COUNT_SPAN(left_x, cur_y, right_x);
          }
 
          cur_y++;
@@ -592,6 +627,7 @@ static void triangle_stepper(uintptr_t state,
 
          if (right_x >= left_x) {
             draw(state, left_x, cur_y, right_x);
+            COUNT_SPAN(left_x, cur_y, right_x);
          }
 
          cur_y++;
@@ -646,6 +682,7 @@ static void triangle_stepper(uintptr_t state,
 
          if (right_x >= left_x) {
             draw(state, left_x, cur_y, right_x);
+            COUNT_SPAN(left_x, cur_y, right_x);
          }
 
          cur_y++;
@@ -674,6 +711,7 @@ static void triangle_stepper(uintptr_t state,
 
          if (right_x >= left_x) {
             draw(state, left_x, cur_y, right_x);
+            COUNT_SPAN(left_x, cur_y, right_x);
          }
 
          cur_y++;
@@ -681,8 +719,12 @@ static void triangle_stepper(uintptr_t state,
          right_error += right_x_delta;
       }
    }
+
+   _AL_RENDER_STATS_ADD(software_pixels, pixels);
 }
 
+#undef COUNT_SPAN
+
 /*
 This one will check to see what exactly we need to draw...
 I.e. this will call all of the actual renderers and set the appropriate callbacks
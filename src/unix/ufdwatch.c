@@ -17,11 +17,20 @@
  *      This module implements a background thread that waits for data
  *      to arrive in file descriptors, at which point it dispatches to
  *      functions which will process that data.
+ *
+ *      On Linux the thread sleeps in epoll_wait, with the descriptors
+ *      registered edge-triggered, so a descriptor is only reported when
+ *      new data arrives.  Elsewhere, or if epoll cannot be set up, it
+ *      falls back to select().  In both cases the thread is woken through
+ *      a descriptor of its own rather than by polling with a timeout.
  */
 
 
+#include <errno.h>
+#include <fcntl.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/select.h>
 #include <unistd.h>
@@ -32,6 +41,16 @@
 #include "allegro5/internal/aintern_vector.h"
 #include "allegro5/platform/aintunix.h"
 
+#if defined(ALLEGRO_HAVE_SYS_EPOLL_H) && defined(ALLEGRO_HAVE_SYS_EVENTFD_H)
+   #define USE_EPOLL
+   #include <sys/epoll.h>
+   #include <sys/eventfd.h>
+#endif
+
+ALLEGRO_DEBUG_CHANNEL("fdwatch")
+
+
+#define MAX_EPOLL_EVENTS   32
 
 
 typedef struct WATCH_ITEM
@@ -46,12 +65,194 @@ static _AL_THREAD fd_watch_thread;
 static _AL_MUTEX fd_watch_mutex = _AL_MUTEX_UNINITED;
 static _AL_VECTOR fd_watch_list = _AL_VECTOR_INITIALIZER(WATCH_ITEM);
 
+/* Written to wake up the thread.  With eventfd both ends are the same
+ * descriptor, otherwise they are the two ends of a pipe.
+ */
+static int wake_fd[2] = { -1, -1 };
+
+#ifdef USE_EPOLL
+static int epoll_fd = -1;
+static bool use_epoll = false;
+#endif
+
+
+
+/* find_item: [any thread, fd_watch_mutex held]
+ *  Returns the watch item for fd, or NULL.
+ */
+static WATCH_ITEM *find_item(int fd)
+{
+   WATCH_ITEM *wi;
+   unsigned int i;
+
+   for (i = 0; i < _al_vector_size(&fd_watch_list); i++) {
+      wi = _al_vector_ref(&fd_watch_list, i);
+      if (wi->fd == fd)
+         return wi;
+   }
+   return NULL;
+}
+
 
 
-/* fd_watch_thread_func: [fdwatch thread]
+/* wake_thread: [primary thread]
+ *  Makes the thread return from epoll_wait or select.
+ */
+static void wake_thread(void)
+{
+   char c = 0;
+
+#ifdef USE_EPOLL
+   if (use_epoll) {
+      uint64_t one = 1;
+      if (write(wake_fd[1], &one, sizeof(one)) < 0) {
+         ALLEGRO_WARN("Could not wake fdwatch thread: %s\n", strerror(errno));
+      }
+      return;
+   }
+#endif
+   if (write(wake_fd[1], &c, 1) < 0 && errno != EAGAIN) {
+      ALLEGRO_WARN("Could not wake fdwatch thread: %s\n", strerror(errno));
+   }
+}
+
+
+
+/* drain_wake_fd: [fdwatch thread]
+ */
+static void drain_wake_fd(void)
+{
+   char buf[64];
+
+   while (read(wake_fd[0], buf, sizeof(buf)) > 0) {
+   }
+}
+
+
+
+/* dispatch: [fdwatch thread, fd_watch_mutex held]
+ *  Calls the callback for fd, unless it was removed in the meantime.
+ */
+static void dispatch(int fd)
+{
+   WATCH_ITEM *wi;
+
+   if (fd == wake_fd[0]) {
+      drain_wake_fd();
+      return;
+   }
+
+   wi = find_item(fd);
+   if (wi) {
+      /* The callback is allowed to modify the watch list so the mutex
+       * must be recursive.
+       */
+      wi->callback(wi->cb_data);
+   }
+}
+
+
+
+#ifdef USE_EPOLL
+
+/* epoll_thread_func: [fdwatch thread]
  *  The thread loop function.
  */
-static void fd_watch_thread_func(_AL_THREAD *self, void *unused)
+static void epoll_thread_func(_AL_THREAD *self, void *unused)
+{
+   struct epoll_event events[MAX_EPOLL_EVENTS];
+   int n, i;
+
+   (void)unused;
+
+   while (!_al_get_thread_should_stop(self)) {
+      /* wait for something to happen on one of the fds */
+      n = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, -1);
+      if (n < 1)
+         continue;
+
+      /* one or more of the fds has activity */
+      _al_mutex_lock(&fd_watch_mutex);
+      for (i = 0; i < n; i++) {
+         dispatch(events[i].data.fd);
+      }
+      _al_mutex_unlock(&fd_watch_mutex);
+   }
+}
+
+
+
+static bool epoll_open_watcher(void)
+{
+   struct epoll_event ev;
+
+   epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+   if (epoll_fd < 0) {
+      ALLEGRO_ERROR("epoll_create1 failed: %s\n", strerror(errno));
+      return false;
+   }
+
+   wake_fd[0] = wake_fd[1] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+   if (wake_fd[0] < 0) {
+      ALLEGRO_ERROR("eventfd failed: %s\n", strerror(errno));
+      close(epoll_fd);
+      epoll_fd = -1;
+      return false;
+   }
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.fd = wake_fd[0];
+   epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd[0], &ev);
+
+   return true;
+}
+
+
+
+static void epoll_close_watcher(void)
+{
+   close(wake_fd[0]);
+   wake_fd[0] = wake_fd[1] = -1;
+   close(epoll_fd);
+   epoll_fd = -1;
+}
+
+
+
+/* The thread sees additions and removals straight away, so there is no
+ * need to wake it.  A removed fd may still be reported once, which
+ * dispatch() ignores.
+ */
+static void epoll_add_fd(int fd)
+{
+   struct epoll_event ev;
+
+   memset(&ev, 0, sizeof(ev));
+   /* Edge-triggered, so callbacks must read until EAGAIN. */
+   ev.events = EPOLLIN | EPOLLET;
+   ev.data.fd = fd;
+   if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      ALLEGRO_WARN("Could not watch fd %d: %s\n", fd, strerror(errno));
+   }
+}
+
+
+
+static void epoll_remove_fd(int fd)
+{
+   /* Fails harmlessly if the fd has already been closed. */
+   epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+#endif /* USE_EPOLL */
+
+
+
+/* select_thread_func: [fdwatch thread]
+ *  The thread loop function.
+ */
+static void select_thread_func(_AL_THREAD *self, void *unused)
 {
    (void)unused;
 
@@ -67,7 +268,8 @@ static void fd_watch_thread_func(_AL_THREAD *self, void *unused)
          unsigned int i;
 
          FD_ZERO(&rfds);
-         max_fd = -1;
+         FD_SET(wake_fd[0], &rfds);
+         max_fd = wake_fd[0];
 
          for (i = 0; i < _al_vector_size(&fd_watch_list); i++) {
             wi = _al_vector_ref(&fd_watch_list, i);
@@ -79,32 +281,17 @@ static void fd_watch_thread_func(_AL_THREAD *self, void *unused)
       _al_mutex_unlock(&fd_watch_mutex);
 
       /* wait for something to happen on one of the fds */
-      {
-         struct timeval tv;
-         int retval;
-
-         tv.tv_sec = 0;
-         tv.tv_usec = 250000;
-
-         retval = select(max_fd+1, &rfds, NULL, NULL, &tv);
-         if (retval < 1)
-            continue;
-      }
+      if (select(max_fd+1, &rfds, NULL, NULL, NULL) < 1)
+         continue;
 
       /* one or more of the fds has activity */
       _al_mutex_lock(&fd_watch_mutex);
       {
-         WATCH_ITEM *wi;
-         unsigned int i;
+         int fd;
 
-         for (i = 0; i < _al_vector_size(&fd_watch_list); i++) {
-            wi = _al_vector_ref(&fd_watch_list, i);
-            if (FD_ISSET(wi->fd, &rfds)) {
-               /* The callback is allowed to modify the watch list so the mutex
-                * must be recursive.
-                */
-               wi->callback(wi->cb_data);
-            }
+         for (fd = 0; fd <= max_fd; fd++) {
+            if (FD_ISSET(fd, &rfds))
+               dispatch(fd);
          }
       }
       _al_mutex_unlock(&fd_watch_mutex);
@@ -113,12 +300,121 @@ static void fd_watch_thread_func(_AL_THREAD *self, void *unused)
 
 
 
+static bool select_open_watcher(void)
+{
+   if (pipe(wake_fd) != 0) {
+      ALLEGRO_ERROR("pipe failed: %s\n", strerror(errno));
+      return false;
+   }
+   fcntl(wake_fd[0], F_SETFL, O_NONBLOCK);
+   fcntl(wake_fd[1], F_SETFL, O_NONBLOCK);
+   return true;
+}
+
+
+
+static void select_close_watcher(void)
+{
+   close(wake_fd[0]);
+   close(wake_fd[1]);
+   wake_fd[0] = wake_fd[1] = -1;
+}
+
+
+
+/* The fd_set is rebuilt on every loop, so just make the thread loop. */
+static void select_add_fd(int fd)
+{
+   (void)fd;
+   wake_thread();
+}
+
+
+
+static void select_remove_fd(int fd)
+{
+   (void)fd;
+   wake_thread();
+}
+
+
+/* The select() watcher is always built, as a fallback for when epoll or
+ * eventfd are unavailable at run time.
+ */
+
+static void fd_watch_thread_func(_AL_THREAD *self, void *unused)
+{
+#ifdef USE_EPOLL
+   if (use_epoll) {
+      epoll_thread_func(self, unused);
+      return;
+   }
+#endif
+   select_thread_func(self, unused);
+}
+
+
+
+static bool open_watcher(void)
+{
+#ifdef USE_EPOLL
+   use_epoll = epoll_open_watcher();
+   if (use_epoll)
+      return true;
+   ALLEGRO_WARN("Falling back to select()\n");
+#endif
+   return select_open_watcher();
+}
+
+
+
+static void close_watcher(void)
+{
+#ifdef USE_EPOLL
+   if (use_epoll) {
+      epoll_close_watcher();
+      return;
+   }
+#endif
+   select_close_watcher();
+}
+
+
+
+static void add_fd(int fd)
+{
+#ifdef USE_EPOLL
+   if (use_epoll) {
+      epoll_add_fd(fd);
+      return;
+   }
+#endif
+   select_add_fd(fd);
+}
+
+
+
+static void remove_fd(int fd)
+{
+#ifdef USE_EPOLL
+   if (use_epoll) {
+      epoll_remove_fd(fd);
+      return;
+   }
+#endif
+   select_remove_fd(fd);
+}
+
+
+
 /* _al_unix_start_watching_fd: [primary thread]
  * 
  *  Start watching for data on file descriptor `fd'.  This is done in
  *  a background thread, which is started if necessary.  When there is
  *  data waiting to be read on fd, `callback' is applied to `cb_data'.
- *  The callback function should read as much data off fd as possible.
+ *  The callback function must read as much data off fd as possible,
+ *  i.e. until read() fails with EAGAIN, as it will not be called again
+ *  for data which was already waiting.  Hence fd should be non-blocking.
  *
  *  Note: the callback is run from the background thread.  You can
  *  assume there is only one callback being called from the fdwatch
@@ -131,6 +427,8 @@ void _al_unix_start_watching_fd(int fd, void (*callback)(void *), void *cb_data)
 
    /* start the background thread if necessary */
    if (_al_vector_size(&fd_watch_list) == 0) {
+      if (!open_watcher())
+         return;
       /* We need a recursive mutex to allow callbacks to modify the fd watch
        * list.
        */
@@ -146,6 +444,8 @@ void _al_unix_start_watching_fd(int fd, void (*callback)(void *), void *cb_data)
       wi->fd = fd;
       wi->callback = callback;
       wi->cb_data = cb_data;
+
+      add_fd(fd);
    }
    _al_mutex_unlock(&fd_watch_mutex);
 }
@@ -174,6 +474,7 @@ void _al_unix_stop_watching_fd(int fd)
          if (wi->fd == fd) {
             _al_vector_delete_at(&fd_watch_list, i);
             list_empty = _al_vector_is_empty(&fd_watch_list);
+            remove_fd(fd);
             break;
          }
       }
@@ -182,9 +483,12 @@ void _al_unix_stop_watching_fd(int fd)
 
    /* if no more fd's are being watched, stop the background thread */
    if (list_empty) {
+      _al_thread_set_should_stop(&fd_watch_thread);
+      wake_thread();
       _al_thread_join(&fd_watch_thread);
       _al_mutex_destroy(&fd_watch_mutex);
       _al_vector_free(&fd_watch_list);
+      close_watcher();
    }
 }
 
@@ -28,8 +28,39 @@ ALLEGRO_STATIC_ASSERT(utime,
    sizeof(ALLEGRO_TIMEOUT_UNIX) <= sizeof(ALLEGRO_TIMEOUT));
 
 
+#ifdef ALLEGRO_HAVE_CLOCK_GETTIME
+   #include <time.h>
+#endif
+
+
+#if defined(ALLEGRO_HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+   /* The clock read by al_get_time().  The monotonic clock does not jump
+    * when the system time is changed, and is read without a system call
+    * on most systems.
+    */
+   static clockid_t time_clock = CLOCK_MONOTONIC;
+   #define HAVE_TIME_CLOCK
+#endif
+
 /* Marks the time Allegro was initialised, for al_get_time(). */
-struct timeval _al_unix_initial_time;
+static int64_t initial_time_ns;
+
+
+
+static int64_t current_time_ns(void)
+{
+#ifdef HAVE_TIME_CLOCK
+   struct timespec now;
+
+   clock_gettime(time_clock, &now);
+   return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+#else
+   struct timeval now;
+
+   gettimeofday(&now, NULL);
+   return (int64_t) now.tv_sec * 1000000000 + (int64_t) now.tv_usec * 1000;
+#endif
+}
 
 
 
@@ -38,7 +69,24 @@ struct timeval _al_unix_initial_time;
  */
 void _al_unix_init_time(void)
 {
-   gettimeofday(&_al_unix_initial_time, NULL);
+#ifdef HAVE_TIME_CLOCK
+   struct timespec ts;
+
+   /* The monotonic clock may be missing at run time on old systems. */
+   if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+      time_clock = CLOCK_REALTIME;
+#endif
+
+   initial_time_ns = current_time_ns();
+}
+
+
+
+/* Function: al_get_time_ns
+ */
+int64_t al_get_time_ns(void)
+{
+   return current_time_ns() - initial_time_ns;
 }
 
 
@@ -47,13 +95,7 @@ void _al_unix_init_time(void)
  */
 double al_get_time(void)
 {
-   struct timeval now;
-   double time;
-
-   gettimeofday(&now, NULL);
-   time = (double) (now.tv_sec - _al_unix_initial_time.tv_sec)
-      + (double) (now.tv_usec - _al_unix_initial_time.tv_usec) * 1.0e-6;
-   return time;
+   return (double) al_get_time_ns() / 1.0e9;
 }
 
 
@@ -76,23 +118,31 @@ void al_rest(double seconds)
 void al_init_timeout(ALLEGRO_TIMEOUT *timeout, double seconds)
 {
     ALLEGRO_TIMEOUT_UNIX *ut = (ALLEGRO_TIMEOUT_UNIX *) timeout;
-    struct timeval now;
+    struct timespec now;
     double integral;
     double frac;
 
     ASSERT(ut);
 
-    gettimeofday(&now, NULL);
+#ifdef _AL_TIMEOUT_CLOCK
+    clock_gettime(_AL_TIMEOUT_CLOCK, &now);
+#else
+    {
+       struct timeval tv;
+       gettimeofday(&tv, NULL);
+       now.tv_sec = tv.tv_sec;
+       now.tv_nsec = tv.tv_usec * 1000;
+    }
+#endif
 
     if (seconds <= 0.0) {
-	ut->abstime.tv_sec = now.tv_sec;
-	ut->abstime.tv_nsec = now.tv_usec * 1000;
+	ut->abstime = now;
     }
     else {
 	frac = modf(seconds, &integral);
 
 	ut->abstime.tv_sec = now.tv_sec + integral;
-	ut->abstime.tv_nsec = (now.tv_usec * 1000) + (frac * 1000000000L);
+	ut->abstime.tv_nsec = now.tv_nsec + (frac * 1000000000L);
 	ut->abstime.tv_sec += ut->abstime.tv_nsec / 1000000000L;
 	ut->abstime.tv_nsec = ut->abstime.tv_nsec % 1000000000L;
     }
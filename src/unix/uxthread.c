@@ -16,7 +16,8 @@
  */
 
 
-#define _XOPEN_SOURCE 500       /* for Unix98 recursive mutexes */
+#define _XOPEN_SOURCE 600       /* for Unix98 recursive mutexes and */
+                                /* pthread_condattr_setclock */
                                 /* XXX: added configure test */
 
 #include <sys/time.h>
@@ -42,6 +43,7 @@ static void *thread_proc_trampoline(void *data)
    _al_android_thread_created();
 #endif
    (*thread->proc)(thread, thread->arg);
+   _al_release_memory_pool_cache();
 #ifdef ALLEGRO_ANDROID
    _al_android_thread_ended();
 #endif
@@ -146,6 +148,22 @@ void _al_mutex_destroy(_AL_MUTEX *mutex)
 /* condition variables */
 /* most of the condition variable implementation is actually inline */
 
+void _al_cond_init(_AL_COND *cond)
+{
+#ifdef _AL_TIMEOUT_CLOCK
+   pthread_condattr_t attr;
+
+   /* Measure timeouts against the same clock as al_init_timeout. */
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, _AL_TIMEOUT_CLOCK);
+   pthread_cond_init(&cond->cond, &attr);
+   pthread_condattr_destroy(&attr);
+#else
+   pthread_cond_init(&cond->cond, NULL);
+#endif
+}
+
+
 int _al_cond_timedwait(_AL_COND *cond, _AL_MUTEX *mutex,
    const ALLEGRO_TIMEOUT *timeout)
 {
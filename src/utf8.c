@@ -21,6 +21,8 @@
 #include "allegro5/utf8.h"
 #include "allegro5/internal/bstrlib.h"
 #include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_vector.h"
 
 ALLEGRO_STATIC_ASSERT(utf8,
    sizeof(ALLEGRO_USTR_INFO) >= sizeof(struct _al_tagbstring));
@@ -42,11 +44,29 @@ ALLEGRO_STATIC_ASSERT(utf8,
 #define IS_TRAIL_BYTE(c)   (((unsigned)(c) & 0xC0) == 0x80)
 
 
+/* Mask of the high bit of each byte in a 64-bit word. */
+#define ASCII_MASK   (((uint64_t)0x80808080u << 32) | 0x80808080u)
+
+
+/* Return true if the eight bytes at `p` are all 7-bit ASCII. */
+static INLINE bool ascii_word(const unsigned char *p)
+{
+   uint64_t w;
+   memcpy(&w, p, sizeof(w));
+   return (w & ASCII_MASK) == 0;
+}
+
+
 static bool all_ascii(const ALLEGRO_USTR *us)
 {
    const unsigned char *data = (const unsigned char *) _al_bdata(us);
    int size = _al_blength(us);
 
+   for (; size >= 8; data += 8, size -= 8) {
+      if (!ascii_word(data))
+         return false;
+   }
+
    while (size-- > 0) {
       if (*data > 127)
          return false;
@@ -57,6 +77,295 @@ static bool all_ascii(const ALLEGRO_USTR *us)
 }
 
 
+/* Return true if the byte at `pos` begins a code point, as far as
+ * al_ustr_next is concerned.  The first byte always does.
+ */
+static INLINE bool is_start(const unsigned char *data, int pos)
+{
+   return pos == 0 || IS_SINGLE_BYTE(data[pos]) || IS_LEAD_BYTE(data[pos]);
+}
+
+
+/* Code point indexes.
+ *
+ * An indexed string remembers its length and the byte offset of every
+ * INDEX_STRIDE'th code point, so al_ustr_offset only has to walk a short
+ * distance from the nearest checkpoint.  ALLEGRO_USTR is part of the ABI
+ * and has no room for the index, so indexes are kept in a table on the
+ * side.  They are meant for a few large strings, e.g. text editor buffers.
+ *
+ * A change at byte offset `pos` leaves every checkpoint before `pos`
+ * intact, so mutators only drop the checkpoints from there on and the
+ * index is completed again on the next lookup.
+ */
+#define INDEX_STRIDE    64
+
+typedef struct USTR_INDEX {
+   const ALLEGRO_USTR *us;
+   bool complete;          /* length and checkpoints cover the whole string */
+   size_t length;
+   int *checkpoints;       /* byte offset of code point i * INDEX_STRIDE */
+   int num_checkpoints;
+   int max_checkpoints;
+} USTR_INDEX;
+
+static _AL_VECTOR indexes = _AL_VECTOR_INITIALIZER(USTR_INDEX *);
+static ALLEGRO_MUTEX *indexes_mutex;
+/* Lets mutators skip the lock when nothing is indexed. */
+static volatile int num_indexes;
+
+
+/* Must be called with indexes_mutex held. */
+static int find_index(const ALLEGRO_USTR *us)
+{
+   unsigned int i;
+
+   for (i = 0; i < _al_vector_size(&indexes); i++) {
+      USTR_INDEX **ix = _al_vector_ref(&indexes, i);
+      if ((*ix)->us == us)
+         return i;
+   }
+
+   return -1;
+}
+
+
+static void free_index(USTR_INDEX *ix)
+{
+   al_free(ix->checkpoints);
+   al_free(ix);
+}
+
+
+static bool add_checkpoint(USTR_INDEX *ix, int pos)
+{
+   if (ix->num_checkpoints == ix->max_checkpoints) {
+      int new_max = ix->max_checkpoints ? ix->max_checkpoints * 2 : 16;
+      int *p = al_realloc(ix->checkpoints, new_max * sizeof(int));
+      if (!p)
+         return false;
+      ix->checkpoints = p;
+      ix->max_checkpoints = new_max;
+   }
+
+   ix->checkpoints[ix->num_checkpoints++] = pos;
+   return true;
+}
+
+
+/* Scan the string from the last checkpoint to the end, adding
+ * checkpoints and counting the code points.
+ */
+static bool complete_index(USTR_INDEX *ix)
+{
+   const unsigned char *data = (const unsigned char *) _al_bdata(ix->us);
+   int size = _al_blength(ix->us);
+   size_t count = 0;
+   int pos = 0;
+
+   /* Rescan from the last checkpoint, which is added back below. */
+   if (ix->num_checkpoints > 0) {
+      ix->num_checkpoints--;
+      pos = ix->checkpoints[ix->num_checkpoints];
+      count = (size_t)ix->num_checkpoints * INDEX_STRIDE;
+   }
+
+   while (pos < size) {
+      unsigned step = count % INDEX_STRIDE;
+
+      /* Skip runs of ASCII which do not reach the next checkpoint. */
+      if (pos > 0 && step != 0 && step + 8 <= INDEX_STRIDE &&
+            pos + 8 <= size && ascii_word(data + pos)) {
+         pos += 8;
+         count += 8;
+         continue;
+      }
+
+      if (is_start(data, pos)) {
+         if (step == 0 && !add_checkpoint(ix, pos))
+            return false;
+         count++;
+      }
+      pos++;
+   }
+
+   ix->length = count;
+   ix->complete = true;
+   return true;
+}
+
+
+/* Return the complete index of `us`, or NULL if it is not indexed.
+ * Must be called with indexes_mutex held.
+ */
+static USTR_INDEX *get_index(const ALLEGRO_USTR *us)
+{
+   int i = find_index(us);
+   USTR_INDEX *ix;
+
+   if (i < 0)
+      return NULL;
+
+   ix = *(USTR_INDEX **)_al_vector_ref(&indexes, i);
+   if (!ix->complete && !complete_index(ix))
+      return NULL;
+
+   return ix;
+}
+
+
+static bool indexed_length(const ALLEGRO_USTR *us, size_t *length)
+{
+   USTR_INDEX *ix;
+
+   if (num_indexes == 0)
+      return false;
+
+   al_lock_mutex(indexes_mutex);
+   ix = get_index(us);
+   if (ix)
+      *length = ix->length;
+   al_unlock_mutex(indexes_mutex);
+
+   return ix != NULL;
+}
+
+
+/* Move `*pos` to the checkpoint at or before code point `*index`, and
+ * reduce `*index` by the number of code points skipped.  Negative indexes
+ * count back from the end, as for al_ustr_offset.
+ */
+static bool indexed_offset(const ALLEGRO_USTR *us, int *index, int *pos)
+{
+   USTR_INDEX *ix;
+
+   if (num_indexes == 0)
+      return false;
+
+   al_lock_mutex(indexes_mutex);
+   ix = get_index(us);
+   if (ix) {
+      if (*index < 0)
+         *index += (int)ix->length;
+      if (*index < 0) {
+         *index = 0;
+      }
+      else if ((size_t)*index >= ix->length) {
+         *index = 0;
+         *pos = _al_blength(us);
+      }
+      else {
+         *pos = ix->checkpoints[*index / INDEX_STRIDE];
+         *index %= INDEX_STRIDE;
+      }
+   }
+   al_unlock_mutex(indexes_mutex);
+
+   return ix != NULL;
+}
+
+
+/* Called after `us` has been changed from byte offset `pos` onwards. */
+static void invalidate_index(const ALLEGRO_USTR *us, int pos)
+{
+   int i;
+
+   if (num_indexes == 0)
+      return;
+
+   al_lock_mutex(indexes_mutex);
+   i = find_index(us);
+   if (i >= 0) {
+      USTR_INDEX *ix = *(USTR_INDEX **)_al_vector_ref(&indexes, i);
+      /* The first checkpoint is always at the start of the string. */
+      while (ix->num_checkpoints > 1 &&
+            ix->checkpoints[ix->num_checkpoints - 1] >= pos) {
+         ix->num_checkpoints--;
+      }
+      ix->complete = false;
+   }
+   al_unlock_mutex(indexes_mutex);
+}
+
+
+static void remove_index(const ALLEGRO_USTR *us)
+{
+   int i;
+
+   if (num_indexes == 0)
+      return;
+
+   al_lock_mutex(indexes_mutex);
+   i = find_index(us);
+   if (i >= 0) {
+      free_index(*(USTR_INDEX **)_al_vector_ref(&indexes, i));
+      _al_vector_delete_at(&indexes, i);
+      num_indexes--;
+   }
+   al_unlock_mutex(indexes_mutex);
+}
+
+
+static void shutdown_ustr_indexes(void)
+{
+   unsigned int i;
+
+   num_indexes = 0;
+   for (i = 0; i < _al_vector_size(&indexes); i++) {
+      free_index(*(USTR_INDEX **)_al_vector_ref(&indexes, i));
+   }
+   _al_vector_free(&indexes);
+   al_destroy_mutex(indexes_mutex);
+   indexes_mutex = NULL;
+}
+
+
+void _al_init_ustr_indexes(void)
+{
+   indexes_mutex = al_create_mutex();
+   _al_add_exit_func(shutdown_ustr_indexes, "shutdown_ustr_indexes");
+}
+
+
+/* Function: al_ustr_set_indexed
+ */
+bool al_ustr_set_indexed(ALLEGRO_USTR *us, bool indexed)
+{
+   USTR_INDEX *ix;
+   USTR_INDEX **slot;
+   bool ok = true;
+
+   ASSERT(us);
+
+   if (!indexed) {
+      remove_index(us);
+      return true;
+   }
+
+   /* Referenced strings may change behind our back. */
+   if (!indexes_mutex || us->mlen <= 0)
+      return false;
+
+   al_lock_mutex(indexes_mutex);
+   if (find_index(us) < 0) {
+      ix = al_calloc(1, sizeof(*ix));
+      slot = ix ? _al_vector_alloc_back(&indexes) : NULL;
+      if (slot) {
+         ix->us = us;
+         *slot = ix;
+         num_indexes++;
+      }
+      else {
+         al_free(ix);
+         ok = false;
+      }
+   }
+   al_unlock_mutex(indexes_mutex);
+
+   return ok;
+}
+
+
 /* Function: al_ustr_new
  */
 ALLEGRO_USTR *al_ustr_new(const char *s)
@@ -92,6 +401,7 @@ ALLEGRO_USTR *al_ustr_newf(const char *fmt, ...)
  */
 void al_ustr_free(ALLEGRO_USTR *us)
 {
+   remove_index(us);
    _al_bdestroy(us);
 }
 
@@ -204,11 +514,22 @@ size_t al_ustr_size(const ALLEGRO_USTR *us)
  */
 size_t al_ustr_length(const ALLEGRO_USTR *us)
 {
-   int pos = 0;
-   int c = 0;
+   const unsigned char *data = (const unsigned char *) _al_bdata(us);
+   int size = _al_blength(us);
+   size_t c = 0;
+   int pos;
+
+   if (indexed_length(us, &c))
+      return c;
 
-   while (al_ustr_next(us, &pos))
-      c++;
+   for (pos = 0; pos < size; pos++) {
+      while (pos > 0 && pos + 8 <= size && ascii_word(data + pos)) {
+         pos += 8;
+         c += 8;
+      }
+      if (pos < size && is_start(data, pos))
+         c++;
+   }
 
    return c;
 }
@@ -218,14 +539,23 @@ size_t al_ustr_length(const ALLEGRO_USTR *us)
  */
 int al_ustr_offset(const ALLEGRO_USTR *us, int index)
 {
+   const unsigned char *data = (const unsigned char *) _al_bdata(us);
+   int size = _al_blength(us);
    int pos = 0;
 
-   if (index < 0)
+   if (!indexed_offset(us, &index, &pos) && index < 0)
       index += al_ustr_length(us);
 
-   while (index-- > 0) {
+   while (index > 0) {
+      /* Each of the next eight bytes is a code point if they are ASCII. */
+      if (index >= 8 && pos + 9 <= size && ascii_word(data + pos + 1)) {
+         pos += 8;
+         index -= 8;
+         continue;
+      }
       if (!al_ustr_next(us, &pos))
          return pos;
+      index--;
    }
 
    return pos;
@@ -399,7 +729,9 @@ int32_t al_ustr_prev_get(const ALLEGRO_USTR *us, int *pos)
  */
 bool al_ustr_insert(ALLEGRO_USTR *us1, int pos, const ALLEGRO_USTR *us2)
 {
-   return _al_binsert(us1, pos, us2, '\0') == _AL_BSTR_OK;
+   int rc = _al_binsert(us1, pos, us2, '\0');
+   invalidate_index(us1, pos);
+   return rc == _AL_BSTR_OK;
 }
 
 
@@ -421,15 +753,18 @@ size_t al_ustr_insert_chr(ALLEGRO_USTR *us, int pos, int32_t c)
    size_t sz;
 
    if (uc < 128) {
-      return (_al_binsertch(us, pos, 1, uc) == _AL_BSTR_OK) ? 1 : 0;
+      sz = (_al_binsertch(us, pos, 1, uc) == _AL_BSTR_OK) ? 1 : 0;
    }
-
-   sz = al_utf8_width(c);
-   if (_al_binsertch(us, pos, sz, '\0') == _AL_BSTR_OK) {
-      return al_utf8_encode(_al_bdataofs(us, pos), c);
+   else {
+      sz = al_utf8_width(c);
+      if (_al_binsertch(us, pos, sz, '\0') == _AL_BSTR_OK)
+         sz = al_utf8_encode(_al_bdataofs(us, pos), c);
+      else
+         sz = 0;
    }
 
-   return 0;
+   invalidate_index(us, pos);
+   return sz;
 }
 
 
@@ -437,7 +772,10 @@ size_t al_ustr_insert_chr(ALLEGRO_USTR *us, int pos, int32_t c)
  */
 bool al_ustr_append(ALLEGRO_USTR *us1, const ALLEGRO_USTR *us2)
 {
-   return _al_bconcat(us1, us2) == _AL_BSTR_OK;
+   int pos = _al_blength(us1);
+   int rc = _al_bconcat(us1, us2);
+   invalidate_index(us1, pos);
+   return rc == _AL_BSTR_OK;
 }
 
 
@@ -445,7 +783,10 @@ bool al_ustr_append(ALLEGRO_USTR *us1, const ALLEGRO_USTR *us2)
  */
 bool al_ustr_append_cstr(ALLEGRO_USTR *us, const char *s)
 {
-   return _al_bcatcstr(us, s) == _AL_BSTR_OK;
+   int pos = _al_blength(us);
+   int rc = _al_bcatcstr(us, s);
+   invalidate_index(us, pos);
+   return rc == _AL_BSTR_OK;
 }
 
 
@@ -456,7 +797,10 @@ size_t al_ustr_append_chr(ALLEGRO_USTR *us, int32_t c)
    uint32_t uc = c;
 
    if (uc < 128) {
-      return (_al_bconchar(us, uc) == _AL_BSTR_OK) ? 1 : 0;
+      int pos = _al_blength(us);
+      int rc = _al_bconchar(us, uc);
+      invalidate_index(us, pos);
+      return (rc == _AL_BSTR_OK) ? 1 : 0;
    }
 
    return al_ustr_insert_chr(us, al_ustr_size(us), c);
@@ -482,6 +826,7 @@ bool al_ustr_appendf(ALLEGRO_USTR *us, const char *fmt, ...)
 bool al_ustr_vappendf(ALLEGRO_USTR *us, const char *fmt, va_list ap)
 {
    va_list arglist;
+   int pos = _al_blength(us);
    int sz;
    int rc;
 
@@ -499,11 +844,13 @@ bool al_ustr_vappendf(ALLEGRO_USTR *us, const char *fmt, va_list ap)
       va_end(arglist);
 
       if (rc >= 0) {
+         invalidate_index(us, pos);
          return true;
       }
 
       if (rc == _AL_BSTR_ERR) {
          /* A real error? */
+         invalidate_index(us, pos);
          return false;
       }
 
@@ -519,13 +866,16 @@ bool al_ustr_remove_chr(ALLEGRO_USTR *us, int pos)
 {
    int32_t c;
    size_t w;
+   int rc;
 
    c = al_ustr_get(us, pos);
    if (c < 0)
       return false;
 
    w = al_utf8_width(c);
-   return _al_bdelete(us, pos, w) == _AL_BSTR_OK;
+   rc = _al_bdelete(us, pos, w);
+   invalidate_index(us, pos);
+   return rc == _AL_BSTR_OK;
 }
 
 
@@ -533,7 +883,9 @@ bool al_ustr_remove_chr(ALLEGRO_USTR *us, int pos)
  */
 bool al_ustr_remove_range(ALLEGRO_USTR *us, int start_pos, int end_pos)
 {
-   return _al_bdelete(us, start_pos, end_pos - start_pos) == _AL_BSTR_OK;
+   int rc = _al_bdelete(us, start_pos, end_pos - start_pos);
+   invalidate_index(us, start_pos);
+   return rc == _AL_BSTR_OK;
 }
 
 
@@ -541,7 +893,9 @@ bool al_ustr_remove_range(ALLEGRO_USTR *us, int start_pos, int end_pos)
  */
 bool al_ustr_truncate(ALLEGRO_USTR *us, int start_pos)
 {
-   return _al_btrunc(us, start_pos) == _AL_BSTR_OK;
+   int rc = _al_btrunc(us, start_pos);
+   invalidate_index(us, start_pos);
+   return rc == _AL_BSTR_OK;
 }
 
 
@@ -549,7 +903,9 @@ bool al_ustr_truncate(ALLEGRO_USTR *us, int start_pos)
  */
 bool al_ustr_ltrim_ws(ALLEGRO_USTR *us)
 {
-   return _al_bltrimws(us) == _AL_BSTR_OK;
+   int rc = _al_bltrimws(us);
+   invalidate_index(us, 0);
+   return rc == _AL_BSTR_OK;
 }
 
 
@@ -557,7 +913,9 @@ bool al_ustr_ltrim_ws(ALLEGRO_USTR *us)
  */
 bool al_ustr_rtrim_ws(ALLEGRO_USTR *us)
 {
-   return _al_brtrimws(us) == _AL_BSTR_OK;
+   int rc = _al_brtrimws(us);
+   invalidate_index(us, _al_blength(us));
+   return rc == _AL_BSTR_OK;
 }
 
 
@@ -565,7 +923,9 @@ bool al_ustr_rtrim_ws(ALLEGRO_USTR *us)
  */
 bool al_ustr_trim_ws(ALLEGRO_USTR *us)
 {
-   return _al_btrimws(us) == _AL_BSTR_OK;
+   int rc = _al_btrimws(us);
+   invalidate_index(us, 0);
+   return rc == _AL_BSTR_OK;
 }
 
 
@@ -573,7 +933,9 @@ bool al_ustr_trim_ws(ALLEGRO_USTR *us)
  */
 bool al_ustr_assign(ALLEGRO_USTR *us1, const ALLEGRO_USTR *us2)
 {
-   return _al_bassign(us1, us2) == _AL_BSTR_OK;
+   int rc = _al_bassign(us1, us2);
+   invalidate_index(us1, 0);
+   return rc == _AL_BSTR_OK;
 }
 
 
@@ -583,6 +945,7 @@ bool al_ustr_assign_substr(ALLEGRO_USTR *us1, const ALLEGRO_USTR *us2,
    int start_pos, int end_pos)
 {
    int rc = _al_bassignmidstr(us1, us2, start_pos, end_pos - start_pos);
+   invalidate_index(us1, 0);
    return rc == _AL_BSTR_OK;
 }
 
@@ -591,7 +954,9 @@ bool al_ustr_assign_substr(ALLEGRO_USTR *us1, const ALLEGRO_USTR *us2,
  */
 bool al_ustr_assign_cstr(ALLEGRO_USTR *us1, const char *s)
 {
-   return _al_bassigncstr(us1, s) == _AL_BSTR_OK;
+   int rc = _al_bassigncstr(us1, s);
+   invalidate_index(us1, 0);
+   return rc == _AL_BSTR_OK;
 }
 
 
@@ -620,6 +985,7 @@ size_t al_ustr_set_chr(ALLEGRO_USTR *us, int start_pos, int32_t c)
    else
       rc = _AL_BSTR_OK;
 
+   invalidate_index(us, start_pos);
    if (rc == _AL_BSTR_OK)
       return al_utf8_encode(_al_bdataofs(us, start_pos), c);
    else
@@ -632,8 +998,9 @@ size_t al_ustr_set_chr(ALLEGRO_USTR *us, int start_pos, int32_t c)
 bool al_ustr_replace_range(ALLEGRO_USTR *us1, int start_pos1, int end_pos1,
    const ALLEGRO_USTR *us2)
 {
-   return _al_breplace(us1, start_pos1, end_pos1 - start_pos1, us2, '\0')
-      == _AL_BSTR_OK;
+   int rc = _al_breplace(us1, start_pos1, end_pos1 - start_pos1, us2, '\0');
+   invalidate_index(us1, start_pos1);
+   return rc == _AL_BSTR_OK;
 }
 
 
@@ -852,7 +1219,9 @@ int al_ustr_rfind_cstr(const ALLEGRO_USTR *haystack, int end_pos,
 bool al_ustr_find_replace(ALLEGRO_USTR *us, int start_pos,
    const ALLEGRO_USTR *find, const ALLEGRO_USTR *replace)
 {
-   return _al_bfindreplace(us, find, replace, start_pos) == _AL_BSTR_OK;
+   int rc = _al_bfindreplace(us, find, replace, start_pos);
+   invalidate_index(us, start_pos);
+   return rc == _AL_BSTR_OK;
 }
 
 
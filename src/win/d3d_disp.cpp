@@ -2757,6 +2757,7 @@ static void d3d_flush_vertex_cache(ALLEGRO_DISPLAY* disp)
    }
 
    disp->num_cache_vertices = 0;
+   _AL_RENDER_STATS_ADD(vertex_cache_flushes, 1);
 #ifdef ALLEGRO_CFG_SHADER_HLSL
    if (disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
       d3d_disp->effect->End();
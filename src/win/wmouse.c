@@ -103,10 +103,12 @@ static void generate_mouse_event(unsigned int type,
 {
    ALLEGRO_EVENT event;
 
-   if (!_al_event_source_needs_to_generate_event(&the_mouse.es))
+   _al_event_source_lock(&the_mouse.es);
+   if (!_al_event_source_wants_event_type(&the_mouse.es, type)) {
+      _al_event_source_unlock(&the_mouse.es);
       return;
+   }
 
-   _al_event_source_lock(&the_mouse.es);
    event.mouse.type = type;
    event.mouse.timestamp = al_get_time();
    event.mouse.display = source;
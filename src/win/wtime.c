@@ -30,6 +30,7 @@ ALLEGRO_STATIC_ASSERT(wtime,
 	(int64_t)li.LowPart)
 
 static int64_t high_res_timer_freq;
+static int64_t high_res_initial_count;
 static int64_t _al_win_prev_time;
 static double _al_win_total_time;
 
@@ -89,6 +90,22 @@ double al_get_time(void)
 }
 
 
+int64_t al_get_time_ns(void)
+{
+   LARGE_INTEGER count;
+   int64_t ticks;
+
+   if (real_get_time_func != high_res_current_time)
+      return (int64_t)(low_res_current_time() * 1.0e9);
+
+   /* Split the conversion so that it cannot overflow. */
+   QueryPerformanceCounter(&count);
+   ticks = LARGE_INTEGER_TO_INT64(count) - high_res_initial_count;
+   return (ticks / high_res_timer_freq) * 1000000000 +
+      (ticks % high_res_timer_freq) * 1000000000 / high_res_timer_freq;
+}
+
+
 void _al_win_init_time(void)
 {
    LARGE_INTEGER tmp_freq;
@@ -106,6 +123,7 @@ void _al_win_init_time(void)
       real_get_time_func = high_res_current_time;
       QueryPerformanceCounter(&count);
       _al_win_prev_time = LARGE_INTEGER_TO_INT64(count);
+      high_res_initial_count = _al_win_prev_time;
    }
 }
 
@@ -31,6 +31,7 @@ static unsigned __stdcall thread_proc_trampoline(void *data)
 {
    _AL_THREAD *thread = data;
    (*thread->proc)(thread, thread->arg);
+   _al_release_memory_pool_cache();
 
    /* _endthreadex does not automatically close the thread handle,
     * unlike _endthread.  We rely on this in al_join_thread().
@@ -35,6 +35,7 @@
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_events.h"
 #include "allegro5/internal/aintern_keyboard.h"
+#include "allegro5/internal/aintern_seqlock.h"
 #include "allegro5/internal/aintern_x.h"
 #include "allegro5/internal/aintern_xdisplay.h"
 #include "allegro5/internal/aintern_xkeyboard.h"
@@ -59,6 +60,7 @@ typedef struct ALLEGRO_KEYBOARD_XWIN
 {
    ALLEGRO_KEYBOARD parent;
    ALLEGRO_KEYBOARD_STATE state;
+   _AL_SEQLOCK state_lock;
    // Quit if Ctrl-Alt-Del is pressed.
    bool three_finger_flag;
 } ALLEGRO_KEYBOARD_XWIN;
@@ -481,7 +483,9 @@ void _al_xwin_keyboard_switch_handler(ALLEGRO_DISPLAY *display, bool focus_in)
    _al_event_source_lock(&the_keyboard.parent.es);
 
    if (focus_in) {
+      _al_seqlock_write_begin(&the_keyboard.state_lock);
       the_keyboard.state.display = display;
+      _al_seqlock_write_end(&the_keyboard.state_lock);
 #ifdef ALLEGRO_XWINDOWS_WITH_XIM
       if (xic) {
          ALLEGRO_DISPLAY_XGLX *display_glx = (void *)display;
@@ -490,7 +494,9 @@ void _al_xwin_keyboard_switch_handler(ALLEGRO_DISPLAY *display, bool focus_in)
 #endif
    }
    else {
+      _al_seqlock_write_begin(&the_keyboard.state_lock);
       the_keyboard.state.display = NULL;
+      _al_seqlock_write_end(&the_keyboard.state_lock);
    }
 
    _al_event_source_unlock(&the_keyboard.parent.es);
@@ -994,15 +1000,13 @@ static const char *xkeybd_keycode_to_name(int keycode)
 
 
 /* xkeybd_get_keyboard_state:
- *  Copy the current keyboard state into RET_STATE, with any necessary locking.
+ *  Copy the current keyboard state into RET_STATE.  The copy is retried if
+ *  the bgman thread changes the state meanwhile, so this never blocks it.
  */
 static void xkeybd_get_keyboard_state(ALLEGRO_KEYBOARD_STATE *ret_state)
 {
-   _al_event_source_lock(&the_keyboard.parent.es);
-   {
-      *ret_state = the_keyboard.state;
-   }
-   _al_event_source_unlock(&the_keyboard.parent.es);
+   _AL_SEQLOCK_READ(&the_keyboard.state_lock, &the_keyboard.parent.es, *ret_state,
+      the_keyboard.state);
 }
 
 
@@ -1025,7 +1029,9 @@ static void handle_key_press(int mycode, int unichar, int filtered,
    _al_event_source_lock(&the_keyboard.parent.es);
    {
       /* Update the key_down array.  */
+      _al_seqlock_write_begin(&the_keyboard.state_lock);
       _AL_KEYBOARD_STATE_SET_KEY_DOWN(the_keyboard.state, mycode);
+      _al_seqlock_write_end(&the_keyboard.state_lock);
 
       /* Generate the events if necessary. */
       if (_al_event_source_needs_to_generate_event(&the_keyboard.parent.es)) {
@@ -1102,7 +1108,9 @@ static void handle_key_release(int mycode, ALLEGRO_DISPLAY *display)
    _al_event_source_lock(&the_keyboard.parent.es);
    {
       /* Update the key_down array.  */
+      _al_seqlock_write_begin(&the_keyboard.state_lock);
       _AL_KEYBOARD_STATE_CLEAR_KEY_DOWN(the_keyboard.state, mycode);
+      _al_seqlock_write_end(&the_keyboard.state_lock);
 
       /* Generate the release event if necessary. */
       if (_al_event_source_needs_to_generate_event(&the_keyboard.parent.es)) {
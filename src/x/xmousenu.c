@@ -26,6 +26,7 @@
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_mouse.h"
+#include "allegro5/internal/aintern_seqlock.h"
 #include "allegro5/internal/aintern_x.h"
 #include "allegro5/internal/aintern_xdisplay.h"
 #include "allegro5/internal/aintern_xmouse.h"
@@ -44,6 +45,7 @@ typedef struct ALLEGRO_MOUSE_XWIN
 {
    ALLEGRO_MOUSE parent;
    ALLEGRO_MOUSE_STATE state;
+   _AL_SEQLOCK state_lock;
    int min_x, min_y;
    int max_x, max_y;
 } ALLEGRO_MOUSE_XWIN;
@@ -230,8 +232,12 @@ static bool xmouse_set_mouse_xy(ALLEGRO_DISPLAY *display, int x, int y)
    if (x < 0 || y < 0 || x >= window_width || y >= window_height)
       return false;
 
+   _al_event_source_lock(&the_mouse.parent.es);
+   _al_seqlock_write_begin(&the_mouse.state_lock);
    the_mouse.state.x = x;
    the_mouse.state.y = y;
+   _al_seqlock_write_end(&the_mouse.state_lock);
+   _al_event_source_unlock(&the_mouse.parent.es);
 
 #ifdef ALLEGRO_RASPBERRYPI
    float scale_x, scale_y;
@@ -284,8 +290,10 @@ static bool xmouse_set_mouse_axis(int which, int v)
       int dw = w - the_mouse.state.w;
 
       if (dz != 0 || dw != 0) {
+         _al_seqlock_write_begin(&the_mouse.state_lock);
          the_mouse.state.z = z;
          the_mouse.state.w = w;
+         _al_seqlock_write_end(&the_mouse.state_lock);
 
          generate_mouse_event(
             ALLEGRO_EVENT_MOUSE_AXES,
@@ -304,17 +312,15 @@ static bool xmouse_set_mouse_axis(int which, int v)
 
 
 /* xmouse_get_state:
- *  Copy the current mouse state into RET_STATE, with any necessary locking.
+ *  Copy the current mouse state into RET_STATE, retrying if the bgman
+ *  thread updates it meanwhile instead of locking it out.
  */
 static void xmouse_get_state(ALLEGRO_MOUSE_STATE *ret_state)
 {
    ASSERT(xmouse_installed);
 
-   _al_event_source_lock(&the_mouse.parent.es);
-   {
-      *ret_state = the_mouse.state;
-   }
-   _al_event_source_unlock(&the_mouse.parent.es);
+   _AL_SEQLOCK_READ(&the_mouse.state_lock, &the_mouse.parent.es, *ret_state,
+      the_mouse.state);
 }
 
 
@@ -340,8 +346,10 @@ void _al_xwin_mouse_button_press_handler(int x_button,
 
    _al_event_source_lock(&the_mouse.parent.es);
    {
+      _al_seqlock_write_begin(&the_mouse.state_lock);
       the_mouse.state.buttons |= (1 << (al_button - 1));
       the_mouse.state.pressure = the_mouse.state.buttons ? 1.0 : 0.0; /* TODO */
+      _al_seqlock_write_end(&the_mouse.state_lock);
 
       generate_mouse_event(
          ALLEGRO_EVENT_MOUSE_BUTTON_DOWN,
@@ -373,8 +381,10 @@ static void wheel_motion_handler(int x_button, ALLEGRO_DISPLAY *display)
 
    _al_event_source_lock(&the_mouse.parent.es);
    {
+      _al_seqlock_write_begin(&the_mouse.state_lock);
       the_mouse.state.z += dz;
       the_mouse.state.w += dw;
+      _al_seqlock_write_end(&the_mouse.state_lock);
 
       generate_mouse_event(
          ALLEGRO_EVENT_MOUSE_AXES,
@@ -406,8 +416,10 @@ void _al_xwin_mouse_button_release_handler(int x_button,
 
    _al_event_source_lock(&the_mouse.parent.es);
    {
+      _al_seqlock_write_begin(&the_mouse.state_lock);
       the_mouse.state.buttons &=~ (1 << (al_button - 1));
       the_mouse.state.pressure = the_mouse.state.buttons ? 1.0 : 0.0; /* TODO */
+      _al_seqlock_write_end(&the_mouse.state_lock);
 
       generate_mouse_event(
          ALLEGRO_EVENT_MOUSE_BUTTON_UP,
@@ -452,9 +464,11 @@ void _al_xwin_mouse_motion_notify_handler(int x, int y,
    int dx = x - the_mouse.state.x;
    int dy = y - the_mouse.state.y;
 
+   _al_seqlock_write_begin(&the_mouse.state_lock);
    the_mouse.state.x = x;
    the_mouse.state.y = y;
    the_mouse.state.display = display;
+   _al_seqlock_write_end(&the_mouse.state_lock);
 
    generate_mouse_event(
       event_type,
@@ -507,7 +521,7 @@ static void generate_mouse_event(unsigned int type,
 {
    ALLEGRO_EVENT event;
 
-   if (!_al_event_source_needs_to_generate_event(&the_mouse.parent.es))
+   if (!_al_event_source_wants_event_type(&the_mouse.parent.es, type))
       return;
 
    event.mouse.type = type;
@@ -544,6 +558,7 @@ void _al_xwin_mouse_switch_handler(ALLEGRO_DISPLAY *display,
 
    _al_event_source_lock(&the_mouse.parent.es);
 
+   _al_seqlock_write_begin(&the_mouse.state_lock);
    switch (event->type) {
       case EnterNotify:
          the_mouse.state.display = display;
@@ -562,6 +577,7 @@ void _al_xwin_mouse_switch_handler(ALLEGRO_DISPLAY *display,
          event_type = 0;
          break;
    }
+   _al_seqlock_write_end(&the_mouse.state_lock);
 
    generate_mouse_event(
       event_type,